@@ -54,6 +54,11 @@ UPB_DEFAULT_CPPOPTS = select({
 
 UPB_DEFAULT_COPTS = select({
     "//:windows": [],
+    "//:fasttable_trampoline_setting": [
+        "-std=gnu99",
+        "-DUPB_ENABLE_FASTTABLE",
+        "-DUPB_FASTTABLE_FORCE_TRAMPOLINE",
+    ],
     "//:fasttable_enabled_setting": ["-std=gnu99", "-DUPB_ENABLE_FASTTABLE"],
     "//conditions:default": _DEFAULT_COPTS,
 })
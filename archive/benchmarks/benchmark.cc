@@ -32,6 +32,8 @@
 
 #include <string.h>
 
+#include <random>
+#include <string>
 #include <vector>
 
 #include "google/ads/googleads/v13/services/google_ads_service.upbdefs.h"
@@ -44,7 +46,13 @@
 #include "benchmarks/descriptor_sv.pb.h"
 #include "upb/base/internal/log2.h"
 #include "upb/mem/arena.h"
+#include "upb/mem/arena.hpp"
+#include "upb/message/message.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.hpp"
+#include "upb/mini_descriptor/internal/modifiers.h"
 #include "upb/reflection/def.hpp"
+#include "upb/wire/decode.h"
 
 upb_StringView descriptor = benchmarks_descriptor_proto_upbdefinit.descriptor;
 namespace protobuf = ::google::protobuf;
@@ -53,6 +61,14 @@ namespace protobuf = ::google::protobuf;
 // We use 64-bit ints here to force alignment.
 int64_t buf[8191];
 
+void AppendVarint(std::string* out, uint64_t val) {
+  while (val >= 0x80) {
+    out->push_back(static_cast<char>(val | 0x80));
+    val >>= 7;
+  }
+  out->push_back(static_cast<char>(val));
+}
+
 void CollectFileDescriptors(
     const _upb_DefPool_Init* file,
     std::vector<upb_StringView>& serialized_files,
@@ -290,6 +306,99 @@ BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, UseArena, Alias);
 BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, InitBlock, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, InitBlock, Alias);
 
+// Many small fields that alternate between two repeated fields, so the cost is
+// dominated by dispatching from one field to the next.  Useful for comparing
+// fasttable dispatch strategies (see compare.py --trampoline).
+static void BM_Parse_Upb_InterleavedFields(benchmark::State& state) {
+  std::string data;
+  for (int i = 0; i < 1000; i++) {
+    data.append("\x50\x01", 2);  // public_dependency: 1
+    data.append("\x58\x02", 2);  // weak_dependency: 2
+  }
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_Init(buf, sizeof(buf), nullptr);
+    upb_benchmark_FileDescriptorProto* file =
+        upb_benchmark_FileDescriptorProto_parse(data.data(), data.size(),
+                                                arena);
+    if (!file) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Parse_Upb_InterleavedFields);
+
+// Value-width distributions for BM_Parse_Upb_PackedVarint.
+enum VarintWidth {
+  kVarintWidth_OneByte,   // Small values, e.g. counts or enum values.
+  kVarintWidth_TwoBytes,  // Values in [128, 16384).
+  kVarintWidth_Mixed,     // Uniformly random widths from 1 to 10 bytes.
+  kVarintWidth_TenBytes,  // e.g. negative int32/int64 values.
+};
+
+// A single packed repeated field with many elements, as found in metrics or
+// telemetry payloads.  Exercises the bulk packed varint decoder.
+template <upb_FieldType kType>
+static void BM_Parse_Upb_PackedVarint(benchmark::State& state) {
+  const int kElements = 10000;
+  upb::Arena table_arena;
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kType, 1,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  upb_MiniTable* table = upb_MiniTable_Build(
+      e.data().data(), e.data().size(), table_arena.ptr(), nullptr);
+
+  std::mt19937_64 rng(0);
+  std::string body;
+  for (int i = 0; i < kElements; i++) {
+    uint64_t val = rng();
+    switch (state.range(0)) {
+      case kVarintWidth_OneByte:
+        val &= 0x7f;
+        break;
+      case kVarintWidth_TwoBytes:
+        val = 0x80 | (val & 0x3fff);
+        break;
+      case kVarintWidth_Mixed:
+        val >>= 7 * (rng() % 10);
+        break;
+      case kVarintWidth_TenBytes:
+        val |= 1ULL << 63;
+        break;
+    }
+    AppendVarint(&body, val);
+  }
+  std::string data = "\x0a";
+  AppendVarint(&data, body.size());
+  data += body;
+
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_Message* msg = upb_Message_New(table, arena);
+    if (upb_Decode(data.data(), data.size(), msg, table, nullptr, 0, arena) !=
+        kUpb_DecodeStatus_Ok) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedVarint, kUpb_FieldType_Int32)
+    ->DenseRange(kVarintWidth_OneByte, kVarintWidth_TenBytes);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedVarint, kUpb_FieldType_UInt32)
+    ->DenseRange(kVarintWidth_OneByte, kVarintWidth_TenBytes);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedVarint, kUpb_FieldType_Int64)
+    ->DenseRange(kVarintWidth_OneByte, kVarintWidth_TenBytes);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedVarint, kUpb_FieldType_SInt64)
+    ->DenseRange(kVarintWidth_OneByte, kVarintWidth_TenBytes);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedVarint, kUpb_FieldType_Bool)
+    ->DenseRange(kVarintWidth_OneByte, kVarintWidth_TenBytes);
+
 template <ArenaMode AMode, class P>
 struct Proto2Factory;
 
@@ -58,7 +58,8 @@ def GitWorktree(commit):
 def Run(cmd):
   subprocess.check_call(cmd, shell=True)
 
-def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
+def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False,
+              trampoline=False):
   tmpfile = "/tmp/bench-output.json"
   Run("rm -rf {}".format(tmpfile))
   #Run("CC=clang bazel test ...")
@@ -66,6 +67,8 @@ def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
     extra_args = " --//:fasttable_enabled=true"
   else:
     extra_args = ""
+  if trampoline:
+    extra_args += " --//:fasttable_force_trampoline=true"
 
   if bench_cpu:
     Run("CC=clang bazel build -c opt --copt=-march=native benchmarks:benchmark" + extra_args)
@@ -95,19 +98,25 @@ baseline = "main"
 bench_cpu = True
 fasttable = False
 
-if len(sys.argv) > 1:
-  baseline = sys.argv[1]
+if len(sys.argv) > 1 and sys.argv[1] == "--trampoline":
+  # Compares the fasttable trampoline (used when the compiler does not
+  # guarantee tail calls) against tail calls, both in the current directory.
+  Benchmark("/tmp/new", bench_cpu, fasttable=True, trampoline=True)
+  Benchmark("/tmp/old", bench_cpu, fasttable=True)
+else:
+  if len(sys.argv) > 1:
+    baseline = sys.argv[1]
 
-  # Quickly verify that the baseline exists.
-  with GitWorktree(baseline):
-    pass
+    # Quickly verify that the baseline exists.
+    with GitWorktree(baseline):
+      pass
 
-# Benchmark our current directory first, since it's more likely to be broken.
-Benchmark("/tmp/new", bench_cpu, fasttable=fasttable)
+  # Benchmark our current directory first, since it's more likely to be broken.
+  Benchmark("/tmp/new", bench_cpu, fasttable=fasttable)
 
-# Benchmark the baseline.
-with GitWorktree(baseline):
-  Benchmark("/tmp/old", bench_cpu, fasttable=fasttable)
+  # Benchmark the baseline.
+  with GitWorktree(baseline):
+    Benchmark("/tmp/old", bench_cpu, fasttable=fasttable)
 
 print()
 print()
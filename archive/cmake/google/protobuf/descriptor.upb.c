@@ -25,6 +25,8 @@ const upb_MiniTable google_protobuf_FileDescriptorSet_msg_init = {
   &google_protobuf_FileDescriptorSet_submsgs[0],
   &google_protobuf_FileDescriptorSet__fields[0],
   8, 1, kUpb_ExtMode_NonExtendable, 1, UPB_FASTTABLE_MASK(8), 0,
+  NULL,
+  NULL,
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000000003f00000a, &upb_prm_1bt_max192b},
@@ -56,10 +58,28 @@ static const upb_MiniTableField google_protobuf_FileDescriptorProto__fields[13]
   {13, UPB_SIZE(64, 128), 6, kUpb_NoSub, 12, (int)kUpb_FieldMode_Scalar | (int)kUpb_LabelFlags_IsAlternate | ((int)kUpb_FieldRep_StringView << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_FileDescriptorProto__encode_table[13] = {
+  {UPB_SIZE(0x000000010028000a, 0x000000010008000a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200300012, 0x0000000200180012), &upb_ehs_1bt},
+  {0x0000000000000002, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000004, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000005, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000006, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x0004000300180042, 0x0004000300500042), &upb_ehm_1bt},
+  {UPB_SIZE(0x00050004001c004a, 0x000500040058004a), &upb_ehm_1bt},
+  {0x0000000000000009, &_upb_FastEncoder_EncodeGeneric},
+  {0x000000000000000a, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x0000000500380062, 0x0000000500700062), &upb_ehs_1bt},
+  {UPB_SIZE(0x000000060040006a, 0x000000060080006a), &upb_ehs_1bt},
+};
+
 const upb_MiniTable google_protobuf_FileDescriptorProto_msg_init = {
   &google_protobuf_FileDescriptorProto_submsgs[0],
   &google_protobuf_FileDescriptorProto__fields[0],
   UPB_SIZE(72, 144), 13, kUpb_ExtMode_NonExtendable, 13, UPB_FASTTABLE_MASK(120), 0,
+  NULL,
+  &google_protobuf_FileDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -104,10 +124,25 @@ static const upb_MiniTableField google_protobuf_DescriptorProto__fields[10] = {
   {10, UPB_SIZE(36, 88), 0, kUpb_NoSub, 12, (int)kUpb_FieldMode_Array | (int)kUpb_LabelFlags_IsAlternate | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_DescriptorProto__encode_table[10] = {
+  {UPB_SIZE(0x000000010028000a, 0x000000010008000a), &upb_ehs_1bt},
+  {0x0000000000000001, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000002, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000004, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000005, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x000500020018003a, 0x000500020040003a), &upb_ehm_1bt},
+  {0x0000000000000007, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000008, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000009, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_DescriptorProto_msg_init = {
   &google_protobuf_DescriptorProto_submsgs[0],
   &google_protobuf_DescriptorProto__fields[0],
   UPB_SIZE(48, 96), 10, kUpb_ExtMode_NonExtendable, 10, UPB_FASTTABLE_MASK(120), 0,
+  NULL,
+  &google_protobuf_DescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -138,10 +173,18 @@ static const upb_MiniTableField google_protobuf_DescriptorProto_ExtensionRange__
   {3, UPB_SIZE(12, 16), 3, 0, 11, (int)kUpb_FieldMode_Scalar | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_DescriptorProto_ExtensionRange__encode_table[3] = {
+  {0x0000000100040008, &upb_ehv4_1bt},
+  {0x0000000200080010, &upb_ehv4_1bt},
+  {UPB_SIZE(0x00000003000c001a, 0x000000030010001a), &upb_ehm_1bt},
+};
+
 const upb_MiniTable google_protobuf_DescriptorProto_ExtensionRange_msg_init = {
   &google_protobuf_DescriptorProto_ExtensionRange_submsgs[0],
   &google_protobuf_DescriptorProto_ExtensionRange__fields[0],
   UPB_SIZE(16, 24), 3, kUpb_ExtMode_NonExtendable, 3, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_DescriptorProto_ExtensionRange__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0004000001000008, &upb_psv4_1bt},
@@ -155,10 +198,17 @@ static const upb_MiniTableField google_protobuf_DescriptorProto_ReservedRange__f
   {2, 8, 2, kUpb_NoSub, 5, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_4Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_DescriptorProto_ReservedRange__encode_table[2] = {
+  {0x0000000100040008, &upb_ehv4_1bt},
+  {0x0000000200080010, &upb_ehv4_1bt},
+};
+
 const upb_MiniTable google_protobuf_DescriptorProto_ReservedRange_msg_init = {
   NULL,
   &google_protobuf_DescriptorProto_ReservedRange__fields[0],
   16, 2, kUpb_ExtMode_NonExtendable, 2, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_DescriptorProto_ReservedRange__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0004000001000008, &upb_psv4_1bt},
@@ -181,10 +231,27 @@ static const upb_MiniTableField google_protobuf_ExtensionRangeOptions__fields[4]
   {999, UPB_SIZE(16, 24), 0, 2, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_ExtensionRangeOptions__field_hash_slots[8] = {
+  0, 1, 0, 4, 0, 0, 2, 3,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_ExtensionRangeOptions__field_hash = {
+  &google_protobuf_ExtensionRangeOptions__field_hash_slots[0], 0x9e3779b1, 29,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_ExtensionRangeOptions__encode_table[4] = {
+  {0x0000000000000000, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x0003000100080018, 0x0003000100040018), &upb_ehv4_1bt},
+  {UPB_SIZE(0x00010002000c0392, 0x0001000200100392), &upb_ehm_2bt},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_ExtensionRangeOptions_msg_init = {
   &google_protobuf_ExtensionRangeOptions_submsgs[0],
   &google_protobuf_ExtensionRangeOptions__fields[0],
   UPB_SIZE(24, 32), 4, kUpb_ExtMode_Extendable, 0, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_ExtensionRangeOptions__field_hash,
+  &google_protobuf_ExtensionRangeOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -229,10 +296,20 @@ static const upb_MiniTableField google_protobuf_ExtensionRangeOptions_Declaratio
   {6, 9, 5, kUpb_NoSub, 8, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_1Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_ExtensionRangeOptions_Declaration__encode_table[5] = {
+  {0x0000000100040008, &upb_ehv4_1bt},
+  {UPB_SIZE(0x00000002000c0012, 0x0000000200100012), &upb_ehs_1bt},
+  {UPB_SIZE(0x000000030014001a, 0x000000030020001a), &upb_ehs_1bt},
+  {0x0000000400080028, &upb_ehb1_1bt},
+  {0x0000000500090030, &upb_ehb1_1bt},
+};
+
 const upb_MiniTable google_protobuf_ExtensionRangeOptions_Declaration_msg_init = {
   NULL,
   &google_protobuf_ExtensionRangeOptions_Declaration__fields[0],
   UPB_SIZE(32, 48), 5, kUpb_ExtMode_NonExtendable, 3, UPB_FASTTABLE_MASK(56), 0,
+  NULL,
+  &google_protobuf_ExtensionRangeOptions_Declaration__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0004000001000008, &upb_psv4_1bt},
@@ -265,10 +342,26 @@ static const upb_MiniTableField google_protobuf_FieldDescriptorProto__fields[11]
   {17, UPB_SIZE(24, 20), 11, kUpb_NoSub, 8, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_1Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_FieldDescriptorProto__encode_table[11] = {
+  {UPB_SIZE(0x00000001001c000a, 0x000000010018000a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200240012, 0x0000000200280012), &upb_ehs_1bt},
+  {0x0000000300040018, &upb_ehv4_1bt},
+  {0x0001000400080020, &upb_ehv4_1bt},
+  {0x00020005000c0028, &upb_ehv4_1bt},
+  {UPB_SIZE(0x00000006002c0032, 0x0000000600380032), &upb_ehs_1bt},
+  {UPB_SIZE(0x000000070034003a, 0x000000070048003a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000800100042, 0x0000000800580042), &upb_ehm_1bt},
+  {UPB_SIZE(0x0000000900140048, 0x0000000900100048), &upb_ehv4_1bt},
+  {UPB_SIZE(0x0000000a003c0052, 0x0000000a00600052), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000b00180188, 0x0000000b00140188), &upb_ehb1_2bt},
+};
+
 const upb_MiniTable google_protobuf_FieldDescriptorProto_msg_init = {
   &google_protobuf_FieldDescriptorProto_submsgs[0],
   &google_protobuf_FieldDescriptorProto__fields[0],
   UPB_SIZE(72, 112), 11, kUpb_ExtMode_NonExtendable, 10, UPB_FASTTABLE_MASK(248), 0,
+  NULL,
+  &google_protobuf_FieldDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x001800000100000a, &upb_pss_1bt},
@@ -314,10 +407,17 @@ static const upb_MiniTableField google_protobuf_OneofDescriptorProto__fields[2]
   {2, UPB_SIZE(4, 24), 2, 0, 11, (int)kUpb_FieldMode_Scalar | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_OneofDescriptorProto__encode_table[2] = {
+  {0x000000010008000a, &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200040012, 0x0000000200180012), &upb_ehm_1bt},
+};
+
 const upb_MiniTable google_protobuf_OneofDescriptorProto_msg_init = {
   &google_protobuf_OneofDescriptorProto_submsgs[0],
   &google_protobuf_OneofDescriptorProto__fields[0],
   UPB_SIZE(16, 32), 2, kUpb_ExtMode_NonExtendable, 2, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_OneofDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -340,10 +440,20 @@ static const upb_MiniTableField google_protobuf_EnumDescriptorProto__fields[5] =
   {5, UPB_SIZE(16, 48), 0, kUpb_NoSub, 12, (int)kUpb_FieldMode_Array | (int)kUpb_LabelFlags_IsAlternate | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_EnumDescriptorProto__encode_table[5] = {
+  {UPB_SIZE(0x000000010014000a, 0x000000010008000a), &upb_ehs_1bt},
+  {0x0000000000000001, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x000100020008001a, 0x000100020020001a), &upb_ehm_1bt},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+  {0x0000000000000004, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_EnumDescriptorProto_msg_init = {
   &google_protobuf_EnumDescriptorProto_submsgs[0],
   &google_protobuf_EnumDescriptorProto__fields[0],
   UPB_SIZE(32, 56), 5, kUpb_ExtMode_NonExtendable, 5, UPB_FASTTABLE_MASK(56), 0,
+  NULL,
+  &google_protobuf_EnumDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -361,10 +471,17 @@ static const upb_MiniTableField google_protobuf_EnumDescriptorProto_EnumReserved
   {2, 8, 2, kUpb_NoSub, 5, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_4Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_EnumDescriptorProto_EnumReservedRange__encode_table[2] = {
+  {0x0000000100040008, &upb_ehv4_1bt},
+  {0x0000000200080010, &upb_ehv4_1bt},
+};
+
 const upb_MiniTable google_protobuf_EnumDescriptorProto_EnumReservedRange_msg_init = {
   NULL,
   &google_protobuf_EnumDescriptorProto_EnumReservedRange__fields[0],
   16, 2, kUpb_ExtMode_NonExtendable, 2, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_EnumDescriptorProto_EnumReservedRange__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0004000001000008, &upb_psv4_1bt},
@@ -383,10 +500,18 @@ static const upb_MiniTableField google_protobuf_EnumValueDescriptorProto__fields
   {3, UPB_SIZE(8, 24), 3, 0, 11, (int)kUpb_FieldMode_Scalar | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_EnumValueDescriptorProto__encode_table[3] = {
+  {UPB_SIZE(0x00000001000c000a, 0x000000010008000a), &upb_ehs_1bt},
+  {0x0000000200040010, &upb_ehv4_1bt},
+  {UPB_SIZE(0x000000030008001a, 0x000000030018001a), &upb_ehm_1bt},
+};
+
 const upb_MiniTable google_protobuf_EnumValueDescriptorProto_msg_init = {
   &google_protobuf_EnumValueDescriptorProto_submsgs[0],
   &google_protobuf_EnumValueDescriptorProto__fields[0],
   UPB_SIZE(24, 32), 3, kUpb_ExtMode_NonExtendable, 3, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_EnumValueDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -406,10 +531,18 @@ static const upb_MiniTableField google_protobuf_ServiceDescriptorProto__fields[3
   {3, UPB_SIZE(8, 32), 2, 1, 11, (int)kUpb_FieldMode_Scalar | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_ServiceDescriptorProto__encode_table[3] = {
+  {UPB_SIZE(0x00000001000c000a, 0x000000010008000a), &upb_ehs_1bt},
+  {0x0000000000000001, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x000100020008001a, 0x000100020020001a), &upb_ehm_1bt},
+};
+
 const upb_MiniTable google_protobuf_ServiceDescriptorProto_msg_init = {
   &google_protobuf_ServiceDescriptorProto_submsgs[0],
   &google_protobuf_ServiceDescriptorProto__fields[0],
   UPB_SIZE(24, 40), 3, kUpb_ExtMode_NonExtendable, 3, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_ServiceDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -431,10 +564,21 @@ static const upb_MiniTableField google_protobuf_MethodDescriptorProto__fields[6]
   {6, UPB_SIZE(9, 2), 6, kUpb_NoSub, 8, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_1Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_MethodDescriptorProto__encode_table[6] = {
+  {UPB_SIZE(0x00000001000c000a, 0x000000010008000a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200140012, 0x0000000200180012), &upb_ehs_1bt},
+  {UPB_SIZE(0x00000003001c001a, 0x000000030028001a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000400040022, 0x0000000400380022), &upb_ehm_1bt},
+  {UPB_SIZE(0x0000000500080028, 0x0000000500010028), &upb_ehb1_1bt},
+  {UPB_SIZE(0x0000000600090030, 0x0000000600020030), &upb_ehb1_1bt},
+};
+
 const upb_MiniTable google_protobuf_MethodDescriptorProto_msg_init = {
   &google_protobuf_MethodDescriptorProto_submsgs[0],
   &google_protobuf_MethodDescriptorProto__fields[0],
   UPB_SIZE(40, 64), 6, kUpb_ExtMode_NonExtendable, 6, UPB_FASTTABLE_MASK(56), 0,
+  NULL,
+  &google_protobuf_MethodDescriptorProto__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -478,10 +622,48 @@ static const upb_MiniTableField google_protobuf_FileOptions__fields[22] = {
   {999, UPB_SIZE(24, 192), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_FileOptions__field_hash_slots[64] = {
+  0, 19, 10, 0, 0, 0, 0, 11, 0, 0, 21, 2, 0, 12, 4, 0,
+  0, 0, 0, 0, 0, 0, 14, 6, 0, 15, 8, 0, 17, 9, 0, 0,
+  0, 0, 20, 0, 0, 0, 22, 0, 0, 0, 0, 0, 0, 3, 0, 0,
+  5, 0, 0, 0, 0, 13, 0, 0, 0, 7, 0, 16, 0, 0, 18, 0,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_FileOptions__field_hash = {
+  &google_protobuf_FileOptions__field_hash_slots[0], 0x85ebca77, 26,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_FileOptions__encode_table[22] = {
+  {UPB_SIZE(0x00000001001c000a, 0x000000010018000a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200240042, 0x0000000200280042), &upb_ehs_1bt},
+  {0x0002000300040048, &upb_ehv4_1bt},
+  {0x0000000400080050, &upb_ehb1_1bt},
+  {UPB_SIZE(0x00000005002c005a, 0x000000050038005a), &upb_ehs_1bt},
+  {0x0000000600090180, &upb_ehb1_2bt},
+  {0x00000007000a0188, &upb_ehb1_2bt},
+  {0x00000008000b0190, &upb_ehb1_2bt},
+  {0x00000009000c01a0, &upb_ehb1_2bt},
+  {0x0000000a000d01b8, &upb_ehb1_2bt},
+  {0x0000000b000e01d8, &upb_ehb1_2bt},
+  {0x0000000c000f01f8, &upb_ehb1_2bt},
+  {UPB_SIZE(0x0000000d003402a2, 0x0000000d004802a2), &upb_ehs_2bt},
+  {UPB_SIZE(0x0000000e003c02aa, 0x0000000e005802aa), &upb_ehs_2bt},
+  {UPB_SIZE(0x0000000f004402ba, 0x0000000f006802ba), &upb_ehs_2bt},
+  {UPB_SIZE(0x00000010004c02c2, 0x00000010007802c2), &upb_ehs_2bt},
+  {UPB_SIZE(0x00000011005402ca, 0x00000011008802ca), &upb_ehs_2bt},
+  {0x00000012001002d0, &upb_ehb1_2bt},
+  {UPB_SIZE(0x00000013005c02e2, 0x00000013009802e2), &upb_ehs_2bt},
+  {UPB_SIZE(0x00000014006402ea, 0x0000001400a802ea), &upb_ehs_2bt},
+  {UPB_SIZE(0x0000001500140392, 0x0000001500b80392), &upb_ehm_2bt},
+  {0x0000000000000015, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_FileOptions_msg_init = {
   &google_protobuf_FileOptions_submsgs[0],
   &google_protobuf_FileOptions__fields[0],
   UPB_SIZE(112, 200), 22, kUpb_ExtMode_Extendable, 1, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_FileOptions__field_hash,
+  &google_protobuf_FileOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x001800000100000a, &upb_pss_1bt},
@@ -533,10 +715,30 @@ static const upb_MiniTableField google_protobuf_MessageOptions__fields[7] = {
   {999, UPB_SIZE(12, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_MessageOptions__field_hash_slots[8] = {
+  0, 0, 6, 0, 7, 4, 5, 0,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_MessageOptions__field_hash = {
+  &google_protobuf_MessageOptions__field_hash_slots[0], 0x85ebca77, 29,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_MessageOptions__encode_table[7] = {
+  {0x0000000100010008, &upb_ehb1_1bt},
+  {0x0000000200020010, &upb_ehb1_1bt},
+  {0x0000000300030018, &upb_ehb1_1bt},
+  {0x0000000400040038, &upb_ehb1_1bt},
+  {0x0000000500050058, &upb_ehb1_1bt},
+  {0x0000000600080062, &upb_ehm_1bt},
+  {0x0000000000000006, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_MessageOptions_msg_init = {
   &google_protobuf_MessageOptions_submsgs[0],
   &google_protobuf_MessageOptions__fields[0],
   UPB_SIZE(16, 24), 7, kUpb_ExtMode_Extendable, 3, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_MessageOptions__field_hash,
+  &google_protobuf_MessageOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0001000001000008, &upb_psb1_1bt},
@@ -599,10 +801,37 @@ static const upb_MiniTableField google_protobuf_FieldOptions__fields[13] = {
   {999, UPB_SIZE(36, 48), 0, 2, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_FieldOptions__field_hash_slots[32] = {
+  0, 0, 4, 0, 0, 6, 0, 0, 7, 0, 0, 11, 0, 13, 0, 0,
+  9, 0, 0, 0, 0, 0, 5, 10, 0, 0, 0, 0, 8, 0, 0, 12,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_FieldOptions__field_hash = {
+  &google_protobuf_FieldOptions__field_hash_slots[0], 0x9e3779b1, 27,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_FieldOptions__encode_table[13] = {
+  {0x0003000100040008, &upb_ehv4_1bt},
+  {0x0000000200080010, &upb_ehb1_1bt},
+  {0x0000000300090018, &upb_ehb1_1bt},
+  {0x00000004000a0028, &upb_ehb1_1bt},
+  {0x00040005000c0030, &upb_ehv4_1bt},
+  {0x0000000600100050, &upb_ehb1_1bt},
+  {0x0000000700110078, &upb_ehb1_1bt},
+  {0x0000000800120180, &upb_ehb1_2bt},
+  {0x0005000900140188, &upb_ehv4_2bt},
+  {0x0000000000000009, &_upb_FastEncoder_EncodeGeneric},
+  {0x000000000000000a, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x0001000a002001aa, 0x0001000a002801aa), &upb_ehm_2bt},
+  {0x000000000000000c, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_FieldOptions_msg_init = {
   &google_protobuf_FieldOptions_submsgs[0],
   &google_protobuf_FieldOptions__fields[0],
   UPB_SIZE(40, 56), 13, kUpb_ExtMode_Extendable, 3, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_FieldOptions__field_hash,
+  &google_protobuf_FieldOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -644,10 +873,17 @@ static const upb_MiniTableField google_protobuf_FieldOptions_EditionDefault__fie
   {2, UPB_SIZE(12, 24), 2, kUpb_NoSub, 12, (int)kUpb_FieldMode_Scalar | (int)kUpb_LabelFlags_IsAlternate | ((int)kUpb_FieldRep_StringView << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_FieldOptions_EditionDefault__encode_table[2] = {
+  {UPB_SIZE(0x000000010004000a, 0x000000010008000a), &upb_ehs_1bt},
+  {UPB_SIZE(0x00000002000c0012, 0x0000000200180012), &upb_ehs_1bt},
+};
+
 const upb_MiniTable google_protobuf_FieldOptions_EditionDefault_msg_init = {
   NULL,
   &google_protobuf_FieldOptions_EditionDefault__fields[0],
   UPB_SIZE(24, 40), 2, kUpb_ExtMode_NonExtendable, 2, UPB_FASTTABLE_MASK(24), 0,
+  NULL,
+  &google_protobuf_FieldOptions_EditionDefault__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -666,10 +902,17 @@ static const upb_MiniTableField google_protobuf_OneofOptions__fields[2] = {
   {999, UPB_SIZE(8, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_OneofOptions__encode_table[2] = {
+  {UPB_SIZE(0x000000010004000a, 0x000000010008000a), &upb_ehm_1bt},
+  {0x0000000000000001, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_OneofOptions_msg_init = {
   &google_protobuf_OneofOptions_submsgs[0],
   &google_protobuf_OneofOptions__fields[0],
   UPB_SIZE(16, 24), 2, kUpb_ExtMode_Extendable, 1, UPB_FASTTABLE_MASK(248), 0,
+  NULL,
+  &google_protobuf_OneofOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_psm_1bt_max64b},
@@ -719,10 +962,28 @@ static const upb_MiniTableField google_protobuf_EnumOptions__fields[5] = {
   {999, UPB_SIZE(8, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_EnumOptions__field_hash_slots[16] = {
+  0, 0, 0, 1, 0, 4, 5, 0, 0, 0, 0, 3, 0, 2, 0, 0,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_EnumOptions__field_hash = {
+  &google_protobuf_EnumOptions__field_hash_slots[0], 0x9e3779b1, 28,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_EnumOptions__encode_table[5] = {
+  {0x0000000100010010, &upb_ehb1_1bt},
+  {0x0000000200020018, &upb_ehb1_1bt},
+  {0x0000000300030030, &upb_ehb1_1bt},
+  {UPB_SIZE(0x000000040004003a, 0x000000040008003a), &upb_ehm_1bt},
+  {0x0000000000000004, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_EnumOptions_msg_init = {
   &google_protobuf_EnumOptions_submsgs[0],
   &google_protobuf_EnumOptions__fields[0],
   UPB_SIZE(16, 24), 5, kUpb_ExtMode_Extendable, 0, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_EnumOptions__field_hash,
+  &google_protobuf_EnumOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -771,10 +1032,19 @@ static const upb_MiniTableField google_protobuf_EnumValueOptions__fields[4] = {
   {999, UPB_SIZE(12, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_EnumValueOptions__encode_table[4] = {
+  {0x0000000100010008, &upb_ehb1_1bt},
+  {UPB_SIZE(0x0000000200040012, 0x0000000200080012), &upb_ehm_1bt},
+  {UPB_SIZE(0x0000000300080018, 0x0000000300020018), &upb_ehb1_1bt},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_EnumValueOptions_msg_init = {
   &google_protobuf_EnumValueOptions_submsgs[0],
   &google_protobuf_EnumValueOptions__fields[0],
   UPB_SIZE(16, 24), 4, kUpb_ExtMode_Extendable, 3, UPB_FASTTABLE_MASK(248), 0,
+  NULL,
+  &google_protobuf_EnumValueOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0001000001000008, &upb_psb1_1bt},
@@ -822,10 +1092,18 @@ static const upb_MiniTableField google_protobuf_ServiceOptions__fields[3] = {
   {999, UPB_SIZE(8, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_ServiceOptions__encode_table[3] = {
+  {0x0000000100010288, &upb_ehb1_2bt},
+  {UPB_SIZE(0x0000000200040292, 0x0000000200080292), &upb_ehm_2bt},
+  {0x0000000000000002, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_ServiceOptions_msg_init = {
   &google_protobuf_ServiceOptions_submsgs[0],
   &google_protobuf_ServiceOptions__fields[0],
   UPB_SIZE(16, 24), 3, kUpb_ExtMode_Extendable, 0, UPB_FASTTABLE_MASK(248), 0,
+  NULL,
+  &google_protobuf_ServiceOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -875,10 +1153,27 @@ static const upb_MiniTableField google_protobuf_MethodOptions__fields[4] = {
   {999, UPB_SIZE(12, 16), 0, 1, 11, (int)kUpb_FieldMode_Array | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_MethodOptions__field_hash_slots[8] = {
+  0, 0, 0, 4, 1, 2, 3, 0,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_MethodOptions__field_hash = {
+  &google_protobuf_MethodOptions__field_hash_slots[0], 0x1b873593, 29,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_MethodOptions__encode_table[4] = {
+  {0x0000000100010288, &upb_ehb1_2bt},
+  {0x0002000200040290, &upb_ehv4_2bt},
+  {0x000000030008029a, &upb_ehm_2bt},
+  {0x0000000000000003, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_MethodOptions_msg_init = {
   &google_protobuf_MethodOptions_submsgs[0],
   &google_protobuf_MethodOptions__fields[0],
   UPB_SIZE(16, 24), 4, kUpb_ExtMode_Extendable, 0, UPB_FASTTABLE_MASK(248), 0,
+  &google_protobuf_MethodOptions__field_hash,
+  &google_protobuf_MethodOptions__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -929,10 +1224,30 @@ static const upb_MiniTableField google_protobuf_UninterpretedOption__fields[7] =
   {8, UPB_SIZE(48, 72), 6, kUpb_NoSub, 12, (int)kUpb_FieldMode_Scalar | (int)kUpb_LabelFlags_IsAlternate | ((int)kUpb_FieldRep_StringView << kUpb_FieldRep_Shift)},
 };
 
+static const uint16_t google_protobuf_UninterpretedOption__field_hash_slots[16] = {
+  0, 4, 0, 1, 0, 6, 0, 3, 0, 0, 0, 5, 0, 2, 0, 7,
+};
+
+static const struct upb_MiniTableFieldHash google_protobuf_UninterpretedOption__field_hash = {
+  &google_protobuf_UninterpretedOption__field_hash_slots[0], 0x9e3779b1, 28,
+};
+
+static const _upb_FastEncoder_Entry google_protobuf_UninterpretedOption__encode_table[7] = {
+  {0x0000000000000000, &_upb_FastEncoder_EncodeGeneric},
+  {UPB_SIZE(0x000000010008001a, 0x000000010010001a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200100020, 0x0000000200200020), &upb_ehv8_1bt},
+  {UPB_SIZE(0x0000000300180028, 0x0000000300280028), &upb_ehv8_1bt},
+  {UPB_SIZE(0x0000000400200031, 0x0000000400300031), &upb_ehf8_1bt},
+  {UPB_SIZE(0x000000050028003a, 0x000000050038003a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000600300042, 0x0000000600480042), &upb_ehs_1bt},
+};
+
 const upb_MiniTable google_protobuf_UninterpretedOption_msg_init = {
   &google_protobuf_UninterpretedOption_submsgs[0],
   &google_protobuf_UninterpretedOption__fields[0],
   UPB_SIZE(56, 88), 7, kUpb_ExtMode_NonExtendable, 0, UPB_FASTTABLE_MASK(120), 0,
+  &google_protobuf_UninterpretedOption__field_hash,
+  &google_protobuf_UninterpretedOption__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -958,10 +1273,17 @@ static const upb_MiniTableField google_protobuf_UninterpretedOption_NamePart__fi
   {2, 1, 2, kUpb_NoSub, 8, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_1Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_UninterpretedOption_NamePart__encode_table[2] = {
+  {UPB_SIZE(0x000000010004000a, 0x000000010008000a), &upb_ehs_1bt},
+  {0x0000000200010010, &upb_ehb1_1bt},
+};
+
 const upb_MiniTable google_protobuf_UninterpretedOption_NamePart_msg_init = {
   NULL,
   &google_protobuf_UninterpretedOption_NamePart__fields[0],
   UPB_SIZE(16, 24), 2, kUpb_ExtMode_NonExtendable, 2, UPB_FASTTABLE_MASK(24), 2,
+  NULL,
+  &google_protobuf_UninterpretedOption_NamePart__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800000100000a, &upb_pss_1bt},
@@ -990,10 +1312,22 @@ static const upb_MiniTableField google_protobuf_FeatureSet__fields[7] = {
   {999, UPB_SIZE(28, 32), 7, 0, 11, (int)kUpb_FieldMode_Scalar | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_FeatureSet__encode_table[7] = {
+  {0x0001000100040008, &upb_ehv4_1bt},
+  {0x0002000200080010, &upb_ehv4_1bt},
+  {0x00030003000c0018, &upb_ehv4_1bt},
+  {0x0004000400100020, &upb_ehv4_1bt},
+  {0x0005000500140028, &upb_ehv4_1bt},
+  {0x0006000600180030, &upb_ehv4_1bt},
+  {UPB_SIZE(0x00000007001c3eba, 0x0000000700203eba), &upb_ehm_2bt},
+};
+
 const upb_MiniTable google_protobuf_FeatureSet_msg_init = {
   &google_protobuf_FeatureSet_submsgs[0],
   &google_protobuf_FeatureSet__fields[0],
   UPB_SIZE(32, 40), 7, kUpb_ExtMode_Extendable, 6, UPB_FASTTABLE_MASK(248), 0,
+  NULL,
+  &google_protobuf_FeatureSet__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
@@ -1042,6 +1376,8 @@ const upb_MiniTable google_protobuf_SourceCodeInfo_msg_init = {
   &google_protobuf_SourceCodeInfo_submsgs[0],
   &google_protobuf_SourceCodeInfo__fields[0],
   8, 1, kUpb_ExtMode_NonExtendable, 1, UPB_FASTTABLE_MASK(8), 0,
+  NULL,
+  NULL,
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000000003f00000a, &upb_prm_1bt_max128b},
@@ -1056,10 +1392,20 @@ static const upb_MiniTableField google_protobuf_SourceCodeInfo_Location__fields[
   {6, UPB_SIZE(12, 56), 0, kUpb_NoSub, 12, (int)kUpb_FieldMode_Array | (int)kUpb_LabelFlags_IsAlternate | ((int)UPB_SIZE(kUpb_FieldRep_4Byte, kUpb_FieldRep_8Byte) << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_SourceCodeInfo_Location__encode_table[5] = {
+  {UPB_SIZE(0x000000000004000a, 0x000000000008000a), &upb_epv4_1bt},
+  {UPB_SIZE(0x0000000000080012, 0x0000000000100012), &upb_epv4_1bt},
+  {UPB_SIZE(0x000000010010001a, 0x000000010018001a), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200180022, 0x0000000200280022), &upb_ehs_1bt},
+  {0x0000000000000004, &_upb_FastEncoder_EncodeGeneric},
+};
+
 const upb_MiniTable google_protobuf_SourceCodeInfo_Location_msg_init = {
   NULL,
   &google_protobuf_SourceCodeInfo_Location__fields[0],
   UPB_SIZE(32, 64), 5, kUpb_ExtMode_NonExtendable, 4, UPB_FASTTABLE_MASK(56), 0,
+  NULL,
+  &google_protobuf_SourceCodeInfo_Location__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000800003f00000a, &upb_ppv4_1bt},
@@ -1084,6 +1430,8 @@ const upb_MiniTable google_protobuf_GeneratedCodeInfo_msg_init = {
   &google_protobuf_GeneratedCodeInfo_submsgs[0],
   &google_protobuf_GeneratedCodeInfo__fields[0],
   8, 1, kUpb_ExtMode_NonExtendable, 1, UPB_FASTTABLE_MASK(8), 0,
+  NULL,
+  NULL,
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x000000003f00000a, &upb_prm_1bt_max64b},
@@ -1102,10 +1450,20 @@ static const upb_MiniTableField google_protobuf_GeneratedCodeInfo_Annotation__fi
   {5, UPB_SIZE(16, 12), 4, 0, 14, (int)kUpb_FieldMode_Scalar | ((int)kUpb_FieldRep_4Byte << kUpb_FieldRep_Shift)},
 };
 
+static const _upb_FastEncoder_Entry google_protobuf_GeneratedCodeInfo_Annotation__encode_table[5] = {
+  {UPB_SIZE(0x000000000004000a, 0x000000000010000a), &upb_epv4_1bt},
+  {UPB_SIZE(0x0000000100140012, 0x0000000100180012), &upb_ehs_1bt},
+  {UPB_SIZE(0x0000000200080018, 0x0000000200040018), &upb_ehv4_1bt},
+  {UPB_SIZE(0x00000003000c0020, 0x0000000300080020), &upb_ehv4_1bt},
+  {UPB_SIZE(0x0000000400100028, 0x00000004000c0028), &upb_ehv4_1bt},
+};
+
 const upb_MiniTable google_protobuf_GeneratedCodeInfo_Annotation_msg_init = {
   &google_protobuf_GeneratedCodeInfo_Annotation_submsgs[0],
   &google_protobuf_GeneratedCodeInfo_Annotation__fields[0],
   UPB_SIZE(32, 40), 5, kUpb_ExtMode_NonExtendable, 5, UPB_FASTTABLE_MASK(56), 0,
+  NULL,
+  &google_protobuf_GeneratedCodeInfo_Annotation__encode_table[0],
   UPB_FASTTABLE_INIT({
     {0x0000000000000000, &_upb_FastDecoder_DecodeGeneric},
     {0x001000003f00000a, &upb_ppv4_1bt},
@@ -844,8 +844,9 @@ UPB_INLINE struct google_protobuf_FileOptions* google_protobuf_FileDescriptorPro
   struct google_protobuf_FileOptions* sub = (struct google_protobuf_FileOptions*)google_protobuf_FileDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FileOptions*)_upb_Message_New(&google_protobuf_FileOptions_msg_init, arena);
-    if (sub) google_protobuf_FileDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FileDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_FileDescriptorProto_set_source_code_info(google_protobuf_FileDescriptorProto *msg, google_protobuf_SourceCodeInfo* value) {
@@ -856,8 +857,9 @@ UPB_INLINE struct google_protobuf_SourceCodeInfo* google_protobuf_FileDescriptor
   struct google_protobuf_SourceCodeInfo* sub = (struct google_protobuf_SourceCodeInfo*)google_protobuf_FileDescriptorProto_source_code_info(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_SourceCodeInfo*)_upb_Message_New(&google_protobuf_SourceCodeInfo_msg_init, arena);
-    if (sub) google_protobuf_FileDescriptorProto_set_source_code_info(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FileDescriptorProto_set_source_code_info(msg, sub);
   return sub;
 }
 UPB_INLINE int32_t* google_protobuf_FileDescriptorProto_mutable_public_dependency(google_protobuf_FileDescriptorProto* msg, size_t* size) {
@@ -1421,8 +1423,9 @@ UPB_INLINE struct google_protobuf_MessageOptions* google_protobuf_DescriptorProt
   struct google_protobuf_MessageOptions* sub = (struct google_protobuf_MessageOptions*)google_protobuf_DescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_MessageOptions*)_upb_Message_New(&google_protobuf_MessageOptions_msg_init, arena);
-    if (sub) google_protobuf_DescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_DescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_OneofDescriptorProto** google_protobuf_DescriptorProto_mutable_oneof_decl(google_protobuf_DescriptorProto* msg, size_t* size) {
@@ -1599,8 +1602,9 @@ UPB_INLINE struct google_protobuf_ExtensionRangeOptions* google_protobuf_Descrip
   struct google_protobuf_ExtensionRangeOptions* sub = (struct google_protobuf_ExtensionRangeOptions*)google_protobuf_DescriptorProto_ExtensionRange_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_ExtensionRangeOptions*)_upb_Message_New(&google_protobuf_ExtensionRangeOptions_msg_init, arena);
-    if (sub) google_protobuf_DescriptorProto_ExtensionRange_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_DescriptorProto_ExtensionRange_set_options(msg, sub);
   return sub;
 }
 
@@ -1857,8 +1861,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_ExtensionRangeOpti
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_ExtensionRangeOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_ExtensionRangeOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_ExtensionRangeOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_ExtensionRangeOptions_mutable_uninterpreted_option(google_protobuf_ExtensionRangeOptions* msg, size_t* size) {
@@ -2257,8 +2262,9 @@ UPB_INLINE struct google_protobuf_FieldOptions* google_protobuf_FieldDescriptorP
   struct google_protobuf_FieldOptions* sub = (struct google_protobuf_FieldOptions*)google_protobuf_FieldDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FieldOptions*)_upb_Message_New(&google_protobuf_FieldOptions_msg_init, arena);
-    if (sub) google_protobuf_FieldDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FieldDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_FieldDescriptorProto_set_oneof_index(google_protobuf_FieldDescriptorProto *msg, int32_t value) {
@@ -2352,8 +2358,9 @@ UPB_INLINE struct google_protobuf_OneofOptions* google_protobuf_OneofDescriptorP
   struct google_protobuf_OneofOptions* sub = (struct google_protobuf_OneofOptions*)google_protobuf_OneofDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_OneofOptions*)_upb_Message_New(&google_protobuf_OneofOptions_msg_init, arena);
-    if (sub) google_protobuf_OneofDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_OneofDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -2572,8 +2579,9 @@ UPB_INLINE struct google_protobuf_EnumOptions* google_protobuf_EnumDescriptorPro
   struct google_protobuf_EnumOptions* sub = (struct google_protobuf_EnumOptions*)google_protobuf_EnumDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_EnumOptions*)_upb_Message_New(&google_protobuf_EnumOptions_msg_init, arena);
-    if (sub) google_protobuf_EnumDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_EnumDescriptorProto_EnumReservedRange** google_protobuf_EnumDescriptorProto_mutable_reserved_range(google_protobuf_EnumDescriptorProto* msg, size_t* size) {
@@ -2799,8 +2807,9 @@ UPB_INLINE struct google_protobuf_EnumValueOptions* google_protobuf_EnumValueDes
   struct google_protobuf_EnumValueOptions* sub = (struct google_protobuf_EnumValueOptions*)google_protobuf_EnumValueDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_EnumValueOptions*)_upb_Message_New(&google_protobuf_EnumValueOptions_msg_init, arena);
-    if (sub) google_protobuf_EnumValueDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumValueDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -2945,8 +2954,9 @@ UPB_INLINE struct google_protobuf_ServiceOptions* google_protobuf_ServiceDescrip
   struct google_protobuf_ServiceOptions* sub = (struct google_protobuf_ServiceOptions*)google_protobuf_ServiceDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_ServiceOptions*)_upb_Message_New(&google_protobuf_ServiceOptions_msg_init, arena);
-    if (sub) google_protobuf_ServiceDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_ServiceDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -3096,8 +3106,9 @@ UPB_INLINE struct google_protobuf_MethodOptions* google_protobuf_MethodDescripto
   struct google_protobuf_MethodOptions* sub = (struct google_protobuf_MethodOptions*)google_protobuf_MethodDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_MethodOptions*)_upb_Message_New(&google_protobuf_MethodOptions_msg_init, arena);
-    if (sub) google_protobuf_MethodDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_MethodDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_MethodDescriptorProto_set_client_streaming(google_protobuf_MethodDescriptorProto *msg, bool value) {
@@ -3585,8 +3596,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_FileOptions_mutabl
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_FileOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_FileOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FileOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_FileOptions_mutable_uninterpreted_option(google_protobuf_FileOptions* msg, size_t* size) {
@@ -3807,8 +3819,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_MessageOptions_mut
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_MessageOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_MessageOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_MessageOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_MessageOptions_mutable_uninterpreted_option(google_protobuf_MessageOptions* msg, size_t* size) {
@@ -4229,8 +4242,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_FieldOptions_mutab
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_FieldOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_FieldOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FieldOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_FieldOptions_mutable_uninterpreted_option(google_protobuf_FieldOptions* msg, size_t* size) {
@@ -4431,8 +4445,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_OneofOptions_mutab
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_OneofOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_OneofOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_OneofOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_OneofOptions_mutable_uninterpreted_option(google_protobuf_OneofOptions* msg, size_t* size) {
@@ -4615,8 +4630,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_EnumOptions_mutabl
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_EnumOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_EnumOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_EnumOptions_mutable_uninterpreted_option(google_protobuf_EnumOptions* msg, size_t* size) {
@@ -4776,8 +4792,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_EnumValueOptions_m
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_EnumValueOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_EnumValueOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumValueOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_EnumValueOptions_set_debug_redact(google_protobuf_EnumValueOptions *msg, bool value) {
@@ -4926,8 +4943,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_ServiceOptions_mut
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_ServiceOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_ServiceOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_ServiceOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_ServiceOptions_mutable_uninterpreted_option(google_protobuf_ServiceOptions* msg, size_t* size) {
@@ -5091,8 +5109,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_MethodOptions_muta
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_MethodOptions_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_MethodOptions_set_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_MethodOptions_set_features(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_UninterpretedOption** google_protobuf_MethodOptions_mutable_uninterpreted_option(google_protobuf_MethodOptions* msg, size_t* size) {
@@ -5584,8 +5603,9 @@ UPB_INLINE struct google_protobuf_FeatureSet* google_protobuf_FeatureSet_mutable
   struct google_protobuf_FeatureSet* sub = (struct google_protobuf_FeatureSet*)google_protobuf_FeatureSet_raw_features(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FeatureSet*)_upb_Message_New(&google_protobuf_FeatureSet_msg_init, arena);
-    if (sub) google_protobuf_FeatureSet_set_raw_features(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FeatureSet_set_raw_features(msg, sub);
   return sub;
 }
 
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 
 #include "upb/collections/internal/map.h"
+#include "upb/mem/arena.h"
 #include "upb/message/internal/extension.h"
 #include "upb/message/internal/map_entry.h"
 
@@ -49,11 +50,19 @@ extern "C" {
 // _upb_mapsorter sorts maps and provides ordered iteration over the entries.
 // Since maps can be recursive (map values can be messages which contain other
 // maps), _upb_mapsorter can contain a stack of maps.
+//
+// All memory comes from `arena`. If no arena is given to _upb_mapsorter_init(),
+// the sorter creates a private one the first time it needs memory and frees it
+// in _upb_mapsorter_destroy().
 
 typedef struct {
   void const** entries;
   int size;
   int cap;
+  void* scratch;  // Sort keys for the map being sorted, reused between maps.
+  size_t scratch_size;
+  upb_Arena* arena;
+  bool owns_arena;
 } _upb_mapsorter;
 
 typedef struct {
@@ -62,14 +71,18 @@ typedef struct {
   int end;
 } _upb_sortedmap;
 
-UPB_INLINE void _upb_mapsorter_init(_upb_mapsorter* s) {
+UPB_INLINE void _upb_mapsorter_init(_upb_mapsorter* s, upb_Arena* arena) {
   s->entries = NULL;
   s->size = 0;
   s->cap = 0;
+  s->scratch = NULL;
+  s->scratch_size = 0;
+  s->arena = arena;
+  s->owns_arena = false;
 }
 
 UPB_INLINE void _upb_mapsorter_destroy(_upb_mapsorter* s) {
-  if (s->entries) free(s->entries);
+  if (s->owns_arena) upb_Arena_Free(s->arena);
 }
 
 UPB_INLINE bool _upb_sortedmap_next(_upb_mapsorter* s, const upb_Map* map,
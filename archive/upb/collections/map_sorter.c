@@ -30,7 +30,11 @@
 
 #include "upb/collections/internal/map_sorter.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "upb/base/internal/log2.h"
+#include "upb/mem/arena.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -45,66 +49,150 @@ static void _upb_mapsorter_getkeys(const void* _a, const void* _b, void* a_key,
   _upb_map_fromkey(b_tabkey, b_key, size);
 }
 
-static int _upb_mapsorter_cmpi64(const void* _a, const void* _b) {
-  int64_t a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, 8);
-  return a < b ? -1 : a > b;
+static int _upb_mapsorter_cmpstr(const void* _a, const void* _b) {
+  upb_StringView a, b;
+  _upb_mapsorter_getkeys(_a, _b, &a, &b, UPB_MAPTYPE_STRING);
+  size_t common_size = UPB_MIN(a.size, b.size);
+  int cmp = memcmp(a.data, b.data, common_size);
+  if (cmp) return -cmp;
+  return a.size < b.size ? -1 : a.size > b.size;
 }
 
-static int _upb_mapsorter_cmpu64(const void* _a, const void* _b) {
-  uint64_t a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, 8);
-  return a < b ? -1 : a > b;
-}
+// Entries are sorted by a 64-bit unsigned key: each map key (or extension
+// number) is mapped to a uint64_t with the same ordering, which lets us radix
+// sort instead of calling qsort() with an indirect comparator.
+typedef struct {
+  uint64_t key;
+  const void* ptr;
+} _upb_sortkey;
 
-static int _upb_mapsorter_cmpi32(const void* _a, const void* _b) {
-  int32_t a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, 4);
-  return a < b ? -1 : a > b;
-}
+// Below this size a radix sort's histogram setup costs more than it saves.
+#define UPB_MAPSORTER_RADIX_MIN 32
 
-static int _upb_mapsorter_cmpu32(const void* _a, const void* _b) {
-  uint32_t a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, 4);
-  return a < b ? -1 : a > b;
+static uint64_t _upb_mapsorter_intkey(const upb_tabent* ent,
+                                      upb_FieldType key_type) {
+  const char* data = upb_tabstrview(ent->key).data;
+  switch (key_type) {
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_SInt64: {
+      uint64_t v;
+      memcpy(&v, data, 8);
+      return v ^ (1ULL << 63);
+    }
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_Fixed64: {
+      uint64_t v;
+      memcpy(&v, data, 8);
+      return v;
+    }
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Enum: {
+      uint32_t v;
+      memcpy(&v, data, 4);
+      return v ^ (1U << 31);
+    }
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Fixed32: {
+      uint32_t v;
+      memcpy(&v, data, 4);
+      return v;
+    }
+    case kUpb_FieldType_Bool: {
+      bool v;
+      memcpy(&v, data, 1);
+      return v;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
 }
 
-static int _upb_mapsorter_cmpbool(const void* _a, const void* _b) {
-  bool a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, 1);
-  return a < b ? -1 : a > b;
+// _upb_mapsorter_cmpstr() orders strings by descending bytes, with a string
+// sorting before any longer string it is a prefix of.  That is plain
+// lexicographic order on the complemented bytes, so the key for a string is
+// its first 8 complemented bytes after `skip`, big-endian and zero padded.
+// Equal keys are resolved afterwards with the full comparator.
+static uint64_t _upb_mapsorter_strkey(const upb_tabent* ent, size_t skip) {
+  upb_StringView str = upb_tabstrview(ent->key);
+  const unsigned char* data = (const unsigned char*)str.data + skip;
+  size_t n = UPB_MIN(str.size - skip, 8);
+  uint64_t key = 0;
+  for (size_t i = 0; i < n; i++) {
+    key |= (uint64_t)(unsigned char)~data[i] << (56 - 8 * i);
+  }
+  return key;
 }
 
-static int _upb_mapsorter_cmpstr(const void* _a, const void* _b) {
-  upb_StringView a, b;
-  _upb_mapsorter_getkeys(_a, _b, &a, &b, UPB_MAPTYPE_STRING);
-  size_t common_size = UPB_MIN(a.size, b.size);
-  int cmp = memcmp(a.data, b.data, common_size);
-  if (cmp) return -cmp;
-  return a.size < b.size ? -1 : a.size > b.size;
+// Returns the length of the prefix shared by every key, so that the 8 bytes of
+// each sort key are spent on bytes that can actually differ.
+static size_t _upb_mapsorter_strprefix(const _upb_sortkey* keys, size_t n) {
+  upb_StringView first = upb_tabstrview(((const upb_tabent*)keys[0].ptr)->key);
+  size_t prefix = first.size;
+  for (size_t i = 1; i < n && prefix; i++) {
+    upb_StringView str = upb_tabstrview(((const upb_tabent*)keys[i].ptr)->key);
+    size_t len = UPB_MIN(prefix, str.size);
+    size_t j = 0;
+    while (j < len && str.data[j] == first.data[j]) j++;
+    prefix = j;
+  }
+  return prefix;
 }
 
-static int (*const compar[kUpb_FieldType_SizeOf])(const void*, const void*) = {
-    [kUpb_FieldType_Int64] = _upb_mapsorter_cmpi64,
-    [kUpb_FieldType_SFixed64] = _upb_mapsorter_cmpi64,
-    [kUpb_FieldType_SInt64] = _upb_mapsorter_cmpi64,
+static void _upb_mapsorter_insertionsort(_upb_sortkey* keys, size_t n) {
+  for (size_t i = 1; i < n; i++) {
+    _upb_sortkey x = keys[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1].key > x.key; j--) keys[j] = keys[j - 1];
+    keys[j] = x;
+  }
+}
 
-    [kUpb_FieldType_UInt64] = _upb_mapsorter_cmpu64,
-    [kUpb_FieldType_Fixed64] = _upb_mapsorter_cmpu64,
+// LSD radix sort over the low `bytes` bytes of each key, one byte per pass.
+// `tmp` must have room for `n` keys.  Returns whichever of the two buffers
+// holds the sorted result.
+static _upb_sortkey* _upb_mapsorter_radixsort(_upb_sortkey* keys,
+                                              _upb_sortkey* tmp, size_t n,
+                                              int bytes) {
+  uint32_t counts[8][256];
+  memset(counts, 0, bytes * sizeof(counts[0]));
+  for (size_t i = 0; i < n; i++) {
+    uint64_t key = keys[i].key;
+    for (int d = 0; d < bytes; d++) counts[d][(key >> (8 * d)) & 0xff]++;
+  }
 
-    [kUpb_FieldType_Int32] = _upb_mapsorter_cmpi32,
-    [kUpb_FieldType_SInt32] = _upb_mapsorter_cmpi32,
-    [kUpb_FieldType_SFixed32] = _upb_mapsorter_cmpi32,
-    [kUpb_FieldType_Enum] = _upb_mapsorter_cmpi32,
+  for (int d = 0; d < bytes; d++) {
+    uint32_t* count = counts[d];
+    int shift = 8 * d;
 
-    [kUpb_FieldType_UInt32] = _upb_mapsorter_cmpu32,
-    [kUpb_FieldType_Fixed32] = _upb_mapsorter_cmpu32,
+    // Small integers and shared string prefixes leave many bytes identical
+    // across all keys; those passes would not reorder anything.
+    if (count[(keys[0].key >> shift) & 0xff] == n) continue;
 
-    [kUpb_FieldType_Bool] = _upb_mapsorter_cmpbool,
+    uint32_t ofs = 0;
+    for (int b = 0; b < 256; b++) {
+      uint32_t c = count[b];
+      count[b] = ofs;
+      ofs += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      tmp[count[(keys[i].key >> shift) & 0xff]++] = keys[i];
+    }
+    _upb_sortkey* swap = keys;
+    keys = tmp;
+    tmp = swap;
+  }
+  return keys;
+}
 
-    [kUpb_FieldType_String] = _upb_mapsorter_cmpstr,
-    [kUpb_FieldType_Bytes] = _upb_mapsorter_cmpstr,
-};
+static bool _upb_mapsorter_arena(_upb_mapsorter* s) {
+  if (UPB_LIKELY(s->arena)) return true;
+  s->arena = upb_Arena_New();
+  s->owns_arena = s->arena != NULL;
+  return s->owns_arena;
+}
 
 static bool _upb_mapsorter_resize(_upb_mapsorter* s, _upb_sortedmap* sorted,
                                   int size) {
@@ -113,58 +201,123 @@ static bool _upb_mapsorter_resize(_upb_mapsorter* s, _upb_sortedmap* sorted,
   sorted->end = sorted->start + size;
 
   if (sorted->end > s->cap) {
-    s->cap = upb_Log2CeilingSize(sorted->end);
-    s->entries = realloc(s->entries, s->cap * sizeof(*s->entries));
-    if (!s->entries) return false;
+    if (!_upb_mapsorter_arena(s)) return false;
+    int cap = upb_Log2CeilingSize(sorted->end);
+    void* entries =
+        upb_Arena_Realloc(s->arena, s->entries, s->cap * sizeof(*s->entries),
+                          cap * sizeof(*s->entries));
+    if (!entries) return false;
+    s->entries = entries;
+    s->cap = cap;
   }
 
   s->size = sorted->end;
   return true;
 }
 
+// Returns room for 2 * `n` sort keys: `n` to sort and `n` for the radix sort
+// to scatter into.
+static _upb_sortkey* _upb_mapsorter_scratch(_upb_mapsorter* s, size_t n) {
+  size_t size = 2 * n * sizeof(_upb_sortkey);
+  if (size > s->scratch_size) {
+    // Nothing in the old buffer needs to survive, so there is no need to
+    // realloc.
+    size_t new_size = UPB_MAX(s->scratch_size * 2, size);
+    void* scratch = upb_Arena_Malloc(s->arena, new_size);
+    if (!scratch) return NULL;
+    s->scratch = scratch;
+    s->scratch_size = new_size;
+  }
+  return s->scratch;
+}
+
+// Sorts `keys` and stores the sorted entries in `sorted`'s range of
+// s->entries.  `keys` must have room for 2 * `n` keys.  Returns the sorted keys.
+static const _upb_sortkey* _upb_mapsorter_sort(_upb_mapsorter* s,
+                                               _upb_sortedmap* sorted,
+                                               _upb_sortkey* keys, size_t n,
+                                               int bytes) {
+  if (n < UPB_MAPSORTER_RADIX_MIN) {
+    _upb_mapsorter_insertionsort(keys, n);
+  } else {
+    keys = _upb_mapsorter_radixsort(keys, keys + n, n, bytes);
+  }
+
+  const void** dst = &s->entries[sorted->start];
+  for (size_t i = 0; i < n; i++) dst[i] = keys[i].ptr;
+  return keys;
+}
+
+// Orders the runs of string entries whose prefix keys were equal.
+static void _upb_mapsorter_sortties(_upb_mapsorter* s, _upb_sortedmap* sorted,
+                                    const _upb_sortkey* keys, size_t n) {
+  const void** entries = &s->entries[sorted->start];
+  size_t i = 0;
+  while (i < n) {
+    size_t j = i + 1;
+    while (j < n && keys[j].key == keys[i].key) j++;
+    if (j - i > 1) {
+      qsort(&entries[i], j - i, sizeof(*entries), _upb_mapsorter_cmpstr);
+    }
+    i = j;
+  }
+}
+
 bool _upb_mapsorter_pushmap(_upb_mapsorter* s, upb_FieldType key_type,
                             const upb_Map* map, _upb_sortedmap* sorted) {
   int map_size = _upb_Map_Size(map);
 
   if (!_upb_mapsorter_resize(s, sorted, map_size)) return false;
+  if (map_size == 0) return true;
 
-  // Copy non-empty entries from the table to s->entries.
-  const void** dst = &s->entries[sorted->start];
+  _upb_sortkey* keys = _upb_mapsorter_scratch(s, map_size);
+  if (!keys) return false;
+
+  // Gather the non-empty entries from the table.
+  _upb_sortkey* dst = keys;
   const upb_tabent* src = map->table.t.entries;
   const upb_tabent* end = src + upb_table_size(&map->table.t);
   for (; src < end; src++) {
     if (!upb_tabent_isempty(src)) {
-      *dst = src;
+      dst->ptr = src;
       dst++;
     }
   }
-  UPB_ASSERT(dst == &s->entries[sorted->end]);
+  UPB_ASSERT(dst == keys + map_size);
 
   // Sort entries according to the key type.
-  qsort(&s->entries[sorted->start], map_size, sizeof(*s->entries),
-        compar[key_type]);
+  if (key_type == kUpb_FieldType_String || key_type == kUpb_FieldType_Bytes) {
+    size_t prefix = _upb_mapsorter_strprefix(keys, map_size);
+    for (int i = 0; i < map_size; i++) {
+      keys[i].key = _upb_mapsorter_strkey(keys[i].ptr, prefix);
+    }
+    const _upb_sortkey* sorted_keys =
+        _upb_mapsorter_sort(s, sorted, keys, map_size, 8);
+    _upb_mapsorter_sortties(s, sorted, sorted_keys, map_size);
+  } else {
+    int bytes = map->key_size;
+    for (int i = 0; i < map_size; i++) {
+      keys[i].key = _upb_mapsorter_intkey(keys[i].ptr, key_type);
+    }
+    _upb_mapsorter_sort(s, sorted, keys, map_size, bytes);
+  }
   return true;
 }
 
-static int _upb_mapsorter_cmpext(const void* _a, const void* _b) {
-  const upb_Message_Extension* const* a = _a;
-  const upb_Message_Extension* const* b = _b;
-  uint32_t a_num = (*a)->ext->field.number;
-  uint32_t b_num = (*b)->ext->field.number;
-  assert(a_num != b_num);
-  return a_num < b_num ? -1 : 1;
-}
-
 bool _upb_mapsorter_pushexts(_upb_mapsorter* s,
                              const upb_Message_Extension* exts, size_t count,
                              _upb_sortedmap* sorted) {
   if (!_upb_mapsorter_resize(s, sorted, count)) return false;
+  if (count == 0) return true;
+
+  _upb_sortkey* keys = _upb_mapsorter_scratch(s, count);
+  if (!keys) return false;
 
   for (size_t i = 0; i < count; i++) {
-    s->entries[sorted->start + i] = &exts[i];
+    keys[i].key = exts[i].ext->field.number;
+    keys[i].ptr = &exts[i];
   }
 
-  qsort(&s->entries[sorted->start], count, sizeof(*s->entries),
-        _upb_mapsorter_cmpext);
+  _upb_mapsorter_sort(s, sorted, keys, count, 4);
   return true;
 }
@@ -0,0 +1,199 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/collections/internal/map_sorter.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "upb/base/descriptor_constants.h"
+#include "upb/base/string_view.h"
+#include "upb/collections/map.h"
+#include "upb/mem/arena.hpp"
+
+namespace {
+
+// Sorts `map` and returns its keys in iteration order.
+template <class T>
+std::vector<T> SortedKeys(const upb_Map* map, upb_FieldType type,
+                          upb_Arena* arena) {
+  _upb_mapsorter sorter;
+  _upb_mapsorter_init(&sorter, arena);
+  _upb_sortedmap sorted;
+  EXPECT_TRUE(_upb_mapsorter_pushmap(&sorter, type, map, &sorted));
+  std::vector<T> keys;
+  upb_MapEntry ent;
+  while (_upb_sortedmap_next(&sorter, map, &sorted, &ent)) {
+    T key;
+    memcpy(&key, &ent.data.k, sizeof(key));
+    keys.push_back(key);
+  }
+  _upb_mapsorter_popmap(&sorter, &sorted);
+  _upb_mapsorter_destroy(&sorter);
+  return keys;
+}
+
+template <class T>
+void CheckIntSort(upb_CType ctype, upb_FieldType type, size_t n) {
+  upb::Arena arena;
+  upb_Map* map = upb_Map_New(arena.ptr(), ctype, kUpb_CType_Int32);
+  std::mt19937_64 rng(n);
+  std::vector<T> expected;
+  for (size_t i = 0; i < n; i++) {
+    // Mix small values (most bytes equal) with full-range ones.
+    T key = static_cast<T>(i % 2 ? rng() : rng() % 512 - 256);
+    upb_MessageValue k, v;
+    memcpy(&k, &key, sizeof(key));
+    v.int32_val = 0;
+    if (upb_Map_Insert(map, k, v, arena.ptr()) ==
+        kUpb_MapInsertStatus_Inserted) {
+      expected.push_back(key);
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, SortedKeys<T>(map, type, arena.ptr())) << n;
+}
+
+TEST(MapSorterTest, IntegerKeys) {
+  for (size_t n : {0, 1, 2, 31, 32, 1000}) {
+    CheckIntSort<int32_t>(kUpb_CType_Int32, kUpb_FieldType_Int32, n);
+    CheckIntSort<int32_t>(kUpb_CType_Int32, kUpb_FieldType_SFixed32, n);
+    CheckIntSort<uint32_t>(kUpb_CType_UInt32, kUpb_FieldType_UInt32, n);
+    CheckIntSort<int64_t>(kUpb_CType_Int64, kUpb_FieldType_SInt64, n);
+    CheckIntSort<uint64_t>(kUpb_CType_UInt64, kUpb_FieldType_Fixed64, n);
+  }
+}
+
+TEST(MapSorterTest, BoolKeys) {
+  upb::Arena arena;
+  upb_Map* map = upb_Map_New(arena.ptr(), kUpb_CType_Bool, kUpb_CType_Int32);
+  upb_MessageValue k, v;
+  v.int32_val = 0;
+  k.bool_val = true;
+  upb_Map_Insert(map, k, v, arena.ptr());
+  k.bool_val = false;
+  upb_Map_Insert(map, k, v, arena.ptr());
+  EXPECT_EQ((std::vector<bool>{false, true}),
+            SortedKeys<bool>(map, kUpb_FieldType_Bool, arena.ptr()));
+}
+
+TEST(MapSorterTest, StringKeys) {
+  // The sorter has always ordered strings by descending bytes, with a prefix
+  // before the longer strings that extend it.  Deterministic output depends
+  // on this never changing.
+  auto less = [](const std::string& a, const std::string& b) {
+    size_t common = std::min(a.size(), b.size());
+    int cmp = memcmp(a.data(), b.data(), common);
+    if (cmp) return cmp > 0;
+    return a.size() < b.size();
+  };
+
+  for (size_t n : {1, 5, 31, 32, 2000}) {
+    upb::Arena arena;
+    upb_Map* map =
+        upb_Map_New(arena.ptr(), kUpb_CType_String, kUpb_CType_Int32);
+    std::mt19937 rng(n);
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < n; i++) {
+      // Long shared prefixes, prefixes of each other, embedded NULs and 0xff.
+      std::string key = i % 3 ? "some/shared/prefix/" : "";
+      size_t len = rng() % 12;
+      for (size_t j = 0; j < len; j++) {
+        key.push_back("\0\xff" "ab"[rng() % 4]);
+      }
+      upb_MessageValue k, v;
+      k.str_val = upb_StringView_FromDataAndSize(key.data(), key.size());
+      v.int32_val = 0;
+      auto st = upb_Map_Insert(map, k, v, arena.ptr());
+      if (st == kUpb_MapInsertStatus_Inserted) expected.push_back(key);
+    }
+    std::sort(expected.begin(), expected.end(), less);
+
+    std::vector<std::string> actual;
+    for (upb_StringView key : SortedKeys<upb_StringView>(
+             map, kUpb_FieldType_String, arena.ptr())) {
+      actual.emplace_back(key.data, key.size);
+    }
+    EXPECT_EQ(expected, actual) << n;
+  }
+}
+
+TEST(MapSorterTest, NestedMapsWithoutArena) {
+  upb::Arena arena;
+  upb_Map* outer = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_Int32);
+  upb_Map* inner = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_Int32);
+  for (int i = 0; i < 100; i++) {
+    upb_MessageValue k, v;
+    k.int32_val = 100 - i;
+    v.int32_val = 0;
+    upb_Map_Insert(outer, k, v, arena.ptr());
+    k.int32_val = -i;
+    upb_Map_Insert(inner, k, v, arena.ptr());
+  }
+
+  // With no arena the sorter manages its own memory.
+  _upb_mapsorter sorter;
+  _upb_mapsorter_init(&sorter, nullptr);
+  _upb_sortedmap sorted_outer, sorted_inner;
+  ASSERT_TRUE(_upb_mapsorter_pushmap(&sorter, kUpb_FieldType_Int32, outer,
+                                     &sorted_outer));
+  upb_MapEntry ent;
+  ASSERT_TRUE(_upb_sortedmap_next(&sorter, outer, &sorted_outer, &ent));
+  ASSERT_TRUE(_upb_mapsorter_pushmap(&sorter, kUpb_FieldType_Int32, inner,
+                                     &sorted_inner));
+  int32_t prev = INT32_MIN;
+  while (_upb_sortedmap_next(&sorter, inner, &sorted_inner, &ent)) {
+    int32_t key;
+    memcpy(&key, &ent.data.k, sizeof(key));
+    EXPECT_LT(prev, key);
+    prev = key;
+  }
+  EXPECT_EQ(0, prev);
+  _upb_mapsorter_popmap(&sorter, &sorted_inner);
+
+  // The outer map's order survives the inner map being sorted.
+  prev = 1;
+  while (_upb_sortedmap_next(&sorter, outer, &sorted_outer, &ent)) {
+    int32_t key;
+    memcpy(&key, &ent.data.k, sizeof(key));
+    EXPECT_LT(prev, key);
+    prev = key;
+  }
+  EXPECT_EQ(100, prev);
+  _upb_mapsorter_popmap(&sorter, &sorted_outer);
+  _upb_mapsorter_destroy(&sorter);
+}
+
+}  // namespace
@@ -28,8 +28,17 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+// mmap()/madvise() are hidden in strict C99 mode.
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include "upb/mem/internal/arena.h"
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 #include "upb/port/atomic.h"
 
 // Must be last.
@@ -39,12 +48,22 @@ struct _upb_MemBlock {
   // Atomic only for the benefit of SpaceAllocated().
   UPB_ATOMIC(_upb_MemBlock*) next;
   uint32_t size;
+  // Whether the block was mapped by upb_Arena_MapHugeBlock() instead of
+  // coming from the block allocator.
+  bool hugepage;
   // Data follows.
 };
 
 static const size_t memblock_reserve =
     UPB_ALIGN_UP(sizeof(_upb_MemBlock), UPB_MALLOC_ALIGN);
 
+enum {
+  kUpb_Arena_DefaultInitialBlockSize = 256,
+  kUpb_Arena_DefaultGrowthFactor = 2,
+};
+
+static const size_t kUpb_Arena_HugePageSize = 2 << 20;
+
 typedef struct _upb_ArenaRoot {
   upb_Arena* root;
   uintptr_t tagged_count;
@@ -115,11 +134,70 @@ uint32_t upb_Arena_DebugRefCount(upb_Arena* a) {
   return _upb_Arena_RefCountFromTagged(poc);
 }
 
-static void upb_Arena_AddBlock(upb_Arena* a, void* ptr, size_t size) {
+// Maps a 2MiB-aligned block of `size` bytes (a multiple of 2MiB) and asks
+// the kernel to back it with transparent hugepages.  Returns NULL if this is
+// not supported, in which case the caller falls back to the block allocator.
+static void* upb_Arena_MapHugeBlock(size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // Over-map by one hugepage so that an aligned range is sure to fit, then
+  // unmap the slop on either side.
+  size_t len = size + kUpb_Arena_HugePageSize;
+  char* mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return NULL;
+  char* aligned =
+      (char*)UPB_ALIGN_UP((uintptr_t)mem, kUpb_Arena_HugePageSize);
+  if (aligned != mem) munmap(mem, aligned - mem);
+  munmap(aligned + size, mem + len - (aligned + size));
+  madvise(aligned, size, MADV_HUGEPAGE);
+  return aligned;
+#else
+  UPB_UNUSED(size);
+  return NULL;
+#endif
+}
+
+// Allocates memory for a block of at least `*size` bytes.  Large blocks of
+// arenas that asked for hugepages are rounded up to a multiple of 2MiB, in
+// which case `*size` is updated and `*hugepage` set.  Blocks so close to 4GiB
+// that the rounded size would not fit in _upb_MemBlock.size come from `alloc`.
+static void* upb_Arena_AllocBlockMem(upb_alloc* alloc, bool want_hugepages,
+                                     size_t* size, bool* hugepage) {
+  *hugepage = false;
+  if (want_hugepages && *size >= kUpb_Arena_HugePageSize &&
+      *size <= UPB_ALIGN_DOWN((size_t)UINT32_MAX, kUpb_Arena_HugePageSize)) {
+    size_t huge_size = UPB_ALIGN_UP(*size, kUpb_Arena_HugePageSize);
+    void* mem = upb_Arena_MapHugeBlock(huge_size);
+    if (mem) {
+      *size = huge_size;
+      *hugepage = true;
+      return mem;
+    }
+  }
+  return upb_malloc(alloc, *size);
+}
+
+static void upb_Arena_FreeBlock(upb_alloc* alloc, _upb_MemBlock* block) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (block->hugepage) {
+    // The arena may live at the end of its first block, outside `size`.
+    size_t len = UPB_ALIGN_UP(block->size, kUpb_Arena_HugePageSize);
+    // ASAN does not forget our poisoning when the range is unmapped.
+    UPB_UNPOISON_MEMORY_REGION(block, len);
+    munmap(block, len);
+    return;
+  }
+#endif
+  upb_free(alloc, block);
+}
+
+static void upb_Arena_AddBlock(upb_Arena* a, void* ptr, size_t size,
+                               bool hugepage) {
   _upb_MemBlock* block = ptr;
 
   // Insert into linked list.
   block->size = (uint32_t)size;
+  block->hugepage = hugepage;
   upb_Atomic_Init(&block->next, a->blocks);
   upb_Atomic_Store(&a->blocks, block, memory_order_release);
 
@@ -132,31 +210,78 @@ static void upb_Arena_AddBlock(upb_Arena* a, void* ptr, size_t size) {
 static bool upb_Arena_AllocBlock(upb_Arena* a, size_t size) {
   if (!a->block_alloc) return false;
   _upb_MemBlock* last_block = upb_Atomic_Load(&a->blocks, memory_order_acquire);
-  size_t last_size = last_block != NULL ? last_block->size : 128;
-  size_t block_size = UPB_MAX(size, last_size * 2) + memblock_reserve;
-  _upb_MemBlock* block = upb_malloc(upb_Arena_BlockAlloc(a), block_size);
+  uint64_t next_size = last_block != NULL
+                           ? (uint64_t)last_block->size * a->growth_factor
+                           : a->initial_block_size;
+  if (a->max_block_size && next_size > a->max_block_size) {
+    next_size = a->max_block_size;
+  }
+  if (size > UINT32_MAX - memblock_reserve) return false;
+  size_t block_size = (size_t)UPB_MIN(UPB_MAX(size, next_size),
+                                      UINT32_MAX - memblock_reserve) +
+                      memblock_reserve;
+  bool hugepage;
+  _upb_MemBlock* block = upb_Arena_AllocBlockMem(
+      upb_Arena_BlockAlloc(a), a->hugepages, &block_size, &hugepage);
 
   if (!block) return false;
-  upb_Arena_AddBlock(a, block, block_size);
+  a->tail_waste += a->head.end - a->head.ptr;
+  upb_Arena_AddBlock(a, block, block_size, hugepage);
   return true;
 }
 
 void* _upb_Arena_SlowMalloc(upb_Arena* a, size_t size) {
-  if (!upb_Arena_AllocBlock(a, size)) return NULL; /* Out of memory. */
-  UPB_ASSERT(_upb_ArenaHas(a) >= size);
+  // Leave room for the ASAN guard, or oversized allocations never fit.
+  size_t span = size + UPB_ASAN_GUARD_SIZE;
+  if (!upb_Arena_AllocBlock(a, span)) return NULL; /* Out of memory. */
+  UPB_ASSERT(_upb_ArenaHas(a) >= span);
   return upb_Arena_Malloc(a, size);
 }
 
 /* Public Arena API ***********************************************************/
 
-static upb_Arena* upb_Arena_InitSlow(upb_alloc* alloc) {
+// Also clears the instrumentation counters.
+static void upb_Arena_SetOptions(upb_Arena* a,
+                                 const upb_ArenaOptions* options) {
+  a->initial_block_size = kUpb_Arena_DefaultInitialBlockSize;
+  a->max_block_size = 0;
+  a->growth_factor = kUpb_Arena_DefaultGrowthFactor;
+  a->hugepages = false;
+  a->head.realloc_abandoned = 0;
+  a->tail_waste = 0;
+  upb_Atomic_Init(&a->fuse_count, 0);
+  if (!options) return;
+
+  if (options->initial_block_size) {
+    a->initial_block_size =
+        UPB_MIN(options->initial_block_size, UINT32_MAX - memblock_reserve);
+  }
+  if (options->max_block_size) {
+    a->max_block_size =
+        UPB_MIN(options->max_block_size, UINT32_MAX - memblock_reserve);
+  }
+  if (options->growth_factor) {
+    a->growth_factor = UPB_MIN(options->growth_factor, UINT16_MAX);
+  }
+  a->hugepages = options->hugepages;
+}
+
+static upb_Arena* upb_Arena_InitSlow(upb_alloc* alloc,
+                                     const upb_ArenaOptions* options) {
   const size_t first_block_overhead = sizeof(upb_Arena) + memblock_reserve;
   upb_Arena* a;
 
   /* We need to malloc the initial block. */
   char* mem;
-  size_t n = first_block_overhead + 256;
-  if (!alloc || !(mem = upb_malloc(alloc, n))) {
+  size_t n = first_block_overhead + kUpb_Arena_DefaultInitialBlockSize;
+  if (options && options->initial_block_size) {
+    n = first_block_overhead +
+        UPB_MIN(UPB_ALIGN_MALLOC(options->initial_block_size),
+                UINT32_MAX - first_block_overhead);
+  }
+  bool hugepage;
+  if (!alloc || !(mem = upb_Arena_AllocBlockMem(
+                      alloc, options && options->hugepages, &n, &hugepage))) {
     return NULL;
   }
 
@@ -164,17 +289,24 @@ static upb_Arena* upb_Arena_InitSlow(upb_alloc* alloc) {
   n -= sizeof(*a);
 
   a->block_alloc = upb_Arena_MakeBlockAlloc(alloc, 0);
+  upb_Arena_SetOptions(a, options);
   upb_Atomic_Init(&a->parent_or_count, _upb_Arena_TaggedFromRefcount(1));
   upb_Atomic_Init(&a->next, NULL);
   upb_Atomic_Init(&a->tail, a);
   upb_Atomic_Init(&a->blocks, NULL);
+  a->initial_block = NULL;
 
-  upb_Arena_AddBlock(a, mem, n);
+  upb_Arena_AddBlock(a, mem, n, hugepage);
 
   return a;
 }
 
 upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc) {
+  return upb_Arena_InitWithOptions(mem, n, alloc, NULL);
+}
+
+upb_Arena* upb_Arena_InitWithOptions(void* mem, size_t n, upb_alloc* alloc,
+                                     const upb_ArenaOptions* options) {
   upb_Arena* a;
 
   if (n) {
@@ -190,7 +322,7 @@ upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc) {
   n = UPB_ALIGN_DOWN(n, UPB_ALIGN_OF(upb_Arena));
 
   if (UPB_UNLIKELY(n < sizeof(upb_Arena))) {
-    return upb_Arena_InitSlow(alloc);
+    return upb_Arena_InitSlow(alloc, options);
   }
 
   a = UPB_PTR_AT(mem, n - sizeof(*a), upb_Arena);
@@ -200,12 +332,143 @@ upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc) {
   upb_Atomic_Init(&a->tail, a);
   upb_Atomic_Init(&a->blocks, NULL);
   a->block_alloc = upb_Arena_MakeBlockAlloc(alloc, 1);
+  upb_Arena_SetOptions(a, options);
+  a->initial_block = mem;
   a->head.ptr = mem;
   a->head.end = UPB_PTR_AT(mem, n - sizeof(*a), char);
 
   return a;
 }
 
+bool upb_Arena_Reset(upb_Arena* a) {
+  // Blocks of fused arenas may be referenced through any of the other arenas.
+  if (upb_Atomic_Load(&a->parent_or_count, memory_order_relaxed) !=
+          _upb_Arena_TaggedFromRefcount(1) ||
+      upb_Atomic_Load(&a->next, memory_order_relaxed) != NULL) {
+    return false;
+  }
+
+  // Keep the largest block, plus the oldest block if `a` itself lives there.
+  _upb_MemBlock* first = NULL;
+  _upb_MemBlock* largest = NULL;
+  upb_alloc* block_alloc = upb_Arena_BlockAlloc(a);
+  _upb_MemBlock* block = upb_Atomic_Load(&a->blocks, memory_order_relaxed);
+  while (block != NULL) {
+    _upb_MemBlock* next = upb_Atomic_Load(&block->next, memory_order_relaxed);
+    if (next == NULL && !upb_Arena_HasInitialBlock(a)) {
+      first = block;
+    } else if (largest == NULL || block->size > largest->size) {
+      if (largest) upb_Arena_FreeBlock(block_alloc, largest);
+      largest = block;
+    } else {
+      upb_Arena_FreeBlock(block_alloc, block);
+    }
+    block = next;
+  }
+
+  // The largest block goes at the head of the list so that further growth
+  // doubles from it, and the first block stays at the end, where it is
+  // recognized as the one `a` lives in.
+  if (first) upb_Atomic_Init(&first->next, NULL);
+  if (largest) upb_Atomic_Init(&largest->next, first);
+  upb_Atomic_Store(&a->blocks, largest ? largest : first,
+                   memory_order_relaxed);
+
+  // Allocate from whichever kept block has the most room.  The first block
+  // can be the bigger one when max_block_size is below initial_block_size.
+  _upb_MemBlock* head = largest;
+  if (first && (head == NULL || first->size > head->size)) head = first;
+
+  if (a->initial_block != NULL &&
+      (head == NULL || (size_t)((char*)a - a->initial_block) >=
+                           head->size - memblock_reserve)) {
+    a->head.ptr = a->initial_block;
+    a->head.end = (char*)a;
+  } else {
+    UPB_ASSERT(head != NULL);
+    a->head.ptr = UPB_PTR_AT(head, memblock_reserve, char);
+    a->head.end = UPB_PTR_AT(head, head->size, char);
+  }
+
+  UPB_POISON_MEMORY_REGION(a->head.ptr, a->head.end - a->head.ptr);
+
+  // Whatever kept block is not allocated from counts as waste.
+  a->head.realloc_abandoned = 0;
+  a->tail_waste = 0;
+  if (first && a->head.end != (char*)a) {
+    a->tail_waste += first->size - memblock_reserve;
+  }
+  if (largest && a->head.ptr != UPB_PTR_AT(largest, memblock_reserve, char)) {
+    a->tail_waste += largest->size - memblock_reserve;
+  }
+  if (a->initial_block && a->head.ptr != a->initial_block) {
+    a->tail_waste += (char*)a - a->initial_block;
+  }
+  return true;
+}
+
+upb_ArenaMark upb_Arena_Mark(upb_Arena* a) {
+  upb_ArenaMark mark;
+  mark.head = a->head;
+  mark.blocks = upb_Atomic_Load(&a->blocks, memory_order_relaxed);
+  mark.tail_waste = a->tail_waste;
+  mark.fuse_count = upb_Atomic_Load(&a->fuse_count, memory_order_relaxed);
+  return mark;
+}
+
+void upb_Arena_RewindTo(upb_Arena* a, const upb_ArenaMark* mark) {
+  // Once fused, the allocations may be referenced from the other arenas.
+  UPB_ASSERT(upb_Atomic_Load(&a->fuse_count, memory_order_relaxed) ==
+             mark->fuse_count);
+
+  // Blocks are only ever prepended, so the ones added since the mark are
+  // exactly those in front of it.
+  upb_alloc* block_alloc = upb_Arena_BlockAlloc(a);
+  _upb_MemBlock* block = upb_Atomic_Load(&a->blocks, memory_order_relaxed);
+  while (block != mark->blocks) {
+    UPB_ASSERT(block != NULL);
+    _upb_MemBlock* next = upb_Atomic_Load(&block->next, memory_order_relaxed);
+    upb_Arena_FreeBlock(block_alloc, block);
+    block = next;
+  }
+  upb_Atomic_Store(&a->blocks, block, memory_order_relaxed);
+
+  a->head = mark->head;
+  a->tail_waste = mark->tail_waste;
+  UPB_POISON_MEMORY_REGION(a->head.ptr, a->head.end - a->head.ptr);
+}
+
+void upb_Arena_GetStats(upb_Arena* a, upb_ArenaStats* stats) {
+  memset(stats, 0, sizeof(*stats));
+
+  // Usable space across all blocks, from which bytes_used is derived.
+  size_t capacity = a->initial_block ? (char*)a - a->initial_block : 0;
+  _upb_MemBlock* block = upb_Atomic_Load(&a->blocks, memory_order_relaxed);
+  while (block != NULL) {
+    _upb_MemBlock* next = upb_Atomic_Load(&block->next, memory_order_relaxed);
+    int bucket = 0;
+    while (bucket < kUpb_ArenaStats_HistogramBuckets - 1 &&
+           ((size_t)block->size >> (bucket + 9)) != 0) {
+      bucket++;
+    }
+    stats->block_histogram[bucket]++;
+    stats->block_count++;
+    stats->bytes_allocated += block->size;
+    if (next == NULL && !upb_Arena_HasInitialBlock(a)) {
+      // The arena itself lives at the end of its first block.
+      stats->bytes_allocated += sizeof(upb_Arena);
+    }
+    capacity += block->size - memblock_reserve;
+    block = next;
+  }
+
+  stats->bytes_free = a->head.end - a->head.ptr;
+  stats->tail_waste = a->tail_waste;
+  stats->bytes_used = capacity - stats->bytes_free - stats->tail_waste;
+  stats->realloc_abandoned = a->head.realloc_abandoned;
+  stats->fuse_count = upb_Atomic_Load(&a->fuse_count, memory_order_relaxed);
+}
+
 static void arena_dofree(upb_Arena* a) {
   UPB_ASSERT(_upb_Arena_RefCountFromTagged(a->parent_or_count) == 1);
 
@@ -219,7 +482,7 @@ static void arena_dofree(upb_Arena* a) {
       // Load first since we are deleting block.
       _upb_MemBlock* next_block =
           upb_Atomic_Load(&block->next, memory_order_acquire);
-      upb_free(block_alloc, block);
+      upb_Arena_FreeBlock(block_alloc, block);
       block = next_block;
     }
     a = next_arena;
@@ -365,6 +628,8 @@ bool upb_Arena_Fuse(upb_Arena* a1, upb_Arena* a2) {
   while (true) {
     upb_Arena* new_root = _upb_Arena_DoFuse(a1, a2, &ref_delta);
     if (new_root != NULL && _upb_Arena_FixupRefs(new_root, ref_delta)) {
+      upb_Atomic_Add(&a1->fuse_count, 1, memory_order_relaxed);
+      upb_Atomic_Add(&a2->fuse_count, 1, memory_order_relaxed);
       return true;
     }
   }
@@ -56,8 +56,31 @@ typedef struct upb_Arena upb_Arena;
 
 typedef struct {
   char *ptr, *end;
+  size_t realloc_abandoned;  // See upb_ArenaStats.
 } _upb_ArenaHead;
 
+// Controls how an arena grows.  Zero-initialize and set only the fields of
+// interest; zero selects the default for every field.
+typedef struct {
+  // Size of the first block allocated from the block allocator (256 bytes by
+  // default).
+  size_t initial_block_size;
+
+  // Blocks stop growing once they reach this size.  A single allocation that
+  // is larger still gets a block of its own.  Zero means no limit.
+  size_t max_block_size;
+
+  // Each block is this many times larger than the one before it (2 by
+  // default).  A factor of 1 yields equally sized blocks.
+  uint32_t growth_factor;
+
+  // Back blocks of 2MiB or more with 2MiB-aligned, MADV_HUGEPAGE mappings
+  // taken directly from the OS rather than from the block allocator, to cut
+  // TLB misses on very large arenas.  Such blocks are rounded up to a multiple
+  // of 2MiB.  Ignored where transparent hugepages are unavailable.
+  bool hugepages;
+} upb_ArenaOptions;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -67,9 +90,85 @@ extern "C" {
 // is a fixed-size arena and cannot grow.
 UPB_API upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc);
 
+// A saved arena position, see upb_Arena_Mark().  Treat as opaque.
+typedef struct {
+  _upb_ArenaHead head;
+  void* blocks;
+  size_t tail_waste;
+  uint32_t fuse_count;
+} upb_ArenaMark;
+
+// Records the arena's current position, so that everything allocated after
+// this point can be discarded with upb_Arena_RewindTo(), e.g. after a failed
+// speculative parse.
+UPB_API upb_ArenaMark upb_Arena_Mark(upb_Arena* a);
+
+// Discards every allocation made since `mark` was taken, freeing the blocks
+// that were added after it.  Marks nest like a stack: rewinding to a mark
+// invalidates the marks taken after it.  The arena must not have been fused
+// or reset since the mark was taken.
+UPB_API void upb_Arena_RewindTo(upb_Arena* a, const upb_ArenaMark* mark);
+
+// Number of buckets in upb_ArenaStats.block_histogram.
+#define kUpb_ArenaStats_HistogramBuckets 16
+
+// Memory usage of a single arena.  Everything here is either computed on
+// demand or counted on paths that are already slow, so it costs nothing to
+// keep track of.
+//
+// Unless the arena has a user-provided initial block, bytes_allocated minus
+// (bytes_used + bytes_free + tail_waste) is the overhead of block headers and
+// of the upb_Arena itself.
+typedef struct {
+  // Memory obtained from the block allocator, in `block_count` blocks.  A
+  // user-provided initial block is not included.
+  size_t bytes_allocated;
+  uint32_t block_count;
+
+  // block_histogram[i] counts blocks of [2^(i+8), 2^(i+9)) bytes; the first
+  // and last buckets also hold anything smaller or larger.
+  uint32_t block_histogram[kUpb_ArenaStats_HistogramBuckets];
+
+  // Bytes handed out by upb_Arena_Malloc() and friends, including rounding
+  // to UPB_MALLOC_ALIGN.
+  size_t bytes_used;
+
+  // Of `bytes_used`, the bytes given up by upb_Arena_Realloc() when it moved
+  // or shrank an allocation that was not the most recent one.
+  size_t realloc_abandoned;
+
+  // Bytes still available in the block currently being allocated from.
+  size_t bytes_free;
+
+  // Bytes left over at the end of blocks that the arena has moved on from,
+  // because the next allocation did not fit.
+  size_t tail_waste;
+
+  // Successful upb_Arena_Fuse() calls that this arena took part in.
+  uint32_t fuse_count;
+} upb_ArenaStats;
+
+// Fills in `stats` for `a`.  Only `a`'s own blocks are covered, not those of
+// arenas it was fused with.  upb_Arena_Reset() clears everything except the
+// fuse count.
+UPB_API void upb_Arena_GetStats(upb_Arena* a, upb_ArenaStats* stats);
+
+// Like upb_Arena_Init(), but with a custom growth policy.  `options` may be
+// NULL and need not outlive the call.
+UPB_API upb_Arena* upb_Arena_InitWithOptions(void* mem, size_t n,
+                                             upb_alloc* alloc,
+                                             const upb_ArenaOptions* options);
+
 UPB_API void upb_Arena_Free(upb_Arena* a);
 UPB_API bool upb_Arena_Fuse(upb_Arena* a, upb_Arena* b);
 
+// Discards everything allocated from the arena so that its memory can be
+// reused.  The largest block is kept (along with the block holding the arena
+// itself), so a request loop that resets one arena reaches a steady state
+// without calling the block allocator.  Returns false and does nothing if the
+// arena has been fused.
+UPB_API bool upb_Arena_Reset(upb_Arena* a);
+
 void* _upb_Arena_SlowMalloc(upb_Arena* a, size_t size);
 size_t upb_Arena_SpaceAllocated(upb_Arena* arena);
 uint32_t upb_Arena_DebugRefCount(upb_Arena* arena);
@@ -127,6 +226,7 @@ UPB_API_INLINE void* upb_Arena_Realloc(upb_Arena* a, void* ptr, size_t oldsize,
       return ptr;
     }
   } else if (size <= oldsize) {
+    h->realloc_abandoned += oldsize - size;
     return ptr;
   }
 
@@ -134,6 +234,7 @@ UPB_API_INLINE void* upb_Arena_Realloc(upb_Arena* a, void* ptr, size_t oldsize,
 
   if (ret && oldsize > 0) {
     memcpy(ret, ptr, UPB_MIN(oldsize, size));
+    h->realloc_abandoned += oldsize;
   }
 
   return ret;
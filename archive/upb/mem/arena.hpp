@@ -44,11 +44,17 @@ class Arena {
   Arena(char* initial_block, size_t size)
       : ptr_(upb_Arena_Init(initial_block, size, &upb_alloc_global),
              upb_Arena_Free) {}
+  explicit Arena(const upb_ArenaOptions& options)
+      : ptr_(upb_Arena_InitWithOptions(nullptr, 0, &upb_alloc_global,
+                                       &options),
+             upb_Arena_Free) {}
 
   upb_Arena* ptr() const { return ptr_.get(); }
 
   void Fuse(Arena& other) { upb_Arena_Fuse(ptr(), other.ptr()); }
 
+  bool Reset() { return upb_Arena_Reset(ptr()); }
+
  protected:
   std::unique_ptr<upb_Arena, decltype(&upb_Arena_Free)> ptr_;
 };
@@ -31,6 +31,8 @@
 #include "upb/mem/arena.h"
 
 #include <array>
+#include <cstring>
+#include <string>
 #include <atomic>
 #include <thread>
 #include <vector>
@@ -40,6 +42,7 @@
 #include "absl/random/distributions.h"
 #include "absl/random/random.h"
 #include "absl/synchronization/notification.h"
+#include "upb/mem/block_cache.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -83,6 +86,340 @@ TEST(ArenaTest, FuseWithInitialBlock) {
   for (int i = 0; i < size; ++i) upb_Arena_Free(arenas[i]);
 }
 
+TEST(ArenaTest, ResetKeepsLargestBlock) {
+  upb_Arena* arena = upb_Arena_New();
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 1000), nullptr);
+  }
+  size_t grown = upb_Arena_SpaceAllocated(arena);
+
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  size_t kept = upb_Arena_SpaceAllocated(arena);
+  EXPECT_LT(kept, grown);
+  EXPECT_GT(kept, grown / 3);
+
+  // Allocating the same amount again fits in the kept block.
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 400), nullptr);
+  }
+  EXPECT_EQ(upb_Arena_SpaceAllocated(arena), kept);
+
+  // Resetting a freshly reset arena is harmless.
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  EXPECT_EQ(upb_Arena_SpaceAllocated(arena), kept);
+  upb_Arena_Free(arena);
+
+  // An arena that never grew keeps only the block it lives in.
+  arena = upb_Arena_New();
+  void* first = upb_Arena_Malloc(arena, 16);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  EXPECT_EQ(upb_Arena_Malloc(arena, 16), first);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, ResetWithInitialBlock) {
+  char buf[1024];
+  upb_Arena* arena = upb_Arena_Init(buf, sizeof(buf), &upb_alloc_global);
+  void* first = upb_Arena_Malloc(arena, 16);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  EXPECT_EQ(upb_Arena_Malloc(arena, 16), first);
+
+  // Once the arena has outgrown its initial block, the larger heap block is
+  // reused instead.
+  EXPECT_NE(upb_Arena_Malloc(arena, 4000), nullptr);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  size_t kept = upb_Arena_SpaceAllocated(arena);
+  EXPECT_GT(kept, 0);
+  EXPECT_NE(upb_Arena_Malloc(arena, 3000), nullptr);
+  EXPECT_EQ(upb_Arena_SpaceAllocated(arena), kept);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, ResetFusedArenaFails) {
+  upb_Arena* arena1 = upb_Arena_New();
+  upb_Arena* arena2 = upb_Arena_New();
+  EXPECT_TRUE(upb_Arena_Fuse(arena1, arena2));
+  EXPECT_FALSE(upb_Arena_Reset(arena1));
+  EXPECT_FALSE(upb_Arena_Reset(arena2));
+  upb_Arena_Free(arena1);
+  upb_Arena_Free(arena2);
+}
+
+TEST(ArenaTest, InitWithOptions) {
+  upb_ArenaOptions options = {};
+  options.initial_block_size = 4096;
+  options.max_block_size = 8192;
+  upb_Arena* arena = upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_global,
+                                               &options);
+  size_t initial = upb_Arena_SpaceAllocated(arena);
+  EXPECT_GE(initial, 4096);
+  EXPECT_LT(initial, 4096 + 256);
+
+  // Blocks double up to the maximum and then stay there, instead of running
+  // ahead to twice the space in use.
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 1000), nullptr);
+  }
+  size_t space = upb_Arena_SpaceAllocated(arena);
+  EXPECT_GT(space, 1000 * 1000);
+  EXPECT_LT(space, 1000 * 1000 * 5 / 4);
+
+  // An allocation above the maximum still succeeds.
+  EXPECT_NE(upb_Arena_Malloc(arena, 100000), nullptr);
+  upb_Arena_Free(arena);
+
+  // A growth factor of 1 gives fixed-size blocks.
+  options = {};
+  options.growth_factor = 1;
+  arena = upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_global, &options);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 200), nullptr);
+  }
+  EXPECT_LT(upb_Arena_SpaceAllocated(arena), 2 * 100 * 200);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, HugepageBlocks) {
+  upb_ArenaOptions options = {};
+  options.initial_block_size = 1 << 20;
+  options.hugepages = true;
+  upb_Arena* arena = upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_global,
+                                               &options);
+  // Grows past 2MiB, so the later blocks come from hugepage mappings.
+  for (int i = 0; i < 16; i++) {
+    char* p = static_cast<char*>(upb_Arena_Malloc(arena, 1 << 20));
+    ASSERT_NE(p, nullptr);
+    memset(p, i, 1 << 20);
+  }
+  EXPECT_GE(upb_Arena_SpaceAllocated(arena), 16 << 20);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  EXPECT_NE(upb_Arena_Malloc(arena, 1 << 20), nullptr);
+  upb_Arena_Free(arena);
+
+  // The first block, which holds the arena itself, can be a hugepage block
+  // as well.
+  options.initial_block_size = 4 << 20;
+  arena = upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_global, &options);
+  ASSERT_NE(arena, nullptr);
+  EXPECT_NE(upb_Arena_Malloc(arena, 3 << 20), nullptr);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, Stats) {
+  upb_Arena* arena = upb_Arena_New();
+  upb_ArenaStats stats;
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.block_count, 1);
+  EXPECT_EQ(stats.bytes_used, 0);
+  EXPECT_EQ(stats.tail_waste, 0);
+  EXPECT_GT(stats.bytes_free, 0);
+  EXPECT_GT(stats.bytes_allocated, stats.bytes_free);
+
+  // Leave a tail behind by making an allocation that does not fit.
+  size_t free_before = stats.bytes_free;
+  EXPECT_NE(upb_Arena_Malloc(arena, 24), nullptr);
+  EXPECT_NE(upb_Arena_Malloc(arena, 1000), nullptr);
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.block_count, 2);
+  EXPECT_EQ(stats.tail_waste, free_before - 24 - UPB_ASAN_GUARD_SIZE);
+  EXPECT_EQ(stats.bytes_used, 24 + 1000 + 2 * UPB_ASAN_GUARD_SIZE);
+  EXPECT_GT(stats.bytes_allocated,
+            stats.bytes_used + stats.bytes_free + stats.tail_waste);
+
+  uint32_t blocks = 0;
+  for (uint32_t n : stats.block_histogram) blocks += n;
+  EXPECT_EQ(blocks, stats.block_count);
+  EXPECT_EQ(stats.block_histogram[0], 1);  // The 256-byte first block.
+  EXPECT_EQ(stats.block_histogram[1] + stats.block_histogram[2], 1);
+
+  // Moving an allocation abandons the old copy.
+  void* p = upb_Arena_Malloc(arena, 64);
+  EXPECT_NE(upb_Arena_Malloc(arena, 8), nullptr);
+  EXPECT_NE(upb_Arena_Realloc(arena, p, 64, 128), p);
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.realloc_abandoned, 64);
+
+  upb_Arena* other = upb_Arena_New();
+  EXPECT_TRUE(upb_Arena_Fuse(arena, other));
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.fuse_count, 1);
+  upb_Arena_Free(other);
+  upb_Arena_Free(arena);
+
+  // After a reset, nothing is in use and the idle kept block is waste.
+  arena = upb_Arena_New();
+  EXPECT_NE(upb_Arena_Malloc(arena, 5000), nullptr);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.block_count, 2);
+  EXPECT_EQ(stats.bytes_used, 0);
+  EXPECT_EQ(stats.realloc_abandoned, 0);
+  EXPECT_GT(stats.tail_waste, 0);
+  upb_Arena_Free(arena);
+
+  // A first block bigger than the later ones is the one allocated from.
+  upb_ArenaOptions options = {};
+  options.initial_block_size = 1 << 20;
+  options.max_block_size = 4096;
+  arena = upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_global, &options);
+  EXPECT_NE(upb_Arena_Malloc(arena, (1 << 20) - 1000), nullptr);
+  EXPECT_NE(upb_Arena_Malloc(arena, 2000), nullptr);
+  EXPECT_TRUE(upb_Arena_Reset(arena));
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.block_count, 2);
+  EXPECT_GE(stats.bytes_free, 1 << 20);
+  EXPECT_LE(stats.tail_waste, 4096);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, MarkAndRewind) {
+  upb_Arena* arena = upb_Arena_New();
+  EXPECT_NE(upb_Arena_Malloc(arena, 16), nullptr);
+  size_t space = upb_Arena_SpaceAllocated(arena);
+
+  upb_ArenaMark mark = upb_Arena_Mark(arena);
+  void* first = upb_Arena_Malloc(arena, 16);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 1000), nullptr);
+  }
+  EXPECT_GT(upb_Arena_SpaceAllocated(arena), space);
+
+  upb_Arena_RewindTo(arena, &mark);
+  EXPECT_EQ(upb_Arena_SpaceAllocated(arena), space);
+  EXPECT_EQ(upb_Arena_Malloc(arena, 16), first);
+  upb_ArenaStats stats;
+  upb_Arena_GetStats(arena, &stats);
+  EXPECT_EQ(stats.tail_waste, 0);
+  EXPECT_EQ(stats.bytes_used, 32 + 2 * UPB_ASAN_GUARD_SIZE);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, NestedMarks) {
+  char buf[512];
+  upb_Arena* arena = upb_Arena_Init(buf, sizeof(buf), &upb_alloc_global);
+  upb_ArenaMark outer = upb_Arena_Mark(arena);
+  void* a = upb_Arena_Malloc(arena, 100);
+  upb_ArenaMark inner = upb_Arena_Mark(arena);
+  void* b = upb_Arena_Malloc(arena, 100);
+  EXPECT_NE(upb_Arena_Malloc(arena, 5000), nullptr);
+
+  // Rewinding with nothing allocated since the mark is a no-op.
+  upb_ArenaMark top = upb_Arena_Mark(arena);
+  upb_Arena_RewindTo(arena, &top);
+
+  upb_Arena_RewindTo(arena, &inner);
+  EXPECT_EQ(upb_Arena_SpaceAllocated(arena), 0);
+  EXPECT_EQ(upb_Arena_Malloc(arena, 100), b);
+  upb_Arena_RewindTo(arena, &outer);
+  EXPECT_EQ(upb_Arena_Malloc(arena, 100), a);
+  upb_Arena_Free(arena);
+}
+
+TEST(ArenaTest, BlockCacheReusesBlocks) {
+  upb_BlockCache_Trim(0);
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), 0);
+
+  upb_Arena* arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 100), nullptr);
+  }
+  upb_Arena_Free(arena);
+  size_t cached = upb_BlockCache_CachedBytes();
+  EXPECT_GT(cached, 0);
+
+  // A second arena of the same shape is served entirely from the cache.
+  arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+  EXPECT_LT(upb_BlockCache_CachedBytes(), cached);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_NE(upb_Arena_Malloc(arena, 100), nullptr);
+  }
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), 0);
+  upb_Arena_Free(arena);
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), cached);
+
+  upb_BlockCache_Trim(0);
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), 0);
+}
+
+TEST(ArenaTest, BlockCacheLimit) {
+  size_t limit = upb_BlockCache_Limit();
+  upb_BlockCache_SetLimit(0);
+  upb_Arena* arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+  EXPECT_NE(upb_Arena_Malloc(arena, 10000), nullptr);
+  upb_Arena_Free(arena);
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), 0);
+
+  upb_BlockCache_SetLimit(limit);
+  arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+  EXPECT_NE(upb_Arena_Malloc(arena, 10000), nullptr);
+  upb_Arena_Free(arena);
+  EXPECT_GT(upb_BlockCache_CachedBytes(), 0);
+  EXPECT_LE(upb_BlockCache_CachedBytes(), limit);
+
+  // Lowering the limit trims immediately.
+  upb_BlockCache_SetLimit(0);
+  EXPECT_EQ(upb_BlockCache_CachedBytes(), 0);
+  upb_BlockCache_SetLimit(limit);
+}
+
+TEST(ArenaTest, BlockCacheRealloc) {
+  char* p = static_cast<char*>(upb_malloc(&upb_alloc_cached, 100));
+  ASSERT_NE(p, nullptr);
+  memset(p, 'x', 100);
+
+  // Growing within the same size class keeps the pointer.
+  EXPECT_EQ(upb_realloc(&upb_alloc_cached, p, 100, 200), p);
+
+  // Growing past the largest size class moves the data out of the cache.
+  p = static_cast<char*>(upb_realloc(&upb_alloc_cached, p, 200, 4 << 20));
+  ASSERT_NE(p, nullptr);
+  EXPECT_EQ(std::string(p, 100), std::string(100, 'x'));
+  p = static_cast<char*>(upb_realloc(&upb_alloc_cached, p, 4 << 20, 8 << 20));
+  ASSERT_NE(p, nullptr);
+  EXPECT_EQ(std::string(p, 100), std::string(100, 'x'));
+
+  // Shrinking back brings it into a size class again.
+  p = static_cast<char*>(upb_realloc(&upb_alloc_cached, p, 8 << 20, 1000));
+  ASSERT_NE(p, nullptr);
+  EXPECT_EQ(std::string(p, 100), std::string(100, 'x'));
+  upb_free(&upb_alloc_cached, p);
+  upb_BlockCache_Trim(0);
+}
+
+// A cached block may come back as any kind of block: the first block of an
+// arena, which holds the arena itself at its end, or a later block that the
+// arena poisoned while it was unused.
+TEST(ArenaTest, BlockCacheBlockChangesRole) {
+  upb_BlockCache_Trim(0);
+  for (size_t initial : {256, 4096, 300, 1000, 2048, 512, 8192, 256}) {
+    upb_ArenaOptions options = {};
+    options.initial_block_size = initial;
+    upb_Arena* arena =
+        upb_Arena_InitWithOptions(NULL, 0, &upb_alloc_cached, &options);
+    ASSERT_NE(arena, nullptr);
+    for (int i = 0; i < 50; i++) {
+      char* p = static_cast<char*>(upb_Arena_Malloc(arena, 10 + i * 13));
+      ASSERT_NE(p, nullptr);
+      memset(p, 'x', 10 + i * 13);
+    }
+    upb_Arena_Free(arena);
+  }
+  upb_BlockCache_Trim(0);
+}
+
+TEST(ArenaTest, BlockCacheCrossThreadFree) {
+  upb_Arena* arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+  EXPECT_NE(upb_Arena_Malloc(arena, 5000), nullptr);
+  std::thread t([arena] {
+    upb_Arena_Free(arena);
+    EXPECT_GT(upb_BlockCache_CachedBytes(), 0);
+    upb_BlockCache_Trim(0);
+  });
+  t.join();
+}
+
 class Environment {
  public:
   ~Environment() {
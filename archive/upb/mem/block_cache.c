@@ -0,0 +1,229 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/mem/block_cache.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef UPB_THREAD_LOCAL
+
+// Every block is preceded by a header that records its size class, since
+// upb_free() does not tell us how large the block being freed is.
+static const size_t kUpb_BlockCache_HeaderSize = UPB_MALLOC_ALIGN;
+
+// Size classes are spaced four per power of two, which bounds the space
+// wasted by rounding up to 25%.  Class `c` holds blocks of
+// (4 + c % 4) << (c / 4 + 6) bytes (header included), i.e. 256, 320, 384,
+// 448, 512, 640, ... up to 1MiB.
+enum {
+  kUpb_BlockCache_MinClassLg2 = 8,
+  kUpb_BlockCache_ClassCount = 49,
+  kUpb_BlockCache_Uncached = -1,
+  kUpb_BlockCache_DefaultLimit = 1 << 20,
+};
+
+typedef struct _upb_CachedBlock {
+  struct _upb_CachedBlock* next;
+} _upb_CachedBlock;
+
+typedef struct {
+  _upb_CachedBlock* free_lists[kUpb_BlockCache_ClassCount];
+  size_t cached_bytes;
+  size_t limit;
+} _upb_BlockCache;
+
+static UPB_THREAD_LOCAL _upb_BlockCache _upb_block_cache = {
+    {NULL}, 0, kUpb_BlockCache_DefaultLimit};
+
+static size_t _upb_BlockCache_ClassSize(int size_class) {
+  return (size_t)(4 + (size_class & 3)) << ((size_class >> 2) + 6);
+}
+
+static int _upb_BlockCache_Log2Floor(size_t x) {
+#ifdef __GNUC__
+  return (int)(sizeof(unsigned long long) * 8 - 1) -
+         __builtin_clzll((unsigned long long)x);
+#else
+  int lg2 = 0;
+  while (x >>= 1) lg2++;
+  return lg2;
+#endif
+}
+
+// Returns the smallest class that holds `n` bytes, or
+// kUpb_BlockCache_Uncached if `n` is too large to be cached.
+static int _upb_BlockCache_SizeClass(size_t n) {
+  if (n <= (1 << kUpb_BlockCache_MinClassLg2)) return 0;
+  if (n > _upb_BlockCache_ClassSize(kUpb_BlockCache_ClassCount - 1)) {
+    return kUpb_BlockCache_Uncached;
+  }
+  size_t x = n - 1;
+  int lg2 = _upb_BlockCache_Log2Floor(x);
+  int sub = (int)(x >> (lg2 - 2)) & 3;
+  return (lg2 - kUpb_BlockCache_MinClassLg2) * 4 + sub + 1;
+}
+
+static int32_t* _upb_BlockCache_Header(void* ptr) {
+  return (int32_t*)((char*)ptr - kUpb_BlockCache_HeaderSize);
+}
+
+static void* _upb_BlockCache_Malloc(size_t size) {
+  if (size > SIZE_MAX - kUpb_BlockCache_HeaderSize) return NULL;
+  size_t n = size + kUpb_BlockCache_HeaderSize;
+  int size_class = _upb_BlockCache_SizeClass(n);
+  char* mem;
+
+  if (size_class == kUpb_BlockCache_Uncached) {
+    mem = upb_gmalloc(n);
+  } else {
+    _upb_BlockCache* cache = &_upb_block_cache;
+    _upb_CachedBlock* block = cache->free_lists[size_class];
+    if (block) {
+      size_t class_size = _upb_BlockCache_ClassSize(size_class);
+      cache->free_lists[size_class] = block->next;
+      cache->cached_bytes -= class_size;
+      // The block's last owner may have poisoned any part of it.
+      UPB_UNPOISON_MEMORY_REGION(block,
+                                 class_size - kUpb_BlockCache_HeaderSize);
+      return block;
+    }
+    mem = upb_gmalloc(_upb_BlockCache_ClassSize(size_class));
+  }
+
+  if (!mem) return NULL;
+  *(int32_t*)mem = size_class;
+  return mem + kUpb_BlockCache_HeaderSize;
+}
+
+static void _upb_BlockCache_Free(void* ptr) {
+  int size_class = *_upb_BlockCache_Header(ptr);
+  _upb_BlockCache* cache = &_upb_block_cache;
+
+  if (size_class != kUpb_BlockCache_Uncached) {
+    size_t class_size = _upb_BlockCache_ClassSize(size_class);
+    if (cache->cached_bytes + class_size <= cache->limit) {
+      _upb_CachedBlock* block = ptr;
+      // Keep the link usable and poison the rest, so that a stale pointer
+      // into a cached block is still caught.
+      UPB_UNPOISON_MEMORY_REGION(block, sizeof(*block));
+      block->next = cache->free_lists[size_class];
+      UPB_POISON_MEMORY_REGION(
+          block + 1,
+          class_size - kUpb_BlockCache_HeaderSize - sizeof(*block));
+      cache->free_lists[size_class] = block;
+      cache->cached_bytes += class_size;
+      return;
+    }
+  }
+
+  upb_gfree(_upb_BlockCache_Header(ptr));
+}
+
+static void* _upb_BlockCache_AllocFunc(upb_alloc* alloc, void* ptr,
+                                       size_t oldsize, size_t size) {
+  UPB_UNUSED(alloc);
+  if (size == 0) {
+    if (ptr) _upb_BlockCache_Free(ptr);
+    return NULL;
+  }
+  if (!ptr) return _upb_BlockCache_Malloc(size);
+
+  int size_class = *_upb_BlockCache_Header(ptr);
+  if (size_class == kUpb_BlockCache_Uncached) {
+    if (size > SIZE_MAX - kUpb_BlockCache_HeaderSize) return NULL;
+    if (_upb_BlockCache_SizeClass(size + kUpb_BlockCache_HeaderSize) ==
+        kUpb_BlockCache_Uncached) {
+      char* mem = upb_grealloc(_upb_BlockCache_Header(ptr),
+                               oldsize + kUpb_BlockCache_HeaderSize,
+                               size + kUpb_BlockCache_HeaderSize);
+      return mem ? mem + kUpb_BlockCache_HeaderSize : NULL;
+    }
+  } else if (size + kUpb_BlockCache_HeaderSize <=
+             _upb_BlockCache_ClassSize(size_class)) {
+    UPB_UNPOISON_MEMORY_REGION(ptr, size);
+    return ptr;  // Still fits in its size class.
+  }
+
+  void* ret = _upb_BlockCache_Malloc(size);
+  if (!ret) return NULL;
+  memcpy(ret, ptr, UPB_MIN(oldsize, size));
+  _upb_BlockCache_Free(ptr);
+  return ret;
+}
+
+upb_alloc upb_alloc_cached = {&_upb_BlockCache_AllocFunc};
+
+void upb_BlockCache_Trim(size_t max_bytes) {
+  _upb_BlockCache* cache = &_upb_block_cache;
+  // Release the largest blocks first.
+  for (int i = kUpb_BlockCache_ClassCount - 1; i >= 0; i--) {
+    while (cache->cached_bytes > max_bytes && cache->free_lists[i]) {
+      _upb_CachedBlock* block = cache->free_lists[i];
+      cache->free_lists[i] = block->next;
+      cache->cached_bytes -= _upb_BlockCache_ClassSize(i);
+      upb_gfree(_upb_BlockCache_Header(block));
+    }
+  }
+}
+
+size_t upb_BlockCache_CachedBytes(void) {
+  return _upb_block_cache.cached_bytes;
+}
+
+size_t upb_BlockCache_Limit(void) { return _upb_block_cache.limit; }
+
+void upb_BlockCache_SetLimit(size_t max_bytes) {
+  _upb_block_cache.limit = max_bytes;
+  upb_BlockCache_Trim(max_bytes);
+}
+
+#else  // !UPB_THREAD_LOCAL
+
+static void* _upb_BlockCache_AllocFunc(upb_alloc* alloc, void* ptr,
+                                       size_t oldsize, size_t size) {
+  UPB_UNUSED(alloc);
+  return upb_realloc(&upb_alloc_global, ptr, oldsize, size);
+}
+
+upb_alloc upb_alloc_cached = {&_upb_BlockCache_AllocFunc};
+
+void upb_BlockCache_Trim(size_t max_bytes) { UPB_UNUSED(max_bytes); }
+
+size_t upb_BlockCache_CachedBytes(void) { return 0; }
+
+size_t upb_BlockCache_Limit(void) { return 0; }
+
+void upb_BlockCache_SetLimit(size_t max_bytes) { UPB_UNUSED(max_bytes); }
+
+#endif  // UPB_THREAD_LOCAL
@@ -0,0 +1,83 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/* upb_alloc_cached is a upb_alloc that keeps freed blocks in per-thread free
+ * lists, bucketed by size class, so that they can be handed out again without
+ * a trip through malloc().  It is intended as the block allocator for
+ * short-lived arenas:
+ *
+ *   upb_Arena* arena = upb_Arena_Init(NULL, 0, &upb_alloc_cached);
+ *
+ * so that creating and destroying an arena costs a few pointer operations
+ * once the calling thread's cache is warm.
+ *
+ * A block may be freed on a different thread than the one that allocated it;
+ * it simply lands in the freeing thread's cache.  Each thread caches at most
+ * upb_BlockCache_Limit() bytes, and blocks larger than 1MiB are never cached.
+ * Cached memory is only handed back to the system by upb_BlockCache_Trim(), so
+ * a thread that is about to exit should call upb_BlockCache_Trim(0).
+ *
+ * If the compiler does not support thread-local storage, upb_alloc_cached
+ * simply forwards to upb_alloc_global. */
+
+#ifndef UPB_MEM_BLOCK_CACHE_H_
+#define UPB_MEM_BLOCK_CACHE_H_
+
+#include <stddef.h>
+
+#include "upb/mem/alloc.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern upb_alloc upb_alloc_cached;
+
+// Frees cached blocks of the calling thread until at most `max_bytes` remain.
+UPB_API void upb_BlockCache_Trim(size_t max_bytes);
+
+// Returns the number of bytes currently cached by the calling thread.
+UPB_API size_t upb_BlockCache_CachedBytes(void);
+
+// Gets/sets the maximum number of bytes the calling thread will keep cached.
+// Lowering the limit trims the cache immediately.  The default is 1MiB.
+UPB_API size_t upb_BlockCache_Limit(void);
+UPB_API void upb_BlockCache_SetLimit(size_t max_bytes);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MEM_BLOCK_CACHE_H_ */
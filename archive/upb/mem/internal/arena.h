@@ -32,6 +32,7 @@
 #define UPB_MEM_INTERNAL_ARENA_H_
 
 #include "upb/mem/arena.h"
+#include "upb/port/atomic.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -65,6 +66,20 @@ struct upb_Arena {
   // Linked list of blocks to free/cleanup.  Atomic only for the benefit of
   // upb_Arena_SpaceAllocated().
   UPB_ATOMIC(_upb_MemBlock*) blocks;
+
+  // Start of the user-provided initial block, or NULL if there is none.  Only
+  // needed so that upb_Arena_Reset() can rewind into it.
+  char* initial_block;
+
+  // Block growth policy, see upb_ArenaOptions.
+  uint32_t initial_block_size;
+  uint32_t max_block_size;  // 0 for no limit.
+  uint16_t growth_factor;
+  bool hugepages;
+
+  // Instrumentation, see upb_ArenaStats.
+  size_t tail_waste;
+  UPB_ATOMIC(uint32_t) fuse_count;
 };
 
 UPB_INLINE bool _upb_Arena_IsTaggedRefcount(uintptr_t parent_or_count) {
@@ -112,6 +127,29 @@ UPB_INLINE bool upb_Arena_HasInitialBlock(upb_Arena* arena) {
   return arena->block_alloc & 0x1;
 }
 
+// Initializes `des` as a temporary stand-in for `src` that can allocate but
+// not fuse or free, so that a hot loop can allocate from a local copy
+// (see the decoder).  _upb_Arena_SwapOut() hands the allocations back.
+UPB_INLINE void _upb_Arena_SwapIn(upb_Arena* des, const upb_Arena* src) {
+  des->head = src->head;
+  des->block_alloc = src->block_alloc;
+  upb_Atomic_Init(&des->blocks,
+                  upb_Atomic_Load(&src->blocks, memory_order_relaxed));
+  des->initial_block_size = src->initial_block_size;
+  des->max_block_size = src->max_block_size;
+  des->growth_factor = src->growth_factor;
+  des->hugepages = src->hugepages;
+  des->tail_waste = src->tail_waste;
+}
+
+UPB_INLINE void _upb_Arena_SwapOut(upb_Arena* des, const upb_Arena* src) {
+  des->head = src->head;
+  upb_Atomic_Store(&des->blocks,
+                   upb_Atomic_Load(&src->blocks, memory_order_relaxed),
+                   memory_order_relaxed);
+  des->tail_waste = src->tail_waste;
+}
+
 #include "upb/port/undef.inc"
 
 #endif /* UPB_MEM_INTERNAL_ARENA_H_ */
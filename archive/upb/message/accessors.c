@@ -32,6 +32,7 @@
 
 #include "upb/collections/array.h"
 #include "upb/collections/internal/array.h"
+#include "upb/collections/internal/map.h"
 #include "upb/collections/map.h"
 #include "upb/message/message.h"
 #include "upb/mini_table/field.h"
@@ -69,6 +70,52 @@ upb_MapInsertStatus upb_Message_InsertMapEntry(upb_Map* map,
   return upb_Map_Insert(map, map_entry_key, map_entry_value, arena);
 }
 
+void upb_Message_ClearForReuse(upb_Message* msg,
+                               const upb_MiniTable* mini_table) {
+  const char zeros[16] = {0};
+  for (size_t i = 0; i < mini_table->field_count; i++) {
+    const upb_MiniTableField* field = &mini_table->fields[i];
+    void* mem = _upb_MiniTableField_GetPtr(msg, field);
+    switch (upb_FieldMode_Get(field)) {
+      case kUpb_FieldMode_Array: {
+        upb_Array* arr = *(upb_Array**)mem;
+        if (arr) arr->size = 0;
+        continue;
+      }
+      case kUpb_FieldMode_Map: {
+        upb_Map* map = *(upb_Map**)mem;
+        if (map) _upb_Map_Clear(map);
+        continue;
+      }
+      case kUpb_FieldMode_Scalar:
+        break;
+    }
+    if (field->presence < 0) {
+      // A oneof's storage is shared by several types, so it is not reused.
+      *_upb_oneofcase_field(msg, field) = 0;
+    } else if (field->presence > 0) {
+      upb_TaggedMessagePtr tagged =
+          upb_MiniTableField_CType(field) == kUpb_CType_Message
+              ? *(upb_TaggedMessagePtr*)mem
+              : 0;
+      if (tagged && !upb_TaggedMessagePtr_IsEmpty(tagged)) {
+        // A sub-message whose hasbit is clear was cleared by an earlier call,
+        // and nothing can have set fields in it since.
+        if (_upb_hasbit_field(msg, field)) {
+          upb_Message_ClearForReuse(
+              _upb_TaggedMessagePtr_GetMessage(tagged),
+              upb_MiniTable_GetSubMessageTable(mini_table, field));
+          _upb_clearhas(msg, _upb_Message_Hasidx(field));
+        }
+        continue;
+      }
+      _upb_clearhas(msg, _upb_Message_Hasidx(field));
+    }
+    _upb_MiniTable_CopyFieldData(mem, zeros, field);
+  }
+  _upb_Message_DiscardInternal_shallow(msg);
+}
+
 bool upb_Message_IsExactlyEqual(const upb_Message* m1, const upb_Message* m2,
                                 const upb_MiniTable* layout) {
   if (m1 == m2) return true;
@@ -65,6 +65,22 @@ UPB_API_INLINE void upb_Message_Clear(upb_Message* msg,
   memset(mem, 0, upb_msg_sizeof(l));
 }
 
+// Clears a message tree like upb_Message_Clear(), but keeps the memory that it
+// has already allocated so that the next parse into `msg` can reuse it:
+// sub-messages stay attached and are cleared in place, repeated fields keep
+// their capacity, maps keep their tables, and the buffer for unknown fields
+// and extensions is kept. Use this to parse a stream of messages into a single
+// message without growing the arena on every parse:
+//
+//   upb_Message_ClearForReuse(msg, mini_table);
+//   upb_Decode(buf, size, msg, mini_table, NULL, 0, arena);
+//
+// A cleared sub-message is no longer present, but its getter may still return
+// it, as an empty message. Elements of repeated message fields, map entries and
+// extensions are not reused.
+UPB_API void upb_Message_ClearForReuse(upb_Message* msg,
+                                       const upb_MiniTable* mini_table);
+
 UPB_API_INLINE bool upb_Message_HasField(const upb_Message* msg,
                                          const upb_MiniTableField* field) {
   if (upb_MiniTableField_IsExtension(field)) {
@@ -310,8 +326,9 @@ UPB_API_INLINE upb_Message* upb_Message_GetOrCreateMutableMessage(
     UPB_ASSERT(sub_mini_table);
     sub_message = _upb_Message_New(sub_mini_table, arena);
     *UPB_PTR_AT(msg, field->offset, upb_Message*) = sub_message;
-    _upb_Message_SetPresence(msg, field);
   }
+  // The sub-message may have been kept by upb_Message_ClearForReuse().
+  _upb_Message_SetPresence(msg, field);
   return sub_message;
 }
 
@@ -215,7 +215,11 @@ upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
               upb_Message_GetTaggedMessagePtr(src, field, NULL);
           const upb_Message* sub_message =
               _upb_TaggedMessagePtr_GetMessage(tagged);
-          if (sub_message != NULL) {
+          if (sub_message != NULL && field->presence > 0 &&
+              !_upb_Message_HasNonExtensionField(src, field)) {
+            // Kept by upb_Message_ClearForReuse(); it must not be shared.
+            _upb_Message_ClearNonExtensionField(dst, field);
+          } else if (sub_message != NULL) {
             // If the message is currently in an unlinked, "empty" state we keep
             // it that way, because we don't want to deal with decode options,
             // decode status, or possible parse failure here.
@@ -293,12 +297,11 @@ upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
   }
 
   // Clone unknowns.
-  size_t unknown_size = 0;
-  const char* ptr = upb_Message_GetUnknown(src, &unknown_size);
-  if (unknown_size != 0) {
-    UPB_ASSERT(ptr);
+  upb_StringView unknown;
+  uintptr_t iter = kUpb_Message_UnknownBegin;
+  while (upb_Message_NextUnknown(src, &unknown, &iter)) {
     // Make a copy into destination arena.
-    if (!_upb_Message_AddUnknown(dst, ptr, unknown_size, arena)) {
+    if (!_upb_Message_AddUnknown(dst, unknown.data, unknown.size, arena)) {
       return NULL;
     }
   }
@@ -84,6 +84,12 @@ typedef struct {
    *   extensions data: data[(ext_begin - overhead) .. (size - overhead)] */
   uint32_t unknown_end;
   uint32_t ext_begin;
+
+  /* If nonzero, the unknown data is an array of upb_StringView that point to
+   * serialized unknown fields stored elsewhere (usually the decoder's input
+   * buffer, see kUpb_DecodeOption_AliasUnknown) instead of the bytes
+   * themselves. */
+  uint32_t unknown_aliased;
   /* Data follows, as if there were an array:
    *   char data[size - sizeof(upb_Message_InternalData)]; */
 } upb_Message_InternalData;
@@ -128,11 +134,27 @@ UPB_INLINE upb_Message_Internal* upb_Message_Getinternal(
 // Discards the unknown fields for this message only.
 void _upb_Message_DiscardUnknown_shallow(upb_Message* msg);
 
+// Discards the message's unknown fields and extensions, keeping the buffer
+// that holds them so that it can be filled again.
+void _upb_Message_DiscardInternal_shallow(upb_Message* msg);
+
 // Adds unknown data (serialized protobuf data) to the given message.
 // The data is copied into the message instance.
 bool _upb_Message_AddUnknown(upb_Message* msg, const char* data, size_t len,
                              upb_Arena* arena);
 
+// Returns the message's unknown data as an array of |*count| chunks, in the
+// order they were added. Unknown data that is not aliased is returned as a
+// single chunk stored in |*flat|.
+const upb_StringView* _upb_Message_UnknownChunks(const upb_Message* msg,
+                                                 upb_StringView* flat,
+                                                 size_t* count);
+
+// Adds unknown data (serialized protobuf data) to the given message without
+// copying it. The data must outlive the message.
+bool _upb_Message_AddUnknownAliased(upb_Message* msg, const char* data,
+                                    size_t len, upb_Arena* arena);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -59,6 +59,7 @@ static bool realloc_internal(upb_Message* msg, size_t need, upb_Arena* arena) {
     internal->size = size;
     internal->unknown_end = overhead;
     internal->ext_begin = size;
+    internal->unknown_aliased = 0;
     in->internal = internal;
   } else if (in->internal->ext_begin - in->internal->unknown_end < need) {
     /* Internal data is too small, reallocate. */
@@ -81,25 +82,105 @@ static bool realloc_internal(upb_Message* msg, size_t need, upb_Arena* arena) {
   return true;
 }
 
+static upb_StringView* _upb_Message_UnknownSpans(
+    const upb_Message_InternalData* internal, size_t* count) {
+  UPB_ASSERT(internal->unknown_aliased);
+  *count = (internal->unknown_end - overhead) / sizeof(upb_StringView);
+  return UPB_PTR_AT(internal, overhead, upb_StringView);
+}
+
+static bool _upb_Message_AppendUnknownSpan(upb_Message* msg, const char* data,
+                                           size_t len, upb_Arena* arena) {
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  size_t count;
+  upb_StringView* spans = _upb_Message_UnknownSpans(in->internal, &count);
+  if (count) {
+    // Fields that were adjacent in the input stay in one span.
+    upb_StringView* last = &spans[count - 1];
+    if ((uintptr_t)last->data + last->size == (uintptr_t)data) {
+      last->size += len;
+      return true;
+    }
+  }
+  if (!realloc_internal(msg, sizeof(upb_StringView), arena)) return false;
+  upb_StringView* span =
+      UPB_PTR_AT(in->internal, in->internal->unknown_end, upb_StringView);
+  *span = upb_StringView_FromDataAndSize(data, len);
+  in->internal->unknown_end += sizeof(upb_StringView);
+  return true;
+}
+
 bool _upb_Message_AddUnknown(upb_Message* msg, const char* data, size_t len,
                              upb_Arena* arena) {
-  if (!realloc_internal(msg, len, arena)) return false;
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal && in->internal->unknown_aliased) {
+    char* copy = upb_Arena_Malloc(arena, len);
+    if (!copy) return false;
+    memcpy(copy, data, len);
+    return _upb_Message_AppendUnknownSpan(msg, copy, len, arena);
+  }
+  if (!realloc_internal(msg, len, arena)) return false;
   memcpy(UPB_PTR_AT(in->internal, in->internal->unknown_end, char), data, len);
   in->internal->unknown_end += len;
   return true;
 }
 
+bool _upb_Message_AddUnknownAliased(upb_Message* msg, const char* data,
+                                    size_t len, upb_Arena* arena) {
+  if (len == 0) return true;
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (!in->internal || !in->internal->unknown_aliased) {
+    // Switch to spans, moving any unknown data we already hold to the arena.
+    size_t existing_len;
+    const char* existing = upb_Message_GetUnknown(msg, &existing_len);
+    char* copy = NULL;
+    if (existing_len) {
+      copy = upb_Arena_Malloc(arena, existing_len);
+      if (!copy) return false;
+      memcpy(copy, existing, existing_len);
+      in->internal->unknown_end = overhead;
+    }
+    if (!realloc_internal(msg, sizeof(upb_StringView), arena)) return false;
+    in->internal->unknown_aliased = 1;
+    if (copy &&
+        !_upb_Message_AppendUnknownSpan(msg, copy, existing_len, arena)) {
+      return false;
+    }
+  }
+  return _upb_Message_AppendUnknownSpan(msg, data, len, arena);
+}
+
 void _upb_Message_DiscardUnknown_shallow(upb_Message* msg) {
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
   if (in->internal) {
     in->internal->unknown_end = overhead;
+    in->internal->unknown_aliased = 0;
+  }
+}
+
+void _upb_Message_DiscardInternal_shallow(upb_Message* msg) {
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal) {
+    in->internal->unknown_end = overhead;
+    in->internal->ext_begin = in->internal->size;
+    in->internal->unknown_aliased = 0;
   }
 }
 
 const char* upb_Message_GetUnknown(const upb_Message* msg, size_t* len) {
   const upb_Message_Internal* in = upb_Message_Getinternal(msg);
-  if (in->internal) {
+  if (in->internal && in->internal->unknown_aliased) {
+    size_t count;
+    const upb_StringView* spans =
+        _upb_Message_UnknownSpans(in->internal, &count);
+    if (count != 1) {
+      // More than one chunk cannot be returned as a single pointer.
+      *len = 0;
+      return NULL;
+    }
+    *len = spans[0].size;
+    return spans[0].data;
+  } else if (in->internal) {
     *len = in->internal->unknown_end - overhead;
     return (char*)(in->internal + 1);
   } else {
@@ -108,8 +189,50 @@ const char* upb_Message_GetUnknown(const upb_Message* msg, size_t* len) {
   }
 }
 
+const upb_StringView* _upb_Message_UnknownChunks(const upb_Message* msg,
+                                                 upb_StringView* flat,
+                                                 size_t* count) {
+  const upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal && in->internal->unknown_aliased) {
+    return _upb_Message_UnknownSpans(in->internal, count);
+  }
+  flat->data = upb_Message_GetUnknown(msg, &flat->size);
+  *count = flat->size ? 1 : 0;
+  return flat;
+}
+
+bool upb_Message_NextUnknown(const upb_Message* msg, upb_StringView* data,
+                             uintptr_t* iter) {
+  upb_StringView flat;
+  size_t count;
+  const upb_StringView* chunks = _upb_Message_UnknownChunks(msg, &flat, &count);
+  if (*iter >= count) return false;
+  *data = chunks[(*iter)++];
+  return true;
+}
+
+bool upb_Message_FlattenUnknown(upb_Message* msg, upb_Arena* arena) {
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (!in->internal || !in->internal->unknown_aliased) return true;
+  size_t count;
+  const upb_StringView* spans = _upb_Message_UnknownSpans(in->internal, &count);
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) total += spans[i].size;
+  char* buf = upb_Arena_Malloc(arena, total);
+  if (total && !buf) return false;
+  char* ptr = buf;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(ptr, spans[i].data, spans[i].size);
+    ptr += spans[i].size;
+  }
+  in->internal->unknown_end = overhead;
+  in->internal->unknown_aliased = 0;
+  return _upb_Message_AddUnknown(msg, buf, total, arena);
+}
+
 void upb_Message_DeleteUnknown(upb_Message* msg, const char* data, size_t len) {
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  UPB_ASSERT(!in->internal->unknown_aliased);
   const char* internal_unknown_end =
       UPB_PTR_AT(in->internal, in->internal->unknown_end, char);
 #ifndef NDEBUG
@@ -35,6 +35,9 @@
 #ifndef UPB_MESSAGE_MESSAGE_H_
 #define UPB_MESSAGE_MESSAGE_H_
 
+#include <stdint.h>
+
+#include "upb/base/string_view.h"
 #include "upb/mem/arena.h"
 #include "upb/message/types.h"
 #include "upb/mini_table/message.h"
@@ -56,9 +59,32 @@ void upb_Message_AddUnknown(upb_Message* msg, const char* data, size_t len,
                             upb_Arena* arena);
 
 // Returns a reference to the message's unknown data.
+//
+// If the message was parsed with kUpb_DecodeOption_AliasUnknown, its unknown
+// data may be split into several chunks in the input buffer. Then this returns
+// NULL and sets *len to 0; call upb_Message_FlattenUnknown() first, or use
+// upb_Message_NextUnknown().
 const char* upb_Message_GetUnknown(const upb_Message* msg, size_t* len);
 
-// Removes partial unknown data from message.
+// Iterates over the chunks of the message's unknown data. Every chunk holds
+// whole fields, in the order they were parsed. Usage:
+//
+//   upb_StringView data;
+//   uintptr_t iter = kUpb_Message_UnknownBegin;
+//   while (upb_Message_NextUnknown(msg, &data, &iter)) {
+//     // ...
+//   }
+#define kUpb_Message_UnknownBegin 0
+bool upb_Message_NextUnknown(const upb_Message* msg, upb_StringView* data,
+                             uintptr_t* iter);
+
+// Copies unknown data that aliases an external buffer into the message, so
+// that upb_Message_GetUnknown() returns it in one piece and the buffer no
+// longer needs to outlive the message. Returns false on allocation failure.
+bool upb_Message_FlattenUnknown(upb_Message* msg, upb_Arena* arena);
+
+// Removes partial unknown data from message. The unknown data must not be
+// aliased (see upb_Message_FlattenUnknown()).
 void upb_Message_DeleteUnknown(upb_Message* msg, const char* data, size_t len);
 
 // Returns the number of extensions present in this message.
@@ -85,6 +85,11 @@ upb_GetExtension_Status upb_MiniTable_GetOrPromoteExtension(
     return kUpb_GetExtension_Ok;
   }
 
+  // Promotion removes the field from the unknown data, which must be flat.
+  if (!upb_Message_FlattenUnknown(msg, arena)) {
+    return kUpb_GetExtension_OutOfMemory;
+  }
+
   // Check unknown fields, if available promote.
   int field_number = ext_table->field.number;
   upb_FindUnknownRet result = upb_MiniTable_FindUnknown(
@@ -130,30 +135,35 @@ static upb_FindUnknownRet upb_FindUnknownRet_ParseError(void) {
 upb_FindUnknownRet upb_MiniTable_FindUnknown(const upb_Message* msg,
                                              uint32_t field_number,
                                              int depth_limit) {
-  size_t size;
   upb_FindUnknownRet ret;
+  upb_StringView unknown;
+  uintptr_t iter = kUpb_Message_UnknownBegin;
 
-  const char* ptr = upb_Message_GetUnknown(msg, &size);
-  upb_EpsCopyInputStream stream;
-  upb_EpsCopyInputStream_Init(&stream, &ptr, size, true);
+  // Each chunk of unknown data holds whole fields, so we can scan them one at
+  // a time.
+  while (upb_Message_NextUnknown(msg, &unknown, &iter)) {
+    const char* ptr = unknown.data;
+    upb_EpsCopyInputStream stream;
+    upb_EpsCopyInputStream_Init(&stream, &ptr, unknown.size, true);
+
+    while (!upb_EpsCopyInputStream_IsDone(&stream, &ptr)) {
+      uint32_t tag;
+      const char* unknown_begin = ptr;
+      ptr = upb_WireReader_ReadTag(ptr, &tag);
+      if (!ptr) return upb_FindUnknownRet_ParseError();
+      if (field_number == upb_WireReader_GetFieldNumber(tag)) {
+        ret.status = kUpb_FindUnknown_Ok;
+        ret.ptr = upb_EpsCopyInputStream_GetAliasedPtr(&stream, unknown_begin);
+        ptr = _upb_WireReader_SkipValue(ptr, tag, depth_limit, &stream);
+        // Because we know that the input is a flat buffer, it is safe to
+        // perform pointer arithmetic on aliased pointers.
+        ret.len = upb_EpsCopyInputStream_GetAliasedPtr(&stream, ptr) - ret.ptr;
+        return ret;
+      }
 
-  while (!upb_EpsCopyInputStream_IsDone(&stream, &ptr)) {
-    uint32_t tag;
-    const char* unknown_begin = ptr;
-    ptr = upb_WireReader_ReadTag(ptr, &tag);
-    if (!ptr) return upb_FindUnknownRet_ParseError();
-    if (field_number == upb_WireReader_GetFieldNumber(tag)) {
-      ret.status = kUpb_FindUnknown_Ok;
-      ret.ptr = upb_EpsCopyInputStream_GetAliasedPtr(&stream, unknown_begin);
       ptr = _upb_WireReader_SkipValue(ptr, tag, depth_limit, &stream);
-      // Because we know that the input is a flat buffer, it is safe to perform
-      // pointer arithmetic on aliased pointers.
-      ret.len = upb_EpsCopyInputStream_GetAliasedPtr(&stream, ptr) - ret.ptr;
-      return ret;
+      if (!ptr) return upb_FindUnknownRet_ParseError();
     }
-
-    ptr = _upb_WireReader_SkipValue(ptr, tag, depth_limit, &stream);
-    if (!ptr) return upb_FindUnknownRet_ParseError();
   }
   ret.status = kUpb_FindUnknown_NotPresent;
   ret.ptr = NULL;
@@ -166,16 +176,18 @@ static upb_DecodeStatus upb_Message_PromoteOne(upb_TaggedMessagePtr* tagged,
                                                int decode_options,
                                                upb_Arena* arena) {
   upb_Message* empty = _upb_TaggedMessagePtr_GetEmptyMessage(*tagged);
-  size_t unknown_size;
-  const char* unknown_data = upb_Message_GetUnknown(empty, &unknown_size);
   upb_Message* promoted = upb_Message_New(mini_table, arena);
   if (!promoted) return kUpb_DecodeStatus_OutOfMemory;
-  upb_DecodeStatus status = upb_Decode(unknown_data, unknown_size, promoted,
-                                       mini_table, NULL, decode_options, arena);
-  if (status == kUpb_DecodeStatus_Ok) {
-    *tagged = _upb_TaggedMessagePtr_Pack(promoted, false);
+  upb_StringView unknown;
+  uintptr_t iter = kUpb_Message_UnknownBegin;
+  while (upb_Message_NextUnknown(empty, &unknown, &iter)) {
+    upb_DecodeStatus status = upb_Decode(unknown.data, unknown.size, promoted,
+                                         mini_table, NULL, decode_options,
+                                         arena);
+    if (status != kUpb_DecodeStatus_Ok) return status;
   }
-  return status;
+  *tagged = _upb_TaggedMessagePtr_Pack(promoted, false);
+  return kUpb_DecodeStatus_Ok;
 }
 
 upb_DecodeStatus upb_Message_PromoteMessage(upb_Message* parent,
@@ -253,6 +265,10 @@ upb_UnknownToMessageRet upb_MiniTable_PromoteUnknownToMessage(
   }
   upb_UnknownToMessageRet ret;
   ret.status = kUpb_UnknownToMessage_Ok;
+  if (!upb_Message_FlattenUnknown(msg, arena)) {
+    ret.status = kUpb_UnknownToMessage_OutOfMemory;
+    return ret;
+  }
   do {
     unknown = upb_MiniTable_FindUnknown(
         msg, field->number, upb_DecodeOptions_GetMaxDepth(decode_options));
@@ -298,6 +314,9 @@ upb_UnknownToMessage_Status upb_MiniTable_PromoteUnknownToMessageArray(
     upb_Message* msg, const upb_MiniTableField* field,
     const upb_MiniTable* mini_table, int decode_options, upb_Arena* arena) {
   upb_Array* repeated_messages = upb_Message_GetMutableArray(msg, field);
+  if (!upb_Message_FlattenUnknown(msg, arena)) {
+    return kUpb_UnknownToMessage_OutOfMemory;
+  }
   // Find all unknowns with given field number and parse.
   upb_FindUnknownRet unknown;
   do {
@@ -337,6 +356,9 @@ upb_UnknownToMessage_Status upb_MiniTable_PromoteUnknownToMap(
   UPB_ASSERT(map_entry_mini_table);
   UPB_ASSERT(map_entry_mini_table->field_count == 2);
   UPB_ASSERT(upb_FieldMode_Get(field) == kUpb_FieldMode_Map);
+  if (!upb_Message_FlattenUnknown(msg, arena)) {
+    return kUpb_UnknownToMessage_OutOfMemory;
+  }
   // Find all unknowns with given field number and parse.
   upb_FindUnknownRet unknown;
   while (1) {
@@ -0,0 +1,193 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Chooses encode table entries for MiniTables that are built at runtime.  This
+// mirrors the encode table that upbc emits for generated code.
+
+#include "upb/mini_descriptor/internal/build_tables.h"
+#include "upb/mini_table/internal/field.h"
+#include "upb/wire/encode_fast.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef enum {
+  CARD_h = 0, /* Singular with hasbit */
+  CARD_s = 1, /* Singular without hasbit */
+  CARD_o = 2, /* Oneof */
+  CARD_p = 3, /* Packed repeated */
+} upb_fastenc_card;
+
+typedef enum {
+  TYPE_b1,
+  TYPE_v4,
+  TYPE_u4,
+  TYPE_v8,
+  TYPE_z4,
+  TYPE_z8,
+  TYPE_f4,
+  TYPE_f8,
+} upb_fastenc_type;
+
+#define F(card, type, valbytes)                  \
+  {                                              \
+    &upb_e##card##type##valbytes##_1bt,          \
+        &upb_e##card##type##valbytes##_2bt,      \
+  }
+
+#define TYPES(card)                                                       \
+  {                                                                       \
+    F(card, b, 1), F(card, v, 4), F(card, u, 4), F(card, v, 8),           \
+        F(card, z, 4), F(card, z, 8), F(card, f, 4), F(card, f, 8),       \
+        F(card, s, ), F(card, m, ),                                       \
+  }
+
+// Indexed by [card][type][tagbytes - 1].  Packed strings and sub-messages
+// don't exist, so the 'p' row stops at the primitive types.
+static _upb_FieldEncoder* const fastenc_encoders[4][TYPE_f8 + 3][2] = {
+    TYPES(h),
+    TYPES(s),
+    TYPES(o),
+    {
+        F(p, b, 1),
+        F(p, v, 4),
+        F(p, u, 4),
+        F(p, v, 8),
+        F(p, z, 4),
+        F(p, z, 8),
+        F(p, f, 4),
+        F(p, f, 8),
+    },
+};
+
+#undef F
+#undef TYPES
+
+// Returns the index of the field type in fastenc_encoders, or -1 if the type
+// has no specialized encoder.
+static int fastenc_typeindex(upb_FieldType type) {
+  switch (type) {
+    case kUpb_FieldType_Bool:
+      return TYPE_b1;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      return TYPE_v4;
+    case kUpb_FieldType_UInt32:
+      return TYPE_u4;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      return TYPE_v8;
+    case kUpb_FieldType_SInt32:
+      return TYPE_z4;
+    case kUpb_FieldType_SInt64:
+      return TYPE_z8;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      return TYPE_f4;
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      return TYPE_f8;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      return TYPE_f8 + 1;
+    case kUpb_FieldType_Message:
+      return TYPE_f8 + 2;
+    default:
+      return -1;
+  }
+}
+
+bool _upb_MiniTable_BuildEncodeTable(const upb_MiniTable* m,
+                                     _upb_FastEncoder_Entry* entries) {
+  bool any_specialized = false;
+
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    _upb_FastEncoder_Entry* ent = &entries[i];
+    ent->field_data = i;
+    ent->field_encoder = &_upb_FastEncoder_EncodeGeneric;
+
+    int card;
+    uint64_t presence = 0;
+    switch (upb_FieldMode_Get(f)) {
+      case kUpb_FieldMode_Array:
+        if (!(f->mode & kUpb_LabelFlags_IsPacked)) continue;
+        card = CARD_p;
+        break;
+      case kUpb_FieldMode_Scalar:
+        if (f->presence > 0) {
+          card = CARD_h;
+          presence = f->presence;
+        } else if (f->presence < 0) {
+          card = CARD_o;
+          presence = ~f->presence;
+        } else {
+          card = CARD_s;
+        }
+        break;
+      default:
+        continue;
+    }
+
+    int type = fastenc_typeindex(f->UPB_PRIVATE(descriptortype));
+    if (type < 0 || (card == CARD_p && type > TYPE_f8)) continue;
+
+    uint32_t wire_type;
+    if (card == CARD_p || type > TYPE_f8) {
+      wire_type = kUpb_WireType_Delimited;
+    } else if (type == TYPE_f4) {
+      wire_type = kUpb_WireType_32Bit;
+    } else if (type == TYPE_f8) {
+      wire_type = kUpb_WireType_64Bit;
+    } else {
+      wire_type = kUpb_WireType_Varint;
+    }
+
+    // Tag must fit within a two-byte varint.
+    if (f->number >= 1 << 11) continue;
+    uint32_t tag = f->number << 3 | wire_type;
+    int tagbytes = tag < 0x80 ? 1 : 2;
+    uint64_t tag_data =
+        tagbytes == 1 ? tag : (tag & 0x7f) | 0x80 | (tag >> 7) << 8;
+
+    uint64_t submsg_index = f->UPB_PRIVATE(submsg_index) == kUpb_NoSub
+                                ? 0
+                                : f->UPB_PRIVATE(submsg_index);
+    ent->field_data = tag_data | (uint64_t)f->offset << 16 | presence << 32 |
+                      submsg_index << 48;
+    ent->field_encoder = fastenc_encoders[card][type][tagbytes - 1];
+    any_specialized = true;
+  }
+
+  return any_specialized;
+}
@@ -0,0 +1,253 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Chooses fast table entries for MiniTables that are built at runtime.  This
+// mirrors FastDecodeTable() in upbc, except that sub-message sizes are not
+// known until the table is linked, so sub-messages always use the "max" parser.
+
+#include "upb/mini_descriptor/internal/build_tables.h"
+#include "upb/mini_table/internal/field.h"
+#include "upb/wire/decode_fast.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#if UPB_FASTTABLE
+
+typedef enum {
+  CARD_s = 0, /* Singular (optional, non-repeated) */
+  CARD_o = 1, /* Oneof */
+  CARD_r = 2, /* Repeated */
+  CARD_p = 3  /* Packed Repeated */
+} upb_card;
+
+#define F(card, type, valbytes) \
+  {&upb_p##card##type##valbytes##_1bt, &upb_p##card##type##valbytes##_2bt}
+
+#define TYPES(card)                                                        \
+  {F(card, b, 1), F(card, v, 4), F(card, v, 8), F(card, z, 4), F(card, z, 8), \
+   F(card, f, 4), F(card, f, 8)}
+
+static _upb_FieldParser* const fastdecode_scalarparsers[4][7][2] = {
+    TYPES(s), TYPES(o), TYPES(r), TYPES(p)};
+
+#undef TYPES
+#undef F
+
+#define F(card, type) {&upb_p##card##type##_1bt, &upb_p##card##type##_2bt}
+
+static _upb_FieldParser* const fastdecode_stringparsers[3][2][2] = {
+    {F(s, s), F(s, b)}, {F(o, s), F(o, b)}, {F(r, s), F(r, b)}};
+
+#undef F
+
+#define F(card) {&upb_p##card##m_1bt_maxmaxb, &upb_p##card##m_2bt_maxmaxb}
+
+static _upb_FieldParser* const fastdecode_msgparsers[3][2] = {F(s), F(o), F(r)};
+
+#undef F
+
+// Returns the index into the second dimension of fastdecode_scalarparsers,
+// or -1 if the type is not a scalar type supported by the fast parser.
+static int fastdecode_scalartype(upb_FieldType type) {
+  switch (type) {
+    case kUpb_FieldType_Bool:
+      return 0;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_UInt32:
+      return 1;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      return 2;
+    case kUpb_FieldType_SInt32:
+      return 3;
+    case kUpb_FieldType_SInt64:
+      return 4;
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Float:
+      return 5;
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Double:
+      return 6;
+    default:
+      return -1;
+  }
+}
+
+static int fastdecode_wiretype(const upb_MiniTableField* f) {
+  if (f->mode & kUpb_LabelFlags_IsPacked) return kUpb_WireType_Delimited;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      return kUpb_WireType_64Bit;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      return kUpb_WireType_32Bit;
+    case kUpb_FieldType_Message:
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      return kUpb_WireType_Delimited;
+    case kUpb_FieldType_Group:
+      return kUpb_WireType_StartGroup;
+    default:
+      return kUpb_WireType_Varint;
+  }
+}
+
+// Fills in `ent` for field `f`, returning false if the field cannot use the
+// fast parser.  `tag` is the field's tag as encoded on the wire.
+static bool fastdecode_fillentry(const upb_MiniTableField* f, uint16_t tag,
+                                 _upb_FastTable_Entry* ent) {
+  upb_FieldType type = f->UPB_PRIVATE(descriptortype);
+  int tagbytes = tag > 0xff ? 1 : 0;  // Index for the 1bt/2bt variant.
+  upb_card card;
+
+  switch (upb_FieldMode_Get(f)) {
+    case kUpb_FieldMode_Map:
+      return false;
+    case kUpb_FieldMode_Array:
+      card = (f->mode & kUpb_LabelFlags_IsPacked) ? CARD_p : CARD_r;
+      break;
+    default:
+      card = f->presence < 0 ? CARD_o : CARD_s;
+      break;
+  }
+
+  // Data is:
+  //
+  //                  48                32                16                 0
+  // |--------|--------|--------|--------|--------|--------|--------|--------|
+  // |   offset (16)   |case offset (16) |presence| submsg |  exp. tag (16)  |
+  // |--------|--------|--------|--------|--------|--------|--------|--------|
+  //
+  // - |presence| is either hasbit index or field number for oneofs.
+  uint64_t data = (uint64_t)f->offset << 48 | tag;
+
+  if (card == CARD_o) {
+    uint64_t case_offset = ~f->presence;
+    if (case_offset > 0xffff || f->number > 0xff) return false;
+    data |= (uint64_t)f->number << 24;
+    data |= case_offset << 32;
+  } else {
+    uint64_t hasbit_index = 63;  // No hasbit (set a high, unused bit).
+    if (f->presence) {
+      hasbit_index = f->presence;
+      if (hasbit_index > 31) return false;
+    }
+    data |= hasbit_index << 24;
+  }
+
+  if (type == kUpb_FieldType_Message) {
+    uint64_t idx = f->UPB_PRIVATE(submsg_index);
+    if (idx > 255 || card == CARD_p) return false;
+    data |= idx << 16;
+    ent->field_parser = fastdecode_msgparsers[card][tagbytes];
+  } else if (type == kUpb_FieldType_String || type == kUpb_FieldType_Bytes) {
+    if (card == CARD_p) return false;
+    int utf8 = type == kUpb_FieldType_String ? 0 : 1;
+    ent->field_parser = fastdecode_stringparsers[card][utf8][tagbytes];
+  } else {
+    // Closed enums and groups are not supported.
+    int scalar = fastdecode_scalartype(type);
+    if (scalar < 0) return false;
+    ent->field_parser = fastdecode_scalarparsers[card][scalar][tagbytes];
+  }
+
+  ent->field_data = data;
+  return true;
+}
+
+static void fastdecode_addfield(const upb_MiniTableField* f,
+                                _upb_FastTable_Entry* entries, int* size) {
+  uint32_t tag = f->number << 3 | fastdecode_wiretype(f);
+  if (f->number >= (1 << 11)) return;  // Tag must fit within two bytes.
+
+  // Two-byte tags are stored in their varint-encoded form.
+  if (tag > 0x7f) tag = (tag & 0x7f) | 0x80 | (tag >> 7) << 8;
+  int slot = (tag & 0xf8) >> 3;
+
+  _upb_FastTable_Entry ent;
+  if (!fastdecode_fillentry(f, tag, &ent)) return;
+
+  while (slot >= *size) {
+    int new_size = *size ? *size * 2 : 1;
+    for (int i = *size; i < new_size; i++) {
+      entries[i].field_data = 0;
+      entries[i].field_parser = &_upb_FastDecoder_DecodeGeneric;
+    }
+    *size = new_size;
+  }
+
+  // A hotter field may already have filled this slot.
+  if (entries[slot].field_parser != &_upb_FastDecoder_DecodeGeneric) return;
+  entries[slot] = ent;
+}
+
+int _upb_MiniTable_BuildFastTable(const upb_MiniTable* m,
+                                  _upb_FastTable_Entry* entries) {
+  int size = 0;
+
+  // Required fields are the hottest, as they are always present.  They have
+  // the lowest hasbits.
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (f->presence > 0 && f->presence <= m->required_count) {
+      fastdecode_addfield(f, entries, &size);
+    }
+  }
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (!(f->presence > 0 && f->presence <= m->required_count)) {
+      fastdecode_addfield(f, entries, &size);
+    }
+  }
+  return size;
+}
+
+void _upb_MiniTable_RemoveFastField(upb_MiniTable* m,
+                                    const upb_MiniTableField* f) {
+  if (m->table_mask == (uint8_t)-1) return;
+  int size = (m->table_mask >> 3) + 1;
+  for (int i = 0; i < size; i++) {
+    _upb_FastTable_Entry* ent = (_upb_FastTable_Entry*)&m->fasttable[i];
+    if (ent->field_parser != &_upb_FastDecoder_DecodeGeneric &&
+        ent->field_data >> 48 == f->offset) {
+      ent->field_data = 0;
+      ent->field_parser = &_upb_FastDecoder_DecodeGeneric;
+    }
+  }
+}
+
+#endif /* UPB_FASTTABLE */
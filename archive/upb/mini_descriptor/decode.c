@@ -32,10 +32,12 @@
 
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "upb/base/string_view.h"
 #include "upb/mem/arena.h"
 #include "upb/mini_descriptor/internal/base92.h"
+#include "upb/mini_descriptor/internal/build_tables.h"
 #include "upb/mini_descriptor/internal/decoder.h"
 #include "upb/mini_descriptor/internal/modifiers.h"
 #include "upb/mini_descriptor/internal/wire_constants.h"
@@ -628,6 +630,109 @@ static void upb_MtDecoder_AssignOffsets(upb_MtDecoder* d) {
   d->table->size = UPB_ALIGN_UP(d->table->size, 8);
 }
 
+// Messages with fewer fields than this above dense_below are searched
+// linearly; a hash would not pay for itself.
+#define kUpb_MtDecoder_FieldHashMinFields 4
+
+static int upb_MtDecoder_FillFieldHash(const upb_MiniTable* t, uint16_t* slots,
+                                       uint32_t size_lg2, uint32_t mul) {
+  const uint32_t shift = 32 - size_lg2;
+  const uint32_t mask = (1 << size_lg2) - 1;
+  int max_probe = 0;
+  memset(slots, 0, sizeof(*slots) << size_lg2);
+  for (int i = t->dense_below; i < t->field_count; i++) {
+    uint32_t slot = (t->fields[i].number * mul) >> shift;
+    int probe = 0;
+    while (slots[slot]) {
+      slot = (slot + 1) & mask;
+      probe++;
+    }
+    slots[slot] = i + 1;
+    max_probe = UPB_MAX(max_probe, probe);
+  }
+  return max_probe;
+}
+
+static void upb_MtDecoder_BuildFieldHash(upb_MtDecoder* d) {
+  // Odd multipliers with well-mixed bits, tried in order. The first one that
+  // gives the shortest longest probe sequence wins, so the result depends only
+  // on the field numbers and is the same on every platform.
+  static const uint32_t kMultipliers[] = {
+      0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f,
+      0x165667b1, 0xcc9e2d51, 0x1b873593, 0xe6546b65,
+  };
+  upb_MiniTable* t = d->table;
+  const int count = t->field_count - t->dense_below;
+  if (count < kUpb_MtDecoder_FieldHashMinFields) return;
+
+  uint32_t size_lg2 = 1;
+  while ((1 << size_lg2) < 2 * count) size_lg2++;
+
+  struct upb_MiniTableFieldHash* hash = upb_Arena_Malloc(
+      d->arena, sizeof(*hash) + (sizeof(uint16_t) << size_lg2));
+  upb_MdDecoder_CheckOutOfMemory(&d->base, hash);
+  uint16_t* slots = (uint16_t*)(hash + 1);
+
+  const size_t n = sizeof(kMultipliers) / sizeof(kMultipliers[0]);
+  size_t best = 0;
+  int best_probe = INT32_MAX;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    const int probe =
+        upb_MtDecoder_FillFieldHash(t, slots, size_lg2, kMultipliers[i]);
+    if (probe < best_probe) {
+      best = i;
+      best_probe = probe;
+      if (probe == 0) break;
+    }
+  }
+  // The slots hold the layout for the last multiplier we tried.
+  if (i == n) {
+    upb_MtDecoder_FillFieldHash(t, slots, size_lg2, kMultipliers[best]);
+  }
+
+  hash->slots = slots;
+  hash->mul = kMultipliers[best];
+  hash->shift = 32 - size_lg2;
+  t->field_hash = hash;
+}
+
+static void upb_MtDecoder_BuildFastTable(upb_MtDecoder* d) {
+#if UPB_FASTTABLE
+  // Fast tables are only supported on 64-bit, so we only build them for the
+  // native platform.
+  if (d->platform != kUpb_MiniTablePlatform_Native) return;
+
+  _upb_FastTable_Entry entries[32];
+  int size = _upb_MiniTable_BuildFastTable(d->table, entries);
+  if (size <= 1) return;
+
+  upb_MiniTable* table =
+      upb_Arena_Realloc(d->arena, d->table, sizeof(*table),
+                        sizeof(*table) + size * sizeof(entries[0]));
+  upb_MdDecoder_CheckOutOfMemory(&d->base, table);
+  memcpy(table->fasttable, entries, size * sizeof(entries[0]));
+  table->table_mask = (size - 1) << 3;
+  d->table = table;
+#else
+  UPB_UNUSED(d);
+#endif
+}
+
+static void upb_MtDecoder_BuildEncodeTable(upb_MtDecoder* d) {
+  // Encode tables hard-code field offsets, so they only work on the native
+  // platform.
+  if (d->platform != kUpb_MiniTablePlatform_Native) return;
+  if (d->table->field_count == 0) return;
+
+  _upb_FastEncoder_Entry* entries =
+      upb_Arena_Malloc(d->arena, d->table->field_count * sizeof(*entries));
+  upb_MdDecoder_CheckOutOfMemory(&d->base, entries);
+  if (_upb_MiniTable_BuildEncodeTable(d->table, entries)) {
+    d->table->encode_table = entries;
+  }
+}
+
 static void upb_MtDecoder_ValidateEntryField(upb_MtDecoder* d,
                                              const upb_MiniTableField* f,
                                              uint32_t expected_num) {
@@ -706,6 +811,8 @@ static void upb_MtDecoder_ParseMessageSet(upb_MtDecoder* d, const char* data,
   ret->dense_below = 0;
   ret->table_mask = -1;
   ret->required_count = 0;
+  ret->field_hash = NULL;
+  ret->encode_table = NULL;
 }
 
 static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
@@ -719,6 +826,8 @@ static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
   decoder->table->dense_below = 0;
   decoder->table->table_mask = -1;
   decoder->table->required_count = 0;
+  decoder->table->field_hash = NULL;
+  decoder->table->encode_table = NULL;
 
   // Strip off and verify the version tag.
   if (!len--) goto done;
@@ -727,6 +836,7 @@ static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
   switch (vers) {
     case kUpb_EncodedVersion_MapV1:
       upb_MtDecoder_ParseMap(decoder, data, len);
+      upb_MtDecoder_BuildFastTable(decoder);
       break;
 
     case kUpb_EncodedVersion_MessageV1:
@@ -734,6 +844,9 @@ static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
       upb_MtDecoder_AssignHasbits(decoder);
       upb_MtDecoder_SortLayoutItems(decoder);
       upb_MtDecoder_AssignOffsets(decoder);
+      upb_MtDecoder_BuildFieldHash(decoder);
+      upb_MtDecoder_BuildFastTable(decoder);
+      upb_MtDecoder_BuildEncodeTable(decoder);
       break;
 
     case kUpb_EncodedVersion_MessageSetV1:
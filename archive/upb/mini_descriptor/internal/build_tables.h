@@ -0,0 +1,75 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// The dispatch tables that let the wire decoder and encoder use specialized
+// functions for each field.  Generated code gets these tables from upbc;
+// MiniTables built at runtime get them from the functions below, which choose
+// the field functions the same way that upbc does.
+
+#ifndef UPB_MINI_DESCRIPTOR_INTERNAL_BUILD_TABLES_H_
+#define UPB_MINI_DESCRIPTOR_INTERNAL_BUILD_TABLES_H_
+
+#include "upb/mini_table/field.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if UPB_FASTTABLE
+// Builds the fast decoder table for `m`.  `entries` must have room for 32
+// entries.  Returns the number of entries used, which is zero or a power of
+// two.
+int _upb_MiniTable_BuildFastTable(const upb_MiniTable* m,
+                                  _upb_FastTable_Entry* entries);
+
+// Sends field `f` of a runtime-built MiniTable back to the generic decoder.
+// Needed when linking turns `f` into a map, which has no fast parser.
+void _upb_MiniTable_RemoveFastField(upb_MiniTable* m,
+                                    const upb_MiniTableField* f);
+#endif
+
+// Builds the fast encoder table for `m`.  `entries` must have room for
+// m->field_count entries.  Returns false if no field got a specialized encoder,
+// in which case the table is not worth using.
+bool _upb_MiniTable_BuildEncodeTable(const upb_MiniTable* m,
+                                     _upb_FastEncoder_Entry* entries);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MINI_DESCRIPTOR_INTERNAL_BUILD_TABLES_H_ */
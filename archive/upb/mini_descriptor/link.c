@@ -30,6 +30,8 @@
 
 #include "upb/mini_descriptor/link.h"
 
+#include "upb/mini_descriptor/internal/build_tables.h"
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -50,6 +52,9 @@ bool upb_MiniTable_SetSubMessage(upb_MiniTable* table,
         if (UPB_UNLIKELY(table_is_map)) return false;
 
         field->mode = (field->mode & ~kUpb_FieldMode_Mask) | kUpb_FieldMode_Map;
+#if UPB_FASTTABLE
+        _upb_MiniTable_RemoveFastField(table, field);
+#endif
       }
       break;
 
@@ -30,39 +30,113 @@
 
 #include "upb/mini_table/extension_registry.h"
 
-#include "upb/hash/str_table.h"
+#include <string.h>
+
 #include "upb/mini_table/extension.h"
 
 // Must be last.
 #include "upb/port/def.inc"
 
-#define EXTREG_KEY_SIZE (sizeof(upb_MiniTable*) + sizeof(uint32_t))
-
+// An open-addressed hash table of extensions, keyed by (extendee, number).
+// The key is read back out of the extension itself, so each slot is just a
+// pointer. The table is kept at most half full, so lookups for absent keys
+// (which are common: the decoder asks about every unknown field of an
+// extendable message) stop after a short probe.
 struct upb_ExtensionRegistry {
   upb_Arena* arena;
-  upb_strtable exts;  // Key is upb_MiniTable* concatenated with fieldnum.
+  const upb_MiniTableExtension** slots;  // NULL until the first Add().
+  uint32_t mask;                         // Number of slots minus one.
+  uint32_t count;
+  bool frozen;
 };
 
-static void extreg_key(char* buf, const upb_MiniTable* l, uint32_t fieldnum) {
-  memcpy(buf, &l, sizeof(l));
-  memcpy(buf + sizeof(l), &fieldnum, sizeof(fieldnum));
+static uint32_t extreg_hash(const upb_MiniTable* t, uint32_t num) {
+  const uint64_t key = (uint64_t)(uintptr_t)t ^ ((uint64_t)num << 32);
+  // Fibonacci hashing: the top bits of the product mix every bit of the key.
+  return (uint32_t)((key * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static bool extreg_matches(const upb_MiniTableExtension* e,
+                           const upb_MiniTable* t, uint32_t num) {
+  return e->extendee == t && e->field.number == num;
+}
+
+static const upb_MiniTableExtension** extreg_find(
+    const upb_ExtensionRegistry* r, const upb_MiniTable* t, uint32_t num) {
+  uint32_t i = extreg_hash(t, num) & r->mask;
+  while (r->slots[i] && !extreg_matches(r->slots[i], t, num)) {
+    i = (i + 1) & r->mask;
+  }
+  return &r->slots[i];
+}
+
+static bool extreg_resize(upb_ExtensionRegistry* r, uint32_t slot_count) {
+  const upb_MiniTableExtension** old = r->slots;
+  const uint32_t old_count = old ? r->mask + 1 : 0;
+  r->slots = upb_Arena_Malloc(r->arena, slot_count * sizeof(*r->slots));
+  if (!r->slots) {
+    r->slots = old;
+    return false;
+  }
+  memset(r->slots, 0, slot_count * sizeof(*r->slots));
+  r->mask = slot_count - 1;
+  for (uint32_t i = 0; i < old_count; i++) {
+    const upb_MiniTableExtension* e = old[i];
+    if (e) *extreg_find(r, e->extendee, e->field.number) = e;
+  }
+  return true;
+}
+
+// Removes the entry at |slot| with backward-shift deletion, so no tombstones
+// are left behind to lengthen later probes.
+static void extreg_remove(upb_ExtensionRegistry* r, uint32_t slot) {
+  uint32_t i = slot;
+  while (true) {
+    r->slots[i] = NULL;
+    uint32_t j = i;
+    while (true) {
+      j = (j + 1) & r->mask;
+      const upb_MiniTableExtension* e = r->slots[j];
+      if (!e) return;
+      const uint32_t home =
+          extreg_hash(e->extendee, e->field.number) & r->mask;
+      // Move |e| into the hole unless its home slot lies cyclically in (i, j].
+      const bool stays =
+          i <= j ? (i < home && home <= j) : (i < home || home <= j);
+      if (!stays) {
+        r->slots[i] = e;
+        i = j;
+        break;
+      }
+    }
+  }
 }
 
 upb_ExtensionRegistry* upb_ExtensionRegistry_New(upb_Arena* arena) {
   upb_ExtensionRegistry* r = upb_Arena_Malloc(arena, sizeof(*r));
   if (!r) return NULL;
   r->arena = arena;
-  if (!upb_strtable_init(&r->exts, 8, arena)) return NULL;
+  r->slots = NULL;
+  r->mask = 0;
+  r->count = 0;
+  r->frozen = false;
   return r;
 }
 
 UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
                                        const upb_MiniTableExtension* e) {
-  char buf[EXTREG_KEY_SIZE];
-  extreg_key(buf, e->extendee, e->field.number);
-  if (upb_strtable_lookup2(&r->exts, buf, EXTREG_KEY_SIZE, NULL)) return false;
-  return upb_strtable_insert(&r->exts, buf, EXTREG_KEY_SIZE,
-                             upb_value_constptr(e), r->arena);
+  if (r->frozen) return false;
+  if (!r->slots && !extreg_resize(r, 8)) return false;
+  const upb_MiniTableExtension** slot =
+      extreg_find(r, e->extendee, e->field.number);
+  if (*slot) return false;
+  if (2 * (r->count + 1) > r->mask + 1) {
+    if (!extreg_resize(r, 2 * (r->mask + 1))) return false;
+    slot = extreg_find(r, e->extendee, e->field.number);
+  }
+  *slot = e;
+  r->count++;
+  return true;
 }
 
 bool upb_ExtensionRegistry_AddArray(upb_ExtensionRegistry* r,
@@ -79,21 +153,25 @@ failure:
   // Back out the entries previously added.
   for (end = e, e = start; e < end; e++) {
     const upb_MiniTableExtension* ext = *e;
-    char buf[EXTREG_KEY_SIZE];
-    extreg_key(buf, ext->extendee, ext->field.number);
-    upb_strtable_remove2(&r->exts, buf, EXTREG_KEY_SIZE, NULL);
+    const upb_MiniTableExtension** slot =
+        extreg_find(r, ext->extendee, ext->field.number);
+    UPB_ASSERT(*slot == ext);
+    extreg_remove(r, slot - r->slots);
+    r->count--;
   }
   return false;
 }
 
+void upb_ExtensionRegistry_Freeze(upb_ExtensionRegistry* r) {
+  r->frozen = true;
+}
+
+bool upb_ExtensionRegistry_IsFrozen(const upb_ExtensionRegistry* r) {
+  return r->frozen;
+}
+
 const upb_MiniTableExtension* upb_ExtensionRegistry_Lookup(
     const upb_ExtensionRegistry* r, const upb_MiniTable* t, uint32_t num) {
-  char buf[EXTREG_KEY_SIZE];
-  upb_value v;
-  extreg_key(buf, t, num);
-  if (upb_strtable_lookup2(&r->exts, buf, EXTREG_KEY_SIZE, &v)) {
-    return upb_value_getconstptr(v);
-  } else {
-    return NULL;
-  }
+  if (!r->slots) return NULL;
+  return *extreg_find(r, t, num);
 }
@@ -82,13 +82,16 @@ typedef struct upb_ExtensionRegistry upb_ExtensionRegistry;
 // The arena must outlive any use of the extreg.
 UPB_API upb_ExtensionRegistry* upb_ExtensionRegistry_New(upb_Arena* arena);
 
+// Adds |e| to the registry. Returns false on OOM, if an extension with the
+// same extendee and number is already present, or if the registry is frozen.
 UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
                                        const upb_MiniTableExtension* e);
 
 // Adds the given extension info for the array |e| of size |count| into the
 // registry. If there are any errors, the entire array is backed out.
 // The extensions must outlive the registry.
-// Possible errors include OOM or an extension number that already exists.
+// Possible errors include OOM, an extension number that already exists, or a
+// frozen registry.
 // TODO(salo): There is currently no way to know the exact reason for failure.
 bool upb_ExtensionRegistry_AddArray(upb_ExtensionRegistry* r,
                                     const upb_MiniTableExtension** e,
@@ -96,9 +99,18 @@ bool upb_ExtensionRegistry_AddArray(upb_ExtensionRegistry* r,
 
 // Looks up the extension (if any) defined for message type |t| and field
 // number |num|. Returns the extension if found, otherwise NULL.
+// Lookups never modify the registry, so any number of threads may look up
+// extensions concurrently as long as nothing is being added.
 UPB_API const upb_MiniTableExtension* upb_ExtensionRegistry_Lookup(
     const upb_ExtensionRegistry* r, const upb_MiniTable* t, uint32_t num);
 
+// Makes the registry read-only. Any later Add() or AddArray() fails, so a
+// frozen registry can be handed to decoders on many threads without copying
+// or locking. There is no way to unfreeze a registry.
+UPB_API void upb_ExtensionRegistry_Freeze(upb_ExtensionRegistry* r);
+
+UPB_API bool upb_ExtensionRegistry_IsFrozen(const upb_ExtensionRegistry* r);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,143 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "upb/mini_table/extension_registry.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "upb/mem/arena.hpp"
+#include "upb/mini_table/extension.h"
+
+namespace {
+
+class ExtensionRegistryTest : public ::testing::Test {
+ protected:
+  // The registry never looks inside an extendee, so any distinct addresses
+  // will do.
+  const upb_MiniTable* Extendee(int i) {
+    return reinterpret_cast<const upb_MiniTable*>(&extendees_[i]);
+  }
+
+  const upb_MiniTableExtension* NewExtension(int extendee, uint32_t number) {
+    auto* e = static_cast<upb_MiniTableExtension*>(
+        upb_Arena_Malloc(arena_.ptr(), sizeof(upb_MiniTableExtension)));
+    *e = upb_MiniTableExtension{};
+    e->field.number = number;
+    e->extendee = Extendee(extendee);
+    return e;
+  }
+
+  upb::Arena arena_;
+  char extendees_[4] = {};
+};
+
+TEST_F(ExtensionRegistryTest, AddAndLookup) {
+  upb_ExtensionRegistry* r = upb_ExtensionRegistry_New(arena_.ptr());
+  EXPECT_EQ(nullptr, upb_ExtensionRegistry_Lookup(r, Extendee(0), 1));
+
+  std::vector<const upb_MiniTableExtension*> exts;
+  for (int t = 0; t < 3; t++) {
+    for (uint32_t n = 1; n <= 300; n++) {
+      exts.push_back(NewExtension(t, n * 1000 + t));
+      ASSERT_TRUE(upb_ExtensionRegistry_Add(r, exts.back()));
+    }
+  }
+  exts.push_back(NewExtension(3, 536870911));  // Max field number.
+  ASSERT_TRUE(upb_ExtensionRegistry_Add(r, exts.back()));
+
+  for (const upb_MiniTableExtension* e : exts) {
+    EXPECT_EQ(e, upb_ExtensionRegistry_Lookup(r, e->extendee, e->field.number));
+  }
+  EXPECT_EQ(nullptr, upb_ExtensionRegistry_Lookup(r, Extendee(0), 1001));
+  EXPECT_EQ(nullptr, upb_ExtensionRegistry_Lookup(r, Extendee(3), 1000));
+  EXPECT_EQ(nullptr, upb_ExtensionRegistry_Lookup(r, Extendee(0), 536870911));
+}
+
+TEST_F(ExtensionRegistryTest, RejectsDuplicates) {
+  upb_ExtensionRegistry* r = upb_ExtensionRegistry_New(arena_.ptr());
+  const upb_MiniTableExtension* e = NewExtension(0, 5);
+  ASSERT_TRUE(upb_ExtensionRegistry_Add(r, e));
+  EXPECT_FALSE(upb_ExtensionRegistry_Add(r, NewExtension(0, 5)));
+  EXPECT_EQ(e, upb_ExtensionRegistry_Lookup(r, Extendee(0), 5));
+  EXPECT_TRUE(upb_ExtensionRegistry_Add(r, NewExtension(1, 5)));
+}
+
+TEST_F(ExtensionRegistryTest, AddArrayBacksOutOnFailure) {
+  upb_ExtensionRegistry* r = upb_ExtensionRegistry_New(arena_.ptr());
+  std::vector<const upb_MiniTableExtension*> kept;
+  for (uint32_t n = 1; n <= 100; n++) {
+    kept.push_back(NewExtension(0, n));
+    ASSERT_TRUE(upb_ExtensionRegistry_Add(r, kept.back()));
+  }
+
+  // Interleave the new numbers with the existing ones so that removing them
+  // has to repair probe sequences that run through kept entries.
+  std::vector<const upb_MiniTableExtension*> batch;
+  for (uint32_t n = 1; n <= 100; n++) {
+    batch.push_back(NewExtension(1, n));
+    batch.push_back(NewExtension(0, 100 + n));
+  }
+  batch.push_back(NewExtension(0, 50));  // Duplicate: the whole batch fails.
+  EXPECT_FALSE(upb_ExtensionRegistry_AddArray(r, batch.data(), batch.size()));
+
+  for (const upb_MiniTableExtension* e : kept) {
+    EXPECT_EQ(e, upb_ExtensionRegistry_Lookup(r, e->extendee, e->field.number));
+  }
+  for (const upb_MiniTableExtension* e : batch) {
+    if (e == batch.back()) continue;
+    EXPECT_EQ(nullptr,
+              upb_ExtensionRegistry_Lookup(r, e->extendee, e->field.number));
+  }
+
+  batch.pop_back();
+  EXPECT_TRUE(upb_ExtensionRegistry_AddArray(r, batch.data(), batch.size()));
+  for (const upb_MiniTableExtension* e : batch) {
+    EXPECT_EQ(e, upb_ExtensionRegistry_Lookup(r, e->extendee, e->field.number));
+  }
+}
+
+TEST_F(ExtensionRegistryTest, Freeze) {
+  upb_ExtensionRegistry* r = upb_ExtensionRegistry_New(arena_.ptr());
+  const upb_MiniTableExtension* e = NewExtension(0, 1);
+  ASSERT_TRUE(upb_ExtensionRegistry_Add(r, e));
+  EXPECT_FALSE(upb_ExtensionRegistry_IsFrozen(r));
+
+  upb_ExtensionRegistry_Freeze(r);
+  EXPECT_TRUE(upb_ExtensionRegistry_IsFrozen(r));
+  EXPECT_FALSE(upb_ExtensionRegistry_Add(r, NewExtension(0, 2)));
+  const upb_MiniTableExtension* batch[] = {NewExtension(0, 3)};
+  EXPECT_FALSE(upb_ExtensionRegistry_AddArray(r, batch, 1));
+  EXPECT_EQ(e, upb_ExtensionRegistry_Lookup(r, Extendee(0), 1));
+  EXPECT_EQ(nullptr, upb_ExtensionRegistry_Lookup(r, Extendee(0), 2));
+}
+
+}  // namespace
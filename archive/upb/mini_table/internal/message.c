@@ -39,4 +39,6 @@ const struct upb_MiniTable _kUpb_MiniTable_Empty = {
     .dense_below = 0,
     .table_mask = -1,
     .required_count = 0,
+    .field_hash = NULL,
+    .encode_table = NULL,
 };
@@ -31,6 +31,8 @@
 #ifndef UPB_MINI_TABLE_INTERNAL_MESSAGE_H_
 #define UPB_MINI_TABLE_INTERNAL_MESSAGE_H_
 
+#include <stdint.h>
+
 #include "upb/message/types.h"
 #include "upb/mini_table/internal/field.h"
 
@@ -46,6 +48,15 @@ typedef struct {
   _upb_FieldParser* field_parser;
 } _upb_FastTable_Entry;
 
+struct upb_encstate;
+struct upb_MiniTable;
+typedef void _upb_FieldEncoder(struct upb_encstate* e, const upb_Message* msg,
+                               const struct upb_MiniTable* m, uint64_t data);
+typedef struct {
+  uint64_t field_data;
+  _upb_FieldEncoder* field_encoder;
+} _upb_FastEncoder_Entry;
+
 typedef enum {
   kUpb_ExtMode_NonExtendable = 0,  // Non-extendable message.
   kUpb_ExtMode_Extendable = 1,     // Normal extendable message.
@@ -60,6 +71,17 @@ typedef enum {
 
 union upb_MiniTableSub;
 
+// An open-addressed index from field number to field, covering the fields
+// at or above dense_below. Fields are hashed to slot (number * mul) >> shift
+// and collisions are resolved by linear probing. Each slot holds the index of
+// a field in upb_MiniTable.fields plus one, or zero if the slot is empty. The
+// table is at most half full, so every probe sequence ends at an empty slot.
+struct upb_MiniTableFieldHash {
+  const uint16_t* slots;
+  uint32_t mul;
+  uint8_t shift;  // 32 - log2(number of slots)
+};
+
 // upb_MiniTable represents the memory layout of a given upb_MessageDef.
 // The members are public so generated code can initialize them,
 // but users MUST NOT directly read or write any of its members.
@@ -77,6 +99,15 @@ struct upb_MiniTable {
   uint8_t table_mask;
   uint8_t required_count;  // Required fields have the lowest hasbits.
 
+  // Speeds up lookups of sparse field numbers. NULL if the message has too few
+  // fields above dense_below to be worth hashing.
+  const struct upb_MiniTableFieldHash* field_hash;
+
+  // One encoder per field, parallel to `fields`. NULL if no field has a
+  // specialized encoder, or if the MiniTable was built for a platform other
+  // than the native one. See upb/wire/encode_fast.h.
+  const _upb_FastEncoder_Entry* encode_table;
+
   // To statically initialize the tables of variable length, we need a flexible
   // array member, and we need to compile in gnu99 mode (constant initialization
   // of flexible array members is a GNU extension, not in C99 unfortunately.
@@ -102,6 +133,22 @@ UPB_INLINE uint64_t upb_MiniTable_requiredmask(const struct upb_MiniTable* l) {
   return ((1ULL << n) - 1) << 1;
 }
 
+// Looks up a field above dense_below in |t->field_hash|, which must be
+// present. Returns NULL if the message has no such field.
+UPB_INLINE const struct upb_MiniTableField* _upb_MiniTable_FindFieldInHash(
+    const struct upb_MiniTable* t, uint32_t number) {
+  const struct upb_MiniTableFieldHash* h = t->field_hash;
+  const uint32_t mask = UINT32_MAX >> h->shift;
+  uint32_t i = (number * h->mul) >> h->shift;
+  while (true) {
+    const uint16_t slot = h->slots[i];
+    if (slot == 0) return NULL;
+    const struct upb_MiniTableField* f = &t->fields[slot - 1];
+    if (f->number == number) return f;
+    i = (i + 1) & mask;
+  }
+}
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
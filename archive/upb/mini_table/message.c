@@ -48,6 +48,9 @@ const upb_MiniTableField* upb_MiniTable_FindFieldByNumber(
     return &t->fields[i];
   }
 
+  // Sparse field numbers: hash lookup
+  if (t->field_hash) return _upb_MiniTable_FindFieldInHash(t, number);
+
   // Slow case: binary search
   int lo = t->dense_below;
   int hi = t->field_count - 1;
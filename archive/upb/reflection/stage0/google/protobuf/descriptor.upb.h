@@ -653,8 +653,9 @@ UPB_INLINE struct google_protobuf_FileOptions* google_protobuf_FileDescriptorPro
   struct google_protobuf_FileOptions* sub = (struct google_protobuf_FileOptions*)google_protobuf_FileDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FileOptions*)_upb_Message_New(google_protobuf_FileOptions_msg_init(), arena);
-    if (sub) google_protobuf_FileDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FileDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_FileDescriptorProto_set_source_code_info(google_protobuf_FileDescriptorProto *msg, google_protobuf_SourceCodeInfo* value) {
@@ -665,8 +666,9 @@ UPB_INLINE struct google_protobuf_SourceCodeInfo* google_protobuf_FileDescriptor
   struct google_protobuf_SourceCodeInfo* sub = (struct google_protobuf_SourceCodeInfo*)google_protobuf_FileDescriptorProto_source_code_info(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_SourceCodeInfo*)_upb_Message_New(google_protobuf_SourceCodeInfo_msg_init(), arena);
-    if (sub) google_protobuf_FileDescriptorProto_set_source_code_info(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FileDescriptorProto_set_source_code_info(msg, sub);
   return sub;
 }
 UPB_INLINE int32_t* google_protobuf_FileDescriptorProto_mutable_public_dependency(google_protobuf_FileDescriptorProto* msg, size_t* size) {
@@ -1094,8 +1096,9 @@ UPB_INLINE struct google_protobuf_MessageOptions* google_protobuf_DescriptorProt
   struct google_protobuf_MessageOptions* sub = (struct google_protobuf_MessageOptions*)google_protobuf_DescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_MessageOptions*)_upb_Message_New(google_protobuf_MessageOptions_msg_init(), arena);
-    if (sub) google_protobuf_DescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_DescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_OneofDescriptorProto** google_protobuf_DescriptorProto_mutable_oneof_decl(google_protobuf_DescriptorProto* msg, size_t* size) {
@@ -1272,8 +1275,9 @@ UPB_INLINE struct google_protobuf_ExtensionRangeOptions* google_protobuf_Descrip
   struct google_protobuf_ExtensionRangeOptions* sub = (struct google_protobuf_ExtensionRangeOptions*)google_protobuf_DescriptorProto_ExtensionRange_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_ExtensionRangeOptions*)_upb_Message_New(google_protobuf_ExtensionRangeOptions_msg_init(), arena);
-    if (sub) google_protobuf_DescriptorProto_ExtensionRange_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_DescriptorProto_ExtensionRange_set_options(msg, sub);
   return sub;
 }
 
@@ -1672,8 +1676,9 @@ UPB_INLINE struct google_protobuf_FieldOptions* google_protobuf_FieldDescriptorP
   struct google_protobuf_FieldOptions* sub = (struct google_protobuf_FieldOptions*)google_protobuf_FieldDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_FieldOptions*)_upb_Message_New(google_protobuf_FieldOptions_msg_init(), arena);
-    if (sub) google_protobuf_FieldDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_FieldDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_FieldDescriptorProto_set_oneof_index(google_protobuf_FieldDescriptorProto *msg, int32_t value) {
@@ -1767,8 +1772,9 @@ UPB_INLINE struct google_protobuf_OneofOptions* google_protobuf_OneofDescriptorP
   struct google_protobuf_OneofOptions* sub = (struct google_protobuf_OneofOptions*)google_protobuf_OneofDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_OneofOptions*)_upb_Message_New(google_protobuf_OneofOptions_msg_init(), arena);
-    if (sub) google_protobuf_OneofDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_OneofDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -1936,8 +1942,9 @@ UPB_INLINE struct google_protobuf_EnumOptions* google_protobuf_EnumDescriptorPro
   struct google_protobuf_EnumOptions* sub = (struct google_protobuf_EnumOptions*)google_protobuf_EnumDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_EnumOptions*)_upb_Message_New(google_protobuf_EnumOptions_msg_init(), arena);
-    if (sub) google_protobuf_EnumDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE google_protobuf_EnumDescriptorProto_EnumReservedRange** google_protobuf_EnumDescriptorProto_mutable_reserved_range(google_protobuf_EnumDescriptorProto* msg, size_t* size) {
@@ -2163,8 +2170,9 @@ UPB_INLINE struct google_protobuf_EnumValueOptions* google_protobuf_EnumValueDes
   struct google_protobuf_EnumValueOptions* sub = (struct google_protobuf_EnumValueOptions*)google_protobuf_EnumValueDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_EnumValueOptions*)_upb_Message_New(google_protobuf_EnumValueOptions_msg_init(), arena);
-    if (sub) google_protobuf_EnumValueDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_EnumValueDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -2292,8 +2300,9 @@ UPB_INLINE struct google_protobuf_ServiceOptions* google_protobuf_ServiceDescrip
   struct google_protobuf_ServiceOptions* sub = (struct google_protobuf_ServiceOptions*)google_protobuf_ServiceDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_ServiceOptions*)_upb_Message_New(google_protobuf_ServiceOptions_msg_init(), arena);
-    if (sub) google_protobuf_ServiceDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_ServiceDescriptorProto_set_options(msg, sub);
   return sub;
 }
 
@@ -2443,8 +2452,9 @@ UPB_INLINE struct google_protobuf_MethodOptions* google_protobuf_MethodDescripto
   struct google_protobuf_MethodOptions* sub = (struct google_protobuf_MethodOptions*)google_protobuf_MethodDescriptorProto_options(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_MethodOptions*)_upb_Message_New(google_protobuf_MethodOptions_msg_init(), arena);
-    if (sub) google_protobuf_MethodDescriptorProto_set_options(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_MethodDescriptorProto_set_options(msg, sub);
   return sub;
 }
 UPB_INLINE void google_protobuf_MethodDescriptorProto_set_client_streaming(google_protobuf_MethodDescriptorProto *msg, bool value) {
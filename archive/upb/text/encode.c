@@ -435,12 +435,13 @@ static void txtenc_msg(txtenc* e, const upb_Message* msg,
   }
 
   if ((e->options & UPB_TXTENC_SKIPUNKNOWN) == 0) {
-    size_t size;
-    const char* ptr = upb_Message_GetUnknown(msg, &size);
-    if (size != 0) {
+    upb_StringView unknown;
+    uintptr_t iter = kUpb_Message_UnknownBegin;
+    while (upb_Message_NextUnknown(msg, &unknown, &iter)) {
+      const char* ptr = unknown.data;
       char* start = e->ptr;
       upb_EpsCopyInputStream stream;
-      upb_EpsCopyInputStream_Init(&stream, &ptr, size, true);
+      upb_EpsCopyInputStream_Init(&stream, &ptr, unknown.size, true);
       if (!txtenc_unknown(e, ptr, &stream, -1)) {
         /* Unknown failed to parse, back up and don't print it at all. */
         e->ptr = start;
@@ -472,7 +473,7 @@ size_t upb_TextEncode(const upb_Message* msg, const upb_MessageDef* m,
   e.indent_depth = 0;
   e.options = options;
   e.ext_pool = ext_pool;
-  _upb_mapsorter_init(&e.sorter);
+  _upb_mapsorter_init(&e.sorter, NULL);
 
   txtenc_msg(&e, msg, m);
   _upb_mapsorter_destroy(&e.sorter);
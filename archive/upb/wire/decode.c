@@ -35,6 +35,7 @@
 #include "upb/base/descriptor_constants.h"
 #include "upb/collections/internal/array.h"
 #include "upb/collections/internal/map.h"
+#include "upb/mem/alloc.h"
 #include "upb/mem/internal/arena.h"
 #include "upb/message/internal/accessors.h"
 #include "upb/message/internal/map_entry.h"
@@ -44,6 +45,7 @@
 #include "upb/wire/eps_copy_input_stream.h"
 #include "upb/wire/internal/common.h"
 #include "upb/wire/internal/decode.h"
+#include "upb/wire/internal/decode_varint.h"
 #include "upb/wire/internal/swap.h"
 #include "upb/wire/reader.h"
 
@@ -259,24 +261,115 @@ static upb_Message* _upb_Decoder_ReuseSubMessage(
   // message of the correct type and promote data into it before continuing.
   upb_Message* existing = _upb_TaggedMessagePtr_GetEmptyMessage(tagged);
   upb_Message* promoted = _upb_Decoder_NewSubMessage(d, subs, field, target);
-  size_t size;
-  const char* unknown = upb_Message_GetUnknown(existing, &size);
-  upb_DecodeStatus status = upb_Decode(unknown, size, promoted, subl, d->extreg,
-                                       d->options, &d->arena);
-  if (status != kUpb_DecodeStatus_Ok) _upb_Decoder_ErrorJmp(d, status);
+  upb_StringView unknown;
+  uintptr_t iter = kUpb_Message_UnknownBegin;
+  while (upb_Message_NextUnknown(existing, &unknown, &iter)) {
+    upb_DecodeStatus status =
+        upb_Decode(unknown.data, unknown.size, promoted, subl, d->extreg,
+                   d->options, &d->arena);
+    if (status != kUpb_DecodeStatus_Ok) _upb_Decoder_ErrorJmp(d, status);
+  }
   return promoted;
 }
 
 static const char* _upb_Decoder_ReadString(upb_Decoder* d, const char* ptr,
-                                           int size, upb_StringView* str) {
+                                           int size, upb_StringView* str,
+                                           bool validate_utf8) {
   const char* str_ptr = ptr;
   ptr = upb_EpsCopyInputStream_ReadString(&d->input, &str_ptr, size, &d->arena);
-  if (!ptr) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  if (!ptr) {
+    _upb_Decoder_ErrorJmp(d, upb_EpsCopyInputStream_IsError(&d->input)
+                                 ? kUpb_DecodeStatus_Malformed
+                                 : kUpb_DecodeStatus_OutOfMemory);
+  }
+  // The string may have spanned buffers when reading from a stream, so we
+  // validate the result rather than the input.
+  if (validate_utf8) _upb_Decoder_VerifyUtf8(d, str_ptr, size);
   str->data = str_ptr;
   str->size = size;
   return ptr;
 }
 
+// Skips `size` bytes of delimited data, which may extend beyond the current
+// buffer when reading from a stream.
+static const char* _upb_Decoder_SkipDelimited(upb_Decoder* d, const char* ptr,
+                                              int size) {
+  if (UPB_LIKELY(upb_EpsCopyInputStream_CheckDataSizeAvailable(&d->input, ptr,
+                                                                size))) {
+    return ptr + size;
+  }
+  ptr = _upb_EpsCopyInputStream_ReadFallback(&d->input, ptr, NULL, size,
+                                             _upb_Decoder_BufferFlipCallback);
+  if (!ptr) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+  return ptr;
+}
+
+// With kUpb_DecodeOption_Lazy, the wire data for a sub-message is stored as
+// unknown data in an "empty" message instead of being parsed.  It is parsed
+// when the user promotes the message (see message/promote.h).
+UPB_FORCEINLINE
+static bool _upb_Decoder_IsLazy(upb_Decoder* d,
+                                const upb_MiniTableField* field) {
+  return UPB_UNLIKELY(d->options & kUpb_DecodeOption_Lazy) &&
+         field->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Message &&
+         !(field->mode & kUpb_LabelFlags_IsExtension);
+}
+
+static upb_Message* _upb_Decoder_NewLazySubMessage(
+    upb_Decoder* d, upb_TaggedMessagePtr* target) {
+  upb_Message* msg = _upb_Message_New(&_kUpb_MiniTable_Empty, &d->arena);
+  if (!msg) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  upb_TaggedMessagePtr tagged = _upb_TaggedMessagePtr_Pack(msg, true);
+  memcpy(target, &tagged, sizeof(tagged));
+  return msg;
+}
+
+// Adds the unknown data [start, end) to |msg|, aliasing the input buffer if
+// |alias| is set and the data lives there.
+static void _upb_Decoder_StoreUnknown(upb_Decoder* d, upb_Message* msg,
+                                      const char* start, const char* end,
+                                      bool alias) {
+  const size_t size = end - start;
+  bool ok;
+  if (alias &&
+      upb_EpsCopyInputStream_AliasingAvailable(&d->input, start, size)) {
+    start = upb_EpsCopyInputStream_GetAliasedPtr(&d->input, start);
+    ok = _upb_Message_AddUnknownAliased(msg, start, size, &d->arena);
+  } else {
+    ok = _upb_Message_AddUnknown(msg, start, size, &d->arena);
+  }
+  if (!ok) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+}
+
+static void _upb_Decoder_AddUnknown(upb_Decoder* d, upb_Message* msg,
+                                    const char* start, const char* end) {
+  _upb_Decoder_StoreUnknown(d, msg, start, end,
+                            d->options & kUpb_DecodeOption_AliasUnknown);
+}
+
+static const char* _upb_Decoder_DecodeLazySubMessage(upb_Decoder* d,
+                                                     const char* ptr,
+                                                     upb_Message* empty,
+                                                     int size) {
+  const char* start = ptr;
+  if (UPB_LIKELY(upb_EpsCopyInputStream_CheckDataSizeAvailable(&d->input, ptr,
+                                                                size))) {
+    ptr += size;
+  } else {
+    // The data spans buffers, so we let the buffer flip callback save the
+    // part of it that lives in the current buffer.
+    d->unknown = start;
+    d->unknown_msg = empty;
+    ptr = _upb_Decoder_SkipDelimited(d, ptr, size);
+    start = d->unknown;
+    d->unknown = NULL;
+  }
+  // The payload is only ever read back as a whole, so it may alias the input
+  // whenever strings do.
+  _upb_Decoder_StoreUnknown(d, empty, start, ptr, true);
+  return ptr;
+}
+
 UPB_FORCEINLINE
 static const char* _upb_Decoder_RecurseSubMessage(upb_Decoder* d,
                                                   const char* ptr,
@@ -286,7 +379,10 @@ static const char* _upb_Decoder_RecurseSubMessage(upb_Decoder* d,
   if (--d->depth < 0) {
     _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_MaxDepthExceeded);
   }
+  const upb_DecodeFieldMask* saved_mask = d->mask;
+  if (UPB_UNLIKELY(saved_mask)) d->mask = subl ? d->submask : NULL;
   ptr = _upb_Decoder_DecodeMessage(d, ptr, submsg, subl);
+  d->mask = saved_mask;
   d->depth++;
   if (d->end_group != expected_end_group) {
     _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
@@ -412,29 +508,54 @@ static const char* _upb_Decoder_DecodeFixedPacked(
     // Length isn't a round multiple of elem size.
     _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
   }
-  _upb_Decoder_Reserve(d, arr, count);
-  void* mem = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
-  arr->size += count;
-  // Note: if/when the decoder supports multi-buffer input, we will need to
-  // handle buffer seams here.
-  if (_upb_IsLittleEndian()) {
-    ptr = upb_EpsCopyInputStream_Copy(&d->input, ptr, mem, val->size);
-  } else {
-    int delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
-    char* dst = mem;
-    while (!_upb_Decoder_IsDone(d, &ptr)) {
-      if (lg2 == 2) {
-        ptr = upb_WireReader_ReadFixed32(ptr, dst);
-        dst += 4;
-      } else {
-        UPB_ASSERT(lg2 == 3);
-        ptr = upb_WireReader_ReadFixed64(ptr, dst);
-        dst += 8;
-      }
+  if (_upb_IsLittleEndian() && upb_EpsCopyInputStream_CheckDataSizeAvailable(
+                                    &d->input, ptr, val->size)) {
+    _upb_Decoder_Reserve(d, arr, count);
+    void* mem = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
+    arr->size += count;
+    memcpy(mem, ptr, val->size);
+    return ptr + val->size;
+  }
+
+  // When reading from a stream, the length has not been checked against the
+  // data that is actually there, so the array grows as the elements arrive.
+  int delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
+  while (!_upb_Decoder_IsDone(d, &ptr)) {
+    _upb_Decoder_Reserve(d, arr, 1);
+    char* dst = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, char);
+    arr->size++;
+    if (lg2 == 2) {
+      ptr = upb_WireReader_ReadFixed32(ptr, dst);
+    } else {
+      UPB_ASSERT(lg2 == 3);
+      ptr = upb_WireReader_ReadFixed64(ptr, dst);
     }
-    upb_EpsCopyInputStream_PopLimit(&d->input, ptr, delta);
   }
+  upb_EpsCopyInputStream_PopLimit(&d->input, ptr, delta);
+  return ptr;
+}
 
+// Decodes the varints of a packed field that start in the current buffer,
+// or as many as fit in the array's capacity, into the space past the end of
+// `arr`.  The caller must add `*count` to the array's size.
+UPB_FORCEINLINE
+static const char* _upb_Decoder_DecodeVarintRun(upb_Decoder* d,
+                                                const char* ptr, upb_Array* arr,
+                                                int lg2, upb_FieldType type,
+                                                size_t* count) {
+  // IsDone() returned false, so at least one varint starts at `ptr` even if
+  // the buffer was just flipped.
+  const char* end = UPB_MAX(d->input.limit_ptr, ptr + 1);
+  if (arr->size == arr->capacity) {
+    // Grow by exactly what this buffer holds instead of repeatedly doubling.
+    size_t n = _upb_Decoder_CountVarints(
+        ptr, upb_EpsCopyInputStream_AvailableEnd(&d->input));
+    _upb_Decoder_Reserve(d, arr, UPB_MAX(n, 1));
+  }
+  char* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, char);
+  ptr = _upb_Decoder_DecodeVarintArray(ptr, end, out,
+                                       arr->capacity - arr->size, type, count);
+  if (!ptr) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
   return ptr;
 }
 
@@ -442,19 +563,12 @@ UPB_FORCEINLINE
 static const char* _upb_Decoder_DecodeVarintPacked(
     upb_Decoder* d, const char* ptr, upb_Array* arr, wireval* val,
     const upb_MiniTableField* field, int lg2) {
-  int scale = 1 << lg2;
   int saved_limit = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
-  char* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
   while (!_upb_Decoder_IsDone(d, &ptr)) {
-    wireval elem;
-    ptr = _upb_Decoder_DecodeVarint(d, ptr, &elem.uint64_val);
-    _upb_Decoder_Munge(field->UPB_PRIVATE(descriptortype), &elem);
-    if (_upb_Decoder_Reserve(d, arr, 1)) {
-      out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
-    }
-    arr->size++;
-    memcpy(out, &elem, scale);
-    out += scale;
+    size_t count;
+    ptr = _upb_Decoder_DecodeVarintRun(
+        d, ptr, arr, lg2, field->UPB_PRIVATE(descriptortype), &count);
+    arr->size += count;
   }
   upb_EpsCopyInputStream_PopLimit(&d->input, ptr, saved_limit);
   return ptr;
@@ -467,27 +581,112 @@ static const char* _upb_Decoder_DecodeEnumPacked(
     wireval* val) {
   const upb_MiniTableEnum* e = subs[field->UPB_PRIVATE(submsg_index)].subenum;
   int saved_limit = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
-  char* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size * 4, void);
   while (!_upb_Decoder_IsDone(d, &ptr)) {
-    wireval elem;
-    ptr = _upb_Decoder_DecodeVarint(d, ptr, &elem.uint64_val);
-    _upb_Decoder_MungeInt32(&elem);
-    if (!_upb_Decoder_CheckEnum(d, ptr, msg, e, field, &elem)) {
-      continue;
-    }
-    if (_upb_Decoder_Reserve(d, arr, 1)) {
-      out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size * 4, void);
+    size_t count;
+    ptr = _upb_Decoder_DecodeVarintRun(d, ptr, arr, 2, kUpb_FieldType_Enum,
+                                       &count);
+    // Drop the values that are not in the enum, keeping the rest in order.
+    uint32_t* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size * 4, uint32_t);
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+      wireval elem;
+      elem.uint32_val = out[i];
+      if (_upb_Decoder_CheckEnum(d, ptr, msg, e, field, &elem)) {
+        out[kept++] = elem.uint32_val;
+      }
     }
-    arr->size++;
-    memcpy(out, &elem, 4);
-    out += 4;
+    arr->size += kept;
   }
   upb_EpsCopyInputStream_PopLimit(&d->input, ptr, saved_limit);
   return ptr;
 }
 
+size_t _upb_Decoder_CountTagRun(upb_Decoder* d, const char* ptr,
+                                uint32_t tag) {
+  const char* end = d->input.limit_ptr;
+  size_t n = 0;
+  // Every field starts before `end`, and its tag and any length or varint
+  // value fit in the slop bytes after that.
+  while (ptr < end) {
+    uint32_t next;
+    ptr = upb_WireReader_ReadTag(ptr, &next);
+    if (!ptr || next != tag) break;
+    n++;
+    switch (upb_WireReader_GetWireType(tag)) {
+      case kUpb_WireType_Varint:
+        ptr = upb_WireReader_SkipVarint(ptr);
+        break;
+      case kUpb_WireType_32Bit:
+        ptr += 4;
+        break;
+      case kUpb_WireType_64Bit:
+        ptr += 8;
+        break;
+      case kUpb_WireType_Delimited: {
+        int size;
+        ptr = upb_WireReader_ReadSize(ptr, &size);
+        if (!ptr || size > end - ptr) return n;
+        ptr += size;
+        break;
+      }
+      default:
+        return n;
+    }
+    if (!ptr) break;
+  }
+  return n;
+}
+
+// Returns the number of elements that the repeated field is about to receive,
+// as far as can be seen in the current buffer.  `ptr` and `val` are as passed
+// to _upb_Decoder_DecodeToArray().
+static size_t _upb_Decoder_CountArrayElements(upb_Decoder* d, const char* ptr,
+                                              const upb_MiniTableField* field,
+                                              wireval* val, int op) {
+  int type = field->UPB_PRIVATE(descriptortype);
+  uint32_t tag = field->number << 3;
+  switch (op) {
+    case OP_FIXPCK_LG2(2):
+    case OP_FIXPCK_LG2(3): {
+      // When streaming, only trust the length as far as the data we have.
+      size_t avail = upb_EpsCopyInputStream_AvailableEnd(&d->input) - ptr;
+      return UPB_MIN(val->size, avail) >> (op - OP_FIXPCK_LG2(0));
+    }
+    case OP_VARPCK_LG2(0):
+    case OP_VARPCK_LG2(2):
+    case OP_VARPCK_LG2(3):
+    case kUpb_DecodeOp_PackedEnum:
+      return _upb_Decoder_CountVarints(
+          ptr, UPB_MIN(ptr + val->size,
+                       upb_EpsCopyInputStream_AvailableEnd(&d->input)));
+    case kUpb_DecodeOp_String:
+    case kUpb_DecodeOp_Bytes:
+    case kUpb_DecodeOp_SubMessage:
+      // Groups are too costly to skip over.
+      if (type == kUpb_FieldType_Group) return 1;
+      tag |= kUpb_WireType_Delimited;
+      ptr += val->size;
+      break;
+    default:
+      // Scalars have already been read, so `ptr` is at the next tag.
+      if (type == kUpb_FieldType_Fixed32 || type == kUpb_FieldType_SFixed32 ||
+          type == kUpb_FieldType_Float) {
+        tag |= kUpb_WireType_32Bit;
+      } else if (type == kUpb_FieldType_Fixed64 ||
+                 type == kUpb_FieldType_SFixed64 ||
+                 type == kUpb_FieldType_Double) {
+        tag |= kUpb_WireType_64Bit;
+      } else {
+        tag |= kUpb_WireType_Varint;
+      }
+      break;
+  }
+  return 1 + _upb_Decoder_CountTagRun(d, ptr, tag);
+}
+
 upb_Array* _upb_Decoder_CreateArray(upb_Decoder* d,
-                                    const upb_MiniTableField* field) {
+                                    const upb_MiniTableField* field,
+                                    size_t capacity) {
   /* Maps descriptor type -> elem_size_lg2.  */
   static const uint8_t kElemSizeLg2[] = {
       [0] = -1,  // invalid descriptor type
@@ -512,7 +711,7 @@ upb_Array* _upb_Decoder_CreateArray(upb_Decoder* d,
   };
 
   size_t lg2 = kElemSizeLg2[field->UPB_PRIVATE(descriptortype)];
-  upb_Array* ret = _upb_Array_New(&d->arena, 4, lg2);
+  upb_Array* ret = _upb_Array_New(&d->arena, UPB_MAX(capacity, 4), lg2);
   if (!ret) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
   return ret;
 }
@@ -529,7 +728,10 @@ static const char* _upb_Decoder_DecodeToArray(upb_Decoder* d, const char* ptr,
   if (arr) {
     _upb_Decoder_Reserve(d, arr, 1);
   } else {
-    arr = _upb_Decoder_CreateArray(d, field);
+    // Size the array for all the elements we can see coming, so that it does
+    // not leave a trail of dead copies in the arena as it grows.
+    size_t count = _upb_Decoder_CountArrayElements(d, ptr, field, val, op);
+    arr = _upb_Decoder_CreateArray(d, field, count);
     *arrp = arr;
   }
 
@@ -543,18 +745,22 @@ static const char* _upb_Decoder_DecodeToArray(upb_Decoder* d, const char* ptr,
       memcpy(mem, val, 1 << op);
       return ptr;
     case kUpb_DecodeOp_String:
-      _upb_Decoder_VerifyUtf8(d, ptr, val->size);
-      /* Fallthrough. */
     case kUpb_DecodeOp_Bytes: {
       /* Append bytes. */
       upb_StringView* str = (upb_StringView*)_upb_array_ptr(arr) + arr->size;
       arr->size++;
-      return _upb_Decoder_ReadString(d, ptr, val->size, str);
+      return _upb_Decoder_ReadString(d, ptr, val->size, str,
+                                     op == kUpb_DecodeOp_String);
     }
     case kUpb_DecodeOp_SubMessage: {
       /* Append submessage / group. */
       upb_TaggedMessagePtr* target = UPB_PTR_AT(
           _upb_array_ptr(arr), arr->size * sizeof(void*), upb_TaggedMessagePtr);
+      if (_upb_Decoder_IsLazy(d, field)) {
+        upb_Message* empty = _upb_Decoder_NewLazySubMessage(d, target);
+        arr->size++;
+        return _upb_Decoder_DecodeLazySubMessage(d, ptr, empty, val->size);
+      }
       upb_Message* submsg = _upb_Decoder_NewSubMessage(d, subs, field, target);
       arr->size++;
       if (UPB_UNLIKELY(field->UPB_PRIVATE(descriptortype) ==
@@ -653,9 +859,9 @@ static const char* _upb_Decoder_DecodeToMap(upb_Decoder* d, const char* ptr,
   ptr =
       _upb_Decoder_DecodeSubMessage(d, ptr, &ent.data, subs, field, val->size);
   // check if ent had any unknown fields
-  size_t size;
-  upb_Message_GetUnknown(&ent.data, &size);
-  if (size != 0) {
+  upb_StringView unknown;
+  uintptr_t iter = kUpb_Message_UnknownBegin;
+  if (upb_Message_NextUnknown(&ent.data, &unknown, &iter)) {
     char* buf;
     size_t size;
     uint32_t tag = ((uint32_t)field->number << 3) | kUpb_WireType_Delimited;
@@ -709,6 +915,14 @@ static const char* _upb_Decoder_DecodeToSubMessage(
     case kUpb_DecodeOp_SubMessage: {
       upb_TaggedMessagePtr* submsgp = mem;
       upb_Message* submsg;
+      if (_upb_Decoder_IsLazy(d, field) &&
+          (!*submsgp || upb_TaggedMessagePtr_IsEmpty(*submsgp))) {
+        // Since parsing is a merge, more data for a lazy sub-message can
+        // simply be appended to it.
+        submsg = *submsgp ? _upb_TaggedMessagePtr_GetEmptyMessage(*submsgp)
+                          : _upb_Decoder_NewLazySubMessage(d, submsgp);
+        return _upb_Decoder_DecodeLazySubMessage(d, ptr, submsg, val->size);
+      }
       if (*submsgp) {
         submsg = _upb_Decoder_ReuseSubMessage(d, subs, field, submsgp);
       } else {
@@ -723,10 +937,9 @@ static const char* _upb_Decoder_DecodeToSubMessage(
       break;
     }
     case kUpb_DecodeOp_String:
-      _upb_Decoder_VerifyUtf8(d, ptr, val->size);
-      /* Fallthrough. */
     case kUpb_DecodeOp_Bytes:
-      return _upb_Decoder_ReadString(d, ptr, val->size, mem);
+      return _upb_Decoder_ReadString(d, ptr, val->size, mem,
+                                     op == kUpb_DecodeOp_String);
     case kUpb_DecodeOp_Scalar8Byte:
       memcpy(mem, val, 8);
       break;
@@ -752,6 +965,7 @@ const char* _upb_Decoder_CheckRequired(upb_Decoder* d, const char* ptr,
   if (UPB_LIKELY((d->options & kUpb_DecodeOption_CheckRequired) == 0)) {
     return ptr;
   }
+  if (msg == d->deferred_required) return ptr;
   uint64_t msg_head;
   memcpy(&msg_head, msg, 8);
   msg_head = _upb_BigEndian_Swap64(msg_head);
@@ -766,10 +980,14 @@ static bool _upb_Decoder_TryFastDispatch(upb_Decoder* d, const char** ptr,
                                          upb_Message* msg,
                                          const upb_MiniTable* layout) {
 #if UPB_FASTTABLE
-  if (layout && layout->table_mask != (unsigned char)-1) {
-    uint16_t tag = _upb_FastDecoder_LoadTag(*ptr);
+  if (layout && layout->table_mask != (unsigned char)-1 && !d->mask) {
     intptr_t table = decode_totable(layout);
+#if UPB_FASTTABLE_TRAMPOLINE
+    *ptr = _upb_FastDecoder_Trampoline(d, *ptr, msg, table);
+#else
+    uint16_t tag = _upb_FastDecoder_LoadTag(*ptr);
     *ptr = _upb_FastDecoder_TagDispatch(d, *ptr, msg, table, 0, tag);
+#endif
     return true;
   }
 #endif
@@ -792,7 +1010,7 @@ static const char* upb_Decoder_SkipField(upb_Decoder* d, const char* ptr,
     case kUpb_WireType_Delimited: {
       uint32_t size;
       ptr = upb_Decoder_DecodeSize(d, ptr, &size);
-      return ptr + size;
+      return _upb_Decoder_SkipDelimited(d, ptr, size);
     }
     case kUpb_WireType_StartGroup:
       return _upb_Decoder_DecodeUnknownGroup(d, ptr, field_number);
@@ -801,6 +1019,23 @@ static const char* upb_Decoder_SkipField(upb_Decoder* d, const char* ptr,
   }
 }
 
+// Returns true if `field` is selected by the current field mask, and sets up
+// the mask for its sub-message.  Extensions and unknown fields are never
+// selected.
+UPB_FORCEINLINE
+static bool _upb_Decoder_IsSelected(upb_Decoder* d, const upb_MiniTable* layout,
+                                    const upb_MiniTableField* field) {
+  const upb_DecodeFieldMask* mask = d->mask;
+  UPB_ASSERT(mask->table == layout);
+  size_t idx = ((uintptr_t)field - (uintptr_t)layout->fields) / sizeof(*field);
+  if ((uintptr_t)field < (uintptr_t)layout->fields ||
+      idx >= layout->field_count || !mask->selected[idx]) {
+    return false;
+  }
+  d->submask = mask->sub[idx];
+  return true;
+}
+
 enum {
   kStartItemTag = ((kUpb_MsgSet_Item << 3) | kUpb_WireType_StartGroup),
   kEndItemTag = ((kUpb_MsgSet_Item << 3) | kUpb_WireType_EndGroup),
@@ -892,7 +1127,15 @@ static const char* upb_Decoder_DecodeMessageSetItem(
         uint32_t size;
         ptr = upb_Decoder_DecodeSize(d, ptr, &size);
         const char* data = ptr;
-        ptr += size;
+        if (d->input.stream) {
+          // Stream buffers do not outlive the next buffer flip, so the payload
+          // must be copied before we can hold on to it.
+          upb_StringView copy;
+          ptr = _upb_Decoder_ReadString(d, ptr, size, &copy, false);
+          data = copy.data;
+        } else {
+          ptr += size;
+        }
         if (state_mask & kUpb_HavePayload) break;  // Ignore dup.
         state_mask |= kUpb_HavePayload;
         if (state_mask & kUpb_HaveId) {
@@ -927,7 +1170,15 @@ static const upb_MiniTableField* _upb_Decoder_FindField(upb_Decoder* d,
     goto found;
   }
 
-  if (t->dense_below < t->field_count) {
+  if (t->field_hash) {
+    /* Sparse field numbers: hash lookup. */
+    const upb_MiniTableField* f =
+        _upb_MiniTable_FindFieldInHash(t, field_number);
+    if (f) {
+      idx = f - t->fields;
+      goto found;
+    }
+  } else if (t->dense_below < t->field_count) {
     /* Linear search non-dense fields. Resume scanning from last_field_index
      * since fields are usually in order. */
     size_t last = *last_field_index;
@@ -1196,7 +1447,9 @@ static const char* _upb_Decoder_DecodeUnknownField(upb_Decoder* d,
   // significant speedups in benchmarks.
   const char* start = ptr;
 
-  if (wire_type == kUpb_WireType_Delimited) ptr += val.size;
+  if (wire_type == kUpb_WireType_Delimited && !msg) {
+    ptr = _upb_Decoder_SkipDelimited(d, ptr, val.size);
+  }
   if (msg) {
     switch (wire_type) {
       case kUpb_WireType_Varint:
@@ -1225,10 +1478,21 @@ static const char* _upb_Decoder_DecodeUnknownField(upb_Decoder* d,
       ptr = _upb_Decoder_DecodeUnknownGroup(d, ptr, field_number);
       start = d->unknown;
       d->unknown = NULL;
+    } else if (wire_type == kUpb_WireType_Delimited) {
+      if (UPB_LIKELY(upb_EpsCopyInputStream_CheckDataSizeAvailable(
+              &d->input, ptr, val.size))) {
+        ptr += val.size;
+      } else {
+        // The data spans buffers, so we let the buffer flip callback save
+        // the part of the field that lives in the current buffer.
+        d->unknown = start;
+        d->unknown_msg = msg;
+        ptr = _upb_Decoder_SkipDelimited(d, ptr, val.size);
+        start = d->unknown;
+        d->unknown = NULL;
+      }
     }
-    if (!_upb_Message_AddUnknown(msg, start, ptr - start, &d->arena)) {
-      _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
-    }
+    _upb_Decoder_AddUnknown(d, msg, start, ptr);
   } else if (wire_type == kUpb_WireType_StartGroup) {
     ptr = _upb_Decoder_DecodeUnknownGroup(d, ptr, field_number);
   }
@@ -1280,6 +1544,13 @@ static const char* _upb_Decoder_DecodeMessage(upb_Decoder* d, const char* ptr,
     }
 
     field = _upb_Decoder_FindField(d, layout, field_number, &last_field_index);
+    if (UPB_UNLIKELY(d->mask) && !_upb_Decoder_IsSelected(d, layout, field)) {
+      if (field_number == 0) {
+        _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+      }
+      ptr = upb_Decoder_SkipField(d, ptr, tag);
+      continue;
+    }
     ptr = _upb_Decoder_DecodeWireValue(d, ptr, layout, field, wire_type, &val,
                                        &op);
 
@@ -1330,6 +1601,12 @@ const char* _upb_Decoder_IsDoneFallback(upb_EpsCopyInputStream* e,
       e, ptr, overrun, _upb_Decoder_BufferFlipCallback);
 }
 
+// Hands the allocations made through the decoder's temporary arena back to
+// `arena`.
+static void upb_Decoder_ReleaseArena(upb_Decoder* d, upb_Arena* arena) {
+  _upb_Arena_SwapOut(arena, &d->arena);
+}
+
 static upb_DecodeStatus upb_Decoder_Decode(upb_Decoder* const decoder,
                                            const char* const buf,
                                            void* const msg,
@@ -1341,43 +1618,669 @@ static upb_DecodeStatus upb_Decoder_Decode(upb_Decoder* const decoder,
     UPB_ASSERT(decoder->status != kUpb_DecodeStatus_Ok);
   }
 
-  _upb_MemBlock* blocks =
-      upb_Atomic_Load(&decoder->arena.blocks, memory_order_relaxed);
-  arena->head = decoder->arena.head;
-  upb_Atomic_Store(&arena->blocks, blocks, memory_order_relaxed);
+  upb_Decoder_ReleaseArena(decoder, arena);
   return decoder->status;
 }
 
+// Initializes everything except the input stream.
+static void upb_Decoder_Init(upb_Decoder* d,
+                             const upb_ExtensionRegistry* extreg, int options,
+                             upb_Arena* arena) {
+  unsigned depth = (unsigned)options >> 16;
+
+  d->extreg = extreg;
+  d->unknown = NULL;
+  d->depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
+  d->end_group = DECODE_NOGROUP;
+  d->options = (uint16_t)options;
+  d->missing_required = false;
+  d->deferred_required = NULL;
+  d->mask = NULL;
+  d->submask = NULL;
+  d->status = kUpb_DecodeStatus_Ok;
+
+  // Violating the encapsulation of the arena for performance reasons.
+  // This is a temporary arena that we swap into and swap out of when we are
+  // done.  The temporary arena only needs to be able to handle allocation,
+  // not fuse or free, so it does not need many of the members to be initialized
+  // (particularly parent_or_count).
+  _upb_Arena_SwapIn(&d->arena, arena);
+}
+
 upb_DecodeStatus upb_Decode(const char* buf, size_t size, void* msg,
                             const upb_MiniTable* l,
                             const upb_ExtensionRegistry* extreg, int options,
                             upb_Arena* arena) {
   upb_Decoder decoder;
-  unsigned depth = (unsigned)options >> 16;
 
   upb_EpsCopyInputStream_Init(&decoder.input, &buf, size,
                               options & kUpb_DecodeOption_AliasString);
+  upb_Decoder_Init(&decoder, extreg, options, arena);
 
-  decoder.extreg = extreg;
-  decoder.unknown = NULL;
-  decoder.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
-  decoder.end_group = DECODE_NOGROUP;
-  decoder.options = (uint16_t)options;
-  decoder.missing_required = false;
-  decoder.status = kUpb_DecodeStatus_Ok;
+  return upb_Decoder_Decode(&decoder, buf, msg, l, arena);
+}
 
-  // Violating the encapsulation of the arena for performance reasons.
-  // This is a temporary arena that we swap into and swap out of when we are
-  // done.  The temporary arena only needs to be able to handle allocation,
-  // not fuse or free, so it does not need many of the members to be initialized
-  // (particularly parent_or_count).
-  _upb_MemBlock* blocks = upb_Atomic_Load(&arena->blocks, memory_order_relaxed);
-  decoder.arena.head = arena->head;
-  decoder.arena.block_alloc = arena->block_alloc;
-  upb_Atomic_Init(&decoder.arena.blocks, blocks);
+upb_DecodeStatus upb_DecodeWithFieldMask(const char* buf, size_t size,
+                                         upb_Message* msg,
+                                         const upb_MiniTable* l,
+                                         const upb_DecodeFieldMask* mask,
+                                         const upb_ExtensionRegistry* extreg,
+                                         int options, upb_Arena* arena) {
+  upb_Decoder decoder;
+
+  UPB_ASSERT(mask->table == l);
+  upb_EpsCopyInputStream_Init(&decoder.input, &buf, size,
+                              options & kUpb_DecodeOption_AliasString);
+  upb_Decoder_Init(&decoder, extreg, options, arena);
+  decoder.mask = mask;
 
   return upb_Decoder_Decode(&decoder, buf, msg, l, arena);
 }
 
+upb_DecodeStatus upb_DecodeFromStream(upb_ZeroCopyInputStream* stream,
+                                      void* msg, const upb_MiniTable* l,
+                                      const upb_ExtensionRegistry* extreg,
+                                      int options, upb_Arena* arena,
+                                      upb_Status* status) {
+  upb_Decoder decoder;
+  const char* buf;
+
+  if (!upb_EpsCopyInputStream_InitWithStream(&decoder.input, &buf, stream,
+                                             status)) {
+    return kUpb_DecodeStatus_Malformed;
+  }
+  upb_Decoder_Init(&decoder, extreg, options, arena);
+
+  return upb_Decoder_Decode(&decoder, buf, msg, l, arena);
+}
+
+static void _upb_Decoder_DecodeDelimitedBatch(upb_Decoder* d, const char* ptr,
+                                              upb_Array* msgs,
+                                              const upb_MiniTable* l) {
+  while (!_upb_Decoder_IsDone(d, &ptr)) {
+    uint32_t size;
+    ptr = upb_Decoder_DecodeSize(d, ptr, &size);
+    upb_Message* msg = _upb_Message_New(l, &d->arena);
+    if (!msg) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+    _upb_Decoder_Reserve(d, msgs, 1);
+
+    int saved_delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, size);
+    if (!_upb_Decoder_TryFastDispatch(d, &ptr, msg, l)) {
+      ptr = _upb_Decoder_DecodeMessage(d, ptr, msg, l);
+    }
+    if (d->end_group != DECODE_NOGROUP) {
+      _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+    }
+    upb_EpsCopyInputStream_PopLimit(&d->input, ptr, saved_delta);
+
+    upb_Message** target = (upb_Message**)_upb_array_ptr(msgs) + msgs->size;
+    *target = msg;
+    msgs->size++;
+  }
+}
+
+static upb_DecodeStatus upb_Decoder_DecodeBatch(upb_Decoder* const decoder,
+                                                const char* const buf,
+                                                upb_Array* const msgs,
+                                                const upb_MiniTable* const l,
+                                                upb_Arena* const arena) {
+  if (UPB_SETJMP(decoder->err) == 0) {
+    _upb_Decoder_DecodeDelimitedBatch(decoder, buf, msgs, l);
+    if (decoder->missing_required) {
+      decoder->status = kUpb_DecodeStatus_MissingRequired;
+    }
+  } else {
+    UPB_ASSERT(decoder->status != kUpb_DecodeStatus_Ok);
+  }
+
+  upb_Decoder_ReleaseArena(decoder, arena);
+  return decoder->status;
+}
+
+upb_DecodeStatus upb_DecodeDelimitedBatch(const char* buf, size_t size,
+                                          upb_Array* msgs,
+                                          const upb_MiniTable* l,
+                                          const upb_ExtensionRegistry* extreg,
+                                          int options, upb_Arena* arena) {
+  upb_Decoder decoder;
+
+  UPB_ASSERT(_upb_Array_ElementSizeLg2(msgs) == UPB_SIZE(2, 3));
+  upb_EpsCopyInputStream_Init(&decoder.input, &buf, size,
+                              options & kUpb_DecodeOption_AliasString);
+  upb_Decoder_Init(&decoder, extreg, options, arena);
+
+  return upb_Decoder_DecodeBatch(&decoder, buf, msgs, l, arena);
+}
+
+// Push decoding //////////////////////////////////////////////////////////////
+
+// Protobuf parsing is a merge, so parsing a message in pieces gives the same
+// result as parsing it all at once as long as every piece ends on a field
+// boundary.  The push decoder parses all of the complete top-level fields in
+// each chunk right away and only buffers the trailing incomplete field (if
+// any) until the rest of it arrives.  Only as much of the following chunks as
+// that field needs is copied, and the fields after it are parsed in place.
+
+struct upb_DecoderState {
+  upb_Decoder decoder;
+  upb_Message* msg;
+  const upb_MiniTable* l;
+  const upb_ExtensionRegistry* extreg;
+  int options;
+  upb_Arena* arena;
+  char* buf;        // Start of a top-level field that is not yet complete.
+  size_t size;      // Number of bytes in `buf`.
+  size_t capacity;  // Allocated size of `buf`.
+  size_t need;      // If known, the size `buf` must reach to be complete.
+  size_t scanned;   // How far into `buf` the last scan got.
+  int groups;       // Number of groups open at `scanned`.
+  upb_DecodeStatus status;  // Sticky, once there is an error.
+  bool missing_required;
+};
+
+typedef enum {
+  kUpb_FieldScan_Complete,
+  kUpb_FieldScan_Incomplete,
+  kUpb_FieldScan_Malformed,
+} upb_FieldScan;
+
+static upb_FieldScan _upb_DecoderState_ScanVarint(const char** ptr,
+                                                  const char* end,
+                                                  uint64_t* val) {
+  const char* p = *ptr;
+  uint64_t ret = 0;
+  for (int i = 0; i < 10; i++) {
+    if (p == end) return kUpb_FieldScan_Incomplete;
+    uint64_t byte = (uint8_t)*p++;
+    ret |= (byte & 0x7f) << (i * 7);
+    if (!(byte & 0x80)) {
+      *ptr = p;
+      *val = ret;
+      return kUpb_FieldScan_Complete;
+    }
+  }
+  return kUpb_FieldScan_Malformed;
+}
+
+// Scans past the field starting at `*ptr`, without reading beyond `end`.
+// Groups are not descended into: their START_GROUP and END_GROUP tags are
+// scanned like fields without a value.  If a length-delimited value is
+// incomplete, `*need` is set to how far past `start` the data must extend for
+// it to be complete.
+static upb_FieldScan _upb_DecoderState_ScanField(const char** ptr,
+                                                 const char* start,
+                                                 const char* end,
+                                                 uint32_t* tag, size_t* need) {
+  const char* p = *ptr;
+  uint64_t val;
+  upb_FieldScan ret = _upb_DecoderState_ScanVarint(&p, end, &val);
+  if (ret != kUpb_FieldScan_Complete) return ret;
+  if (val > UINT32_MAX || (val >> 3) == 0) return kUpb_FieldScan_Malformed;
+  *tag = val;
+
+  switch (val & 7) {
+    case kUpb_WireType_Varint:
+      ret = _upb_DecoderState_ScanVarint(&p, end, &val);
+      break;
+    case kUpb_WireType_64Bit:
+    case kUpb_WireType_32Bit: {
+      size_t size = (val & 7) == kUpb_WireType_64Bit ? 8 : 4;
+      if ((size_t)(end - p) < size) return kUpb_FieldScan_Incomplete;
+      p += size;
+      break;
+    }
+    case kUpb_WireType_Delimited:
+      ret = _upb_DecoderState_ScanVarint(&p, end, &val);
+      if (ret != kUpb_FieldScan_Complete) return ret;
+      if (val >= INT32_MAX) return kUpb_FieldScan_Malformed;
+      if ((uint64_t)(end - p) < val) {
+        *need = (p - start) + val;
+        return kUpb_FieldScan_Incomplete;
+      }
+      p += val;
+      break;
+    case kUpb_WireType_StartGroup:
+    case kUpb_WireType_EndGroup:
+      break;
+    default:
+      return kUpb_FieldScan_Malformed;
+  }
+  if (ret == kUpb_FieldScan_Complete) *ptr = p;
+  return ret;
+}
+
+// Returns the number of bytes at the start of [buf, buf + size) that hold
+// complete top-level fields.  Malformed input is treated as complete, so
+// that the decoder will report it.  The scan starts at `s->scanned` with
+// `s->groups` groups open, and if the last field is incomplete, saves how far
+// into it the scan got, so that a field which arrives in many pieces is only
+// scanned once.  Only the nesting of groups is tracked here; the decoder
+// reports END_GROUP tags that do not match.
+static size_t _upb_DecoderState_Scan(upb_DecoderState* s, const char* buf,
+                                     size_t size) {
+  const char* ptr = buf + s->scanned;
+  const char* end = buf + size;
+  const char* field_start = buf;  // Start of the current top-level field.
+  int depth = (unsigned)s->options >> 16;
+  if (!depth) depth = kUpb_WireFormat_DefaultDepthLimit;
+  s->need = 0;
+  while (ptr < end) {
+    if (s->groups == 0) field_start = ptr;
+    uint32_t tag;
+    upb_FieldScan ret =
+        _upb_DecoderState_ScanField(&ptr, field_start, end, &tag, &s->need);
+    if (ret == kUpb_FieldScan_Incomplete) break;
+    if (ret == kUpb_FieldScan_Malformed ||
+        ((tag & 7) == kUpb_WireType_StartGroup && s->groups == depth) ||
+        ((tag & 7) == kUpb_WireType_EndGroup && s->groups == 0)) {
+      s->scanned = 0;
+      s->groups = 0;
+      return size;
+    }
+    if ((tag & 7) == kUpb_WireType_StartGroup) s->groups++;
+    if ((tag & 7) == kUpb_WireType_EndGroup) s->groups--;
+  }
+  if (ptr == end && s->groups == 0) {
+    s->scanned = 0;
+    return size;
+  }
+  s->scanned = ptr - field_start;
+  return field_start - buf;
+}
+
+static bool _upb_DecoderState_Decode(upb_DecoderState* s, const char* buf,
+                                     size_t size) {
+  if (size == 0) return true;
+  upb_Decoder* d = &s->decoder;
+  upb_EpsCopyInputStream_Init(&d->input, &buf, size, false);
+  upb_Decoder_Init(d, s->extreg, s->options, s->arena);
+  d->deferred_required = s->msg;
+  upb_DecodeStatus status = upb_Decoder_Decode(d, buf, s->msg, s->l, s->arena);
+  if (status == kUpb_DecodeStatus_MissingRequired) {
+    s->missing_required = true;
+  } else if (status != kUpb_DecodeStatus_Ok) {
+    s->status = status;
+    return false;
+  }
+  return true;
+}
+
+static bool _upb_DecoderState_Append(upb_DecoderState* s, const char* data,
+                                     size_t size) {
+  if (size > s->capacity - s->size) {
+    size_t capacity = UPB_MAX(UPB_MAX(s->capacity * 2, s->size + size), 128);
+    char* buf = upb_grealloc(s->buf, s->capacity, capacity);
+    if (!buf) {
+      s->status = kUpb_DecodeStatus_OutOfMemory;
+      return false;
+    }
+    s->buf = buf;
+    s->capacity = capacity;
+  }
+  if (size) memcpy(s->buf + s->size, data, size);
+  s->size += size;
+  return true;
+}
+
+upb_DecoderState* upb_DecoderState_New(upb_Message* msg,
+                                       const upb_MiniTable* l,
+                                       const upb_ExtensionRegistry* extreg,
+                                       int options, upb_Arena* arena) {
+  upb_DecoderState* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s) return NULL;
+  s->msg = msg;
+  s->l = l;
+  s->extreg = extreg;
+  // The caller's buffers do not outlive the call to Feed().
+  s->options = options & ~kUpb_DecodeOption_AliasString;
+  s->arena = arena;
+  s->buf = NULL;
+  s->size = 0;
+  s->capacity = 0;
+  s->need = 0;
+  s->scanned = 0;
+  s->groups = 0;
+  s->status = kUpb_DecodeStatus_Ok;
+  s->missing_required = false;
+  return s;
+}
+
+static void _upb_DecoderState_FreeBuffer(upb_DecoderState* s) {
+  upb_gfree(s->buf);
+  s->buf = NULL;
+  s->size = 0;
+  s->capacity = 0;
+}
+
+static void _upb_DecoderState_Feed(upb_DecoderState* s, const char* data,
+                                   size_t size) {
+  // Complete the buffered field first.  Copy exactly the rest of it if its
+  // size is known, or else double the buffer until the field is found to end.
+  while (s->size != 0 && size != 0) {
+    size_t take = s->need > s->size ? s->need - s->size : UPB_MAX(s->size, 16);
+    take = UPB_MIN(take, size);
+    if (!_upb_DecoderState_Append(s, data, take)) return;
+    data += take;
+    size -= take;
+    if (s->size < s->need) continue;
+    size_t n = _upb_DecoderState_Scan(s, s->buf, s->size);
+    if (n == 0) continue;
+
+    // Whatever was copied past the complete fields is parsed from `data`.
+    size_t extra = s->size - n;
+    UPB_ASSERT(extra <= take);
+    data -= extra;
+    size += extra;
+    s->size = 0;
+    s->scanned = 0;
+    s->groups = 0;
+    if (!_upb_DecoderState_Decode(s, s->buf, n)) return;
+  }
+
+  if (s->size == 0) {
+    // Parse straight out of the caller's buffer.
+    size_t n = _upb_DecoderState_Scan(s, data, size);
+    if (_upb_DecoderState_Decode(s, data, n)) {
+      _upb_DecoderState_Append(s, data + n, size - n);
+    }
+  }
+}
+
+upb_DecodeStatus upb_DecoderState_Feed(upb_DecoderState* s, const char* data,
+                                       size_t size) {
+  if (s->status != kUpb_DecodeStatus_Ok) return s->status;
+  _upb_DecoderState_Feed(s, data, size);
+  if (s->status != kUpb_DecodeStatus_Ok) _upb_DecoderState_FreeBuffer(s);
+  return s->status;
+}
+
+upb_DecodeStatus upb_DecoderState_Finish(upb_DecoderState* s) {
+  if (s->status != kUpb_DecodeStatus_Ok) return s->status;
+  bool truncated = s->size != 0;
+  _upb_DecoderState_FreeBuffer(s);
+  if (truncated) {
+    // The input ended in the middle of a field.
+    s->status = kUpb_DecodeStatus_Malformed;
+    return s->status;
+  }
+  if (s->options & kUpb_DecodeOption_CheckRequired) {
+    if (s->missing_required) return kUpb_DecodeStatus_MissingRequired;
+    // Decoding empty input checks the top-level message.
+    return upb_Decode(NULL, 0, s->msg, s->l, s->extreg, s->options, s->arena);
+  }
+  return kUpb_DecodeStatus_Ok;
+}
+
+// Parallel decoding //////////////////////////////////////////////////////////
+
+// Like the push decoder, this relies on parsing being a merge.  Each shard is a
+// run of complete top-level fields, which a worker decodes with a field mask
+// that selects only the repeated field, into a message of its own.  The other
+// top-level fields ("gaps") are decoded into the real message in order, and
+// the elements from the shards are appended to it in order.
+
+// Input that interleaves the repeated field with many other fields is decoded
+// sequentially instead.
+#define kUpb_ParallelDecoder_MaxGaps 64
+
+typedef struct {
+  const char* ptr;
+  size_t size;
+} upb_DecodeSpan;
+
+typedef struct {
+  upb_DecodeSpan span;
+  upb_Arena* arena;  // Fused into the decoder's arena.
+  upb_Message* msg;  // Holds the decoded elements.
+  upb_DecodeStatus status;
+} upb_DecodeShard;
+
+struct upb_ParallelDecoder {
+  const char* buf;
+  size_t size;
+  upb_Message* msg;
+  const upb_MiniTable* l;
+  const upb_MiniTableField* field;
+  const upb_ExtensionRegistry* extreg;
+  int options;
+  upb_Arena* arena;
+  upb_DecodeFieldMask* mask;
+  upb_DecodeShard* shards;
+  size_t shard_count;
+  upb_DecodeSpan gaps[kUpb_ParallelDecoder_MaxGaps];
+  size_t gap_count;
+};
+
+// Decodes `span` into `msg` without checking the required fields of `msg`
+// itself, since other spans may supply them.
+static upb_DecodeStatus _upb_ParallelDecoder_DecodeSpan(
+    upb_ParallelDecoder* p, upb_DecodeSpan span, upb_Message* msg,
+    const upb_DecodeFieldMask* mask, upb_Arena* arena) {
+  upb_Decoder decoder;
+  const char* buf = span.ptr;
+  upb_EpsCopyInputStream_Init(&decoder.input, &buf, span.size,
+                              p->options & kUpb_DecodeOption_AliasString);
+  upb_Decoder_Init(&decoder, p->extreg, p->options, arena);
+  decoder.mask = mask;
+  decoder.deferred_required = msg;
+  return upb_Decoder_Decode(&decoder, buf, msg, p->l, arena);
+}
+
+// Scans the top-level fields, cutting shards of about `shard_size` bytes and
+// recording the gaps.  Returns false if the input should be decoded
+// sequentially.
+static bool _upb_ParallelDecoder_Scan(upb_ParallelDecoder* p, size_t max_shards,
+                                      size_t shard_size) {
+  const uint32_t target = (p->field->number << 3) | kUpb_WireType_Delimited;
+  const char* ptr = p->buf;
+  const char* end = p->buf + p->size;
+  const char* shard_start = ptr;
+  const char* gap_start = NULL;
+  const char* field_start = ptr;
+  int groups = 0;
+  int depth = (unsigned)p->options >> 16;
+  if (!depth) depth = kUpb_WireFormat_DefaultDepthLimit;
+
+  // Malformed input is left for the regular decoder to report.
+  while (ptr < end) {
+    if (groups == 0) field_start = ptr;
+    uint32_t tag;
+    size_t need;
+    if (_upb_DecoderState_ScanField(&ptr, field_start, end, &tag, &need) !=
+        kUpb_FieldScan_Complete) {
+      return false;
+    }
+    if ((tag & 7) == kUpb_WireType_StartGroup) {
+      if (groups == depth) return false;
+      groups++;
+    } else if ((tag & 7) == kUpb_WireType_EndGroup) {
+      if (groups == 0) return false;
+      groups--;
+    }
+    if (groups) continue;  // Not yet at the end of a top-level group.
+
+    if (tag != target) {
+      if (!gap_start) gap_start = field_start;
+    } else if (gap_start) {
+      if (p->gap_count == kUpb_ParallelDecoder_MaxGaps) return false;
+      p->gaps[p->gap_count++] =
+          (upb_DecodeSpan){gap_start, field_start - gap_start};
+      gap_start = NULL;
+    }
+    if ((size_t)(ptr - shard_start) >= shard_size &&
+        p->shard_count < max_shards - 1) {
+      p->shards[p->shard_count++].span =
+          (upb_DecodeSpan){shard_start, ptr - shard_start};
+      shard_start = ptr;
+    }
+  }
+  if (groups) return false;
+  if (gap_start) {
+    if (p->gap_count == kUpb_ParallelDecoder_MaxGaps) return false;
+    p->gaps[p->gap_count++] = (upb_DecodeSpan){gap_start, end - gap_start};
+  }
+  if (shard_start < end) {
+    p->shards[p->shard_count++].span =
+        (upb_DecodeSpan){shard_start, end - shard_start};
+  }
+  return true;
+}
+
+// Drops the decoder's references to the shard arenas.  What was allocated
+// from them stays alive, since they are fused into `p->arena`.
+static void _upb_ParallelDecoder_FreeShards(upb_ParallelDecoder* p) {
+  for (size_t i = 0; i < p->shard_count; i++) {
+    upb_Arena_Free(p->shards[i].arena);
+  }
+  p->shard_count = 0;
+}
+
+static bool _upb_ParallelDecoder_InitShards(upb_ParallelDecoder* p,
+                                            size_t max_shards) {
+  if (max_shards == 0) max_shards = 1;
+  if (upb_FieldMode_Get(p->field) != kUpb_FieldMode_Array ||
+      p->field->UPB_PRIVATE(descriptortype) != kUpb_FieldType_Message ||
+      !upb_MiniTable_GetSubMessageTable(p->l, p->field)) {
+    return false;
+  }
+
+  p->mask = upb_DecodeFieldMask_New(p->l, p->arena);
+  p->shards = upb_Arena_Malloc(p->arena, max_shards * sizeof(*p->shards));
+  if (!p->mask || !p->shards ||
+      !upb_DecodeFieldMask_AddPath(p->mask, &p->field->number, 1, p->arena)) {
+    return false;
+  }
+
+  size_t shard_size = p->size / max_shards + 1;
+  if (!_upb_ParallelDecoder_Scan(p, max_shards, shard_size)) return false;
+
+  for (size_t i = 0; i < p->shard_count; i++) {
+    upb_DecodeShard* shard = &p->shards[i];
+    shard->msg = NULL;
+    shard->status = kUpb_DecodeStatus_Ok;
+    shard->arena = upb_Arena_New();
+    if (!shard->arena || !upb_Arena_Fuse(p->arena, shard->arena)) {
+      if (shard->arena) upb_Arena_Free(shard->arena);
+      p->shard_count = i;
+      _upb_ParallelDecoder_FreeShards(p);
+      return false;
+    }
+  }
+  return true;
+}
+
+upb_ParallelDecoder* upb_ParallelDecoder_New(
+    const char* buf, size_t size, upb_Message* msg, const upb_MiniTable* l,
+    uint32_t field_number, const upb_ExtensionRegistry* extreg, int options,
+    size_t max_shards, upb_Arena* arena) {
+  upb_ParallelDecoder* p = upb_Arena_Malloc(arena, sizeof(*p));
+  if (!p) return NULL;
+  p->buf = buf;
+  p->size = size;
+  p->msg = msg;
+  p->l = l;
+  p->field = upb_MiniTable_FindFieldByNumber(l, field_number);
+  p->extreg = extreg;
+  p->options = options;
+  p->arena = arena;
+  p->mask = NULL;
+  p->shards = NULL;
+  p->shard_count = 0;
+  p->gap_count = 0;
+  if (!p->field || !_upb_ParallelDecoder_InitShards(p, max_shards)) {
+    // Decode sequentially.
+    p->shard_count = 0;
+    p->gap_count = 0;
+  }
+  return p;
+}
+
+size_t upb_ParallelDecoder_ShardCount(const upb_ParallelDecoder* p) {
+  return p->shard_count;
+}
+
+upb_DecodeStatus upb_ParallelDecoder_DecodeShard(upb_ParallelDecoder* p,
+                                                 size_t i) {
+  UPB_ASSERT(i < p->shard_count);
+  upb_DecodeShard* shard = &p->shards[i];
+  shard->msg = _upb_Message_New(p->l, shard->arena);
+  if (!shard->msg) {
+    shard->status = kUpb_DecodeStatus_OutOfMemory;
+  } else {
+    shard->status = _upb_ParallelDecoder_DecodeSpan(p, shard->span, shard->msg,
+                                                    p->mask, shard->arena);
+  }
+  return shard->status;
+}
+
+static upb_DecodeStatus _upb_ParallelDecoder_Merge(upb_ParallelDecoder* p) {
+  bool missing_required = false;
+  size_t count = 0;
+  for (size_t i = 0; i < p->shard_count; i++) {
+    upb_DecodeShard* shard = &p->shards[i];
+    UPB_ASSERT(shard->msg || shard->status != kUpb_DecodeStatus_Ok);
+    if (shard->status == kUpb_DecodeStatus_MissingRequired) {
+      missing_required = true;
+    } else if (shard->status != kUpb_DecodeStatus_Ok) {
+      return shard->status;
+    }
+    const upb_Array* arr =
+        *UPB_PTR_AT(shard->msg, p->field->offset, const upb_Array*);
+    if (arr) count += arr->size;
+  }
+
+  for (size_t i = 0; i < p->gap_count; i++) {
+    upb_DecodeStatus status = _upb_ParallelDecoder_DecodeSpan(
+        p, p->gaps[i], p->msg, NULL, p->arena);
+    if (status == kUpb_DecodeStatus_MissingRequired) {
+      missing_required = true;
+    } else if (status != kUpb_DecodeStatus_Ok) {
+      return status;
+    }
+  }
+
+  // Append the elements of every shard, in order.
+  if (count) {
+    upb_Array** arrp = UPB_PTR_AT(p->msg, p->field->offset, upb_Array*);
+    upb_Array* arr = *arrp;
+    if (!arr) {
+      arr = _upb_Array_New(p->arena, count, UPB_SIZE(2, 3));
+      if (!arr) return kUpb_DecodeStatus_OutOfMemory;
+      *arrp = arr;
+    }
+    size_t size = arr->size;
+    if (!_upb_Array_ResizeUninitialized(arr, size + count, p->arena)) {
+      return kUpb_DecodeStatus_OutOfMemory;
+    }
+    char* dst = UPB_PTR_AT(_upb_array_ptr(arr), size * sizeof(void*), char);
+    for (size_t i = 0; i < p->shard_count; i++) {
+      upb_Array* src =
+          *UPB_PTR_AT(p->shards[i].msg, p->field->offset, upb_Array*);
+      if (!src || !src->size) continue;
+      memcpy(dst, _upb_array_ptr(src), src->size * sizeof(void*));
+      dst += src->size * sizeof(void*);
+    }
+  }
+
+  if (p->options & kUpb_DecodeOption_CheckRequired) {
+    if (missing_required) return kUpb_DecodeStatus_MissingRequired;
+    // Decoding empty input checks the top-level message.
+    return upb_Decode(NULL, 0, p->msg, p->l, p->extreg, p->options, p->arena);
+  }
+  return kUpb_DecodeStatus_Ok;
+}
+
+upb_DecodeStatus upb_ParallelDecoder_Finish(upb_ParallelDecoder* p) {
+  if (p->shard_count == 0) {
+    return upb_Decode(p->buf, p->size, p->msg, p->l, p->extreg, p->options,
+                      p->arena);
+  }
+  upb_DecodeStatus status = _upb_ParallelDecoder_Merge(p);
+  _upb_ParallelDecoder_FreeShards(p);
+  return status;
+}
+
+#undef kUpb_ParallelDecoder_MaxGaps
+
 #undef OP_FIXPCK_LG2
 #undef OP_VARPCK_LG2
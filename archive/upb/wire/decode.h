@@ -33,9 +33,13 @@
 #ifndef UPB_WIRE_DECODE_H_
 #define UPB_WIRE_DECODE_H_
 
+#include "upb/base/status.h"
+#include "upb/collections/array.h"
+#include "upb/io/zero_copy_input_stream.h"
 #include "upb/mem/arena.h"
 #include "upb/message/message.h"
 #include "upb/mini_table/extension_registry.h"
+#include "upb/wire/decode_field_mask.h"
 #include "upb/wire/types.h"
 
 // Must be last.
@@ -103,6 +107,39 @@ enum {
    *    be created by the parser or the message-copying logic in message/copy.h.
    */
   kUpb_DecodeOption_ExperimentalAllowUnlinked = 4,
+
+  /* EXPERIMENTAL:
+   *
+   * If set, the parser will not parse sub-message fields (other than groups,
+   * map values and extensions).  Instead their wire data is stored in the
+   * same internal "empty" message type that is used for unlinked sub-messages,
+   * and it is parsed only if the message is promoted using the interfaces in
+   * message/promote.h.  This saves time and memory when only a few of the
+   * sub-messages in a payload will be read.
+   *
+   * All of the caveats for kUpb_DecodeOption_ExperimentalAllowUnlinked apply:
+   * the resulting messages may only be read by code that is aware of the
+   * promotion rules.  Required fields in lazy sub-messages are not checked
+   * until they are promoted.
+   *
+   * On its own this option saves CPU but not arena memory, since each
+   * sub-message's wire data is copied into the arena.  Together with
+   * kUpb_DecodeOption_AliasString the wire data aliases the input buffer
+   * instead, which must then outlive the message.
+   */
+  kUpb_DecodeOption_Lazy = 8,
+
+  /* If set, unknown fields will alias the input buffer instead of being copied
+   * into the message, and upb_Encode() will copy them straight back out of
+   * it.  Like strings under kUpb_DecodeOption_AliasString, the input buffer
+   * must then outlive the message.  This option only takes effect together
+   * with kUpb_DecodeOption_AliasString.
+   *
+   * The unknown fields of a message parsed this way may be split into several
+   * chunks.  Read them with upb_Message_NextUnknown(), or call
+   * upb_Message_FlattenUnknown() before using upb_Message_GetUnknown().
+   */
+  kUpb_DecodeOption_AliasUnknown = 16,
 };
 
 UPB_INLINE uint32_t upb_DecodeOptions_MaxDepth(uint16_t depth) {
@@ -143,6 +180,121 @@ UPB_API upb_DecodeStatus upb_Decode(const char* buf, size_t size,
                                     const upb_ExtensionRegistry* extreg,
                                     int options, upb_Arena* arena);
 
+// Like upb_Decode(), but only decodes the fields selected by `mask`, which
+// must have been created for `l`.  All other fields, including extensions and
+// unknown fields, are skipped over without being stored in `msg`, so they cost
+// neither arena memory nor copying.
+//
+// Skipped required fields are reported as missing by
+// kUpb_DecodeOption_CheckRequired, so that option is rarely useful here.
+UPB_API upb_DecodeStatus upb_DecodeWithFieldMask(
+    const char* buf, size_t size, upb_Message* msg, const upb_MiniTable* l,
+    const upb_DecodeFieldMask* mask, const upb_ExtensionRegistry* extreg,
+    int options, upb_Arena* arena);
+
+// Like upb_Decode(), but pulls the input from `stream` one chunk at a time
+// instead of requiring it to be in a single flat buffer.  The stream is read
+// until it reports EOF.  kUpb_DecodeOption_AliasString is ignored, since stream
+// buffers do not outlive the next call to upb_ZeroCopyInputStream_Next().
+//
+// If the stream itself reports an error, it is written to `status` and
+// kUpb_DecodeStatus_Malformed is returned.
+UPB_API upb_DecodeStatus upb_DecodeFromStream(
+    upb_ZeroCopyInputStream* stream, upb_Message* msg, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena,
+    upb_Status* status);
+
+// Decodes a stream of records, each of which is a message of type `l`
+// preceded by its length as a varint, as written by upb_EncodeDelimited().
+// Every record in `buf` is decoded into a new message, which is appended to
+// `msgs`, an array of kUpb_CType_Message.  All of the records share one
+// decoder setup, so this is much cheaper than calling upb_Decode() per record
+// when the records are small.
+//
+// Decoding stops at the first record that fails, which is not appended.  Any
+// other error is reported only once all of the records have been decoded.
+UPB_API upb_DecodeStatus upb_DecodeDelimitedBatch(
+    const char* buf, size_t size, upb_Array* msgs, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena);
+
+// A push-style decoder, for input that arrives in pieces that are not under
+// the caller's control, such as reads from a non-blocking socket.  Each chunk
+// is parsed as soon as it is fed in, except for a trailing field that is not
+// yet complete, which is buffered until the rest of it arrives.
+//
+//   upb_DecoderState* s = upb_DecoderState_New(msg, l, NULL, 0, arena);
+//   while (have_data) upb_DecoderState_Feed(s, data, size);
+//   upb_DecodeStatus status = upb_DecoderState_Finish(s);
+//
+// kUpb_DecodeOption_AliasString is ignored, since chunks only need to live
+// until Feed() returns.  Errors are sticky: once Feed() returns an error, all
+// further calls return the same error.
+//
+// Only top-level fields are parsed incrementally.  A top-level field that is
+// not yet complete is buffered whole, so a large sub-message or string at the
+// top level needs a buffer as large as itself until its last byte arrives.
+// The buffer is allocated with upb_gmalloc(), not from `arena`, and is reused
+// for each incomplete field.  It is released when Feed() fails or when
+// Finish() is called, so Finish() must be called even if the caller stops
+// feeding data early.
+typedef struct upb_DecoderState upb_DecoderState;
+
+// Returns NULL if allocation failed.
+UPB_API upb_DecoderState* upb_DecoderState_New(
+    upb_Message* msg, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena);
+
+UPB_API upb_DecodeStatus upb_DecoderState_Feed(upb_DecoderState* s,
+                                               const char* data, size_t size);
+
+// Signals the end of the input.  Returns kUpb_DecodeStatus_Malformed if it
+// ended in the middle of a field.  Required fields are checked here.
+UPB_API upb_DecodeStatus upb_DecoderState_Finish(upb_DecoderState* s);
+
+// A decoder that spreads the elements of one big repeated sub-message field
+// over several threads.  It is meant for messages such as
+// `message Batch { repeated Record records = 1; }` with very many elements.
+//
+// upb_ParallelDecoder_New() does a quick scan of the top-level fields and
+// splits the input into shards at field boundaries.  Each shard is decoded
+// into its own arena by upb_ParallelDecoder_DecodeShard(), which may be called
+// for different shards on different threads at the same time.  Once every
+// shard has been decoded, upb_ParallelDecoder_Finish() decodes the remaining
+// top-level fields on the calling thread and appends the elements of each
+// shard to the field in order.  The result is the same as upb_Decode().
+//
+//   upb_ParallelDecoder* d = upb_ParallelDecoder_New(
+//       buf, size, msg, l, kRecordsFieldNumber, NULL, 0, 8, arena);
+//   // On a thread pool:
+//   for (size_t i = 0; i < upb_ParallelDecoder_ShardCount(d); i++) {
+//     upb_ParallelDecoder_DecodeShard(d, i);
+//   }
+//   upb_DecodeStatus status = upb_ParallelDecoder_Finish(d);
+//
+// The shard arenas are fused into `arena` (see upb_Arena_Fuse()), so `arena`
+// must not have been created with an initial block.  If it was, or if the
+// field is not a linked repeated message field, or if the scan finds that the
+// input is malformed or that the field is interleaved with too many other
+// fields, there are no shards and Finish() decodes the input on its own.
+typedef struct upb_ParallelDecoder upb_ParallelDecoder;
+
+// Returns NULL if allocation failed.  `buf` must outlive the decoder.
+UPB_API upb_ParallelDecoder* upb_ParallelDecoder_New(
+    const char* buf, size_t size, upb_Message* msg, const upb_MiniTable* l,
+    uint32_t field_number, const upb_ExtensionRegistry* extreg, int options,
+    size_t max_shards, upb_Arena* arena);
+
+UPB_API size_t upb_ParallelDecoder_ShardCount(const upb_ParallelDecoder* d);
+
+// Decodes shard `i`.  Thread-safe with respect to calls for other shards.
+UPB_API upb_DecodeStatus upb_ParallelDecoder_DecodeShard(upb_ParallelDecoder* d,
+                                                         size_t i);
+
+// Must be called once, after every shard has been decoded.  Returns an error
+// if any part of the input failed to decode.  This also releases the shard
+// arenas; until it is called, freeing `arena` does not release its memory.
+UPB_API upb_DecodeStatus upb_ParallelDecoder_Finish(upb_ParallelDecoder* d);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -42,6 +42,9 @@
 
 #include "upb/collections/internal/array.h"
 #include "upb/wire/internal/decode.h"
+#include "upb/wire/internal/decode_varint.h"
+#include "upb/wire/reader.h"
+#include "upb/wire/types.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -69,15 +72,59 @@ typedef enum {
   CARD_p = 3  /* Packed Repeated */
 } upb_card;
 
-UPB_NOINLINE
-static const char* fastdecode_isdonefallback(UPB_PARSE_PARAMS) {
-  int overrun = data;
-  ptr = _upb_EpsCopyInputStream_IsDoneFallbackInline(
-      &d->input, ptr, overrun, _upb_Decoder_BufferFlipCallback);
-  data = _upb_FastDecoder_LoadTag(ptr);
-  UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);
+#if UPB_FASTTABLE_TRAMPOLINE
+
+// Ends the current field by returning to _upb_FastDecoder_Trampoline(), which
+// checks for the end of the message and dispatches the next field.
+UPB_FORCEINLINE
+static const char* fastdecode_dispatch(UPB_PARSE_PARAMS) {
+  (void)d;
+  (void)table;
+  (void)data;
+  *(uint32_t*)msg |= hasbits;  // Sync hasbits.
+  return ptr;
 }
 
+// When the next tag has already been loaded, we still return to the loop,
+// since chaining directly into the next field parser would consume stack.
+UPB_FORCEINLINE
+static const char* fastdecode_tagdispatch(UPB_PARSE_PARAMS) {
+  return fastdecode_dispatch(UPB_PARSE_ARGS);
+}
+
+const char* _upb_FastDecoder_Trampoline(upb_Decoder* d, const char* ptr,
+                                        upb_Message* msg, intptr_t table) {
+  for (;;) {
+    int overrun;
+    switch (upb_EpsCopyInputStream_IsDoneStatus(&d->input, ptr, &overrun)) {
+      case kUpb_IsDoneStatus_Done: {
+        const upb_MiniTable* l = decode_totablep(table);
+        return UPB_UNLIKELY(l->required_count)
+                   ? _upb_Decoder_CheckRequired(d, ptr, msg, l)
+                   : ptr;
+      }
+      case kUpb_IsDoneStatus_NotDone:
+        break;
+      case kUpb_IsDoneStatus_NeedFallback:
+        ptr = _upb_EpsCopyInputStream_IsDoneFallbackInline(
+            &d->input, ptr, overrun, _upb_Decoder_BufferFlipCallback);
+        continue;
+    }
+
+    uint64_t tag = _upb_FastDecoder_LoadTag(ptr);
+    ptr = _upb_FastDecoder_TagDispatch(d, ptr, msg, table, 0, tag);
+
+    // If a field fell back to the generic decoder, it parsed the rest of the
+    // message, which may have ended with an END_GROUP tag.
+    if (UPB_UNLIKELY(d->end_group != DECODE_NOGROUP)) return ptr;
+  }
+}
+
+#else
+
+UPB_NOINLINE
+static const char* fastdecode_isdonefallback(UPB_PARSE_PARAMS);
+
 UPB_FORCEINLINE
 static const char* fastdecode_dispatch(UPB_PARSE_PARAMS) {
   int overrun;
@@ -100,6 +147,24 @@ static const char* fastdecode_dispatch(UPB_PARSE_PARAMS) {
   UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);
 }
 
+UPB_NOINLINE
+static const char* fastdecode_isdonefallback(UPB_PARSE_PARAMS) {
+  int overrun = data;
+  ptr = _upb_EpsCopyInputStream_IsDoneFallbackInline(
+      &d->input, ptr, overrun, _upb_Decoder_BufferFlipCallback);
+  // When reading from a stream, the fallback may have found that we are
+  // exactly at EOF, so we need to check for the limit again.
+  UPB_MUSTTAIL return fastdecode_dispatch(UPB_PARSE_ARGS);
+}
+
+// Dispatches to the parser for the tag that is already loaded in `data`.
+UPB_FORCEINLINE
+static const char* fastdecode_tagdispatch(UPB_PARSE_PARAMS) {
+  UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);
+}
+
+#endif  // UPB_FASTTABLE_TRAMPOLINE
+
 UPB_FORCEINLINE
 static bool fastdecode_checktag(uint16_t data, int tagbytes) {
   if (tagbytes == 1) {
@@ -158,6 +223,8 @@ static const char* fastdecode_delimited(
     }
     int delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, len);
     ptr = func(&d->input, ptr, ctx);
+    // A sub-message that stopped at an END_GROUP tag did not reach its limit.
+    if (UPB_UNLIKELY(d->end_group != DECODE_NOGROUP)) return NULL;
     upb_EpsCopyInputStream_PopLimit(&d->input, ptr, delta);
   }
   return ptr;
@@ -182,21 +249,28 @@ typedef struct {
   uint32_t tag;
 } fastdecode_nextret;
 
+// Grows a full array to `new_size` elements, returning the new end of its
+// data.
+UPB_FORCEINLINE
+static void* fastdecode_growarr(upb_Decoder* d, fastdecode_arr* farr,
+                                int valbytes, size_t new_size) {
+  size_t old_size = farr->arr->capacity;
+  size_t old_bytes = old_size * valbytes;
+  size_t new_bytes = new_size * valbytes;
+  char* old_ptr = _upb_array_ptr(farr->arr);
+  char* new_ptr = upb_Arena_Realloc(&d->arena, old_ptr, old_bytes, new_bytes);
+  uint8_t elem_size_lg2 = __builtin_ctz(valbytes);
+  farr->arr->capacity = new_size;
+  farr->arr->data = _upb_array_tagptr(new_ptr, elem_size_lg2);
+  farr->end = (void*)(new_ptr + (new_size * valbytes));
+  return (void*)(new_ptr + (old_size * valbytes));
+}
+
 UPB_FORCEINLINE
 static void* fastdecode_resizearr(upb_Decoder* d, void* dst,
                                   fastdecode_arr* farr, int valbytes) {
   if (UPB_UNLIKELY(dst == farr->end)) {
-    size_t old_size = farr->arr->capacity;
-    size_t old_bytes = old_size * valbytes;
-    size_t new_size = old_size * 2;
-    size_t new_bytes = new_size * valbytes;
-    char* old_ptr = _upb_array_ptr(farr->arr);
-    char* new_ptr = upb_Arena_Realloc(&d->arena, old_ptr, old_bytes, new_bytes);
-    uint8_t elem_size_lg2 = __builtin_ctz(valbytes);
-    farr->arr->capacity = new_size;
-    farr->arr->data = _upb_array_tagptr(new_ptr, elem_size_lg2);
-    dst = (void*)(new_ptr + (old_size * valbytes));
-    farr->end = (void*)(new_ptr + (new_size * valbytes));
+    dst = fastdecode_growarr(d, farr, valbytes, farr->arr->capacity * 2);
   }
   return dst;
 }
@@ -249,6 +323,20 @@ static void* fastdecode_fieldmem(upb_Message* msg, uint64_t data) {
   return (char*)msg + ofs;
 }
 
+// Creates the array for a repeated field whose first tag is at `ptr`, sized
+// for the run of same-tag elements that follows.
+UPB_NOINLINE
+static upb_Array* fastdecode_newarr(upb_Decoder* d, const char* ptr,
+                                    int elem_size_lg2) {
+  uint32_t tag;
+  size_t count = upb_WireReader_ReadTag(ptr, &tag)
+                     ? _upb_Decoder_CountTagRun(d, ptr, tag)
+                     : 0;
+  upb_Array* arr = _upb_Array_New(&d->arena, UPB_MAX(count, 8), elem_size_lg2);
+  if (!arr) _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  return arr;
+}
+
 UPB_FORCEINLINE
 static void* fastdecode_getfield(upb_Decoder* d, const char* ptr,
                                  upb_Message* msg, uint64_t* data,
@@ -276,7 +364,7 @@ static void* fastdecode_getfield(upb_Decoder* d, const char* ptr,
       *(uint32_t*)msg |= *hasbits;
       *hasbits = 0;
       if (UPB_LIKELY(!*arr_p)) {
-        farr->arr = _upb_Array_New(&d->arena, 8, elem_size_lg2);
+        farr->arr = fastdecode_newarr(d, ptr, elem_size_lg2);
         *arr_p = farr->arr;
       } else {
         farr->arr = *arr_p;
@@ -383,7 +471,7 @@ done:
         goto again;                                                            \
       case FD_NEXT_OTHERFIELD:                                                 \
         data = ret.tag;                                                        \
-        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);      \
+        UPB_MUSTTAIL return fastdecode_tagdispatch(UPB_PARSE_ARGS);            \
       case FD_NEXT_ATLIMIT:                                                    \
         return ptr;                                                            \
     }                                                                          \
@@ -404,15 +492,34 @@ static const char* fastdecode_topackedvarint(upb_EpsCopyInputStream* e,
   upb_Decoder* d = (upb_Decoder*)e;
   fastdecode_varintdata* data = ctx;
   void* dst = data->dst;
-  uint64_t val;
+  upb_FieldType type;
+
+  if (data->valbytes == 1) {
+    type = kUpb_FieldType_Bool;
+  } else if (data->valbytes == 4) {
+    type = data->zigzag ? kUpb_FieldType_SInt32 : kUpb_FieldType_Int32;
+  } else {
+    type = data->zigzag ? kUpb_FieldType_SInt64 : kUpb_FieldType_Int64;
+  }
 
   while (!_upb_Decoder_IsDone(d, &ptr)) {
-    dst = fastdecode_resizearr(d, dst, &data->farr, data->valbytes);
-    ptr = fastdecode_varint64(ptr, &val);
-    if (ptr == NULL) return NULL;
-    val = fastdecode_munge(val, data->valbytes, data->zigzag);
-    memcpy(dst, &val, data->valbytes);
-    dst = (char*)dst + data->valbytes;
+    size_t count;
+    const char* end = UPB_MAX(d->input.limit_ptr, ptr + 1);
+    if (dst == data->farr.end) {
+      // Make room for everything in this buffer at once, but still at least
+      // double so that many short runs appended to one array stay linear.
+      size_t old_size = data->farr.arr->capacity;
+      size_t n = _upb_Decoder_CountVarints(
+          ptr, upb_EpsCopyInputStream_AvailableEnd(&d->input));
+      dst = fastdecode_growarr(d, &data->farr, data->valbytes,
+                               UPB_MAX(old_size * 2, old_size + n));
+    }
+    ptr = _upb_Decoder_DecodeVarintArray(
+        ptr, end, dst,
+        ((char*)data->farr.end - (char*)dst) / data->valbytes, type, &count);
+    // Jump out directly: returning NULL would leave a pushed limit behind.
+    if (ptr == NULL) _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+    dst = (char*)dst + count * data->valbytes;
   }
 
   fastdecode_commitarr(dst, &data->farr, data->valbytes);
@@ -530,7 +637,7 @@ TAGBYTES(p)
         goto again;                                                           \
       case FD_NEXT_OTHERFIELD:                                                \
         data = ret.tag;                                                       \
-        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);     \
+        UPB_MUSTTAIL return fastdecode_tagdispatch(UPB_PARSE_ARGS);           \
       case FD_NEXT_ATLIMIT:                                                   \
         return ptr;                                                           \
     }                                                                         \
@@ -542,6 +649,7 @@ TAGBYTES(p)
                                valbytes, unpacked)                          \
   FASTDECODE_CHECKPACKED(tagbytes, CARD_r, unpacked)                        \
                                                                             \
+  const char* field_start = ptr;                                            \
   ptr += tagbytes;                                                          \
   int size = (uint8_t)ptr[0];                                               \
   ptr++;                                                                    \
@@ -549,12 +657,17 @@ TAGBYTES(p)
     ptr = fastdecode_longsize(ptr, &size);                                  \
   }                                                                         \
                                                                             \
-  if (UPB_UNLIKELY(!upb_EpsCopyInputStream_CheckDataSizeAvailable(          \
-                       &d->input, ptr, size) ||                             \
-                   (size % valbytes) != 0)) {                               \
+  if (UPB_UNLIKELY((size % valbytes) != 0)) {                               \
     _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);              \
   }                                                                         \
                                                                             \
+  if (UPB_UNLIKELY(!upb_EpsCopyInputStream_CheckDataSizeAvailable(          \
+          &d->input, ptr, size))) {                                         \
+    /* Either malformed or spans buffers, the generic path handles both. */ \
+    ptr = field_start;                                                      \
+    RETURN_GENERIC("packed fixed field not in buffer\n");                   \
+  }                                                                         \
+                                                                            \
   upb_Array** arr_p = fastdecode_fieldmem(msg, data);                       \
   upb_Array* arr = *arr_p;                                                  \
   uint8_t elem_size_lg2 = __builtin_ctz(valbytes);                          \
@@ -565,13 +678,18 @@ TAGBYTES(p)
     if (!arr) {                                                             \
       _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);            \
     }                                                                       \
-  } else {                                                                  \
-    _upb_Array_ResizeUninitialized(arr, elems, &d->arena);                  \
   }                                                                         \
                                                                             \
-  char* dst = _upb_array_ptr(arr);                                          \
+  /* Packed runs for the same field append to each other. */              \
+  size_t old_size = arr->size;                                              \
+  size_t new_size = old_size + elems;                                       \
+  if (UPB_UNLIKELY(                                                         \
+          !_upb_Array_ResizeUninitialized(arr, new_size, &d->arena))) {     \
+    _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);            \
+  }                                                                         \
+                                                                            \
+  char* dst = (char*)_upb_array_ptr(arr) + (old_size << elem_size_lg2);     \
   memcpy(dst, ptr, size);                                                   \
-  arr->size = elems;                                                        \
                                                                             \
   ptr += size;                                                              \
   UPB_MUSTTAIL return fastdecode_dispatch(UPB_PARSE_ARGS);
@@ -649,7 +767,11 @@ static const char* fastdecode_verifyutf8(upb_Decoder* d, const char* ptr,
                                                                                \
   const char* s_ptr = ptr;                                                     \
   ptr = upb_EpsCopyInputStream_ReadString(&d->input, &s_ptr, size, &d->arena); \
-  if (!ptr) _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);       \
+  if (!ptr) {                                                                  \
+    _upb_FastDecoder_ErrorJmp(d, upb_EpsCopyInputStream_IsError(&d->input)     \
+                                     ? kUpb_DecodeStatus_Malformed             \
+                                     : kUpb_DecodeStatus_OutOfMemory);         \
+  }                                                                            \
   dst->data = s_ptr;                                                           \
   dst->size = size;                                                            \
                                                                                \
@@ -749,7 +871,7 @@ static void fastdecode_docopy(upb_Decoder* d, const char* ptr, uint32_t size,
         goto again;                                                            \
       case FD_NEXT_OTHERFIELD:                                                 \
         data = ret.tag;                                                        \
-        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);      \
+        UPB_MUSTTAIL return fastdecode_tagdispatch(UPB_PARSE_ARGS);            \
       case FD_NEXT_ATLIMIT:                                                    \
         return ptr;                                                            \
     }                                                                          \
@@ -803,6 +925,9 @@ static void fastdecode_docopy(upb_Decoder* d, const char* ptr, uint32_t size,
                                                                               \
   if (UPB_UNLIKELY(                                                           \
           !upb_EpsCopyInputStream_AliasingAvailable(&d->input, ptr, size))) { \
+    if (card == CARD_r) {                                                     \
+      fastdecode_commitarr(dst + 1, &farr, sizeof(upb_StringView));           \
+    }                                                                         \
     ptr--;                                                                    \
     if (validate_utf8) {                                                      \
       return fastdecode_longstring_utf8(d, ptr, msg, table, hasbits,          \
@@ -831,7 +956,7 @@ static void fastdecode_docopy(upb_Decoder* d, const char* ptr, uint32_t size,
         goto again;                                                           \
       case FD_NEXT_OTHERFIELD:                                                \
         data = ret.tag;                                                       \
-        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);     \
+        UPB_MUSTTAIL return fastdecode_tagdispatch(UPB_PARSE_ARGS);           \
       case FD_NEXT_ATLIMIT:                                                   \
         return ptr;                                                           \
     }                                                                         \
@@ -914,7 +1039,11 @@ static const char* fastdecode_tosubmsg(upb_EpsCopyInputStream* e,
                                        const char* ptr, void* ctx) {
   upb_Decoder* d = (upb_Decoder*)e;
   fastdecode_submsgdata* submsg = ctx;
+#if UPB_FASTTABLE_TRAMPOLINE
+  ptr = _upb_FastDecoder_Trampoline(d, ptr, submsg->msg, submsg->table);
+#else
   ptr = fastdecode_dispatch(d, ptr, submsg->msg, submsg->table, 0, 0);
+#endif
   UPB_ASSUME(ptr != NULL);
   return ptr;
 }
@@ -926,6 +1055,10 @@ static const char* fastdecode_tosubmsg(upb_EpsCopyInputStream* e,
     RETURN_GENERIC("submessage field tag mismatch\n");                    \
   }                                                                       \
                                                                           \
+  if (UPB_UNLIKELY(d->options & kUpb_DecodeOption_Lazy)) {                \
+    RETURN_GENERIC("lazy submessage\n");                                  \
+  }                                                                       \
+                                                                          \
   if (--d->depth == 0) {                                                  \
     _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_MaxDepthExceeded);     \
   }                                                                       \
@@ -941,6 +1074,16 @@ static const char* fastdecode_tosubmsg(upb_EpsCopyInputStream* e,
     RETURN_GENERIC("submessage doesn't have fast tables.");               \
   }                                                                       \
                                                                           \
+  if (card == CARD_o) {                                                   \
+    /* Until the case names this field, its memory belongs to whichever   \
+     * other oneof member was set last, so it cannot be reused. */        \
+    uint16_t case_ofs = data >> 32;                                       \
+    uint32_t* oneof_case = UPB_PTR_AT(msg, case_ofs, uint32_t);           \
+    if (*oneof_case != ((data >> 24) & 0xff)) {                           \
+      *(upb_Message**)fastdecode_fieldmem(msg, data) = NULL;              \
+    }                                                                     \
+  }                                                                       \
+                                                                          \
   dst = fastdecode_getfield(d, ptr, msg, &data, &hasbits, &farr,          \
                             sizeof(upb_Message*), card);                  \
                                                                           \
@@ -977,7 +1120,7 @@ static const char* fastdecode_tosubmsg(upb_EpsCopyInputStream* e,
       case FD_NEXT_OTHERFIELD:                                            \
         d->depth++;                                                       \
         data = ret.tag;                                                   \
-        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS); \
+        UPB_MUSTTAIL return fastdecode_tagdispatch(UPB_PARSE_ARGS);       \
       case FD_NEXT_ATLIMIT:                                               \
         d->depth++;                                                       \
         return ptr;                                                       \
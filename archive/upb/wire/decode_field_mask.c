@@ -0,0 +1,113 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/decode_field_mask.h"
+
+#include <string.h>
+
+#include "upb/mini_table/field.h"
+#include "upb/wire/internal/decode_field_mask.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+upb_DecodeFieldMask* upb_DecodeFieldMask_New(const upb_MiniTable* m,
+                                             upb_Arena* arena) {
+  size_t n = m->field_count;
+  upb_DecodeFieldMask* mask = upb_Arena_Malloc(arena, sizeof(*mask));
+  bool* selected = upb_Arena_Malloc(arena, n * sizeof(*selected));
+  upb_DecodeFieldMask** sub = upb_Arena_Malloc(arena, n * sizeof(*sub));
+  if (!mask || (n && (!selected || !sub))) return NULL;
+
+  if (n) {
+    memset(selected, 0, n * sizeof(*selected));
+    memset(sub, 0, n * sizeof(*sub));
+  }
+  mask->table = m;
+  mask->selected = selected;
+  mask->sub = sub;
+  return mask;
+}
+
+// Resolves `number` in `m`, returning its field index or -1 if not found.
+static int upb_DecodeFieldMask_FieldIndex(const upb_MiniTable* m,
+                                          uint32_t number) {
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(m, number);
+  return f ? (int)(f - m->fields) : -1;
+}
+
+static bool upb_DecodeFieldMask_IsValidPath(const upb_MiniTable* m,
+                                            const uint32_t* path, size_t len) {
+  if (len == 0) return false;
+  for (size_t i = 0; i < len; i++) {
+    int idx = upb_DecodeFieldMask_FieldIndex(m, path[i]);
+    if (idx < 0) return false;
+    if (i == len - 1) break;
+    const upb_MiniTableField* f = &m->fields[idx];
+    if (upb_MiniTableField_CType(f) != kUpb_CType_Message) return false;
+    m = upb_MiniTable_GetSubMessageTable(m, f);
+    if (!m) return false;
+  }
+  return true;
+}
+
+bool upb_DecodeFieldMask_AddPath(upb_DecodeFieldMask* mask,
+                                 const uint32_t* path, size_t len,
+                                 upb_Arena* arena) {
+  if (!upb_DecodeFieldMask_IsValidPath(mask->table, path, len)) return false;
+
+  for (size_t i = 0; i < len - 1; i++) {
+    int idx = upb_DecodeFieldMask_FieldIndex(mask->table, path[i]);
+    if (mask->selected[idx] && !mask->sub[idx]) {
+      return true;  // The whole sub-message is already selected.
+    }
+    if (!mask->sub[idx]) {
+      const upb_MiniTableField* f = &mask->table->fields[idx];
+      const upb_MiniTable* subl =
+          upb_MiniTable_GetSubMessageTable(mask->table, f);
+      upb_DecodeFieldMask* sub = upb_DecodeFieldMask_New(subl, arena);
+      if (!sub) return false;
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        // Entries are inserted under their key, so it is always decoded.
+        sub->selected[upb_DecodeFieldMask_FieldIndex(subl, 1)] = true;
+      }
+      mask->sub[idx] = sub;
+      mask->selected[idx] = true;
+    }
+    mask = mask->sub[idx];
+  }
+
+  int idx = upb_DecodeFieldMask_FieldIndex(mask->table, path[len - 1]);
+  mask->selected[idx] = true;
+  mask->sub[idx] = NULL;
+  return true;
+}
+
+#include "upb/port/undef.inc"
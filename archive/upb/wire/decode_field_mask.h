@@ -0,0 +1,83 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// A field mask for projected decoding: the set of field paths that
+// upb_DecodeWithFieldMask() should decode.  Paths are given as field numbers
+// and are resolved against upb_MiniTables when they are added, so the decoder
+// only needs an array lookup per field.
+
+#ifndef UPB_WIRE_DECODE_FIELD_MASK_H_
+#define UPB_WIRE_DECODE_FIELD_MASK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "upb/mem/arena.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_DecodeFieldMask upb_DecodeFieldMask;
+
+// Creates an empty mask for messages of type `m`.  Returns NULL if allocation
+// failed.  The mask lives as long as `arena`.
+UPB_API upb_DecodeFieldMask* upb_DecodeFieldMask_New(const upb_MiniTable* m,
+                                                     upb_Arena* arena);
+
+// Adds the field path `path[0].path[1]...path[len-1]`, where each element is a
+// field number of the message reached by the previous elements.  A path that
+// ends at a message field selects the entire sub-message, and paths through
+// repeated and map fields apply to every element.
+//
+// A path through a map field continues with a field of the map entry: 1 for
+// the key or 2 for the value.  The key is selected along with the first such
+// path, so that [map, 2, ...] decodes each entry under its real key rather
+// than under a default one.
+//
+// Returns false without modifying the mask if the path is empty, names a field
+// that does not exist, or continues past a field that is not a linked message
+// field.  Also returns false if allocation failed, in which case the mask may
+// have been partially updated and should be discarded.
+UPB_API bool upb_DecodeFieldMask_AddPath(upb_DecodeFieldMask* mask,
+                                         const uint32_t* path, size_t len,
+                                         upb_Arena* arena);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_FIELD_MASK_H_ */
@@ -0,0 +1,1923 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "upb/wire/decode.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "google/protobuf/descriptor.upb.h"
+#include "upb/base/status.hpp"
+#include "upb/collections/internal/array.h"
+#include "upb/collections/map.h"
+#include "upb/io/chunked_input_stream.h"
+#include "upb/mem/arena.hpp"
+#include "upb/message/accessors.h"
+#include "upb/message/internal/message.h"
+#include "upb/message/message.h"
+#include "upb/message/promote.h"
+#include "upb/mini_descriptor/build_enum.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.hpp"
+#include "upb/mini_descriptor/internal/modifiers.h"
+#include "upb/mini_descriptor/link.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/message.h"
+#include "upb/reflection/def.hpp"
+#include "upb/wire/decode_field_mask.h"
+#include "upb/wire/encode.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+namespace {
+
+// Builds a message that exercises strings, repeated sub-messages and packed
+// fields, so that many different field types end up straddling chunks.
+std::string MakeTestPayload() {
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  google_protobuf_FileDescriptorProto_set_name(
+      file, upb_StringView_FromString("some/path/to/a/file.proto"));
+  google_protobuf_FileDescriptorProto_set_package(
+      file, upb_StringView_FromString("some.package"));
+  for (int i = 0; i < 20; i++) {
+    google_protobuf_DescriptorProto* msg =
+        google_protobuf_FileDescriptorProto_add_message_type(file,
+                                                              arena.ptr());
+    // The setters do not copy string data, so we allocate it on the arena.
+    char* name = static_cast<char*>(upb_Arena_Malloc(arena.ptr(), i * 7 + 1));
+    memset(name, 'a' + i, i * 7);
+    google_protobuf_DescriptorProto_set_name(
+        msg, upb_StringView_FromDataAndSize(name, i * 7));
+    for (int j = 0; j < i; j++) {
+      google_protobuf_FieldDescriptorProto* field =
+          google_protobuf_DescriptorProto_add_field(msg, arena.ptr());
+      google_protobuf_FieldDescriptorProto_set_name(
+          field, upb_StringView_FromDataAndSize(name, j));
+      google_protobuf_FieldDescriptorProto_set_number(field, j * 1000 + 1);
+    }
+  }
+  google_protobuf_SourceCodeInfo* info =
+      google_protobuf_FileDescriptorProto_mutable_source_code_info(file,
+                                                                   arena.ptr());
+  google_protobuf_SourceCodeInfo_Location* loc =
+      google_protobuf_SourceCodeInfo_add_location(info, arena.ptr());
+  int32_t* path = google_protobuf_SourceCodeInfo_Location_resize_path(
+      loc, 100, arena.ptr());
+  for (int i = 0; i < 100; i++) path[i] = i * 12345;
+  size_t size;
+  char* buf = google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(),
+                                                           &size);
+  EXPECT_NE(buf, nullptr);
+  return std::string(buf, size);
+}
+
+// Appends an unknown length-delimited field with the given payload size.
+void AppendUnknownField(std::string* data, int field_number, size_t size) {
+  uint32_t tag = (field_number << 3) | kUpb_WireType_Delimited;
+  while (tag >= 0x80) {
+    data->push_back(static_cast<char>(tag | 0x80));
+    tag >>= 7;
+  }
+  data->push_back(static_cast<char>(tag));
+  size_t len = size;
+  while (len >= 0x80) {
+    data->push_back(static_cast<char>(len | 0x80));
+    len >>= 7;
+  }
+  data->push_back(static_cast<char>(len));
+  for (size_t i = 0; i < size; i++) data->push_back(static_cast<char>(i));
+}
+
+upb_DecodeStatus DecodeFromChunks(const std::string& data, size_t chunk,
+                                  upb_Arena* arena, std::string* reencoded) {
+  upb::Status status;
+  upb_ZeroCopyInputStream* stream =
+      upb_ChunkedInputStream_New(data.data(), data.size(), chunk, arena);
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena);
+  upb_DecodeStatus ret = upb_DecodeFromStream(
+      stream, file, &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0,
+      arena, status.ptr());
+  if (ret == kUpb_DecodeStatus_Ok && reencoded) {
+    size_t size;
+    char* buf = google_protobuf_FileDescriptorProto_serialize(file, arena,
+                                                             &size);
+    reencoded->assign(buf, size);
+  }
+  return ret;
+}
+
+TEST(DecodeFromStreamTest, RoundTrip) {
+  std::string data = MakeTestPayload();
+  ASSERT_GT(data.size(), 1000);
+  for (size_t chunk : {1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 100, 1000, 100000}) {
+    SCOPED_TRACE(chunk);
+    upb::Arena arena;
+    std::string reencoded;
+    EXPECT_EQ(kUpb_DecodeStatus_Ok,
+              DecodeFromChunks(data, chunk, arena.ptr(), &reencoded));
+    EXPECT_EQ(data, reencoded);
+  }
+}
+
+TEST(DecodeFromStreamTest, Empty) {
+  upb::Arena arena;
+  std::string reencoded;
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            DecodeFromChunks("", 10, arena.ptr(), &reencoded));
+  EXPECT_EQ("", reencoded);
+}
+
+TEST(DecodeFromStreamTest, UnknownFieldsSpanningChunks) {
+  std::string data = MakeTestPayload();
+  // The encoder writes unknown fields last, so these will round-trip exactly.
+  AppendUnknownField(&data, 1000, 5);
+  AppendUnknownField(&data, 1001, 300);
+  AppendUnknownField(&data, 1002, 70);
+  for (size_t chunk : {1, 5, 16, 17, 64, 1000}) {
+    SCOPED_TRACE(chunk);
+    upb::Arena arena;
+    std::string reencoded;
+    EXPECT_EQ(kUpb_DecodeStatus_Ok,
+              DecodeFromChunks(data, chunk, arena.ptr(), &reencoded));
+    EXPECT_EQ(data, reencoded);
+  }
+}
+
+TEST(DecodeFromStreamTest, Truncated) {
+  std::string data = MakeTestPayload();
+  AppendUnknownField(&data, 1000, 300);
+  // Every prefix that ends inside the trailing unknown field is malformed.
+  for (size_t len = data.size() - 300; len < data.size(); len += 13) {
+    for (size_t chunk : {1, 16, 17, 1000}) {
+      upb::Arena arena;
+      EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+                DecodeFromChunks(data.substr(0, len), chunk, arena.ptr(),
+                                 nullptr))
+          << len << " " << chunk;
+    }
+  }
+}
+
+// A length prefix is only a claim about data that has not arrived yet, so
+// it must not decide how much memory we allocate.
+TEST(DecodeFromStreamTest, HugeLengthOnShortStream) {
+  // package: a string of 1.75GB, in six bytes of input.
+  const std::string data("\x12\x80\x80\x80\x80\x07", 6);
+  for (size_t chunk : {1, 3, 6}) {
+    SCOPED_TRACE(chunk);
+    upb::Arena arena;
+    EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+              DecodeFromChunks(data, chunk, arena.ptr(), nullptr));
+    EXPECT_LT(upb_Arena_SpaceAllocated(arena.ptr()), 64 * 1024);
+  }
+
+  // The same string, with 100000 bytes of it present.
+  std::string partial = data + std::string(100000, 'x');
+  upb::Arena arena;
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            DecodeFromChunks(partial, 1000, arena.ptr(), nullptr));
+  EXPECT_LT(upb_Arena_SpaceAllocated(arena.ptr()), 1024 * 1024);
+
+  // A packed fixed64 field that claims 1.75GB of elements.
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Fixed64, 1,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  const std::string packed = std::string("\x0a\x80\x80\x80\x80\x07", 6) +
+                             std::string(800, '\x01');
+  upb::Arena packed_arena;
+  upb_ZeroCopyInputStream* stream = upb_ChunkedInputStream_New(
+      packed.data(), packed.size(), 100, packed_arena.ptr());
+  upb_Message* msg = upb_Message_New(table, packed_arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_DecodeFromStream(stream, msg, table, nullptr, 0,
+                                 packed_arena.ptr(), status.ptr()));
+  EXPECT_LT(upb_Arena_SpaceAllocated(packed_arena.ptr()), 64 * 1024);
+}
+
+TEST(DecodeFromStreamTest, MatchesFlatDecode) {
+  std::string data = MakeTestPayload();
+  for (size_t len = 0; len < data.size(); len += 17) {
+    std::string prefix = data.substr(0, len);
+    upb::Arena arena;
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    upb_DecodeStatus expected = upb_Decode(
+        prefix.data(), prefix.size(), file,
+        &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0, arena.ptr());
+    for (size_t chunk : {1, 16, 33}) {
+      EXPECT_EQ(expected,
+                DecodeFromChunks(prefix, chunk, arena.ptr(), nullptr))
+          << len << " " << chunk;
+    }
+  }
+}
+
+upb_DecodeStatus PushDecode(const std::string& data, size_t chunk,
+                            const upb_MiniTable* l, upb_Message* msg,
+                            int options, upb_Arena* arena) {
+  upb_DecoderState* s = upb_DecoderState_New(msg, l, nullptr, options, arena);
+  for (size_t i = 0; i < data.size(); i += chunk) {
+    std::string piece = data.substr(i, chunk);
+    upb_DecodeStatus status = upb_DecoderState_Feed(s, piece.data(),
+                                                    piece.size());
+    // Overwrite the chunk, to verify that the decoder did not hold onto it.
+    piece.assign(piece.size(), 'x');
+    if (status != kUpb_DecodeStatus_Ok) return status;
+  }
+  return upb_DecoderState_Finish(s);
+}
+
+TEST(DecoderStateTest, RoundTrip) {
+  std::string data = MakeTestPayload();
+  // Unknown fields exercise both delimited and group scanning.
+  AppendUnknownField(&data, 1000, 300);
+  data.append("\xc3\x3e\x08\x01\xc4\x3e");  // Group 1000 with a varint.
+  for (size_t chunk : {1, 2, 3, 7, 16, 17, 100, 1000, 100000}) {
+    SCOPED_TRACE(chunk);
+    upb::Arena arena;
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              PushDecode(data, chunk,
+                         &google_protobuf_FileDescriptorProto_msg_init, file,
+                         kUpb_DecodeOption_AliasString, arena.ptr()));
+    size_t size;
+    char* buf =
+        google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(), &size);
+    EXPECT_EQ(data, std::string(buf, size));
+  }
+}
+
+TEST(DecoderStateTest, BuffersOnlyTheIncompleteField) {
+  // 100000 copies of FieldDescriptorProto.number, split inside the first one.
+  std::string data;
+  for (int i = 0; i < 100000; i++) data.append("\x18\x01");
+  upb::Arena arena;
+  google_protobuf_FieldDescriptorProto* field =
+      google_protobuf_FieldDescriptorProto_new(arena.ptr());
+  upb_DecoderState* s = upb_DecoderState_New(
+      field, &google_protobuf_FieldDescriptorProto_msg_init, nullptr, 0,
+      arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_DecoderState_Feed(s, data.data(), 1));
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_DecoderState_Feed(s, data.data() + 1, data.size() - 1));
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, upb_DecoderState_Finish(s));
+  EXPECT_LT(upb_Arena_SpaceAllocated(arena.ptr()), data.size() / 10);
+
+  // Nested groups fed one byte at a time.
+  std::string groups;
+  for (int i = 0; i < 50; i++) groups.append("\xc3\x3e");
+  AppendUnknownField(&groups, 1000, 300);
+  for (int i = 0; i < 50; i++) groups.append("\xc4\x3e");
+  field = google_protobuf_FieldDescriptorProto_new(arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            PushDecode(groups + "\x18\x01", 1,
+                       &google_protobuf_FieldDescriptorProto_msg_init, field, 0,
+                       arena.ptr()));
+  EXPECT_EQ(1, google_protobuf_FieldDescriptorProto_number(field));
+
+  // An END_GROUP that does not match is reported by the decoder.
+  field = google_protobuf_FieldDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            PushDecode("\xc3\x3e\xcb\x3e\xc4\x3e\xcc\x3e", 3,
+                       &google_protobuf_FieldDescriptorProto_msg_init, field, 0,
+                       arena.ptr()));
+}
+
+TEST(DecoderStateTest, BufferIsNotAllocatedFromTheArena) {
+  // A single 1MiB name, fed in small chunks, is buffered whole.
+  std::string data("\x0a\x80\x80\x40", 4);
+  data.append(1 << 20, 'a');
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            PushDecode(data, 4096,
+                       &google_protobuf_FileDescriptorProto_msg_init, file, 0,
+                       arena.ptr()));
+  EXPECT_EQ(1u << 20, google_protobuf_FileDescriptorProto_name(file).size);
+  // Only the copy of the string itself lives in the arena.
+  EXPECT_LT(upb_Arena_SpaceAllocated(arena.ptr()),
+            data.size() + data.size() / 4);
+
+  // A failed Feed() releases the buffer without a call to Finish().
+  file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            PushDecode(std::string("\x0a\x05" "abcde\x0f"), 3,
+                       &google_protobuf_FileDescriptorProto_msg_init, file, 0,
+                       arena.ptr()));
+}
+
+TEST(DecoderStateTest, Truncated) {
+  std::string data = MakeTestPayload();
+  data.append("\xc3\x3e\x08\x01\xc4\x3e");
+  for (size_t len : {data.size() - 1, data.size() - 3, data.size() - 5}) {
+    upb::Arena arena;
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+              PushDecode(data.substr(0, len), 7,
+                         &google_protobuf_FileDescriptorProto_msg_init, file, 0,
+                         arena.ptr()));
+  }
+}
+
+TEST(DecoderStateTest, Malformed) {
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  upb_DecoderState* s = upb_DecoderState_New(
+      file, &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0,
+      arena.ptr());
+  // Wire type 7 is invalid.
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed, upb_DecoderState_Feed(s, "\x0f", 1));
+  // Errors are sticky.
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed, upb_DecoderState_Feed(s, "", 0));
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed, upb_DecoderState_Finish(s));
+}
+
+TEST(DecoderStateTest, RequiredFieldsAreCheckedAtFinish) {
+  const std::string name_part("\x0a\x03" "abc");  // name_part: "abc"
+  const std::string is_extension("\x10\x01");     // is_extension: true
+  for (size_t chunk : {1, 2, 5}) {
+    upb::Arena arena;
+    upb_Message* msg =
+        google_protobuf_UninterpretedOption_NamePart_new(arena.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_Ok,
+              PushDecode(name_part + is_extension, chunk,
+                         &google_protobuf_UninterpretedOption_NamePart_msg_init,
+                         msg, kUpb_DecodeOption_CheckRequired, arena.ptr()));
+    msg = google_protobuf_UninterpretedOption_NamePart_new(arena.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+              PushDecode(name_part, chunk,
+                         &google_protobuf_UninterpretedOption_NamePart_msg_init,
+                         msg, kUpb_DecodeOption_CheckRequired, arena.ptr()));
+  }
+
+  // FileDescriptorProto.options.uninterpreted_option.name, where the
+  // NamePart is missing is_extension.
+  const std::string missing(
+      "\x42\x08"            // options
+      "\xba\x3e\x05"        // uninterpreted_option
+      "\x12\x03\x0a\x01x");  // name { name_part: "x" }
+  upb::Arena arena;
+  upb_Message* file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+            PushDecode(missing, 3,
+                       &google_protobuf_FileDescriptorProto_msg_init, file,
+                       kUpb_DecodeOption_CheckRequired, arena.ptr()));
+}
+
+TEST(LazyDecodeTest, RoundTrip) {
+  std::string data = MakeTestPayload();
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), file,
+                       &google_protobuf_FileDescriptorProto_msg_init, nullptr,
+                       kUpb_DecodeOption_Lazy, arena.ptr()));
+  // Lazy sub-messages are re-encoded from their original bytes.
+  size_t size;
+  char* buf =
+      google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(), &size);
+  EXPECT_EQ(data, std::string(buf, size));
+}
+
+TEST(LazyDecodeTest, SubMessagesAreParsedOnPromotion) {
+  std::string data = MakeTestPayload();
+  // Parsing is a merge, so the second copy of each singular sub-message is
+  // appended to the first.
+  data += data;
+  upb::Arena arena;
+  const upb_MiniTable* l = &google_protobuf_FileDescriptorProto_msg_init;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), file, l, nullptr,
+                       kUpb_DecodeOption_Lazy, arena.ptr()));
+
+  // Repeated field.
+  const upb_MiniTableField* message_type =
+      upb_MiniTable_FindFieldByNumber(l, 4);
+  upb_Array* arr = upb_Message_GetMutableArray(file, message_type);
+  ASSERT_EQ(40, upb_Array_Size(arr));
+  for (size_t i = 0; i < upb_Array_Size(arr); i++) {
+    EXPECT_TRUE(
+        upb_TaggedMessagePtr_IsEmpty(upb_Array_Get(arr, i).tagged_msg_val));
+  }
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Array_PromoteMessages(arr,
+                                      &google_protobuf_DescriptorProto_msg_init,
+                                      0, arena.ptr()));
+  size_t n;
+  const google_protobuf_DescriptorProto* const* msgs =
+      google_protobuf_FileDescriptorProto_message_type(file, &n);
+  ASSERT_EQ(40, n);
+  EXPECT_EQ(3 * 7, google_protobuf_DescriptorProto_name(msgs[23]).size);
+  google_protobuf_DescriptorProto_field(msgs[23], &n);
+  EXPECT_EQ(3, n);
+
+  // Singular field.
+  const upb_MiniTableField* source_code_info =
+      upb_MiniTable_FindFieldByNumber(l, 9);
+  EXPECT_TRUE(upb_TaggedMessagePtr_IsEmpty(
+      upb_Message_GetTaggedMessagePtr(file, source_code_info, nullptr)));
+  upb_Message* promoted;
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Message_PromoteMessage(file, l, source_code_info, 0,
+                                       arena.ptr(), &promoted));
+  google_protobuf_SourceCodeInfo_location(
+      (google_protobuf_SourceCodeInfo*)promoted, &n);
+  EXPECT_EQ(2, n);
+}
+
+TEST(LazyDecodeTest, AliasesInputWithAliasString) {
+  std::string data = MakeTestPayload();
+  uintptr_t begin = reinterpret_cast<uintptr_t>(data.data());
+  uintptr_t end = begin + data.size();
+  for (int options : {0, static_cast<int>(kUpb_DecodeOption_AliasString)}) {
+    SCOPED_TRACE(options);
+    upb::Arena arena;
+    const upb_MiniTable* l = &google_protobuf_FileDescriptorProto_msg_init;
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), file, l, nullptr,
+                         kUpb_DecodeOption_Lazy | options, arena.ptr()));
+    const upb_Array* arr =
+        upb_Message_GetArray(file, upb_MiniTable_FindFieldByNumber(l, 4));
+    ASSERT_EQ(20, upb_Array_Size(arr));
+    for (size_t i = 0; i < upb_Array_Size(arr); i++) {
+      upb_TaggedMessagePtr tagged = upb_Array_Get(arr, i).tagged_msg_val;
+      ASSERT_TRUE(upb_TaggedMessagePtr_IsEmpty(tagged));
+      upb_StringView chunk;
+      uintptr_t iter = kUpb_Message_UnknownBegin;
+      ASSERT_TRUE(upb_Message_NextUnknown(
+          _upb_TaggedMessagePtr_GetEmptyMessage(tagged), &chunk, &iter));
+      uintptr_t ptr = reinterpret_cast<uintptr_t>(chunk.data);
+      EXPECT_EQ(options != 0, begin <= ptr && ptr + chunk.size <= end);
+    }
+  }
+}
+
+upb_DecodeFieldMask* MakeMask(
+    std::initializer_list<std::initializer_list<uint32_t>> paths,
+    upb_Arena* arena) {
+  upb_DecodeFieldMask* mask = upb_DecodeFieldMask_New(
+      &google_protobuf_FileDescriptorProto_msg_init, arena);
+  for (const auto& path : paths) {
+    EXPECT_TRUE(
+        upb_DecodeFieldMask_AddPath(mask, path.begin(), path.size(), arena));
+  }
+  return mask;
+}
+
+google_protobuf_FileDescriptorProto* DecodeWithMask(
+    const std::string& data, const upb_DecodeFieldMask* mask,
+    upb_Arena* arena) {
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena);
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            upb_DecodeWithFieldMask(
+                data.data(), data.size(), file,
+                &google_protobuf_FileDescriptorProto_msg_init, mask, nullptr,
+                0, arena));
+  return file;
+}
+
+TEST(FieldMaskDecodeTest, SkipsUnselectedFields) {
+  std::string data = MakeTestPayload();
+  AppendUnknownField(&data, 1000, 500);
+  upb::Arena arena;
+  // name, message_type.name
+  upb_DecodeFieldMask* mask = MakeMask({{1}, {4, 1}}, arena.ptr());
+  google_protobuf_FileDescriptorProto* file =
+      DecodeWithMask(data, mask, arena.ptr());
+
+  size_t n;
+  EXPECT_EQ("some/path/to/a/file.proto",
+            std::string(google_protobuf_FileDescriptorProto_name(file).data,
+                        google_protobuf_FileDescriptorProto_name(file).size));
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_package(file));
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_source_code_info(file));
+  upb_Message_GetUnknown(file, &n);
+  EXPECT_EQ(0, n);
+
+  const google_protobuf_DescriptorProto* const* msgs =
+      google_protobuf_FileDescriptorProto_message_type(file, &n);
+  ASSERT_EQ(20, n);
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(i * 7, google_protobuf_DescriptorProto_name(msgs[i]).size);
+    google_protobuf_DescriptorProto_field(msgs[i], &n);
+    EXPECT_EQ(0, n);
+    upb_Message_GetUnknown(msgs[i], &n);
+    EXPECT_EQ(0, n);
+  }
+}
+
+TEST(FieldMaskDecodeTest, SelectsWholeSubMessage) {
+  std::string data = MakeTestPayload();
+  upb::Arena arena;
+  // source_code_info, and message_type both in part and as a whole.
+  upb_DecodeFieldMask* mask = MakeMask({{9}, {4, 1}, {4}, {4, 2}}, arena.ptr());
+  google_protobuf_FileDescriptorProto* file =
+      DecodeWithMask(data, mask, arena.ptr());
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_name(file));
+
+  // Everything else round-trips, since it was decoded in full.
+  google_protobuf_FileDescriptorProto_set_name(
+      file, upb_StringView_FromString("some/path/to/a/file.proto"));
+  google_protobuf_FileDescriptorProto_set_package(
+      file, upb_StringView_FromString("some.package"));
+  size_t size;
+  char* buf =
+      google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(), &size);
+  EXPECT_EQ(data, std::string(buf, size));
+}
+
+TEST(FieldMaskDecodeTest, PackedFieldInRepeatedSubMessage) {
+  std::string data = MakeTestPayload();
+  upb::Arena arena;
+  // source_code_info.location.path
+  upb_DecodeFieldMask* mask = MakeMask({{9, 1, 1}}, arena.ptr());
+  google_protobuf_FileDescriptorProto* file =
+      DecodeWithMask(data, mask, arena.ptr());
+  size_t n;
+  google_protobuf_FileDescriptorProto_message_type(file, &n);
+  EXPECT_EQ(0, n);
+  const google_protobuf_SourceCodeInfo_Location* const* locs =
+      google_protobuf_SourceCodeInfo_location(
+          google_protobuf_FileDescriptorProto_source_code_info(file), &n);
+  ASSERT_EQ(1, n);
+  const int32_t* path =
+      google_protobuf_SourceCodeInfo_Location_path(locs[0], &n);
+  ASSERT_EQ(100, n);
+  EXPECT_EQ(99 * 12345, path[99]);
+}
+
+TEST(FieldMaskDecodeTest, EmptyMaskStillValidatesInput) {
+  std::string data = MakeTestPayload();
+  data.resize(data.size() - 1);
+  upb::Arena arena;
+  upb_DecodeFieldMask* mask = MakeMask({}, arena.ptr());
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_DecodeWithFieldMask(
+                data.data(), data.size(), file,
+                &google_protobuf_FileDescriptorProto_msg_init, mask, nullptr,
+                0, arena.ptr()));
+}
+
+TEST(FieldMaskDecodeTest, InvalidPaths) {
+  upb::Arena arena;
+  upb_DecodeFieldMask* mask = MakeMask({}, arena.ptr());
+  const uint32_t unknown_field[] = {99};
+  const uint32_t through_string[] = {1, 1};
+  const uint32_t unknown_sub_field[] = {4, 99};
+  EXPECT_FALSE(upb_DecodeFieldMask_AddPath(mask, nullptr, 0, arena.ptr()));
+  EXPECT_FALSE(upb_DecodeFieldMask_AddPath(mask, unknown_field, 1,
+                                           arena.ptr()));
+  EXPECT_FALSE(upb_DecodeFieldMask_AddPath(mask, through_string, 2,
+                                           arena.ptr()));
+  EXPECT_FALSE(upb_DecodeFieldMask_AddPath(mask, unknown_sub_field, 2,
+                                           arena.ptr()));
+
+  // Failed paths leave the mask empty.
+  std::string data = MakeTestPayload();
+  google_protobuf_FileDescriptorProto* file =
+      DecodeWithMask(data, mask, arena.ptr());
+  size_t size;
+  google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(), &size);
+  EXPECT_EQ(0, size);
+}
+
+TEST(FieldMaskDecodeTest, MapValuePathKeepsKeys) {
+  upb::Arena arena;
+  upb::Status status;
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Message, 1, kUpb_FieldModifier_IsRepeated);
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  upb::MtDataEncoder entry;
+  entry.EncodeMap(kUpb_FieldType_Int32, kUpb_FieldType_Int32, 0, 0);
+  upb_MiniTable* entry_table =
+      upb_MiniTable_Build(entry.data().data(), entry.data().size(),
+                          arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, entry_table) << status.error_message();
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(table, 1);
+  ASSERT_TRUE(upb_MiniTable_SetSubMessage(
+      table, const_cast<upb_MiniTableField*>(f), entry_table));
+
+  // [map, value] selects the key as well.
+  upb_DecodeFieldMask* mask = upb_DecodeFieldMask_New(table, arena.ptr());
+  const uint32_t value_path[] = {1, 2};
+  ASSERT_TRUE(upb_DecodeFieldMask_AddPath(mask, value_path, 2, arena.ptr()));
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_DecodeWithFieldMask(
+                "\x0a\x04\x08\x01\x10\x02\x0a\x04\x08\x03\x10\x04", 12, msg,
+                table, mask, nullptr, 0, arena.ptr()));
+  const upb_Map* map = upb_Message_GetMap(msg, f);
+  ASSERT_NE(nullptr, map);
+  EXPECT_EQ(2, upb_Map_Size(map));
+  upb_MessageValue key, val;
+  key.int32_val = 3;
+  ASSERT_TRUE(upb_Map_Get(map, key, &val));
+  EXPECT_EQ(4, val.int32_val);
+}
+
+// When the fast decoder is enabled, every field is parsed by a separate
+// function, and these must not each consume stack, even in debug builds.
+TEST(FastDecodeTest, ManyFieldsDoNotConsumeStack) {
+  // Alternate between two repeated fields so that each run of one field ends
+  // by dispatching to the other.  The encoder would group them by field.
+  const int kCount = 1 << 20;
+  std::string data;
+  for (int i = 0; i < kCount; i++) {
+    data.append("\x1a\x01x", 3);  // dependency: "x"
+    data.append("\x50\x01", 2);   // public_dependency: 1
+  }
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* parsed =
+      google_protobuf_FileDescriptorProto_parse(data.data(), data.size(),
+                                                arena.ptr());
+  ASSERT_NE(nullptr, parsed);
+  size_t n;
+  google_protobuf_FileDescriptorProto_dependency(parsed, &n);
+  EXPECT_EQ(kCount, n);
+  google_protobuf_FileDescriptorProto_public_dependency(parsed, &n);
+  EXPECT_EQ(kCount, n);
+}
+
+// MiniTables built at runtime get fast tables just like generated ones.
+TEST(RuntimeMiniTableTest, DecodesEveryFastFieldKind) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Int32, 1, 0);
+  e.PutField(kUpb_FieldType_String, 2, 0);
+  e.PutField(kUpb_FieldType_SInt64, 3,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  e.PutField(kUpb_FieldType_Message, 4, kUpb_FieldModifier_IsRepeated);
+  e.PutField(kUpb_FieldType_Bool, 5, 0);
+  e.PutField(kUpb_FieldType_Bytes, 6, 0);
+  e.PutField(kUpb_FieldType_Fixed64, 100, 0);
+  e.StartOneof();
+  e.PutOneofField(5);
+  e.PutOneofField(6);
+
+  upb::Arena arena;
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  upb_MiniTableField* submsg_field = const_cast<upb_MiniTableField*>(
+      upb_MiniTable_FindFieldByNumber(table, 4));
+  ASSERT_TRUE(upb_MiniTable_SetSubMessage(table, submsg_field, table));
+#if UPB_FASTTABLE
+  EXPECT_NE(static_cast<uint8_t>(-1), table->table_mask);
+#endif
+
+  const char data[] =
+      "\x08\x96\x01"                              // 1: 150
+      "\x12\x02hi"                                 // 2: "hi"
+      "\x1a\x03\x02\x01\x04"                       // 3: [1, -1, 2]
+      "\x22\x07\x08\x07\x22\x03\x12\x01x"            // 4: {1: 7, 4: {2: "x"}}
+      "\x22\x00"                                   // 4: {}
+      "\x28\x01"                                   // 5: true
+      "\x32\x01\xff"                               // 6: "\xff"
+      "\xa1\x06\x01\x02\x03\x04\x05\x06\x07\x08"      // 100: 0x0807060504030201
+      "\x38\x05";                                  // 7: 5 (unknown)
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data, sizeof(data) - 1, msg, table,
+                                             nullptr, 0, arena.ptr()));
+
+  auto field = [&](uint32_t number) {
+    return upb_MiniTable_FindFieldByNumber(table, number);
+  };
+  EXPECT_EQ(150, upb_Message_GetInt32(msg, field(1), 0));
+  EXPECT_EQ("hi", std::string(upb_Message_GetString(
+                                  msg, field(2), upb_StringView())
+                                  .data,
+                              2));
+  const upb_Array* arr = upb_Message_GetArray(msg, field(3));
+  ASSERT_EQ(3, upb_Array_Size(arr));
+  EXPECT_EQ(-1, upb_Array_Get(arr, 1).int64_val);
+  EXPECT_EQ(2, upb_Array_Get(arr, 2).int64_val);
+  arr = upb_Message_GetArray(msg, field(4));
+  ASSERT_EQ(2, upb_Array_Size(arr));
+  const upb_Message* sub = upb_Array_Get(arr, 0).msg_val;
+  EXPECT_EQ(7, upb_Message_GetInt32(sub, field(1), 0));
+  const upb_Array* subarr = upb_Message_GetArray(sub, field(4));
+  ASSERT_EQ(1, upb_Array_Size(subarr));
+  EXPECT_EQ(1, upb_Message_GetString(upb_Array_Get(subarr, 0).msg_val,
+                                     field(2), upb_StringView())
+                   .size);
+  EXPECT_EQ(6, upb_Message_WhichOneofFieldNumber(msg, field(6)));
+  EXPECT_EQ(0x0807060504030201u, upb_Message_GetUInt64(msg, field(100), 0));
+  size_t n;
+  upb_Message_GetUnknown(msg, &n);
+  EXPECT_EQ(2, n);
+}
+
+// A oneof sub-message must not reuse memory last written by another member
+// of the oneof.
+TEST(RuntimeMiniTableTest, OneofSubMessageAfterOtherMember) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Int64, 1, 0);
+  e.PutField(kUpb_FieldType_Message, 2, 0);
+  e.StartOneof();
+  e.PutOneofField(1);
+  e.PutOneofField(2);
+
+  upb::Arena arena;
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  const upb_MiniTableField* a = upb_MiniTable_FindFieldByNumber(table, 1);
+  const upb_MiniTableField* m = upb_MiniTable_FindFieldByNumber(table, 2);
+  ASSERT_TRUE(upb_MiniTable_SetSubMessage(
+      table, const_cast<upb_MiniTableField*>(m), table));
+
+  const char data[] =
+      "\x08\xc1\x82\x85\x8a\x94\x08"  // 1: 0x4141414141
+      "\x12\x02\x08\x01";             // 2: {1: 1}
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data, sizeof(data) - 1, msg, table,
+                                             nullptr, 0, arena.ptr()));
+  EXPECT_EQ(2, upb_Message_WhichOneofFieldNumber(msg, m));
+  const upb_Message* sub = upb_Message_GetMessage(msg, m, nullptr);
+  ASSERT_NE(nullptr, sub);
+  EXPECT_EQ(1, upb_Message_GetInt64(sub, a, 0));
+}
+
+// A repeated message field only becomes a map when it is linked, after its
+// fast table entry was built.
+TEST(RuntimeMiniTableTest, MapLinkedAfterBuild) {
+  upb::Arena arena;
+  upb::Status status;
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Message, 1, kUpb_FieldModifier_IsRepeated);
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  upb::MtDataEncoder entry;
+  entry.EncodeMap(kUpb_FieldType_Int32, kUpb_FieldType_Int32, 0, 0);
+  upb_MiniTable* entry_table =
+      upb_MiniTable_Build(entry.data().data(), entry.data().size(),
+                          arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, entry_table) << status.error_message();
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(table, 1);
+  ASSERT_TRUE(upb_MiniTable_SetSubMessage(
+      table, const_cast<upb_MiniTableField*>(f), entry_table));
+
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode("\x0a\x04\x08\x01\x10\x02\x0a\x04\x08\x03\x10\x04",
+                       12, msg, table, nullptr, 0, arena.ptr()));
+  const upb_Map* map = upb_Message_GetMap(msg, f);
+  ASSERT_NE(nullptr, map);
+  EXPECT_EQ(2, upb_Map_Size(map));
+  upb_MessageValue key, val;
+  key.int32_val = 3;
+  ASSERT_TRUE(upb_Map_Get(map, key, &val));
+  EXPECT_EQ(4, val.int32_val);
+}
+
+// Strings too long for the one-byte length fast path take a slower path, which
+// must keep the elements that were already parsed in the same run.
+TEST(RuntimeMiniTableTest, LongAliasedStringInRepeatedField) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Bytes, 1, kUpb_FieldModifier_IsRepeated);
+  upb::Arena arena;
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(table, 1);
+
+  std::string data("\x0a\x01x\x0a\xc8\x01", 6);
+  data.append(200, 'y');
+  data.append("\x0a\x01z", 3);
+  for (int options : {0, static_cast<int>(kUpb_DecodeOption_AliasString)}) {
+    upb_Message* msg = upb_Message_New(table, arena.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), msg, table, nullptr,
+                         options, arena.ptr()));
+    const upb_Array* arr = upb_Message_GetArray(msg, f);
+    ASSERT_EQ(3, upb_Array_Size(arr));
+    EXPECT_EQ(1, upb_Array_Get(arr, 0).str_val.size);
+    EXPECT_EQ(200, upb_Array_Get(arr, 1).str_val.size);
+    EXPECT_EQ(1, upb_Array_Get(arr, 2).str_val.size);
+  }
+}
+
+// A packed field may appear more than once, and each run appends to the
+// elements parsed so far.
+TEST(RuntimeMiniTableTest, PackedFixedRunsAppend) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Fixed32, 1,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  e.PutField(kUpb_FieldType_Int32, 2, 0);
+  upb::Arena arena;
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(table, 1);
+
+  const char data[] =
+      "\x0a\x04\x01\x00\x00\x00"                  // 1: [1]
+      "\x10\x05"                                  // 2: 5
+      "\x0a\x08\x02\x00\x00\x00\x03\x00\x00\x00"  // 1: [2, 3]
+      "\x0d\x04\x00\x00\x00";                     // 1: 4 (unpacked)
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data, sizeof(data) - 1, msg, table,
+                                             nullptr, 0, arena.ptr()));
+  const upb_Array* arr = upb_Message_GetArray(msg, f);
+  ASSERT_EQ(4, upb_Array_Size(arr));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(i + 1, upb_Array_Get(arr, i).uint32_val);
+  }
+}
+
+void AppendVarint(std::string* out, uint64_t val) {
+  while (val >= 0x80) {
+    out->push_back(static_cast<char>(val | 0x80));
+    val >>= 7;
+  }
+  out->push_back(static_cast<char>(val));
+}
+
+// Returns wire values that alternate between long runs of one-byte varints
+// and stretches of every width from one to ten bytes.
+std::vector<uint64_t> MixedWidthVarints(size_t n) {
+  std::mt19937_64 rng(n);
+  std::vector<uint64_t> vals;
+  for (size_t i = 0; i < n; i++) {
+    if ((i / 50) % 2 == 0) {
+      vals.push_back(rng() & 0x7f);
+    } else {
+      int bits = 7 * (1 + rng() % 10);
+      vals.push_back(bits >= 64 ? rng() | (1ULL << 63)
+                                : rng() & ((1ULL << bits) - 1));
+    }
+  }
+  return vals;
+}
+
+class PackedVarintTest : public ::testing::Test {
+ protected:
+  static constexpr uint64_t kEnumValues[] = {0, 1, 5, 100};
+
+  void SetUp() override {
+    upb::MtDataEncoder e;
+    e.StartEnum();
+    for (uint64_t v : kEnumValues) e.PutEnumValue(v);
+    e.EndEnum();
+    upb_MiniTableEnum* enum_table = upb_MiniTableEnum_Build(
+        e.data().data(), e.data().size(), arena_.ptr(), nullptr);
+    ASSERT_NE(nullptr, enum_table);
+
+    upb::MtDataEncoder m;
+    m.StartMessage(0);
+    for (uint32_t i = 0; i < kTypes.size(); i++) {
+      uint64_t mod =
+          kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked;
+      if (kTypes[i] == kUpb_FieldType_Enum) {
+        mod |= kUpb_FieldModifier_IsClosedEnum;
+      }
+      m.PutField(kTypes[i], i + 1, mod);
+    }
+    table_ = upb_MiniTable_Build(m.data().data(), m.data().size(),
+                                 arena_.ptr(), nullptr);
+    ASSERT_NE(nullptr, table_);
+    upb_MiniTableField* enum_field = const_cast<upb_MiniTableField*>(
+        upb_MiniTable_FindFieldByNumber(table_, kTypes.size()));
+    ASSERT_TRUE(upb_MiniTable_SetSubEnum(table_, enum_field, enum_table));
+  }
+
+  // Returns how the decoder should represent wire value `val` for field
+  // `num`, or false if it belongs in the unknown fields instead.
+  bool Expected(uint32_t num, uint64_t val, uint64_t* out) {
+    switch (kTypes[num - 1]) {
+      case kUpb_FieldType_Int32:
+      case kUpb_FieldType_UInt32:
+        *out = static_cast<uint32_t>(val);
+        return true;
+      case kUpb_FieldType_SInt32: {
+        uint32_t n = val;
+        *out = static_cast<uint32_t>((n >> 1) ^ -(n & 1));
+        return true;
+      }
+      case kUpb_FieldType_SInt64:
+        *out = (val >> 1) ^ -(val & 1);
+        return true;
+      case kUpb_FieldType_Bool:
+        *out = val != 0;
+        return true;
+      case kUpb_FieldType_Enum:
+        *out = static_cast<uint32_t>(val);
+        for (uint64_t v : kEnumValues) {
+          if (v == *out) return true;
+        }
+        return false;
+      default:
+        *out = val;
+        return true;
+    }
+  }
+
+  uint64_t Element(const upb_Array* arr, uint32_t num, size_t i) {
+    upb_MessageValue v = upb_Array_Get(arr, i);
+    switch (kTypes[num - 1]) {
+      case kUpb_FieldType_Int32:
+      case kUpb_FieldType_UInt32:
+      case kUpb_FieldType_SInt32:
+      case kUpb_FieldType_Enum:
+        return v.uint32_val;
+      case kUpb_FieldType_Bool:
+        return v.bool_val;
+      default:
+        return v.uint64_val;
+    }
+  }
+
+  // Encodes `vals` as the packed field `num`, decodes it from `chunk`-byte
+  // pieces (or from a flat buffer if `chunk` is 0) and checks every element.
+  void RoundTrip(uint32_t num, const std::vector<uint64_t>& vals,
+                 size_t chunk) {
+    std::string body;
+    for (uint64_t v : vals) AppendVarint(&body, v);
+    std::string data;
+    AppendVarint(&data, (num << 3) | kUpb_WireType_Delimited);
+    AppendVarint(&data, body.size());
+    data += body;
+
+    upb::Arena arena;
+    upb_Message* msg = upb_Message_New(table_, arena.ptr());
+    upb_DecodeStatus status;
+    if (chunk == 0) {
+      status = upb_Decode(data.data(), data.size(), msg, table_, nullptr, 0,
+                          arena.ptr());
+    } else {
+      upb::Status stream_status;
+      upb_ZeroCopyInputStream* stream = upb_ChunkedInputStream_New(
+          data.data(), data.size(), chunk, arena.ptr());
+      status = upb_DecodeFromStream(stream, msg, table_, nullptr, 0,
+                                    arena.ptr(), stream_status.ptr());
+    }
+    ASSERT_EQ(kUpb_DecodeStatus_Ok, status);
+
+    const upb_MiniTableField* field =
+        upb_MiniTable_FindFieldByNumber(table_, num);
+    const upb_Array* arr = upb_Message_GetArray(msg, field);
+    ASSERT_NE(nullptr, arr);
+    size_t j = 0;
+    for (size_t i = 0; i < vals.size(); i++) {
+      uint64_t want;
+      if (!Expected(num, vals[i], &want)) continue;
+      ASSERT_LT(j, upb_Array_Size(arr));
+      ASSERT_EQ(want, Element(arr, num, j))
+          << "field " << num << " index " << i;
+      j++;
+    }
+    EXPECT_EQ(j, upb_Array_Size(arr));
+  }
+
+  static constexpr std::array<upb_FieldType, 8> kTypes = {
+      kUpb_FieldType_Int32,  kUpb_FieldType_Int64,  kUpb_FieldType_UInt32,
+      kUpb_FieldType_UInt64, kUpb_FieldType_SInt32, kUpb_FieldType_SInt64,
+      kUpb_FieldType_Bool,   kUpb_FieldType_Enum,
+  };
+
+  upb::Arena arena_;
+  upb_MiniTable* table_;
+};
+
+TEST_F(PackedVarintTest, AllTypesAllWidths) {
+  std::vector<uint64_t> vals = MixedWidthVarints(2000);
+  // Make sure the closed enum sees both known and unknown values.
+  for (size_t i = 0; i < vals.size(); i += 7) vals[i] = kEnumValues[i % 4];
+  for (uint32_t num = 1; num <= kTypes.size(); num++) {
+    RoundTrip(num, vals, 0);
+  }
+}
+
+TEST_F(PackedVarintTest, ShortFields) {
+  // Shorter than any SIMD vector, so these exercise the scalar tails.
+  std::vector<uint64_t> vals = MixedWidthVarints(100);
+  for (size_t n = 0; n < 40; n++) {
+    std::vector<uint64_t> prefix(vals.begin() + 40, vals.begin() + 40 + n);
+    for (uint32_t num = 1; num <= kTypes.size(); num++) {
+      RoundTrip(num, prefix, 0);
+    }
+  }
+}
+
+TEST_F(PackedVarintTest, AcrossBufferBoundaries) {
+  std::vector<uint64_t> vals = MixedWidthVarints(500);
+  for (size_t chunk : {1, 3, 17, 64, 1000}) {
+    for (uint32_t num = 1; num <= kTypes.size(); num++) {
+      RoundTrip(num, vals, chunk);
+    }
+  }
+}
+
+TEST_F(PackedVarintTest, Malformed) {
+  upb::Arena arena;
+  upb_Message* msg = upb_Message_New(table_, arena.ptr());
+  // 32 one-byte values followed by an eleven-byte varint.
+  std::string body(32, '\x01');
+  body += std::string(10, '\x80') + "\x01";
+  std::string data = "\x12";
+  AppendVarint(&data, body.size());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_Decode((data + body).data(), data.size() + body.size(), msg,
+                       table_, nullptr, 0, arena.ptr()));
+
+  // The field's length cuts the last varint in half.
+  body.assign(40, '\x01');
+  body += "\x80\x80";
+  data = "\x12";
+  AppendVarint(&data, body.size() - 1);
+  data += body;
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_Decode(data.data(), data.size(), msg, table_, nullptr, 0,
+                       arena.ptr()));
+}
+
+// Repeated fields are sized up front for the elements that follow, rather
+// than growing (and leaving dead copies in the arena) as they are decoded.
+TEST(PresizeTest, ArraysAreSizedExactly) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_String, 1, kUpb_FieldModifier_IsRepeated);
+  e.PutField(kUpb_FieldType_Int32, 2, kUpb_FieldModifier_IsRepeated);
+  e.PutField(kUpb_FieldType_Fixed64, 3, kUpb_FieldModifier_IsRepeated);
+  e.PutField(kUpb_FieldType_Int64, 4,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  upb::Arena arena;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), nullptr);
+  ASSERT_NE(nullptr, table);
+
+  std::string data;
+  for (int i = 0; i < 1000; i++) data += "\x0a\x02hi";
+  for (int i = 0; i < 500; i++) {
+    data += "\x10";
+    AppendVarint(&data, i * 100);
+  }
+  for (int i = 0; i < 300; i++) data += "\x19" + std::string(8, 'x');
+  std::string packed;
+  for (uint64_t v : MixedWidthVarints(700)) AppendVarint(&packed, v);
+  data += "\x22";
+  AppendVarint(&data, packed.size());
+  data += packed;
+
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                             table, nullptr, 0, arena.ptr()));
+  const size_t kCounts[] = {1000, 500, 300, 700};
+  for (uint32_t num = 1; num <= 4; num++) {
+    const upb_Array* arr = upb_Message_GetArray(
+        msg, upb_MiniTable_FindFieldByNumber(table, num));
+    ASSERT_NE(nullptr, arr);
+    EXPECT_EQ(kCounts[num - 1], upb_Array_Size(arr)) << num;
+    EXPECT_EQ(kCounts[num - 1], arr->capacity) << num;
+  }
+}
+
+TEST(PresizeTest, InterleavedFields) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Int32, 1, kUpb_FieldModifier_IsRepeated);
+  e.PutField(kUpb_FieldType_Int32, 2, kUpb_FieldModifier_IsRepeated);
+  upb::Arena arena;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), nullptr);
+  ASSERT_NE(nullptr, table);
+
+  // Only the first run of each field can be counted ahead; later runs must
+  // still grow the array correctly.
+  std::string data;
+  for (int run = 0; run < 20; run++) {
+    for (int i = 0; i < run; i++) data += "\x08\x01";
+    data += "\x10\x02";
+  }
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                             table, nullptr, 0, arena.ptr()));
+  EXPECT_EQ(190, upb_Array_Size(upb_Message_GetArray(
+                     msg, upb_MiniTable_FindFieldByNumber(table, 1))));
+  EXPECT_EQ(20, upb_Array_Size(upb_Message_GetArray(
+                    msg, upb_MiniTable_FindFieldByNumber(table, 2))));
+}
+
+TEST(SparseFieldTest, DecodesFieldsInAnyOrder) {
+  std::vector<uint32_t> numbers = {1, 2};
+  for (uint32_t n = 1000; n < 5000; n += 97) numbers.push_back(n);
+  numbers.push_back(536870911);  // Max field number.
+
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  for (uint32_t n : numbers) e.PutField(kUpb_FieldType_Int32, n, 0);
+  upb::Arena arena;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), nullptr);
+  ASSERT_NE(nullptr, table);
+  ASSERT_NE(nullptr, table->field_hash);
+
+  for (uint32_t n : numbers) {
+    const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(table, n);
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(n, f->number);
+  }
+  for (uint32_t n : {0u, 3u, 999u, 1001u, 4999u, 536870910u}) {
+    EXPECT_EQ(nullptr, upb_MiniTable_FindFieldByNumber(table, n)) << n;
+  }
+
+  // Reverse order defeats the decoder's resume hint. Interleave unknown fields
+  // whose numbers fall between the known ones.
+  std::string data;
+  for (auto it = numbers.rbegin(); it != numbers.rend(); ++it) {
+    const uint32_t unknown = *it == numbers.back() ? *it - 3 : *it + 3;
+    AppendVarint(&data, *it << 3);
+    AppendVarint(&data, *it % 1000);
+    AppendVarint(&data, unknown << 3);
+    AppendVarint(&data, 7);
+  }
+  upb_Message* msg = upb_Message_New(table, arena.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                             table, nullptr, 0, arena.ptr()));
+  for (uint32_t n : numbers) {
+    EXPECT_EQ(n % 1000, upb_Message_GetInt32(
+                            msg, upb_MiniTable_FindFieldByNumber(table, n), -1))
+        << n;
+  }
+  size_t unknown_size;
+  upb_Message_GetUnknown(msg, &unknown_size);
+  EXPECT_LT(0, unknown_size);
+}
+
+TEST(SparseFieldTest, FewSparseFieldsAreNotHashed) {
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  e.PutField(kUpb_FieldType_Int32, 1, 0);
+  e.PutField(kUpb_FieldType_Int32, 1000, 0);
+  e.PutField(kUpb_FieldType_Int32, 2000, 0);
+  upb::Arena arena;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), nullptr);
+  ASSERT_NE(nullptr, table);
+  EXPECT_EQ(nullptr, table->field_hash);
+  EXPECT_NE(nullptr, upb_MiniTable_FindFieldByNumber(table, 2000));
+}
+
+class AliasUnknownTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    upb::MtDataEncoder e;
+    e.StartMessage(0);
+    e.PutField(kUpb_FieldType_Int32, 1, 0);
+    e.PutField(kUpb_FieldType_String, 3, 0);
+    table_ = upb_MiniTable_Build(e.data().data(), e.data().size(), arena_.ptr(),
+                                 nullptr);
+    ASSERT_NE(nullptr, table_);
+
+    // Known fields 1 and 3, interleaved with unknown fields 2, 100 and 4.
+    data_ = std::string("\x08\x01"         // 1: 1
+                        "\x10\x02"         // 2: 2
+                        "\xa2\x06\x03xyz"  // 100: "xyz"
+                        "\x1a\x01x"        // 3: "x"
+                        "\x25\x01\x02\x03\x04",  // 4: fixed32
+                        18);
+  }
+
+  upb_Message* Parse(const std::string& data, int options) {
+    upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), msg, table_, nullptr,
+                         options, arena_.ptr()));
+    return msg;
+  }
+
+  std::string Serialize(const upb_Message* msg) {
+    char* buf;
+    size_t size;
+    EXPECT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, table_, 0, arena_.ptr(), &buf, &size));
+    return std::string(buf, size);
+  }
+
+  static std::vector<upb_StringView> Chunks(const upb_Message* msg) {
+    std::vector<upb_StringView> chunks;
+    upb_StringView chunk;
+    uintptr_t iter = kUpb_Message_UnknownBegin;
+    while (upb_Message_NextUnknown(msg, &chunk, &iter)) chunks.push_back(chunk);
+    return chunks;
+  }
+
+  static bool Within(const std::string& data, upb_StringView chunk) {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data.data());
+    uintptr_t ptr = reinterpret_cast<uintptr_t>(chunk.data);
+    return begin <= ptr && ptr + chunk.size <= begin + data.size();
+  }
+
+  upb::Arena arena_;
+  upb_MiniTable* table_;
+  std::string data_;
+};
+
+TEST_F(AliasUnknownTest, AliasesInputBuffer) {
+  upb_Message* msg = Parse(
+      data_, kUpb_DecodeOption_AliasString | kUpb_DecodeOption_AliasUnknown);
+  std::vector<upb_StringView> chunks = Chunks(msg);
+  ASSERT_EQ(2, chunks.size());
+  // Adjacent unknown fields share a chunk.
+  EXPECT_EQ(std::string("\x10\x02\xa2\x06\x03xyz", 8),
+            std::string(chunks[0].data, chunks[0].size));
+  EXPECT_EQ(std::string("\x25\x01\x02\x03\x04", 5),
+            std::string(chunks[1].data, chunks[1].size));
+  for (upb_StringView chunk : chunks) EXPECT_TRUE(Within(data_, chunk));
+
+  EXPECT_EQ(Serialize(Parse(data_, 0)), Serialize(msg));
+}
+
+TEST_F(AliasUnknownTest, GetUnknownRefusesSeveralChunks) {
+  upb_Message* msg = Parse(
+      data_, kUpb_DecodeOption_AliasString | kUpb_DecodeOption_AliasUnknown);
+  ASSERT_EQ(2, Chunks(msg).size());
+  // Returning only the first chunk would silently drop the second.
+  size_t size = 1;
+  EXPECT_EQ(nullptr, upb_Message_GetUnknown(msg, &size));
+  EXPECT_EQ(0, size);
+}
+
+TEST_F(AliasUnknownTest, CopiesWithoutAliasString) {
+  upb_Message* msg = Parse(data_, kUpb_DecodeOption_AliasUnknown);
+  std::vector<upb_StringView> chunks = Chunks(msg);
+  ASSERT_EQ(1, chunks.size());
+  EXPECT_FALSE(Within(data_, chunks[0]));
+  EXPECT_EQ(13, chunks[0].size);
+}
+
+TEST_F(AliasUnknownTest, ShortInputAliasesOriginalBuffer) {
+  // Inputs shorter than the slop region are parsed from a copy; the aliases
+  // must still point into the caller's buffer.
+  std::string data("\x10\x02\x08\x01\x20\x03", 6);
+  upb_Message* msg = Parse(
+      data, kUpb_DecodeOption_AliasString | kUpb_DecodeOption_AliasUnknown);
+  std::vector<upb_StringView> chunks = Chunks(msg);
+  ASSERT_EQ(2, chunks.size());
+  EXPECT_TRUE(Within(data, chunks[0]));
+  EXPECT_TRUE(Within(data, chunks[1]));
+  EXPECT_EQ(data.data(), chunks[0].data);
+}
+
+TEST_F(AliasUnknownTest, Flatten) {
+  upb_Message* msg = Parse(
+      data_, kUpb_DecodeOption_AliasString | kUpb_DecodeOption_AliasUnknown);
+  // Copied unknown data joins the aliased chunks in order.
+  upb_StringView extra = upb_StringView_FromString("\x30\x07");
+  ASSERT_TRUE(_upb_Message_AddUnknown(msg, extra.data, extra.size,
+                                      arena_.ptr()));
+  ASSERT_EQ(3, Chunks(msg).size());
+
+  ASSERT_TRUE(upb_Message_FlattenUnknown(msg, arena_.ptr()));
+  size_t size;
+  const char* unknown = upb_Message_GetUnknown(msg, &size);
+  EXPECT_EQ(std::string("\x10\x02\xa2\x06\x03xyz\x25\x01\x02\x03\x04"
+                        "\x30\x07",
+                        15),
+            std::string(unknown, size));
+  EXPECT_FALSE(Within(data_, upb_StringView_FromDataAndSize(unknown, size)));
+  EXPECT_EQ(1, Chunks(msg).size());
+}
+
+std::string SerializeFile(const char* package, bool with_options,
+                          int message_count) {
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  google_protobuf_FileDescriptorProto_set_package(
+      file, upb_StringView_FromString(package));
+  if (with_options) {
+    google_protobuf_FileOptions_set_java_package(
+        google_protobuf_FileDescriptorProto_mutable_options(file, arena.ptr()),
+        upb_StringView_FromString("com.example"));
+  }
+  for (int i = 0; i < message_count; i++) {
+    google_protobuf_DescriptorProto_set_name(
+        google_protobuf_FileDescriptorProto_add_message_type(file, arena.ptr()),
+        upb_StringView_FromString("M"));
+  }
+  size_t size;
+  char* buf =
+      google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(), &size);
+  // Field 100 is unknown.
+  return std::string(buf, size) + std::string("\xa0\x06\x01", 3);
+}
+
+class ClearForReuseTest : public ::testing::Test {
+ protected:
+  void ClearAndParse(const std::string& data) {
+    upb_Message_ClearForReuse((upb_Message*)file_,
+                              &google_protobuf_FileDescriptorProto_msg_init);
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), (upb_Message*)file_,
+                         &google_protobuf_FileDescriptorProto_msg_init,
+                         nullptr, 0, arena_.ptr()));
+  }
+
+  std::string Serialize() {
+    size_t size;
+    char* buf = google_protobuf_FileDescriptorProto_serialize(
+        file_, arena_.ptr(), &size);
+    return std::string(buf, size);
+  }
+
+  upb::Arena arena_;
+  google_protobuf_FileDescriptorProto* file_ =
+      google_protobuf_FileDescriptorProto_new(arena_.ptr());
+};
+
+TEST_F(ClearForReuseTest, ClearsEverything) {
+  ClearAndParse(SerializeFile("first", true, 4));
+  upb_Message_ClearForReuse((upb_Message*)file_,
+                            &google_protobuf_FileDescriptorProto_msg_init);
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_package(file_));
+  EXPECT_EQ(0, google_protobuf_FileDescriptorProto_package(file_).size);
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_options(file_));
+  size_t size;
+  google_protobuf_FileDescriptorProto_message_type(file_, &size);
+  EXPECT_EQ(0, size);
+  upb_Message_GetUnknown((upb_Message*)file_, &size);
+  EXPECT_EQ(0, size);
+  EXPECT_EQ("", Serialize());
+}
+
+TEST_F(ClearForReuseTest, ReusesAllocations) {
+  std::string first = SerializeFile("first", true, 8);
+  ClearAndParse(first);
+  EXPECT_EQ(first, Serialize());
+  const google_protobuf_FileOptions* options =
+      google_protobuf_FileDescriptorProto_options(file_);
+  size_t size;
+  const upb_Array* types =
+      _google_protobuf_FileDescriptorProto_message_type_upb_array(file_, &size);
+  EXPECT_EQ(8, size);
+  const void* types_data = _upb_array_constptr(types);
+  const upb_Message_InternalData* internal =
+      upb_Message_Getinternal((upb_Message*)file_)->internal;
+  ASSERT_NE(nullptr, internal);
+
+  std::string second = SerializeFile("second", true, 6);
+  ClearAndParse(second);
+  EXPECT_EQ(second, Serialize());
+  EXPECT_EQ(options, google_protobuf_FileDescriptorProto_options(file_));
+  EXPECT_EQ(types, _google_protobuf_FileDescriptorProto_message_type_upb_array(
+                       file_, &size));
+  EXPECT_EQ(6, size);
+  EXPECT_EQ(types_data, _upb_array_constptr(types));
+  EXPECT_EQ(internal, upb_Message_Getinternal((upb_Message*)file_)->internal);
+}
+
+TEST_F(ClearForReuseTest, KeptSubMessageIsNotPresent) {
+  ClearAndParse(SerializeFile("first", true, 1));
+  const google_protobuf_FileOptions* options =
+      google_protobuf_FileDescriptorProto_options(file_);
+
+  std::string second = SerializeFile("second", false, 1);
+  ClearAndParse(second);
+  EXPECT_FALSE(google_protobuf_FileDescriptorProto_has_options(file_));
+  EXPECT_EQ(second, Serialize());
+
+  // Mutating the kept sub-message makes it present again.
+  EXPECT_EQ(options, google_protobuf_FileDescriptorProto_mutable_options(
+                         file_, arena_.ptr()));
+  EXPECT_TRUE(google_protobuf_FileDescriptorProto_has_options(file_));
+  EXPECT_FALSE(google_protobuf_FileOptions_has_java_package(options));
+}
+
+TEST(DelimitedBatchTest, RoundTrip) {
+  upb::Arena arena;
+  std::string payload = MakeTestPayload();
+  std::string stream;
+  std::vector<std::string> records;
+  const std::string name(150, 'n');
+  for (size_t i = 0; i < 50; i++) {
+    // Mix large records with small ones, including an empty one.
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    if (i % 5 == 1) {
+      ASSERT_EQ(kUpb_DecodeStatus_Ok,
+                upb_Decode(payload.data(), payload.size(), file,
+                           &google_protobuf_FileDescriptorProto_msg_init,
+                           nullptr, 0, arena.ptr()));
+    } else if (i > 0) {
+      google_protobuf_FileDescriptorProto_set_name(
+          file, upb_StringView_FromDataAndSize(name.data(), i * 3));
+    }
+    char* buf;
+    size_t size;
+    ASSERT_EQ(kUpb_EncodeStatus_Ok,
+              upb_EncodeDelimited(file,
+                                  &google_protobuf_FileDescriptorProto_msg_init,
+                                  0, arena.ptr(), &buf, &size));
+    stream.append(buf, size);
+    ASSERT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(file, &google_protobuf_FileDescriptorProto_msg_init, 0,
+                         arena.ptr(), &buf, &size));
+    records.emplace_back(buf, size);
+  }
+
+  upb_Array* msgs = upb_Array_New(arena.ptr(), kUpb_CType_Message);
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_DecodeDelimitedBatch(
+                stream.data(), stream.size(), msgs,
+                &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0,
+                arena.ptr()));
+  ASSERT_EQ(records.size(), upb_Array_Size(msgs));
+  for (size_t i = 0; i < records.size(); i++) {
+    const upb_Message* msg = upb_Array_Get(msgs, i).msg_val;
+    char* buf;
+    size_t size;
+    ASSERT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, &google_protobuf_FileDescriptorProto_msg_init, 0,
+                         arena.ptr(), &buf, &size));
+    EXPECT_EQ(records[i], std::string(buf, size));
+  }
+}
+
+TEST(DelimitedBatchTest, Errors) {
+  upb::Arena arena;
+  // Two records: name: "ab", then a record truncated by its length prefix.
+  const std::string stream("\x04\x0a\x02" "ab" "\x05\x0a\x02" "ab", 10);
+  upb_Array* msgs = upb_Array_New(arena.ptr(), kUpb_CType_Message);
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_DecodeDelimitedBatch(
+                stream.data(), stream.size(), msgs,
+                &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0,
+                arena.ptr()));
+  EXPECT_EQ(1, upb_Array_Size(msgs));
+
+  // A record that ends inside a field.
+  msgs = upb_Array_New(arena.ptr(), kUpb_CType_Message);
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            upb_DecodeDelimitedBatch(
+                "\x03\x0a\x02" "ab", 5, msgs,
+                &google_protobuf_FileDescriptorProto_msg_init, nullptr, 0,
+                arena.ptr()));
+  EXPECT_EQ(0, upb_Array_Size(msgs));
+
+  // Missing required fields are reported after decoding every record.
+  const std::string name_part("\x07\x0a\x03" "abc" "\x10\x01"
+                              "\x05\x0a\x03" "abc"
+                              "\x00",
+                              15);
+  msgs = upb_Array_New(arena.ptr(), kUpb_CType_Message);
+  EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+            upb_DecodeDelimitedBatch(
+                name_part.data(), name_part.size(), msgs,
+                &google_protobuf_UninterpretedOption_NamePart_msg_init,
+                nullptr, kUpb_DecodeOption_CheckRequired, arena.ptr()));
+  EXPECT_EQ(3, upb_Array_Size(msgs));
+}
+
+upb_DecodeStatus ParallelDecode(const std::string& data, upb_Message* msg,
+                                 uint32_t field_number, size_t max_shards,
+                                 int options, upb_Arena* arena,
+                                 size_t* shard_count = nullptr) {
+  upb_ParallelDecoder* d = upb_ParallelDecoder_New(
+      data.data(), data.size(), msg,
+      &google_protobuf_FileDescriptorProto_msg_init, field_number, nullptr,
+      options, max_shards, arena);
+  EXPECT_NE(nullptr, d);
+  size_t n = upb_ParallelDecoder_ShardCount(d);
+  if (shard_count) *shard_count = n;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n; i++) {
+    threads.emplace_back([d, i] { upb_ParallelDecoder_DecodeShard(d, i); });
+  }
+  for (auto& t : threads) t.join();
+  return upb_ParallelDecoder_Finish(d);
+}
+
+TEST(ParallelDecodeTest, MatchesSequentialDecode) {
+  // message_type (field 4) with name, package and options around it, and an
+  // unknown field in the middle.
+  std::string data = MakeTestPayload();
+  AppendUnknownField(&data, 1000, 10);
+  data += MakeTestPayload();
+  for (size_t max_shards : {1, 2, 3, 8, 100}) {
+    SCOPED_TRACE(max_shards);
+    upb::Arena arena;
+    google_protobuf_FileDescriptorProto* file =
+        google_protobuf_FileDescriptorProto_new(arena.ptr());
+    size_t shards;
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              ParallelDecode(data, file, 4, max_shards, 0, arena.ptr(),
+                             &shards));
+    EXPECT_LE(shards, max_shards);
+    EXPECT_EQ(max_shards > 1, shards > 1);
+    size_t size;
+    google_protobuf_FileDescriptorProto_message_type(file, &size);
+    EXPECT_EQ(40, size);
+
+    upb::Arena arena2;
+    google_protobuf_FileDescriptorProto* expected =
+        google_protobuf_FileDescriptorProto_new(arena2.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), expected,
+                         &google_protobuf_FileDescriptorProto_msg_init,
+                         nullptr, 0, arena2.ptr()));
+    char* buf = google_protobuf_FileDescriptorProto_serialize(
+        file, arena.ptr(), &size);
+    size_t expected_size;
+    char* expected_buf = google_protobuf_FileDescriptorProto_serialize(
+        expected, arena2.ptr(), &expected_size);
+    EXPECT_EQ(std::string(expected_buf, expected_size),
+              std::string(buf, size));
+  }
+}
+
+TEST(ParallelDecodeTest, FallsBackToSequentialDecode) {
+  std::string data = MakeTestPayload();
+  upb::Arena arena;
+  size_t shards;
+
+  // Not a repeated message field.
+  upb_Message* file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            ParallelDecode(data, file, 2, 4, 0, arena.ptr(), &shards));
+  EXPECT_EQ(0, shards);
+
+  // Malformed input is reported by the sequential decoder.
+  file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            ParallelDecode(data.substr(0, data.size() - 1), file, 4, 4, 0,
+                           arena.ptr(), &shards));
+  EXPECT_EQ(0, shards);
+
+  // An arena with an initial block cannot be fused.
+  char mem[4096];
+  upb_Arena* initial = upb_Arena_Init(mem, sizeof(mem), &upb_alloc_global);
+  file = google_protobuf_FileDescriptorProto_new(initial);
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            ParallelDecode(data, file, 4, 4, 0, initial, &shards));
+  EXPECT_EQ(0, shards);
+  upb_Arena_Free(initial);
+}
+
+TEST(ParallelDecodeTest, ErrorsInShards) {
+  // message_type { field { name: "x" } } with a truncated field inside.
+  std::string bad("\x22\x05\x12\x03\x0a\x05x", 7);
+  std::string data = MakeTestPayload() + bad + MakeTestPayload();
+  upb::Arena arena;
+  upb_Message* file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+  size_t shards;
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            ParallelDecode(data, file, 4, 4, 0, arena.ptr(), &shards));
+  EXPECT_EQ(4, shards);
+
+  // uninterpreted_option.name is missing is_extension, inside options
+  // (a gap) and inside message_type (a shard).
+  const std::string options(
+      "\x42\x08"            // options
+      "\xba\x3e\x05"        // uninterpreted_option
+      "\x12\x03\x0a\x01x");  // name { name_part: "x" }
+  const std::string message_type(
+      "\x22\x0a"            // message_type
+      "\x3a\x08"            // options
+      "\xba\x3e\x05"        // uninterpreted_option
+      "\x12\x03\x0a\x01x");  // name { name_part: "x" }
+  for (const std::string& missing : {options, message_type}) {
+    data = MakeTestPayload() + missing + MakeTestPayload();
+    file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_Ok,
+              ParallelDecode(data, file, 4, 4, 0, arena.ptr()));
+    file = google_protobuf_FileDescriptorProto_new(arena.ptr());
+    EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+              ParallelDecode(data, file, 4, 4, kUpb_DecodeOption_CheckRequired,
+                             arena.ptr()));
+  }
+}
+
+// Copies `m` and every MiniTable reachable from it, without their fast tables,
+// so that decoding with the copy always uses the generic decoder.
+const upb_MiniTable* CopyWithoutFastTable(
+    const upb_MiniTable* m, upb_Arena* arena,
+    std::map<const upb_MiniTable*, const upb_MiniTable*>* copies) {
+  auto it = copies->find(m);
+  if (it != copies->end()) return it->second;
+  upb_MiniTable* copy = static_cast<upb_MiniTable*>(
+      upb_Arena_Malloc(arena, sizeof(upb_MiniTable)));
+  memcpy(copy, m, sizeof(upb_MiniTable));
+  copy->table_mask = static_cast<uint8_t>(-1);
+  (*copies)[m] = copy;
+
+  int sub_count = 0;
+  for (int i = 0; i < m->field_count; i++) {
+    uint16_t idx = m->fields[i].UPB_PRIVATE(submsg_index);
+    if (idx != kUpb_NoSub) sub_count = std::max(sub_count, idx + 1);
+  }
+  if (sub_count == 0) return copy;
+  upb_MiniTableSub* subs = static_cast<upb_MiniTableSub*>(
+      upb_Arena_Malloc(arena, sub_count * sizeof(upb_MiniTableSub)));
+  memcpy(subs, m->subs, sub_count * sizeof(upb_MiniTableSub));
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (upb_MiniTableField_CType(f) != kUpb_CType_Message) continue;
+    upb_MiniTableSub* sub = &subs[f->UPB_PRIVATE(submsg_index)];
+    sub->submsg = CopyWithoutFastTable(sub->submsg, arena, copies);
+  }
+  copy->subs = subs;
+  return copy;
+}
+
+void AddField(google_protobuf_DescriptorProto* msg, int number, int label,
+              int type, upb_Arena* arena) {
+  google_protobuf_FieldDescriptorProto* f =
+      google_protobuf_DescriptorProto_add_field(msg, arena);
+  std::string name = "f" + std::to_string(number);
+  char* name_buf = static_cast<char*>(upb_Arena_Malloc(arena, name.size()));
+  memcpy(name_buf, name.data(), name.size());
+  google_protobuf_FieldDescriptorProto_set_name(
+      f, upb_StringView_FromDataAndSize(name_buf, name.size()));
+  google_protobuf_FieldDescriptorProto_set_number(f, number);
+  google_protobuf_FieldDescriptorProto_set_label(f, label);
+  google_protobuf_FieldDescriptorProto_set_type(f, type);
+  if (type == kUpb_FieldType_Message) {
+    google_protobuf_FieldDescriptorProto_set_type_name(
+        f, upb_StringView_FromString(".M"));
+  } else if (type == kUpb_FieldType_Enum) {
+    google_protobuf_FieldDescriptorProto_set_type_name(
+        f, upb_StringView_FromString(".E"));
+  }
+  if (label == kUpb_Label_Repeated && number >= 40 && number < 60) {
+    google_protobuf_FieldOptions_set_packed(
+        google_protobuf_FieldDescriptorProto_mutable_options(f, arena), true);
+  } else if (label == kUpb_Label_Repeated) {
+    google_protobuf_FieldOptions_set_packed(
+        google_protobuf_FieldDescriptorProto_mutable_options(f, arena), false);
+  }
+  if (number >= 60 && number < 80) {
+    google_protobuf_FieldDescriptorProto_set_oneof_index(f, 0);
+  }
+}
+
+// Builds a file with one message M that has a singular (n), unpacked repeated
+// (20 + n) and packed repeated (40 + n) field of every type n, a oneof of a few
+// types (60 + n), and a field with a tag too large for the fast table.
+const upb_MessageDef* BuildTestSchema(upb::DefPool* pool, const char* syntax) {
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  google_protobuf_FileDescriptorProto_set_name(
+      file, upb_StringView_FromString("test.proto"));
+  google_protobuf_FileDescriptorProto_set_syntax(
+      file, upb_StringView_FromString(syntax));
+  bool proto3 = strcmp(syntax, "proto3") == 0;
+
+  google_protobuf_EnumDescriptorProto* e =
+      google_protobuf_FileDescriptorProto_add_enum_type(file, arena.ptr());
+  google_protobuf_EnumDescriptorProto_set_name(e,
+                                               upb_StringView_FromString("E"));
+  const char* value_names[] = {"E0", "E1", "E2"};
+  for (int i = 0; i < 3; i++) {
+    google_protobuf_EnumValueDescriptorProto* v =
+        google_protobuf_EnumDescriptorProto_add_value(e, arena.ptr());
+    google_protobuf_EnumValueDescriptorProto_set_name(
+        v, upb_StringView_FromString(value_names[i]));
+    google_protobuf_EnumValueDescriptorProto_set_number(v, i);
+  }
+
+  google_protobuf_DescriptorProto* m =
+      google_protobuf_FileDescriptorProto_add_message_type(file, arena.ptr());
+  google_protobuf_DescriptorProto_set_name(m, upb_StringView_FromString("M"));
+  google_protobuf_OneofDescriptorProto* oneof =
+      google_protobuf_DescriptorProto_add_oneof_decl(m, arena.ptr());
+  google_protobuf_OneofDescriptorProto_set_name(
+      oneof, upb_StringView_FromString("o"));
+  for (int type = kUpb_FieldType_Double; type <= kUpb_FieldType_SInt64;
+       type++) {
+    if (type == kUpb_FieldType_Group) continue;
+    AddField(m, type, kUpb_Label_Optional, type, arena.ptr());
+    AddField(m, 20 + type, kUpb_Label_Repeated, type, arena.ptr());
+    bool packable = type != kUpb_FieldType_String &&
+                    type != kUpb_FieldType_Bytes &&
+                    type != kUpb_FieldType_Message;
+    if (packable) AddField(m, 40 + type, kUpb_Label_Repeated, type, arena.ptr());
+  }
+  for (int type : {kUpb_FieldType_Fixed64, kUpb_FieldType_Int32,
+                   kUpb_FieldType_String, kUpb_FieldType_Message}) {
+    AddField(m, 60 + type, kUpb_Label_Optional, type, arena.ptr());
+  }
+  AddField(m, 3000, kUpb_Label_Optional, kUpb_FieldType_Int32, arena.ptr());
+  if (!proto3) {
+    AddField(m, 100, kUpb_Label_Required, kUpb_FieldType_Int32, arena.ptr());
+  }
+
+  upb::Status status;
+  upb::FileDefPtr file_def = pool->AddFile(file, &status);
+  EXPECT_TRUE(file_def) << status.error_message();
+  if (!file_def) return nullptr;
+  return upb_FileDef_TopLevelMessage(file_def.ptr(), 0);
+}
+
+// Generates mostly valid wire data for `m`, with runs of the same field, both
+// encodings of repeated scalar fields, strings of every length class, unknown
+// fields and invalid UTF-8.
+void GenerateMessage(const upb_MessageDef* m, std::mt19937* rng, int depth,
+                     std::string* out) {
+  int field_count = (*rng)() % 12;
+  for (int i = 0; i < field_count; i++) {
+    if ((*rng)() % 20 == 0) {
+      AppendVarint(out, 999 << 3 | kUpb_WireType_Varint);
+      AppendVarint(out, (*rng)());
+      continue;
+    }
+    const upb_FieldDef* f =
+        upb_MessageDef_Field(m, (*rng)() % upb_MessageDef_FieldCount(m));
+    upb_FieldType type = upb_FieldDef_Type(f);
+    uint32_t number = upb_FieldDef_Number(f);
+    if (type == kUpb_FieldType_Message && depth >= 3) continue;
+    int run = upb_FieldDef_IsRepeated(f) ? 1 + (*rng)() % 4 : 1;
+    bool packed = upb_FieldDef_IsPrimitive(f) && upb_FieldDef_IsRepeated(f) &&
+                  (*rng)() % 2;
+    std::string packed_data;
+    for (int j = 0; j < run; j++) {
+      std::string val;
+      upb_WireType wire_type;
+      switch (type) {
+        case kUpb_FieldType_Double:
+        case kUpb_FieldType_Fixed64:
+        case kUpb_FieldType_SFixed64:
+          wire_type = kUpb_WireType_64Bit;
+          for (int k = 0; k < 8; k++) val.push_back((*rng)());
+          break;
+        case kUpb_FieldType_Float:
+        case kUpb_FieldType_Fixed32:
+        case kUpb_FieldType_SFixed32:
+          wire_type = kUpb_WireType_32Bit;
+          for (int k = 0; k < 4; k++) val.push_back((*rng)());
+          break;
+        case kUpb_FieldType_String:
+        case kUpb_FieldType_Bytes:
+        case kUpb_FieldType_Message: {
+          wire_type = kUpb_WireType_Delimited;
+          std::string payload;
+          if (type == kUpb_FieldType_Message) {
+            GenerateMessage(upb_FieldDef_MessageSubDef(f), rng, depth + 1,
+                            &payload);
+          } else {
+            static const size_t kSizes[] = {0, 1, 15, 127, 128, 200, 1000};
+            payload.resize(kSizes[(*rng)() % 7], 'a' + (*rng)() % 26);
+            if (!payload.empty() && (*rng)() % 10 == 0) payload[0] = '\xff';
+          }
+          AppendVarint(&val, payload.size());
+          val.append(payload);
+          break;
+        }
+        default: {
+          wire_type = kUpb_WireType_Varint;
+          static const uint64_t kMasks[] = {0x1, 0x7f, 0x3fff, 0xffffffff,
+                                            ~UINT64_C(0)};
+          AppendVarint(&val, (*rng)() & kMasks[(*rng)() % 5]);
+          break;
+        }
+      }
+      if (packed) {
+        packed_data.append(val);
+      } else {
+        AppendVarint(out, number << 3 | wire_type);
+        out->append(val);
+      }
+    }
+    if (packed) {
+      AppendVarint(out, number << 3 | kUpb_WireType_Delimited);
+      AppendVarint(out, packed_data.size());
+      out->append(packed_data);
+    }
+  }
+}
+
+// Decoding with a runtime-built fast table must give the same result as the
+// generic decoder, for valid and corrupt input alike.
+TEST(RuntimeMiniTableTest, FastTableMatchesGenericDecoder) {
+  for (const char* syntax : {"proto2", "proto3"}) {
+    SCOPED_TRACE(syntax);
+    upb::DefPool pool;
+    const upb_MessageDef* m = BuildTestSchema(&pool, syntax);
+    ASSERT_NE(nullptr, m);
+    const upb_MiniTable* fast = upb_MessageDef_MiniTable(m);
+#if UPB_FASTTABLE
+    EXPECT_NE(static_cast<uint8_t>(-1), fast->table_mask);
+#endif
+    upb::Arena table_arena;
+    std::map<const upb_MiniTable*, const upb_MiniTable*> copies;
+    const upb_MiniTable* generic =
+        CopyWithoutFastTable(fast, table_arena.ptr(), &copies);
+
+    std::mt19937 rng(0);
+    for (int i = 0; i < 2000; i++) {
+      std::string data;
+      GenerateMessage(m, &rng, 0, &data);
+      if (i % 4 == 0 && !data.empty()) {
+        // Corrupt or truncate some of the inputs.
+        if (rng() % 2) {
+          data[rng() % data.size()] = rng();
+        } else {
+          data.resize(rng() % data.size());
+        }
+      }
+      for (int options : {0, static_cast<int>(kUpb_DecodeOption_AliasString)}) {
+        upb::Arena arena;
+        upb_Message* fast_msg = upb_Message_New(fast, arena.ptr());
+        upb_Message* generic_msg = upb_Message_New(generic, arena.ptr());
+        upb_DecodeStatus fast_status =
+            upb_Decode(data.data(), data.size(), fast_msg, fast, nullptr,
+                       options, arena.ptr());
+        upb_DecodeStatus generic_status =
+            upb_Decode(data.data(), data.size(), generic_msg, generic, nullptr,
+                       options, arena.ptr());
+        ASSERT_EQ(generic_status, fast_status) << "input " << i;
+        if (fast_status != kUpb_DecodeStatus_Ok) continue;
+
+        char* fast_buf;
+        char* generic_buf;
+        size_t fast_size, generic_size;
+        ASSERT_EQ(kUpb_EncodeStatus_Ok,
+                  upb_Encode(fast_msg, fast, kUpb_EncodeOption_Deterministic,
+                             arena.ptr(), &fast_buf, &fast_size));
+        ASSERT_EQ(kUpb_EncodeStatus_Ok,
+                  upb_Encode(generic_msg, generic,
+                             kUpb_EncodeOption_Deterministic, arena.ptr(),
+                             &generic_buf, &generic_size));
+        ASSERT_EQ(std::string(generic_buf, generic_size),
+                  std::string(fast_buf, fast_size))
+            << "input " << i;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+#include "upb/port/undef.inc"
@@ -0,0 +1,371 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/internal/decode_varint.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "upb/base/descriptor_constants.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define UPB_VARINT_X86 1
+#define UPB_VARINT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define UPB_VARINT_X86 0
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Portable code shared by all implementations. ///////////////////////////////
+
+UPB_FORCEINLINE
+static const char* upb_VarintArray_DecodeOne(const char* ptr, uint64_t* val) {
+  uint64_t byte = (uint8_t)*ptr;
+  uint64_t v = byte;
+  if (UPB_LIKELY((byte & 0x80) == 0)) {
+    *val = v;
+    return ptr + 1;
+  }
+  for (int i = 1; i < 10; i++) {
+    byte = (uint8_t)ptr[i];
+    v += (byte - 1) << (i * 7);
+    if (!(byte & 0x80)) {
+      *val = v;
+      return ptr + i + 1;
+    }
+  }
+  return NULL;
+}
+
+// Stores `val` as element `i` of `out`, converting it the same way
+// _upb_Decoder_Munge() does.
+UPB_FORCEINLINE
+static void upb_VarintArray_Store(void* out, size_t i, uint64_t val,
+                                  upb_FieldType type) {
+  switch (type) {
+    case kUpb_FieldType_Bool:
+      ((bool*)out)[i] = val != 0;
+      break;
+    case kUpb_FieldType_SInt32: {
+      uint32_t n = val;
+      ((uint32_t*)out)[i] = (n >> 1) ^ -(int32_t)(n & 1);
+      break;
+    }
+    case kUpb_FieldType_SInt64:
+      ((uint64_t*)out)[i] = (val >> 1) ^ -(int64_t)(val & 1);
+      break;
+    case kUpb_FieldType_Int64:
+      ((uint64_t*)out)[i] = val;
+      break;
+    default:
+      ((uint32_t*)out)[i] = val;
+      break;
+  }
+}
+
+// Instantiates `kernel` once per distinct element conversion, so that the
+// conversion is resolved at compile time.
+#define UPB_VARINT_ARRAY_SWITCH(kernel)                                       \
+  switch (type) {                                                             \
+    case kUpb_FieldType_Bool:                                                 \
+      return kernel(ptr, end, out, cap, kUpb_FieldType_Bool, count);          \
+    case kUpb_FieldType_SInt32:                                               \
+      return kernel(ptr, end, out, cap, kUpb_FieldType_SInt32, count);        \
+    case kUpb_FieldType_SInt64:                                               \
+      return kernel(ptr, end, out, cap, kUpb_FieldType_SInt64, count);        \
+    case kUpb_FieldType_Int64:                                                \
+    case kUpb_FieldType_UInt64:                                               \
+      return kernel(ptr, end, out, cap, kUpb_FieldType_Int64, count);         \
+    default:                                                                  \
+      return kernel(ptr, end, out, cap, kUpb_FieldType_Int32, count);         \
+  }
+
+UPB_FORCEINLINE
+static const char* upb_VarintArray_DecodeScalar(const char* ptr,
+                                                const char* end, void* out,
+                                                size_t cap, upb_FieldType type,
+                                                size_t* count) {
+  size_t n = 0;
+  while (n < cap && ptr < end) {
+    uint64_t val;
+    ptr = upb_VarintArray_DecodeOne(ptr, &val);
+    if (!ptr) return NULL;
+    upb_VarintArray_Store(out, n++, val, type);
+  }
+  *count = n;
+  return ptr;
+}
+
+static const char* upb_VarintArray_Scalar(const char* ptr, const char* end,
+                                          void* out, size_t cap,
+                                          upb_FieldType type, size_t* count) {
+  UPB_VARINT_ARRAY_SWITCH(upb_VarintArray_DecodeScalar);
+}
+
+static size_t upb_VarintArray_CountScalar(const char* ptr, const char* end) {
+  size_t n = 0;
+  for (; ptr < end; ptr++) n += ((uint8_t)*ptr & 0x80) == 0;
+  return n;
+}
+
+#if UPB_VARINT_X86
+
+// x86-64 SIMD implementations. ///////////////////////////////////////////////
+//
+// Packed fields are usually dominated by small values, so both SIMD variants
+// look ahead one vector at a time: if no byte in it has the continuation bit
+// set, the whole vector is a run of one-byte varints and is widened to the
+// output in a handful of instructions.  Otherwise the one-byte varints in
+// front of the first longer one are stored directly and the longer one is
+// decoded on its own, branch-free with PEXT when BMI2 is available.
+
+// Decodes one varint without a branch per byte, as long as it fits in eight
+// bytes (56 bits of payload).
+UPB_VARINT_TARGET("bmi2")
+UPB_FORCEINLINE
+static const char* upb_VarintArray_DecodeOneBmi2(const char* ptr,
+                                                 uint64_t* val) {
+  uint64_t word;
+  memcpy(&word, ptr, 8);
+  uint64_t stops = ~word & 0x8080808080808080ULL;
+  if (UPB_UNLIKELY(stops == 0)) return upb_VarintArray_DecodeOne(ptr, val);
+  // Keep the payload bits of each byte up to the first one without a
+  // continuation bit.
+  uint64_t keep = (stops ^ (stops - 1)) & 0x7f7f7f7f7f7f7f7fULL;
+  *val = _pext_u64(word, keep);
+  return ptr + (__builtin_ctzll(stops) + 1) / 8;
+}
+
+// Widens 16 one-byte varints at `ptr` to elements [i, i + 16) of `out`.
+UPB_VARINT_TARGET("sse4.1")
+UPB_FORCEINLINE
+static void upb_VarintArray_Widen16(const char* ptr, void* out, size_t i,
+                                    upb_FieldType type) {
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i zero = _mm_setzero_si128();
+  if (type == kUpb_FieldType_Bool) {
+    __m128i v = _mm_loadu_si128((const __m128i*)ptr);
+    _mm_storeu_si128((__m128i*)((bool*)out + i), _mm_min_epu8(v, one));
+  } else if (type == kUpb_FieldType_Int64 || type == kUpb_FieldType_SInt64) {
+    __m128i* dst = (__m128i*)((uint64_t*)out + i);
+    for (int j = 0; j < 8; j++) {
+      uint16_t pair;
+      memcpy(&pair, ptr + 2 * j, 2);
+      __m128i v = _mm_cvtepu8_epi64(_mm_cvtsi32_si128(pair));
+      if (type == kUpb_FieldType_SInt64) {
+        v = _mm_xor_si128(_mm_srli_epi64(v, 1),
+                          _mm_sub_epi64(zero, _mm_and_si128(v, one)));
+      }
+      _mm_storeu_si128(dst + j, v);
+    }
+  } else {
+    __m128i* dst = (__m128i*)((uint32_t*)out + i);
+    for (int j = 0; j < 4; j++) {
+      int32_t quad;
+      memcpy(&quad, ptr + 4 * j, 4);
+      __m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(quad));
+      if (type == kUpb_FieldType_SInt32) {
+        v = _mm_xor_si128(_mm_srli_epi32(v, 1),
+                          _mm_sub_epi32(zero, _mm_and_si128(v, one)));
+      }
+      _mm_storeu_si128(dst + j, v);
+    }
+  }
+}
+
+// Widens 32 one-byte varints at `ptr` to elements [i, i + 32) of `out`.
+UPB_VARINT_TARGET("avx2")
+UPB_FORCEINLINE
+static void upb_VarintArray_Widen32(const char* ptr, void* out, size_t i,
+                                    upb_FieldType type) {
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i zero = _mm256_setzero_si256();
+  if (type == kUpb_FieldType_Bool) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)ptr);
+    _mm256_storeu_si256((__m256i*)((bool*)out + i), _mm256_min_epu8(v, one));
+  } else if (type == kUpb_FieldType_Int64 || type == kUpb_FieldType_SInt64) {
+    __m256i* dst = (__m256i*)((uint64_t*)out + i);
+    for (int j = 0; j < 8; j++) {
+      int32_t quad;
+      memcpy(&quad, ptr + 4 * j, 4);
+      __m256i v = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(quad));
+      if (type == kUpb_FieldType_SInt64) {
+        v = _mm256_xor_si256(_mm256_srli_epi64(v, 1),
+                             _mm256_sub_epi64(zero, _mm256_and_si256(v, one)));
+      }
+      _mm256_storeu_si256(dst + j, v);
+    }
+  } else {
+    __m256i* dst = (__m256i*)((uint32_t*)out + i);
+    for (int j = 0; j < 4; j++) {
+      __m256i v = _mm256_cvtepu8_epi32(
+          _mm_loadl_epi64((const __m128i*)(ptr + 8 * j)));
+      if (type == kUpb_FieldType_SInt32) {
+        v = _mm256_xor_si256(_mm256_srli_epi32(v, 1),
+                             _mm256_sub_epi32(zero, _mm256_and_si256(v, one)));
+      }
+      _mm256_storeu_si256(dst + j, v);
+    }
+  }
+}
+
+UPB_VARINT_TARGET("sse4.1")
+UPB_FORCEINLINE
+static const char* upb_VarintArray_DecodeSse41(const char* ptr,
+                                               const char* end, void* out,
+                                               size_t cap, upb_FieldType type,
+                                               size_t* count) {
+  size_t n = 0;
+  while (n < cap && ptr < end) {
+    if (end - ptr >= 16 && cap - n >= 16) {
+      uint32_t mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ptr));
+      if (mask == 0) {
+        upb_VarintArray_Widen16(ptr, out, n, type);
+        ptr += 16;
+        n += 16;
+        continue;
+      }
+      for (int j = __builtin_ctz(mask); j > 0; j--) {
+        upb_VarintArray_Store(out, n++, (uint8_t)*ptr++, type);
+      }
+    }
+    uint64_t val;
+    ptr = upb_VarintArray_DecodeOne(ptr, &val);
+    if (!ptr) return NULL;
+    upb_VarintArray_Store(out, n++, val, type);
+  }
+  *count = n;
+  return ptr;
+}
+
+UPB_VARINT_TARGET("avx2,bmi2")
+UPB_FORCEINLINE
+static const char* upb_VarintArray_DecodeAvx2(const char* ptr, const char* end,
+                                              void* out, size_t cap,
+                                              upb_FieldType type,
+                                              size_t* count) {
+  size_t n = 0;
+  while (n < cap && ptr < end) {
+    if (end - ptr >= 32 && cap - n >= 32) {
+      uint32_t mask =
+          _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ptr));
+      if (mask == 0) {
+        upb_VarintArray_Widen32(ptr, out, n, type);
+        ptr += 32;
+        n += 32;
+        continue;
+      }
+      for (int j = __builtin_ctz(mask); j > 0; j--) {
+        upb_VarintArray_Store(out, n++, (uint8_t)*ptr++, type);
+      }
+    }
+    uint64_t val;
+    ptr = upb_VarintArray_DecodeOneBmi2(ptr, &val);
+    if (!ptr) return NULL;
+    upb_VarintArray_Store(out, n++, val, type);
+  }
+  *count = n;
+  return ptr;
+}
+
+UPB_VARINT_TARGET("sse4.1")
+static const char* upb_VarintArray_Sse41(const char* ptr, const char* end,
+                                         void* out, size_t cap,
+                                         upb_FieldType type, size_t* count) {
+  UPB_VARINT_ARRAY_SWITCH(upb_VarintArray_DecodeSse41);
+}
+
+UPB_VARINT_TARGET("avx2,bmi2")
+static const char* upb_VarintArray_Avx2(const char* ptr, const char* end,
+                                        void* out, size_t cap,
+                                        upb_FieldType type, size_t* count) {
+  UPB_VARINT_ARRAY_SWITCH(upb_VarintArray_DecodeAvx2);
+}
+
+UPB_VARINT_TARGET("sse4.1")
+static size_t upb_VarintArray_CountSse41(const char* ptr, const char* end) {
+  size_t n = 0;
+  for (; end - ptr >= 16; ptr += 16) {
+    uint32_t mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ptr));
+    n += 16 - __builtin_popcount(mask);
+  }
+  return n + upb_VarintArray_CountScalar(ptr, end);
+}
+
+UPB_VARINT_TARGET("avx2,popcnt")
+static size_t upb_VarintArray_CountAvx2(const char* ptr, const char* end) {
+  size_t n = 0;
+  for (; end - ptr >= 32; ptr += 32) {
+    uint32_t mask =
+        _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ptr));
+    n += 32 - __builtin_popcount(mask);
+  }
+  return n + upb_VarintArray_CountScalar(ptr, end);
+}
+
+#endif  // UPB_VARINT_X86
+
+const char* _upb_Decoder_DecodeVarintArray(const char* ptr, const char* end,
+                                           void* out, size_t cap,
+                                           upb_FieldType type, size_t* count) {
+#if UPB_VARINT_X86
+  // These only test bits that the runtime initialized at startup, so they are
+  // cheap enough to check on every call.
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+    return upb_VarintArray_Avx2(ptr, end, out, cap, type, count);
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return upb_VarintArray_Sse41(ptr, end, out, cap, type, count);
+  }
+#endif
+  return upb_VarintArray_Scalar(ptr, end, out, cap, type, count);
+}
+
+size_t _upb_Decoder_CountVarints(const char* ptr, const char* end) {
+#if UPB_VARINT_X86
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    return upb_VarintArray_CountAvx2(ptr, end);
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return upb_VarintArray_CountSse41(ptr, end);
+  }
+#endif
+  return upb_VarintArray_CountScalar(ptr, end);
+}
+
+#undef UPB_VARINT_ARRAY_SWITCH
+#undef UPB_VARINT_TARGET
+#undef UPB_VARINT_X86
+
+#include "upb/port/undef.inc"
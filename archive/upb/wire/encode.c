@@ -29,16 +29,21 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // We encode backwards, to avoid pre-computing lengths (one-pass encode).
+// kUpb_EncodeOption_ExactSize selects a two-pass forward encoder instead.
 
 #include "upb/wire/encode.h"
 
+#include <stdint.h>
 #include <string.h>
 
 #include "upb/collections/internal/array.h"
 #include "upb/collections/internal/map_sorter.h"
+#include "upb/io/zero_copy_output_stream.h"
+#include "upb/mem/alloc.h"
 #include "upb/message/internal/accessors.h"
 #include "upb/message/internal/extension.h"
 #include "upb/mini_table/sub.h"
+#include "upb/wire/encode_fast.h"
 #include "upb/wire/internal/common.h"
 #include "upb/wire/internal/swap.h"
 
@@ -66,7 +71,7 @@ static uint64_t encode_zz64(int64_t n) {
   return ((uint64_t)n << 1) ^ (n >> 63);
 }
 
-typedef struct {
+typedef struct upb_encstate {
   upb_EncodeStatus status;
   jmp_buf err;
   upb_Arena* arena;
@@ -74,6 +79,20 @@ typedef struct {
   int options;
   int depth;
   _upb_mapsorter sorter;
+  // Lengths recorded by the size pass of the forward encoder, in the order in
+  // which the write pass will need them.
+  size_t* sizes;
+  size_t sizes_count, sizes_cap, sizes_next;
+  // If set, the write pass goes chunk by chunk into this stream.
+  upb_ZeroCopyOutputStream* stream;
+  upb_Status* stream_status;
+  // For upb_EncodeToSegments(): strings and bytes of at least this size are
+  // referenced in place instead of being copied.
+  size_t alias_min;
+  size_t aliased_bytes, aliased_count;
+  upb_StringView* segments;
+  size_t segments_count;
+  char* segment_start;
 } upb_encstate;
 
 static size_t upb_roundup_pow2(size_t bytes) {
@@ -536,10 +555,8 @@ static void encode_ext(upb_encstate* e, const upb_Message_Extension* ext,
   }
 }
 
-static void encode_message(upb_encstate* e, const upb_Message* msg,
-                           const upb_MiniTable* m, size_t* size) {
-  size_t pre_len = e->limit - e->ptr;
-
+static void encode_checkrequired(upb_encstate* e, const upb_Message* msg,
+                                 const upb_MiniTable* m) {
   if ((e->options & kUpb_EncodeOption_CheckRequired) && m->required_count) {
     uint64_t msg_head;
     memcpy(&msg_head, msg, 8);
@@ -548,13 +565,24 @@ static void encode_message(upb_encstate* e, const upb_Message* msg,
       encode_err(e, kUpb_EncodeStatus_MissingRequired);
     }
   }
+}
+
+static void encode_message(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTable* m, size_t* size) {
+  size_t pre_len = e->limit - e->ptr;
+
+  encode_checkrequired(e, msg, m);
 
   if ((e->options & kUpb_EncodeOption_SkipUnknown) == 0) {
-    size_t unknown_size;
-    const char* unknown = upb_Message_GetUnknown(msg, &unknown_size);
+    upb_StringView flat;
+    size_t count;
+    const upb_StringView* unknown =
+        _upb_Message_UnknownChunks(msg, &flat, &count);
 
-    if (unknown) {
-      encode_bytes(e, unknown, unknown_size);
+    // We encode backwards, so the last chunk goes first. Aliased chunks are
+    // copied straight from the buffer they were parsed from.
+    while (count--) {
+      encode_bytes(e, unknown[count].data, unknown[count].size);
     }
   }
 
@@ -581,7 +609,14 @@ static void encode_message(upb_encstate* e, const upb_Message* msg,
     }
   }
 
-  if (m->field_count) {
+  if (m->encode_table) {
+    const _upb_FastEncoder_Entry* ent = &m->encode_table[m->field_count];
+    const _upb_FastEncoder_Entry* first = &m->encode_table[0];
+    while (ent != first) {
+      ent--;
+      ent->field_encoder(e, msg, m, ent->field_data);
+    }
+  } else if (m->field_count) {
     const upb_MiniTableField* f = &m->fields[m->field_count];
     const upb_MiniTableField* first = &m->fields[0];
     while (f != first) {
@@ -595,17 +630,996 @@ static void encode_message(upb_encstate* e, const upb_Message* msg,
   *size = (e->limit - e->ptr) - pre_len;
 }
 
+// Fast encoders ///////////////////////////////////////////////////////////////
+
+// The specialized encoders declared in encode_fast.h.  Each one handles a
+// single field of a known type and presence, with its tag already encoded, so
+// it can skip encode_shouldencode() and the switches in encode_field().
+
+typedef enum {
+  CARD_h = 0, /* Singular with hasbit */
+  CARD_s = 1, /* Singular without hasbit */
+  CARD_o = 2, /* Oneof */
+  CARD_p = 3, /* Packed repeated */
+} upb_fastenc_card;
+
+typedef enum {
+  TYPE_b1,
+  TYPE_v4,
+  TYPE_u4,
+  TYPE_v8,
+  TYPE_z4,
+  TYPE_z8,
+  TYPE_f4,
+  TYPE_f8,
+} upb_fastenc_type;
+
+void _upb_FastEncoder_EncodeGeneric(struct upb_encstate* e,
+                                    const upb_Message* msg,
+                                    const upb_MiniTable* m, uint64_t data) {
+  const upb_MiniTableField* f = &m->fields[data];
+  if (encode_shouldencode(e, msg, m->subs, f)) {
+    encode_field(e, msg, m->subs, f);
+  }
+}
+
+UPB_FORCEINLINE
+static const void* fastenc_field(const upb_Message* msg, uint64_t data) {
+  return UPB_PTR_AT(msg, (uint16_t)(data >> 16), void);
+}
+
+UPB_FORCEINLINE
+static void fastenc_tag(upb_encstate* e, uint64_t data, int tagbytes) {
+  encode_reserve(e, tagbytes);
+  e->ptr[0] = (char)data;
+  if (tagbytes == 2) e->ptr[1] = (char)(data >> 8);
+}
+
+// Checks hasbit or oneof presence.  Fields without a hasbit are checked by the
+// caller, since what counts as "empty" depends on the type.
+UPB_FORCEINLINE
+static bool fastenc_present(const upb_Message* msg, uint64_t data,
+                            upb_fastenc_card card, int tagbytes) {
+  uint16_t presence = data >> 32;
+  switch (card) {
+    case CARD_h:
+      return _upb_hasbit(msg, presence);
+    case CARD_o: {
+      uint32_t tag = data & 0x7f;
+      if (tagbytes == 2) tag |= (uint32_t)((data >> 8) & 0x7f) << 7;
+      return *UPB_PTR_AT(msg, presence, uint32_t) == tag >> 3;
+    }
+    default:
+      return true;
+  }
+}
+
+UPB_FORCEINLINE
+static size_t fastenc_valbytes(upb_fastenc_type type) {
+  switch (type) {
+    case TYPE_b1:
+      return 1;
+    case TYPE_v8:
+    case TYPE_z8:
+    case TYPE_f8:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+UPB_FORCEINLINE
+static bool fastenc_iszero(const void* mem, size_t valbytes) {
+  switch (valbytes) {
+    case 1: {
+      char ch;
+      memcpy(&ch, mem, 1);
+      return ch == 0;
+    }
+    case 4: {
+      uint32_t u32;
+      memcpy(&u32, mem, 4);
+      return u32 == 0;
+    }
+    default: {
+      uint64_t u64;
+      memcpy(&u64, mem, 8);
+      return u64 == 0;
+    }
+  }
+}
+
+UPB_FORCEINLINE
+static void fastenc_value(upb_encstate* e, const void* mem,
+                          upb_fastenc_type type) {
+  switch (type) {
+    case TYPE_b1: {
+      bool val;
+      memcpy(&val, mem, 1);
+      encode_varint(e, val);
+      break;
+    }
+    case TYPE_v4: {
+      int32_t val;
+      memcpy(&val, mem, 4);
+      encode_varint(e, (int64_t)val);
+      break;
+    }
+    case TYPE_u4: {
+      uint32_t val;
+      memcpy(&val, mem, 4);
+      encode_varint(e, val);
+      break;
+    }
+    case TYPE_v8: {
+      uint64_t val;
+      memcpy(&val, mem, 8);
+      encode_varint(e, val);
+      break;
+    }
+    case TYPE_z4: {
+      int32_t val;
+      memcpy(&val, mem, 4);
+      encode_varint(e, encode_zz32(val));
+      break;
+    }
+    case TYPE_z8: {
+      int64_t val;
+      memcpy(&val, mem, 8);
+      encode_varint(e, encode_zz64(val));
+      break;
+    }
+    case TYPE_f4: {
+      uint32_t val;
+      memcpy(&val, mem, 4);
+      encode_fixed32(e, val);
+      break;
+    }
+    case TYPE_f8: {
+      uint64_t val;
+      memcpy(&val, mem, 8);
+      encode_fixed64(e, val);
+      break;
+    }
+  }
+}
+
+UPB_FORCEINLINE
+static void fastenc_scalar(upb_encstate* e, const upb_Message* msg,
+                           uint64_t data, upb_fastenc_card card, int tagbytes,
+                           upb_fastenc_type type) {
+  const void* mem = fastenc_field(msg, data);
+  if (!fastenc_present(msg, data, card, tagbytes)) return;
+  if (card == CARD_s && fastenc_iszero(mem, fastenc_valbytes(type))) return;
+  fastenc_value(e, mem, type);
+  fastenc_tag(e, data, tagbytes);
+}
+
+UPB_FORCEINLINE
+static void fastenc_packed(upb_encstate* e, const upb_Message* msg,
+                           uint64_t data, int tagbytes, upb_fastenc_type type) {
+  const upb_Array* arr = *(const upb_Array* const*)fastenc_field(msg, data);
+  if (arr == NULL || arr->size == 0) return;
+
+  size_t pre_len = e->limit - e->ptr;
+  size_t valbytes = fastenc_valbytes(type);
+  if (type == TYPE_f4 || type == TYPE_f8) {
+    encode_fixedarray(e, arr, valbytes, 0);
+  } else {
+    const char* start = _upb_array_constptr(arr);
+    const char* ptr = start + arr->size * valbytes;
+    do {
+      ptr -= valbytes;
+      fastenc_value(e, ptr, type);
+    } while (ptr != start);
+  }
+  encode_varint(e, e->limit - e->ptr - pre_len);
+  fastenc_tag(e, data, tagbytes);
+}
+
+UPB_FORCEINLINE
+static void fastenc_string(upb_encstate* e, const upb_Message* msg,
+                           uint64_t data, upb_fastenc_card card,
+                           int tagbytes) {
+  const upb_StringView* str = fastenc_field(msg, data);
+  if (!fastenc_present(msg, data, card, tagbytes)) return;
+  if (card == CARD_s && str->size == 0) return;
+  encode_bytes(e, str->data, str->size);
+  encode_varint(e, str->size);
+  fastenc_tag(e, data, tagbytes);
+}
+
+UPB_FORCEINLINE
+static void fastenc_submsg(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTable* m, uint64_t data,
+                           upb_fastenc_card card, int tagbytes) {
+  upb_TaggedMessagePtr submsg =
+      *(const upb_TaggedMessagePtr*)fastenc_field(msg, data);
+  if (!fastenc_present(msg, data, card, tagbytes) || submsg == 0) return;
+
+  const upb_MiniTable* subm = m->subs[(uint16_t)(data >> 48)].submsg;
+  size_t size;
+  if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+  encode_TaggedMessagePtr(e, submsg, subm, &size);
+  encode_varint(e, size);
+  e->depth++;
+  fastenc_tag(e, data, tagbytes);
+}
+
+#define UPB_ENCODE_PARAMS                                                  \
+  struct upb_encstate *e, const upb_Message *msg, const upb_MiniTable *m, \
+      uint64_t data
+
+/* primitive fields ***********************************************************/
+
+#define F(card, type, valbytes, tagbytes)                                \
+  void upb_e##card##type##valbytes##_##tagbytes##bt(UPB_ENCODE_PARAMS) { \
+    UPB_UNUSED(m);                                                       \
+    fastenc_scalar(e, msg, data, CARD_##card, tagbytes,                  \
+                   TYPE_##type##valbytes);                               \
+  }
+
+#define TYPES(card, tagbytes) \
+  F(card, b, 1, tagbytes)     \
+  F(card, v, 4, tagbytes)     \
+  F(card, u, 4, tagbytes)     \
+  F(card, v, 8, tagbytes)     \
+  F(card, z, 4, tagbytes)     \
+  F(card, z, 8, tagbytes)     \
+  F(card, f, 4, tagbytes)     \
+  F(card, f, 8, tagbytes)
+
+#define TAGBYTES(card) \
+  TYPES(card, 1)       \
+  TYPES(card, 2)
+
+TAGBYTES(h)
+TAGBYTES(s)
+TAGBYTES(o)
+
+#undef F
+
+/* packed fields **************************************************************/
+
+#define F(card, type, valbytes, tagbytes)                                \
+  void upb_e##card##type##valbytes##_##tagbytes##bt(UPB_ENCODE_PARAMS) { \
+    UPB_UNUSED(m);                                                       \
+    fastenc_packed(e, msg, data, tagbytes, TYPE_##type##valbytes);       \
+  }
+
+TAGBYTES(p)
+
+#undef F
+#undef TYPES
+#undef TAGBYTES
+
+/* string and sub-message fields **********************************************/
+
+#define F(card, tagbytes)                                     \
+  void upb_e##card##s_##tagbytes##bt(UPB_ENCODE_PARAMS) {     \
+    UPB_UNUSED(m);                                            \
+    fastenc_string(e, msg, data, CARD_##card, tagbytes);      \
+  }                                                           \
+  void upb_e##card##m_##tagbytes##bt(UPB_ENCODE_PARAMS) {     \
+    fastenc_submsg(e, msg, m, data, CARD_##card, tagbytes);   \
+  }
+
+#define TAGBYTES(card) \
+  F(card, 1)           \
+  F(card, 2)
+
+TAGBYTES(h)
+TAGBYTES(s)
+TAGBYTES(o)
+
+#undef F
+#undef TAGBYTES
+#undef UPB_ENCODE_PARAMS
+
+// Forward encoding ////////////////////////////////////////////////////////////
+
+// With kUpb_EncodeOption_ExactSize we make two passes instead: the first
+// computes the exact size of the output, and the second writes it front to
+// back into a buffer of exactly that size.  The first pass records the length
+// of every sub-message, map entry and packed array in the order it
+// visits them, and the second pass visits them in the same order and reads
+// the lengths back.
+
+UPB_FORCEINLINE
+static size_t encode_varintsize(uint64_t val) {
+  if (UPB_LIKELY(val < 128)) return 1;
+#ifdef __GNUC__
+  // Each byte holds 7 bits: ceil(bits / 7) == (bits * 9 + 64) / 64.
+  return ((63 - __builtin_clzll(val)) * 9 + 73) / 64;
+#else
+  size_t n = 1;
+  while (val >= 0x80) {
+    val >>= 7;
+    n++;
+  }
+  return n;
+#endif
+}
+
+UPB_FORCEINLINE
+static size_t encode_tagsize(uint32_t field_number) {
+  return encode_varintsize(field_number << 3);
+}
+
+UPB_NOINLINE
+static void encode_growsizes(upb_encstate* e) {
+  size_t cap = UPB_MAX(64, e->sizes_cap * 2);
+  size_t* sizes = upb_grealloc(e->sizes, e->sizes_cap * sizeof(*sizes),
+                               cap * sizeof(*sizes));
+  if (!sizes) encode_err(e, kUpb_EncodeStatus_OutOfMemory);
+  e->sizes = sizes;
+  e->sizes_cap = cap;
+}
+
+// Returns the index of a new slot for a length that is not yet known.
+UPB_FORCEINLINE
+static size_t encode_reservesize(upb_encstate* e) {
+  if (UPB_UNLIKELY(e->sizes_count == e->sizes_cap)) encode_growsizes(e);
+  return e->sizes_count++;
+}
+
+static size_t encode_nextsize(upb_encstate* e) {
+  UPB_ASSERT(e->sizes_next < e->sizes_count);
+  return e->sizes[e->sizes_next++];
+}
+
+static const uint8_t kUpb_EncodeWireTypes[] = {
+    [kUpb_FieldType_Double] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Float] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Int64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_UInt64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Int32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Fixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Fixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Bool] = kUpb_WireType_Varint,
+    [kUpb_FieldType_String] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Group] = kUpb_WireType_StartGroup,
+    [kUpb_FieldType_Message] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Bytes] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_UInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Enum] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SFixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_SFixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_SInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SInt64] = kUpb_WireType_Varint,
+};
+
+UPB_FORCEINLINE
+static int encode_wiretype(const upb_MiniTableField* f) {
+  return kUpb_EncodeWireTypes[f->UPB_PRIVATE(descriptortype)];
+}
+
+static size_t sizeof_message(upb_encstate* e, const upb_Message* msg,
+                             const upb_MiniTable* m);
+
+static size_t sizeof_TaggedMessagePtr(upb_encstate* e,
+                                      upb_TaggedMessagePtr tagged,
+                                      const upb_MiniTable* m) {
+  if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
+    m = &_kUpb_MiniTable_Empty;
+  }
+  return sizeof_message(e, _upb_TaggedMessagePtr_GetMessage(tagged), m);
+}
+
+// Returns the size of a value without its tag.  For groups this includes the
+// END_GROUP tag.
+static size_t sizeof_value(upb_encstate* e, const void* mem,
+                           const upb_MiniTableSub* subs,
+                           const upb_MiniTableField* f) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Fixed64:
+      return 8;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      return 4;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      return encode_varintsize(*(uint64_t*)mem);
+    case kUpb_FieldType_UInt32:
+      return encode_varintsize(*(uint32_t*)mem);
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      return encode_varintsize((int64_t) * (int32_t*)mem);
+    case kUpb_FieldType_Bool:
+      return 1;
+    case kUpb_FieldType_SInt32:
+      return encode_varintsize(encode_zz32(*(int32_t*)mem));
+    case kUpb_FieldType_SInt64:
+      return encode_varintsize(encode_zz64(*(int64_t*)mem));
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes: {
+      const upb_StringView* view = mem;
+      if (UPB_UNLIKELY(view->size >= e->alias_min)) {
+        e->aliased_bytes += view->size;
+        e->aliased_count++;
+      }
+      return encode_varintsize(view->size) + view->size;
+    }
+    case kUpb_FieldType_Group: {
+      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)mem;
+      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+      size_t size = sizeof_TaggedMessagePtr(e, submsg, subm);
+      e->depth++;
+      return size + encode_tagsize(f->number);
+    }
+    case kUpb_FieldType_Message: {
+      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)mem;
+      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+      size_t slot = encode_reservesize(e);
+      size_t size = sizeof_TaggedMessagePtr(e, submsg, subm);
+      e->sizes[slot] = size;
+      e->depth++;
+      return encode_varintsize(size) + size;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static size_t sizeof_scalar(upb_encstate* e, const void* mem,
+                            const upb_MiniTableSub* subs,
+                            const upb_MiniTableField* f) {
+  if (upb_IsSubMessage(f) && *(upb_TaggedMessagePtr*)mem == 0) return 0;
+  return encode_tagsize(f->number) + sizeof_value(e, mem, subs, f);
+}
+
+static size_t sizeof_array(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTableSub* subs,
+                           const upb_MiniTableField* f) {
+  const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+  if (arr == NULL || arr->size == 0) return 0;
+
+  const char* data = _upb_array_constptr(arr);
+  size_t elem_size = 1 << _upb_Array_ElementSizeLg2(arr);
+  bool packed = f->mode & kUpb_LabelFlags_IsPacked;
+  size_t tag_size = encode_tagsize(f->number);
+  size_t size = packed ? 0 : arr->size * tag_size;
+  size_t slot = packed ? encode_reservesize(e) : 0;
+
+  switch (encode_wiretype(f)) {
+    case kUpb_WireType_64Bit:
+    case kUpb_WireType_32Bit:
+      size += arr->size * elem_size;
+      break;
+    default:
+      for (size_t i = 0; i < arr->size; i++) {
+        size += sizeof_value(e, data + i * elem_size, subs, f);
+      }
+      break;
+  }
+
+  if (!packed) return size;
+  e->sizes[slot] = size;
+  return tag_size + encode_varintsize(size) + size;
+}
+
+static size_t sizeof_mapentry(upb_encstate* e, uint32_t number,
+                              const upb_MiniTable* layout,
+                              const upb_MapEntry* ent) {
+  const upb_MiniTableField* key_field = &layout->fields[0];
+  const upb_MiniTableField* val_field = &layout->fields[1];
+  size_t slot = encode_reservesize(e);
+  size_t size = sizeof_scalar(e, &ent->data.k, layout->subs, key_field) +
+                sizeof_scalar(e, &ent->data.v, layout->subs, val_field);
+  e->sizes[slot] = size;
+  return encode_tagsize(number) + encode_varintsize(size) + size;
+}
+
+// Maps and extensions are visited in the reverse of the order that the
+// backwards encoder visits them, so that both write the same bytes.
+#define ENCODE_FOREACH_SORTED(sorted, i) \
+  for (int i = (sorted)->end; i-- > (sorted)->start;)
+
+static void encode_sortedmapentry(upb_encstate* e, const upb_Map* map, int i,
+                                  upb_MapEntry* ent) {
+  const upb_tabent* tabent = (const upb_tabent*)e->sorter.entries[i];
+  upb_StringView key = upb_tabstrview(tabent->key);
+  _upb_map_fromkey(key, &ent->data.k, map->key_size);
+  upb_value val = {tabent->val.val};
+  _upb_map_fromvalue(val, &ent->data.v, map->val_size);
+}
+
+static size_t sizeof_map(upb_encstate* e, const upb_Message* msg,
+                         const upb_MiniTableSub* subs,
+                         const upb_MiniTableField* f) {
+  const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+  const upb_MiniTable* layout = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+  UPB_ASSERT(layout->field_count == 2);
+  size_t size = 0;
+
+  if (map == NULL) return 0;
+
+  if (e->options & kUpb_EncodeOption_Deterministic) {
+    _upb_sortedmap sorted;
+    _upb_mapsorter_pushmap(&e->sorter,
+                           layout->fields[0].UPB_PRIVATE(descriptortype), map,
+                           &sorted);
+    ENCODE_FOREACH_SORTED(&sorted, i) {
+      upb_MapEntry ent;
+      encode_sortedmapentry(e, map, i, &ent);
+      size += sizeof_mapentry(e, f->number, layout, &ent);
+    }
+    _upb_mapsorter_popmap(&e->sorter, &sorted);
+  } else {
+    intptr_t iter = UPB_STRTABLE_BEGIN;
+    upb_StringView key;
+    upb_value val;
+    while (upb_strtable_next2(&map->table, &key, &val, &iter)) {
+      upb_MapEntry ent;
+      _upb_map_fromkey(key, &ent.data.k, map->key_size);
+      _upb_map_fromvalue(val, &ent.data.v, map->val_size);
+      size += sizeof_mapentry(e, f->number, layout, &ent);
+    }
+  }
+  return size;
+}
+
+static size_t sizeof_field(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTableSub* subs,
+                           const upb_MiniTableField* field) {
+  switch (upb_FieldMode_Get(field)) {
+    case kUpb_FieldMode_Array:
+      return sizeof_array(e, msg, subs, field);
+    case kUpb_FieldMode_Map:
+      return sizeof_map(e, msg, subs, field);
+    case kUpb_FieldMode_Scalar:
+      return sizeof_scalar(e, UPB_PTR_AT(msg, field->offset, void), subs,
+                           field);
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static size_t sizeof_ext(upb_encstate* e, const upb_Message_Extension* ext,
+                         bool is_message_set) {
+  if (UPB_UNLIKELY(is_message_set)) {
+    size_t slot = encode_reservesize(e);
+    size_t size = sizeof_message(e, ext->data.ptr, ext->ext->sub.submsg);
+    e->sizes[slot] = size;
+    return encode_tagsize(kUpb_MsgSet_Item) * 2 +
+           encode_tagsize(kUpb_MsgSet_TypeId) +
+           encode_varintsize(ext->ext->field.number) +
+           encode_tagsize(kUpb_MsgSet_Message) + encode_varintsize(size) +
+           size;
+  } else {
+    return sizeof_field(e, &ext->data, &ext->ext->sub, &ext->ext->field);
+  }
+}
+
+static size_t sizeof_message(upb_encstate* e, const upb_Message* msg,
+                             const upb_MiniTable* m) {
+  size_t size = 0;
+
+  encode_checkrequired(e, msg, m);
+
+  if (m->field_count) {
+    const upb_MiniTableField* f = &m->fields[0];
+    const upb_MiniTableField* end = &m->fields[m->field_count];
+    for (; f != end; f++) {
+      if (encode_shouldencode(e, msg, m->subs, f)) {
+        size += sizeof_field(e, msg, m->subs, f);
+      }
+    }
+  }
+
+  if (m->ext != kUpb_ExtMode_NonExtendable) {
+    size_t ext_count;
+    const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+    if (ext_count) {
+      bool is_message_set = m->ext == kUpb_ExtMode_IsMessageSet;
+      if (e->options & kUpb_EncodeOption_Deterministic) {
+        _upb_sortedmap sorted;
+        _upb_mapsorter_pushexts(&e->sorter, ext, ext_count, &sorted);
+        ENCODE_FOREACH_SORTED(&sorted, i) {
+          size += sizeof_ext(e, e->sorter.entries[i], is_message_set);
+        }
+        _upb_mapsorter_popmap(&e->sorter, &sorted);
+      } else {
+        while (ext_count--) {
+          size += sizeof_ext(e, &ext[ext_count], is_message_set);
+        }
+      }
+    }
+  }
+
+  if ((e->options & kUpb_EncodeOption_SkipUnknown) == 0 &&
+      upb_Message_Getinternal(msg)->internal) {
+    upb_StringView flat;
+    size_t count;
+    const upb_StringView* unknown =
+        _upb_Message_UnknownChunks(msg, &flat, &count);
+    for (size_t i = 0; i < count; i++) size += unknown[i].size;
+  }
+
+  return size;
+}
+
+// The write pass writes into [e->ptr, e->limit).  For a flat buffer, the size
+// pass already made sure that this is exactly large enough.  For a stream it is
+// the current chunk, and we only need to check for space before each write.
+
+UPB_NOINLINE
+static void write_nextchunk(upb_encstate* e) {
+  UPB_ASSERT(e->stream);
+  UPB_ASSERT(e->ptr == e->limit);
+  size_t count;
+  char* chunk =
+      upb_ZeroCopyOutputStream_Next(e->stream, &count, e->stream_status);
+  if (!chunk) {
+    if (upb_Status_IsOk(e->stream_status)) {
+      upb_Status_SetErrorMessage(e->stream_status, "Stream ended early");
+    }
+    e->ptr = e->limit = NULL;
+    encode_err(e, kUpb_EncodeStatus_StreamError);
+  }
+  e->ptr = chunk;
+  e->limit = chunk + count;
+}
+
+static void write_bytes(upb_encstate* e, const void* data, size_t len) {
+  const char* src = data;
+  while (UPB_UNLIKELY((size_t)(e->limit - e->ptr) < len)) {
+    size_t avail = e->limit - e->ptr;
+    if (avail) memcpy(e->ptr, src, avail);
+    e->ptr += avail;
+    src += avail;
+    len -= avail;
+    write_nextchunk(e);
+  }
+  if (len == 0) return; /* memcpy() with zero size is UB */
+  memcpy(e->ptr, src, len);
+  e->ptr += len;
+}
+
+UPB_NOINLINE
+static void write_longvarint(upb_encstate* e, uint64_t val) {
+  if (e->limit - e->ptr >= UPB_PB_VARINT_MAX_LEN) {
+    e->ptr += encode_varint64(val, e->ptr);
+  } else {
+    char buf[UPB_PB_VARINT_MAX_LEN];
+    write_bytes(e, buf, encode_varint64(val, buf));
+  }
+}
+
+UPB_FORCEINLINE
+static void write_varint(upb_encstate* e, uint64_t val) {
+  if (UPB_LIKELY(val < 128 && e->ptr != e->limit)) {
+    *e->ptr++ = (char)val;
+  } else {
+    write_longvarint(e, val);
+  }
+}
+
+static void write_tag(upb_encstate* e, uint32_t field_number,
+                      uint8_t wire_type) {
+  write_varint(e, (field_number << 3) | wire_type);
+}
+
+static void write_fixed64(upb_encstate* e, uint64_t val) {
+  val = _upb_BigEndian_Swap64(val);
+  write_bytes(e, &val, sizeof(uint64_t));
+}
+
+static void write_segment(upb_encstate* e, const char* data, size_t len) {
+  upb_StringView* seg = &e->segments[e->segments_count++];
+  seg->data = data;
+  seg->size = len;
+}
+
+// Ends the segment that is being written into the buffer, if it is not empty.
+static void write_endsegment(upb_encstate* e) {
+  if (e->ptr == e->segment_start) return;
+  write_segment(e, e->segment_start, e->ptr - e->segment_start);
+  e->segment_start = e->ptr;
+}
+
+// Adds a segment that refers to `data` in place instead of copying it.
+UPB_NOINLINE
+static void write_alias(upb_encstate* e, const char* data, size_t len) {
+  write_endsegment(e);
+  write_segment(e, data, len);
+}
+
+static void write_fixed32(upb_encstate* e, uint32_t val) {
+  val = _upb_BigEndian_Swap32(val);
+  write_bytes(e, &val, sizeof(uint32_t));
+}
+
+static void write_message(upb_encstate* e, const upb_Message* msg,
+                          const upb_MiniTable* m);
+
+static void write_TaggedMessagePtr(upb_encstate* e,
+                                   upb_TaggedMessagePtr tagged,
+                                   const upb_MiniTable* m) {
+  if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
+    m = &_kUpb_MiniTable_Empty;
+  }
+  write_message(e, _upb_TaggedMessagePtr_GetMessage(tagged), m);
+}
+
+// Writes a value without its tag.  For groups this includes the END_GROUP tag.
+static void write_value(upb_encstate* e, const void* mem,
+                        const upb_MiniTableSub* subs,
+                        const upb_MiniTableField* f) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Fixed64:
+      write_fixed64(e, *(uint64_t*)mem);
+      return;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      write_fixed32(e, *(uint32_t*)mem);
+      return;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      write_varint(e, *(uint64_t*)mem);
+      return;
+    case kUpb_FieldType_UInt32:
+      write_varint(e, *(uint32_t*)mem);
+      return;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      write_varint(e, (int64_t) * (int32_t*)mem);
+      return;
+    case kUpb_FieldType_Bool:
+      write_varint(e, *(bool*)mem);
+      return;
+    case kUpb_FieldType_SInt32:
+      write_varint(e, encode_zz32(*(int32_t*)mem));
+      return;
+    case kUpb_FieldType_SInt64:
+      write_varint(e, encode_zz64(*(int64_t*)mem));
+      return;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes: {
+      const upb_StringView* view = mem;
+      write_varint(e, view->size);
+      if (UPB_UNLIKELY(view->size >= e->alias_min)) {
+        write_alias(e, view->data, view->size);
+      } else {
+        write_bytes(e, view->data, view->size);
+      }
+      return;
+    }
+    case kUpb_FieldType_Group: {
+      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)mem;
+      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      write_TaggedMessagePtr(e, submsg, subm);
+      write_tag(e, f->number, kUpb_WireType_EndGroup);
+      return;
+    }
+    case kUpb_FieldType_Message: {
+      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)mem;
+      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      write_varint(e, encode_nextsize(e));
+      write_TaggedMessagePtr(e, submsg, subm);
+      return;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void write_scalar(upb_encstate* e, const void* mem,
+                         const upb_MiniTableSub* subs,
+                         const upb_MiniTableField* f) {
+  if (upb_IsSubMessage(f) && *(upb_TaggedMessagePtr*)mem == 0) return;
+  write_tag(e, f->number, encode_wiretype(f));
+  write_value(e, mem, subs, f);
+}
+
+static void write_array(upb_encstate* e, const upb_Message* msg,
+                        const upb_MiniTableSub* subs,
+                        const upb_MiniTableField* f) {
+  const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+  if (arr == NULL || arr->size == 0) return;
+
+  const char* data = _upb_array_constptr(arr);
+  size_t elem_size = 1 << _upb_Array_ElementSizeLg2(arr);
+
+  if (f->mode & kUpb_LabelFlags_IsPacked) {
+    write_tag(e, f->number, kUpb_WireType_Delimited);
+    write_varint(e, encode_nextsize(e));
+    if (encode_wiretype(f) != kUpb_WireType_Varint && _upb_IsLittleEndian()) {
+      write_bytes(e, data, arr->size * elem_size);
+      return;
+    }
+    for (size_t i = 0; i < arr->size; i++) {
+      write_value(e, data + i * elem_size, subs, f);
+    }
+    return;
+  }
+
+  uint32_t tag = (f->number << 3) | encode_wiretype(f);
+  for (size_t i = 0; i < arr->size; i++) {
+    write_varint(e, tag);
+    write_value(e, data + i * elem_size, subs, f);
+  }
+}
+
+static void write_mapentry(upb_encstate* e, uint32_t number,
+                           const upb_MiniTable* layout,
+                           const upb_MapEntry* ent) {
+  const upb_MiniTableField* key_field = &layout->fields[0];
+  const upb_MiniTableField* val_field = &layout->fields[1];
+  write_tag(e, number, kUpb_WireType_Delimited);
+  write_varint(e, encode_nextsize(e));
+  write_scalar(e, &ent->data.k, layout->subs, key_field);
+  write_scalar(e, &ent->data.v, layout->subs, val_field);
+}
+
+static void write_map(upb_encstate* e, const upb_Message* msg,
+                      const upb_MiniTableSub* subs,
+                      const upb_MiniTableField* f) {
+  const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+  const upb_MiniTable* layout = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+
+  if (map == NULL) return;
+
+  if (e->options & kUpb_EncodeOption_Deterministic) {
+    _upb_sortedmap sorted;
+    _upb_mapsorter_pushmap(&e->sorter,
+                           layout->fields[0].UPB_PRIVATE(descriptortype), map,
+                           &sorted);
+    ENCODE_FOREACH_SORTED(&sorted, i) {
+      upb_MapEntry ent;
+      encode_sortedmapentry(e, map, i, &ent);
+      write_mapentry(e, f->number, layout, &ent);
+    }
+    _upb_mapsorter_popmap(&e->sorter, &sorted);
+  } else {
+    intptr_t iter = UPB_STRTABLE_BEGIN;
+    upb_StringView key;
+    upb_value val;
+    while (upb_strtable_next2(&map->table, &key, &val, &iter)) {
+      upb_MapEntry ent;
+      _upb_map_fromkey(key, &ent.data.k, map->key_size);
+      _upb_map_fromvalue(val, &ent.data.v, map->val_size);
+      write_mapentry(e, f->number, layout, &ent);
+    }
+  }
+}
+
+static void write_field(upb_encstate* e, const upb_Message* msg,
+                        const upb_MiniTableSub* subs,
+                        const upb_MiniTableField* field) {
+  switch (upb_FieldMode_Get(field)) {
+    case kUpb_FieldMode_Array:
+      write_array(e, msg, subs, field);
+      break;
+    case kUpb_FieldMode_Map:
+      write_map(e, msg, subs, field);
+      break;
+    case kUpb_FieldMode_Scalar:
+      write_scalar(e, UPB_PTR_AT(msg, field->offset, void), subs, field);
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void write_ext(upb_encstate* e, const upb_Message_Extension* ext,
+                      bool is_message_set) {
+  if (UPB_UNLIKELY(is_message_set)) {
+    write_tag(e, kUpb_MsgSet_Item, kUpb_WireType_StartGroup);
+    write_tag(e, kUpb_MsgSet_TypeId, kUpb_WireType_Varint);
+    write_varint(e, ext->ext->field.number);
+    write_tag(e, kUpb_MsgSet_Message, kUpb_WireType_Delimited);
+    write_varint(e, encode_nextsize(e));
+    write_message(e, ext->data.ptr, ext->ext->sub.submsg);
+    write_tag(e, kUpb_MsgSet_Item, kUpb_WireType_EndGroup);
+  } else {
+    write_field(e, &ext->data, &ext->ext->sub, &ext->ext->field);
+  }
+}
+
+static void write_message(upb_encstate* e, const upb_Message* msg,
+                          const upb_MiniTable* m) {
+  if (m->field_count) {
+    const upb_MiniTableField* f = &m->fields[0];
+    const upb_MiniTableField* end = &m->fields[m->field_count];
+    for (; f != end; f++) {
+      if (encode_shouldencode(e, msg, m->subs, f)) {
+        write_field(e, msg, m->subs, f);
+      }
+    }
+  }
+
+  if (m->ext != kUpb_ExtMode_NonExtendable) {
+    size_t ext_count;
+    const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+    if (ext_count) {
+      bool is_message_set = m->ext == kUpb_ExtMode_IsMessageSet;
+      if (e->options & kUpb_EncodeOption_Deterministic) {
+        _upb_sortedmap sorted;
+        _upb_mapsorter_pushexts(&e->sorter, ext, ext_count, &sorted);
+        ENCODE_FOREACH_SORTED(&sorted, i) {
+          write_ext(e, e->sorter.entries[i], is_message_set);
+        }
+        _upb_mapsorter_popmap(&e->sorter, &sorted);
+      } else {
+        while (ext_count--) {
+          write_ext(e, &ext[ext_count], is_message_set);
+        }
+      }
+    }
+  }
+
+  if ((e->options & kUpb_EncodeOption_SkipUnknown) == 0 &&
+      upb_Message_Getinternal(msg)->internal) {
+    upb_StringView flat;
+    size_t count;
+    const upb_StringView* unknown =
+        _upb_Message_UnknownChunks(msg, &flat, &count);
+    for (size_t i = 0; i < count; i++) {
+      write_bytes(e, unknown[i].data, unknown[i].size);
+    }
+  }
+}
+
+#undef ENCODE_FOREACH_SORTED
+
+// Encodes `msg` into a new buffer from the arena, or into the caller's buffer
+// [e->buf, e->limit) if there is no arena.  Leaves e->ptr at the start of the
+// output and e->limit at its end, like the backwards encoder does.
+static void encode_exact(upb_encstate* e, const upb_Message* msg,
+                         const upb_MiniTable* m, bool delimited,
+                         size_t* size) {
+  *size = sizeof_message(e, msg, m);
+  size_t total = *size + (delimited ? encode_varintsize(*size) : 0);
+
+  if (!e->arena) {
+    if ((size_t)(e->limit - e->buf) < total) {
+      *size = total;
+      encode_err(e, kUpb_EncodeStatus_BufferTooSmall);
+    }
+  } else if (total) {
+    e->buf = upb_Arena_Malloc(e->arena, total);
+    if (!e->buf) encode_err(e, kUpb_EncodeStatus_OutOfMemory);
+  }
+
+  e->ptr = e->buf;
+  e->limit = e->buf + total;
+  if (delimited) write_varint(e, *size);
+  write_message(e, msg, m);
+  UPB_ASSERT(e->ptr == e->limit);
+  UPB_ASSERT(e->sizes_next == e->sizes_count);
+  e->ptr = e->buf;
+}
+
+static void upb_Encoder_Cleanup(upb_encstate* e) {
+  _upb_mapsorter_destroy(&e->sorter);
+  upb_gfree(e->sizes);
+}
+
 static upb_EncodeStatus upb_Encoder_Encode(upb_encstate* const encoder,
                                            const void* const msg,
                                            const upb_MiniTable* const l,
-                                           char** const buf,
+                                           bool delimited, char** const buf,
                                            size_t* const size) {
   // Unfortunately we must continue to perform hackery here because there are
   // code paths which blindly copy the returned pointer without bothering to
   // check for errors until much later (b/235839510). So we still set *buf to
   // NULL on error and we still set it to non-NULL on a successful empty result.
   if (UPB_SETJMP(encoder->err) == 0) {
-    encode_message(encoder, msg, l, size);
+    if (encoder->options & kUpb_EncodeOption_ExactSize) {
+      encode_exact(encoder, msg, l, delimited, size);
+    } else {
+      encode_message(encoder, msg, l, size);
+      if (delimited) encode_varint(encoder, *size);
+    }
     *size = encoder->limit - encoder->ptr;
     if (*size == 0) {
       static char ch;
@@ -617,27 +1631,128 @@ static upb_EncodeStatus upb_Encoder_Encode(upb_encstate* const encoder,
   } else {
     UPB_ASSERT(encoder->status != kUpb_EncodeStatus_Ok);
     *buf = NULL;
-    *size = 0;
+    // For kUpb_EncodeStatus_BufferTooSmall, *size is the size that was needed.
+    if (encoder->status != kUpb_EncodeStatus_BufferTooSmall) *size = 0;
   }
 
-  _upb_mapsorter_destroy(&encoder->sorter);
+  upb_Encoder_Cleanup(encoder);
   return encoder->status;
 }
 
+static void upb_Encoder_Init(upb_encstate* e, int options, upb_Arena* arena) {
+  unsigned depth = (unsigned)options >> 16;
+
+  e->status = kUpb_EncodeStatus_Ok;
+  e->arena = arena;
+  e->buf = NULL;
+  e->limit = NULL;
+  e->ptr = NULL;
+  e->depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
+  e->options = options;
+  _upb_mapsorter_init(&e->sorter, arena);
+  e->sizes = NULL;
+  e->sizes_count = 0;
+  e->sizes_cap = 0;
+  e->sizes_next = 0;
+  e->stream = NULL;
+  e->stream_status = NULL;
+  e->alias_min = SIZE_MAX;
+  e->aliased_bytes = 0;
+  e->aliased_count = 0;
+  e->segments = NULL;
+  e->segments_count = 0;
+  e->segment_start = NULL;
+}
+
+static upb_EncodeStatus upb_Encoder_EncodeTop(const void* msg,
+                                              const upb_MiniTable* l,
+                                              int options, upb_Arena* arena,
+                                              bool delimited, char** buf,
+                                              size_t* size) {
+  upb_encstate e;
+  upb_Encoder_Init(&e, options, arena);
+  return upb_Encoder_Encode(&e, msg, l, delimited, buf, size);
+}
+
 upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
                             int options, upb_Arena* arena, char** buf,
                             size_t* size) {
+  return upb_Encoder_EncodeTop(msg, l, options, arena, false, buf, size);
+}
+
+upb_EncodeStatus upb_EncodeDelimited(const void* msg, const upb_MiniTable* l,
+                                     int options, upb_Arena* arena, char** buf,
+                                     size_t* size) {
+  return upb_Encoder_EncodeTop(msg, l, options, arena, true, buf, size);
+}
+
+upb_EncodeStatus upb_EncodeToBuffer(const void* msg, const upb_MiniTable* l,
+                                    int options, char* buf, size_t capacity,
+                                    size_t* size) {
   upb_encstate e;
-  unsigned depth = (unsigned)options >> 16;
+  char* out;
+  upb_Encoder_Init(&e, options | kUpb_EncodeOption_ExactSize, NULL);
+  e.buf = buf;
+  e.limit = buf + capacity;
+  return upb_Encoder_Encode(&e, msg, l, false, &out, size);
+}
+
+upb_EncodeStatus upb_EncodeToStream(const void* msg, const upb_MiniTable* l,
+                                    int options,
+                                    upb_ZeroCopyOutputStream* stream,
+                                    upb_Status* status) {
+  upb_encstate e;
+  upb_Encoder_Init(&e, options | kUpb_EncodeOption_ExactSize, NULL);
+  e.stream = stream;
+  e.stream_status = status;
+
+  if (UPB_SETJMP(e.err) == 0) {
+    sizeof_message(&e, msg, l);
+    write_message(&e, msg, l);
+    UPB_ASSERT(e.sizes_next == e.sizes_count);
+    // Give back the unused end of the last chunk, if we asked for any.
+    if (e.limit) upb_ZeroCopyOutputStream_BackUp(stream, e.limit - e.ptr);
+  } else {
+    UPB_ASSERT(e.status != kUpb_EncodeStatus_Ok);
+  }
 
-  e.status = kUpb_EncodeStatus_Ok;
-  e.arena = arena;
-  e.buf = NULL;
-  e.limit = NULL;
-  e.ptr = NULL;
-  e.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
-  e.options = options;
-  _upb_mapsorter_init(&e.sorter);
+  upb_Encoder_Cleanup(&e);
+  return e.status;
+}
+
+upb_EncodeStatus upb_EncodeToSegments(const void* msg, const upb_MiniTable* l,
+                                      int options, size_t alias_threshold,
+                                      upb_Arena* arena,
+                                      const upb_StringView** segments,
+                                      size_t* count) {
+  upb_encstate e;
+  upb_Encoder_Init(&e, options | kUpb_EncodeOption_ExactSize, arena);
+  e.alias_min = UPB_MAX(alias_threshold, 1);
+  *segments = NULL;
+  *count = 0;
+
+  if (UPB_SETJMP(e.err) == 0) {
+    // Everything that is not aliased goes into a single buffer, and each
+    // aliased string can split it at most once.
+    size_t size = sizeof_message(&e, msg, l) - e.aliased_bytes;
+    size_t max_segments = 2 * e.aliased_count + 1;
+    e.segments = upb_Arena_Malloc(arena, max_segments * sizeof(*e.segments));
+    e.buf = size ? upb_Arena_Malloc(arena, size) : NULL;
+    if (!e.segments || (size && !e.buf)) {
+      encode_err(&e, kUpb_EncodeStatus_OutOfMemory);
+    }
+    e.ptr = e.segment_start = e.buf;
+    e.limit = e.buf + size;
+    write_message(&e, msg, l);
+    UPB_ASSERT(e.ptr == e.limit);
+    UPB_ASSERT(e.sizes_next == e.sizes_count);
+    write_endsegment(&e);
+    *segments = e.segments;
+    *count = e.segments_count;
+  } else {
+    UPB_ASSERT(e.status != kUpb_EncodeStatus_Ok);
+  }
 
-  return upb_Encoder_Encode(&e, msg, l, buf, size);
+  upb_Encoder_Cleanup(&e);
+  return e.status;
 }
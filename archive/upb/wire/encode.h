@@ -33,6 +33,9 @@
 #ifndef UPB_WIRE_ENCODE_H_
 #define UPB_WIRE_ENCODE_H_
 
+#include "upb/base/status.h"
+#include "upb/base/string_view.h"
+#include "upb/io/zero_copy_output_stream.h"
 #include "upb/message/message.h"
 #include "upb/wire/types.h"
 
@@ -57,6 +60,14 @@ enum {
 
   // When set, the encode will fail if any required fields are missing.
   kUpb_EncodeOption_CheckRequired = 4,
+
+  // When set, the encoder first computes the exact size of the output and then
+  // writes it into a single buffer of that size.  This walks the message twice
+  // but never grows and copies the output buffer or leaves discarded buffers
+  // behind in the arena.  It is faster for large messages whose size is mostly
+  // in strings, bytes and packed fields, and slower for ones made up of many
+  // small fields.
+  kUpb_EncodeOption_ExactSize = 8,
 };
 
 typedef enum {
@@ -66,6 +77,12 @@ typedef enum {
 
   // kUpb_EncodeOption_CheckRequired failed but the parse otherwise succeeded.
   kUpb_EncodeStatus_MissingRequired = 3,
+
+  // The buffer passed to upb_EncodeToBuffer() was too small.
+  kUpb_EncodeStatus_BufferTooSmall = 4,
+
+  // The stream passed to upb_EncodeToStream() reported an error.
+  kUpb_EncodeStatus_StreamError = 5,
 } upb_EncodeStatus;
 
 UPB_INLINE uint32_t upb_EncodeOptions_MaxDepth(uint16_t depth) {
@@ -87,6 +104,54 @@ UPB_API upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
                                     int options, upb_Arena* arena, char** buf,
                                     size_t* size);
 
+// Encodes `msg` into the caller's buffer of `capacity` bytes, as if with
+// kUpb_EncodeOption_ExactSize, and sets `*size` to the number of bytes written.
+// If the buffer is too small, returns kUpb_EncodeStatus_BufferTooSmall and sets
+// `*size` to the capacity that is needed.  No arena is needed: the scratch
+// memory for sub-message sizes and map sorting comes from upb_alloc_global and
+// is freed before this returns.
+UPB_API upb_EncodeStatus upb_EncodeToBuffer(const void* msg,
+                                            const upb_MiniTable* l, int options,
+                                            char* buf, size_t capacity,
+                                            size_t* size);
+
+// Encodes `msg` into `stream` one chunk at a time, so that the serialized
+// message is never held in memory all at once.  This computes the sizes of all
+// sub-messages first, like kUpb_EncodeOption_ExactSize, which takes memory in
+// proportion to the number of sub-messages but not to their contents.  No
+// arena is needed: that memory comes from upb_alloc_global and is freed before
+// this returns.
+//
+// If the stream reports an error or runs out of space, the error is written to
+// `status` and kUpb_EncodeStatus_StreamError is returned.  Whatever was
+// written to the stream before an error is left there.
+UPB_API upb_EncodeStatus upb_EncodeToStream(const void* msg,
+                                            const upb_MiniTable* l, int options,
+                                            upb_ZeroCopyOutputStream* stream,
+                                            upb_Status* status);
+
+// Like upb_Encode(), but produces the output as a list of `*count` segments
+// that, concatenated, form the serialized message, as for writev().  String
+// and bytes fields of at least `alias_threshold` bytes are not copied: their
+// segments point at the fields' own data, which must stay alive and unchanged
+// for as long as the segments are used.  Everything else is written into a
+// single buffer allocated from `arena`, as are the segments themselves.
+UPB_API upb_EncodeStatus upb_EncodeToSegments(const void* msg,
+                                              const upb_MiniTable* l,
+                                              int options,
+                                              size_t alias_threshold,
+                                              upb_Arena* arena,
+                                              const upb_StringView** segments,
+                                              size_t* count);
+
+// Like upb_Encode(), but precedes the message with its length as a varint, so
+// that records can be concatenated into a stream and read back with
+// upb_DecodeDelimitedBatch().
+UPB_API upb_EncodeStatus upb_EncodeDelimited(const void* msg,
+                                             const upb_MiniTable* l,
+                                             int options, upb_Arena* arena,
+                                             char** buf, size_t* size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
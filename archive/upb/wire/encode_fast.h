@@ -0,0 +1,157 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+
+// These are the specialized field encoder functions for the fast encoder.
+// Generated code gives each MiniTable an encode table with one entry per field
+// (in the same order as upb_MiniTable.fields); the entries refer to these
+// functions by name.  MiniTables built at runtime get the same table from
+// _upb_MiniTable_BuildEncodeTable().
+//
+// The function names are encoded with names like:
+//
+//   //  123 4
+//   upb_ehv4_1bt();   // Encode int32 with hasbit, 1 byte tag.
+//
+// In position 1:
+//   - 'e' for encode
+//
+// In position 2 (presence):
+//   - 'h' for singular with hasbit
+//   - 's' for singular without hasbit (encoded if non-zero/non-empty)
+//   - 'o' for oneof
+//   - 'p' for packed repeated
+//
+// In position 3 (type):
+//   - 'b1' for bool
+//   - 'v4' for int32 and enum (sign-extended)
+//   - 'u4' for uint32
+//   - 'v8' for int64 and uint64
+//   - 'z4' for zig-zag-encoded 4-byte varint
+//   - 'z8' for zig-zag-encoded 8-byte varint
+//   - 'f4' for 4-byte fixed
+//   - 'f8' for 8-byte fixed
+//   - 's' for string or bytes
+//   - 'm' for sub-message
+//
+// In position 4 (tag length):
+//   - '1' for one-byte tags (field numbers 1-15)
+//   - '2' for two-byte tags (field numbers 16-2047)
+//
+// The `data` argument packs the per-field information:
+//
+//   bits  0-15: the tag, as the 1 or 2 bytes that appear on the wire
+//   bits 16-31: offset of the field in the message
+//   bits 32-47: hasbit index ('h') or oneof case offset ('o')
+//   bits 48-63: index into upb_MiniTable.subs ('m')
+//
+// Fields that have no specialized encoder (maps, groups, non-packed repeated
+// fields, large field numbers) use _upb_FastEncoder_EncodeGeneric(), whose
+// `data` is the index of the field in upb_MiniTable.fields.
+//
+// kUpb_EncodeOption_ExactSize does not use these tables.
+
+#ifndef UPB_WIRE_ENCODE_FAST_H_
+#define UPB_WIRE_ENCODE_FAST_H_
+
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct upb_encstate;
+
+#define UPB_ENCODE_PARAMS                                                  \
+  struct upb_encstate *e, const upb_Message *msg, const upb_MiniTable *m, \
+      uint64_t data
+
+// The fallback, generic encoding function that can handle any field type.
+void _upb_FastEncoder_EncodeGeneric(UPB_ENCODE_PARAMS);
+
+/* primitive fields ***********************************************************/
+
+#define F(card, type, valbytes, tagbytes) \
+  void upb_e##card##type##valbytes##_##tagbytes##bt(UPB_ENCODE_PARAMS);
+
+#define TYPES(card, tagbytes) \
+  F(card, b, 1, tagbytes)     \
+  F(card, v, 4, tagbytes)     \
+  F(card, u, 4, tagbytes)     \
+  F(card, v, 8, tagbytes)     \
+  F(card, z, 4, tagbytes)     \
+  F(card, z, 8, tagbytes)     \
+  F(card, f, 4, tagbytes)     \
+  F(card, f, 8, tagbytes)
+
+#define TAGBYTES(card) \
+  TYPES(card, 1)       \
+  TYPES(card, 2)
+
+TAGBYTES(h)
+TAGBYTES(s)
+TAGBYTES(o)
+TAGBYTES(p)
+
+#undef F
+#undef TYPES
+#undef TAGBYTES
+
+/* string and sub-message fields **********************************************/
+
+#define F(card, type, tagbytes) \
+  void upb_e##card##type##_##tagbytes##bt(UPB_ENCODE_PARAMS);
+
+#define TYPES(card, tagbytes) \
+  F(card, s, tagbytes)        \
+  F(card, m, tagbytes)
+
+#define TAGBYTES(card) \
+  TYPES(card, 1)       \
+  TYPES(card, 2)
+
+TAGBYTES(h)
+TAGBYTES(s)
+TAGBYTES(o)
+
+#undef F
+#undef TYPES
+#undef TAGBYTES
+
+#undef UPB_ENCODE_PARAMS
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_ENCODE_FAST_H_ */
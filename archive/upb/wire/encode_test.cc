@@ -0,0 +1,587 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/encode.h"
+
+#include <stdint.h>
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "google/protobuf/descriptor.upb.h"
+#include "upb/base/status.hpp"
+#include "upb/io/chunked_output_stream.h"
+#include "upb/mem/arena.hpp"
+#include "upb/message/accessors.h"
+#include "upb/message/message.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.hpp"
+#include "upb/mini_descriptor/internal/modifiers.h"
+#include "upb/mini_descriptor/link.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+namespace {
+
+bool IsNumeric(upb_FieldType type) {
+  return type != kUpb_FieldType_String && type != kUpb_FieldType_Bytes &&
+         type != kUpb_FieldType_Message && type != kUpb_FieldType_Group;
+}
+
+// A message with one field of every kind:
+//   1-18:  optional field of type N (10 and 11 are groups/messages of itself)
+//   21-38: repeated field of type N - 20
+//   41-58: packed repeated field of type N - 40, for numeric types
+//   60:    map<int32, int32>
+//   61:    map<string, (itself)>
+//   62-63: int32 and string with implicit presence
+class EncodeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    upb::Status status;
+    upb::MtDataEncoder e;
+    e.StartMessage(0);
+    for (int type = 1; type <= 18; type++) {
+      e.PutField(static_cast<upb_FieldType>(type), type, 0);
+    }
+    for (int type = 1; type <= 18; type++) {
+      e.PutField(static_cast<upb_FieldType>(type), 20 + type,
+                 kUpb_FieldModifier_IsRepeated);
+    }
+    for (int type = 1; type <= 18; type++) {
+      if (!IsNumeric(static_cast<upb_FieldType>(type))) continue;
+      e.PutField(static_cast<upb_FieldType>(type), 40 + type,
+                 kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+    }
+    e.PutField(kUpb_FieldType_Message, 60, kUpb_FieldModifier_IsRepeated);
+    e.PutField(kUpb_FieldType_Message, 61, kUpb_FieldModifier_IsRepeated);
+    e.PutField(kUpb_FieldType_Int32, 62, kUpb_FieldModifier_IsProto3Singular);
+    e.PutField(kUpb_FieldType_String, 63,
+               kUpb_FieldModifier_IsProto3Singular);
+    table_ = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                 arena_.ptr(), status.ptr());
+    ASSERT_NE(nullptr, table_) << status.error_message();
+
+    upb::MtDataEncoder int_map;
+    int_map.EncodeMap(kUpb_FieldType_Int32, kUpb_FieldType_Int32, 0, 0);
+    upb_MiniTable* int_entry =
+        upb_MiniTable_Build(int_map.data().data(), int_map.data().size(),
+                            arena_.ptr(), status.ptr());
+    ASSERT_NE(nullptr, int_entry) << status.error_message();
+    upb::MtDataEncoder msg_map;
+    msg_map.EncodeMap(kUpb_FieldType_String, kUpb_FieldType_Message, 0, 0);
+    upb_MiniTable* msg_entry =
+        upb_MiniTable_Build(msg_map.data().data(), msg_map.data().size(),
+                            arena_.ptr(), status.ptr());
+    ASSERT_NE(nullptr, msg_entry) << status.error_message();
+
+    ASSERT_TRUE(Link(msg_entry, 2, table_));
+    for (uint32_t number : {10, 11, 30, 31}) {
+      ASSERT_TRUE(Link(table_, number, table_));
+    }
+    ASSERT_TRUE(Link(table_, 60, int_entry));
+    ASSERT_TRUE(Link(table_, 61, msg_entry));
+  }
+
+  static bool Link(upb_MiniTable* table, uint32_t number,
+                   const upb_MiniTable* sub) {
+    auto* f = const_cast<upb_MiniTableField*>(
+        upb_MiniTable_FindFieldByNumber(table, number));
+    return f && upb_MiniTable_SetSubMessage(table, f, sub);
+  }
+
+  static void PutVarint(std::string* out, uint64_t val) {
+    while (val >= 0x80) {
+      out->push_back(static_cast<char>(val | 0x80));
+      val >>= 7;
+    }
+    out->push_back(static_cast<char>(val));
+  }
+
+  static void PutTag(std::string* out, uint32_t number, int wire_type) {
+    PutVarint(out, (number << 3) | wire_type);
+  }
+
+  static void PutDelimited(std::string* out, const std::string& data) {
+    PutVarint(out, data.size());
+    out->append(data);
+  }
+
+  // Appends a random value of `type` without its tag.
+  void PutValue(std::string* out, upb_FieldType type, uint32_t number,
+                int depth) {
+    switch (type) {
+      case kUpb_FieldType_Double:
+      case kUpb_FieldType_Fixed64:
+      case kUpb_FieldType_SFixed64: {
+        uint64_t val = rng_();
+        out->append(reinterpret_cast<const char*>(&val), 8);
+        break;
+      }
+      case kUpb_FieldType_Float:
+      case kUpb_FieldType_Fixed32:
+      case kUpb_FieldType_SFixed32: {
+        uint32_t val = rng_();
+        out->append(reinterpret_cast<const char*>(&val), 4);
+        break;
+      }
+      case kUpb_FieldType_Bool:
+        PutVarint(out, rng_() % 2);
+        break;
+      case kUpb_FieldType_Int32:
+      case kUpb_FieldType_Enum:
+        // Sign-extended, as an encoder would write negative values.
+        PutVarint(out, static_cast<int64_t>(static_cast<int32_t>(
+                           rng_() >> (rng_() % 32))));
+        break;
+      case kUpb_FieldType_UInt32:
+      case kUpb_FieldType_SInt32:
+        PutVarint(out, static_cast<uint32_t>(rng_() >> (rng_() % 32)));
+        break;
+      case kUpb_FieldType_String:
+      case kUpb_FieldType_Bytes:
+        PutDelimited(out, std::string(rng_() % 200, 'a' + rng_() % 26));
+        break;
+      case kUpb_FieldType_Message:
+        PutDelimited(out, RandomMessage(depth - 1));
+        break;
+      case kUpb_FieldType_Group:
+        out->append(RandomMessage(depth - 1));
+        PutTag(out, number, kUpb_WireType_EndGroup);
+        break;
+      default:
+        PutVarint(out, rng_() >> (rng_() % 64));
+        break;
+    }
+  }
+
+  static int WireType(upb_FieldType type) {
+    switch (type) {
+      case kUpb_FieldType_Double:
+      case kUpb_FieldType_Fixed64:
+      case kUpb_FieldType_SFixed64:
+        return kUpb_WireType_64Bit;
+      case kUpb_FieldType_Float:
+      case kUpb_FieldType_Fixed32:
+      case kUpb_FieldType_SFixed32:
+        return kUpb_WireType_32Bit;
+      case kUpb_FieldType_String:
+      case kUpb_FieldType_Bytes:
+      case kUpb_FieldType_Message:
+        return kUpb_WireType_Delimited;
+      case kUpb_FieldType_Group:
+        return kUpb_WireType_StartGroup;
+      default:
+        return kUpb_WireType_Varint;
+    }
+  }
+
+  std::string RandomMessage(int depth) {
+    std::string out;
+    int fields = depth > 0 ? rng_() % 40 : 0;
+    for (int i = 0; i < fields; i++) {
+      uint32_t number = rng_() % 64;
+      upb_FieldType type = static_cast<upb_FieldType>(number % 20);
+      if (number >= 60) {
+        if (number < 62) {
+          std::string entry;
+          PutTag(&entry, 1, number == 60 ? kUpb_WireType_Varint
+                                         : kUpb_WireType_Delimited);
+          PutValue(&entry, number == 60 ? kUpb_FieldType_Int32
+                                        : kUpb_FieldType_String,
+                   1, depth);
+          PutTag(&entry, 2, number == 60 ? kUpb_WireType_Varint
+                                         : kUpb_WireType_Delimited);
+          PutValue(&entry, number == 60 ? kUpb_FieldType_Int32
+                                        : kUpb_FieldType_Message,
+                   2, depth);
+          PutTag(&out, number, kUpb_WireType_Delimited);
+          PutDelimited(&out, entry);
+        } else {
+          type = number == 62 ? kUpb_FieldType_Int32 : kUpb_FieldType_String;
+          PutTag(&out, number, WireType(type));
+          PutValue(&out, type, number, depth);
+        }
+      } else if (type == 0 || type > 18 || (number > 40 && !IsNumeric(type))) {
+        // An unknown field.
+        PutTag(&out, 1000 + number, kUpb_WireType_Varint);
+        PutVarint(&out, rng_());
+      } else if (number > 40) {
+        std::string packed;
+        for (int n = rng_() % 20; n >= 0; n--) {
+          PutValue(&packed, type, number, depth);
+        }
+        PutTag(&out, number, kUpb_WireType_Delimited);
+        PutDelimited(&out, packed);
+      } else {
+        PutTag(&out, number, WireType(type));
+        PutValue(&out, type, number, depth);
+      }
+    }
+    return out;
+  }
+
+  std::string Encode(const upb_Message* msg, int options) {
+    char* buf;
+    size_t size;
+    EXPECT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, table_, options, arena_.ptr(), &buf, &size));
+    return std::string(buf, size);
+  }
+
+  upb::Arena arena_;
+  upb_MiniTable* table_;
+  std::mt19937 rng_;
+};
+
+TEST_F(EncodeTest, ExactSizeMatchesBackwardsEncoder) {
+  for (int i = 0; i < 200; i++) {
+    std::string data = RandomMessage(4);
+    upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                               table_, nullptr, 0,
+                                               arena_.ptr()));
+    for (int options : {0, int{kUpb_EncodeOption_SkipUnknown}}) {
+      options |= kUpb_EncodeOption_Deterministic;
+      EXPECT_EQ(Encode(msg, options),
+                Encode(msg, options | kUpb_EncodeOption_ExactSize));
+    }
+
+    // Without kUpb_EncodeOption_Deterministic the map entries may come out
+    // in a different order, but they must still be the same entries.
+    std::string exact = Encode(msg, kUpb_EncodeOption_ExactSize);
+    EXPECT_EQ(Encode(msg, 0).size(), exact.size());
+    upb_Message* copy = upb_Message_New(table_, arena_.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(exact.data(), exact.size(),
+                                               copy, table_, nullptr, 0,
+                                               arena_.ptr()));
+    EXPECT_EQ(Encode(msg, kUpb_EncodeOption_Deterministic),
+              Encode(copy, kUpb_EncodeOption_Deterministic));
+  }
+}
+
+TEST_F(EncodeTest, EncodeToBuffer) {
+  std::string data = RandomMessage(3);
+  upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), msg, table_, nullptr, 0,
+                       arena_.ptr()));
+  std::string expected = Encode(msg, kUpb_EncodeOption_Deterministic);
+  ASSERT_GT(expected.size(), 100);
+
+  size_t size;
+  EXPECT_EQ(kUpb_EncodeStatus_BufferTooSmall,
+            upb_EncodeToBuffer(msg, table_, kUpb_EncodeOption_Deterministic,
+                               nullptr, 0, &size));
+  EXPECT_EQ(expected.size(), size);
+
+  std::vector<char> buf(expected.size() + 1);
+  EXPECT_EQ(kUpb_EncodeStatus_BufferTooSmall,
+            upb_EncodeToBuffer(msg, table_, kUpb_EncodeOption_Deterministic,
+                               buf.data(), expected.size() - 1, &size));
+  EXPECT_EQ(expected.size(), size);
+  EXPECT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeToBuffer(msg, table_, kUpb_EncodeOption_Deterministic,
+                               buf.data(), buf.size(), &size));
+  EXPECT_EQ(expected, std::string(buf.data(), size));
+
+  upb_Message* empty = upb_Message_New(table_, arena_.ptr());
+  EXPECT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeToBuffer(empty, table_, 0, nullptr, 0, &size));
+  EXPECT_EQ(0, size);
+}
+
+TEST_F(EncodeTest, EncodeToStream) {
+  std::string data;
+  while (data.size() < 5000) data += RandomMessage(4);
+  upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), msg, table_, nullptr, 0,
+                       arena_.ptr()));
+  int options = kUpb_EncodeOption_Deterministic;
+  std::string expected = Encode(msg, options);
+  ASSERT_GT(expected.size(), 1000);
+
+  for (size_t chunk : {1, 2, 3, 7, 16, 100, 1 << 20}) {
+    SCOPED_TRACE(chunk);
+    std::vector<char> buf(expected.size() + 10);
+    upb_ZeroCopyOutputStream* stream = upb_ChunkedOutputStream_New(
+        buf.data(), buf.size(), chunk, arena_.ptr());
+    upb::Status status;
+    EXPECT_EQ(kUpb_EncodeStatus_Ok,
+              upb_EncodeToStream(msg, table_, options, stream, status.ptr()));
+    EXPECT_TRUE(status.ok());
+    EXPECT_EQ(expected.size(), stream->vtable->ByteCount(stream));
+    EXPECT_EQ(expected, std::string(buf.data(), expected.size()));
+  }
+
+  // The stream runs out of space.
+  std::vector<char> buf(expected.size() - 1);
+  upb_ZeroCopyOutputStream* stream = upb_ChunkedOutputStream_New(
+      buf.data(), buf.size(), 10, arena_.ptr());
+  upb::Status status;
+  EXPECT_EQ(kUpb_EncodeStatus_StreamError,
+            upb_EncodeToStream(msg, table_, options, stream, status.ptr()));
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(EncodeTest, EncodeToSegments) {
+  for (int i = 0; i < 50; i++) {
+    std::string data = RandomMessage(4);
+    upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                               table_, nullptr, 0,
+                                               arena_.ptr()));
+    int options = kUpb_EncodeOption_Deterministic;
+    std::string expected = Encode(msg, options);
+    for (size_t threshold : {0, 1, 10, 100, 1000}) {
+      const upb_StringView* segments;
+      size_t count;
+      ASSERT_EQ(kUpb_EncodeStatus_Ok,
+                upb_EncodeToSegments(msg, table_, options, threshold,
+                                     arena_.ptr(), &segments, &count));
+      std::string joined;
+      for (size_t j = 0; j < count; j++) {
+        EXPECT_NE(0, segments[j].size);
+        joined.append(segments[j].data, segments[j].size);
+      }
+      EXPECT_EQ(expected, joined);
+    }
+  }
+}
+
+TEST_F(EncodeTest, EncodeToSegmentsAliasesLargeFields) {
+  upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+  std::string blob(5000, 'x');
+  const upb_MiniTableField* bytes_field =
+      upb_MiniTable_FindFieldByNumber(table_, kUpb_FieldType_Bytes);
+  const upb_MiniTableField* int_field =
+      upb_MiniTable_FindFieldByNumber(table_, kUpb_FieldType_Int32);
+  upb_Message_SetString(msg, bytes_field,
+                        upb_StringView_FromDataAndSize(blob.data(), 5000),
+                        arena_.ptr());
+  upb_Message_SetInt32(msg, int_field, 1, arena_.ptr());
+
+  const upb_StringView* segments;
+  size_t count;
+  ASSERT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeToSegments(msg, table_, 0, 1000, arena_.ptr(),
+                                 &segments, &count));
+  // int32 field and bytes tag/length, then the blob itself.
+  ASSERT_EQ(2, count);
+  EXPECT_EQ(std::string("\x28\x01\x62\x88\x27", 5),
+            std::string(segments[0].data, segments[0].size));
+  EXPECT_EQ(blob.data(), segments[1].data);
+  EXPECT_EQ(5000, segments[1].size);
+
+  ASSERT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeToSegments(msg, table_, 0, 10000, arena_.ptr(),
+                                 &segments, &count));
+  EXPECT_EQ(1, count);
+  EXPECT_EQ(5005, segments[0].size);
+}
+
+TEST_F(EncodeTest, ExactSizeDelimited) {
+  std::string data = RandomMessage(3);
+  upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), msg, table_, nullptr, 0,
+                       arena_.ptr()));
+  char* buf;
+  size_t size;
+  char* exact_buf;
+  size_t exact_size;
+  int options = kUpb_EncodeOption_Deterministic;
+  ASSERT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeDelimited(msg, table_, options, arena_.ptr(), &buf,
+                                &size));
+  ASSERT_EQ(kUpb_EncodeStatus_Ok,
+            upb_EncodeDelimited(msg, table_,
+                                options | kUpb_EncodeOption_ExactSize,
+                                arena_.ptr(), &exact_buf, &exact_size));
+  EXPECT_EQ(std::string(buf, size), std::string(exact_buf, exact_size));
+}
+
+TEST_F(EncodeTest, ExactSizeErrors) {
+  // 100 levels of nested messages.
+  std::string data;
+  for (int i = 0; i < 100; i++) {
+    std::string outer;
+    PutTag(&outer, 11, kUpb_WireType_Delimited);
+    PutDelimited(&outer, data);
+    data = outer;
+  }
+  upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(data.data(), data.size(), msg, table_, nullptr,
+                       upb_DecodeOptions_MaxDepth(200), arena_.ptr()));
+  char* buf;
+  size_t size;
+  for (int options : {0, int{kUpb_EncodeOption_ExactSize}}) {
+    EXPECT_EQ(kUpb_EncodeStatus_MaxDepthExceeded,
+              upb_Encode(msg, table_, options | upb_EncodeOptions_MaxDepth(50),
+                         arena_.ptr(), &buf, &size));
+    EXPECT_EQ(nullptr, buf);
+    EXPECT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, table_, options | upb_EncodeOptions_MaxDepth(101),
+                         arena_.ptr(), &buf, &size));
+  }
+
+  // uninterpreted_option.name is missing is_extension.
+  const std::string missing(
+      "\x42\x08"            // options
+      "\xba\x3e\x05"        // uninterpreted_option
+      "\x12\x03\x0a\x01x");  // name { name_part: "x" }
+  upb_Message* file = google_protobuf_FileDescriptorProto_new(arena_.ptr());
+  ASSERT_EQ(kUpb_DecodeStatus_Ok,
+            upb_Decode(missing.data(), missing.size(), file,
+                       &google_protobuf_FileDescriptorProto_msg_init, nullptr,
+                       0, arena_.ptr()));
+  EXPECT_EQ(kUpb_EncodeStatus_MissingRequired,
+            upb_Encode(file, &google_protobuf_FileDescriptorProto_msg_init,
+                       kUpb_EncodeOption_CheckRequired |
+                           kUpb_EncodeOption_ExactSize,
+                       arena_.ptr(), &buf, &size));
+}
+
+TEST_F(EncodeTest, FastEncodersMatchGenericEncoder) {
+  // upb_MiniTable_Build() gave the table an encode table.  Clearing it sends
+  // every field, including those of nested messages (which use the same
+  // table), through the generic encoder.
+  const _upb_FastEncoder_Entry* encode_table = table_->encode_table;
+  ASSERT_NE(nullptr, encode_table);
+
+  for (int i = 0; i < 200; i++) {
+    std::string data = RandomMessage(4);
+    upb_Message* msg = upb_Message_New(table_, arena_.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok, upb_Decode(data.data(), data.size(), msg,
+                                               table_, nullptr, 0,
+                                               arena_.ptr()));
+    for (int options : {0, int{kUpb_EncodeOption_SkipUnknown},
+                        int{kUpb_EncodeOption_Deterministic}}) {
+      std::string fast = Encode(msg, options);
+      table_->encode_table = nullptr;
+      std::string generic = Encode(msg, options);
+      table_->encode_table = encode_table;
+      EXPECT_EQ(generic, fast);
+    }
+  }
+}
+
+TEST_F(EncodeTest, FastEncodersOneofAndImplicitPresence) {
+  // 1-18:  field of type N with implicit presence (11 is a message of itself)
+  // 21-38: field of type N - 20, all in one oneof
+  // Groups (10 and 30) are left out.
+  upb::MtDataEncoder e;
+  e.StartMessage(0);
+  for (int type = 1; type <= 18; type++) {
+    if (type == kUpb_FieldType_Group) continue;
+    e.PutField(static_cast<upb_FieldType>(type), type,
+               kUpb_FieldModifier_IsProto3Singular);
+  }
+  for (int type = 1; type <= 18; type++) {
+    if (type == kUpb_FieldType_Group) continue;
+    e.PutField(static_cast<upb_FieldType>(type), 20 + type, 0);
+  }
+  e.StartOneof();
+  for (int type = 1; type <= 18; type++) {
+    if (type == kUpb_FieldType_Group) continue;
+    e.PutOneofField(20 + type);
+  }
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena_.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+  ASSERT_TRUE(Link(table, 11, table));
+  ASSERT_TRUE(Link(table, 31, table));
+  const _upb_FastEncoder_Entry* encode_table = table->encode_table;
+  ASSERT_NE(nullptr, encode_table);
+
+  std::function<std::string(int)> random_message = [&](int depth) {
+    std::string out;
+    int fields = depth > 0 ? rng_() % 30 : 0;
+    for (int i = 0; i < fields; i++) {
+      uint32_t number = 1 + rng_() % 38;
+      upb_FieldType type = static_cast<upb_FieldType>(number % 20);
+      if (type == 0 || type > 18 || type == kUpb_FieldType_Group) continue;
+      PutTag(&out, number, WireType(type));
+      if (type == kUpb_FieldType_Message) {
+        PutDelimited(&out, random_message(depth - 1));
+      } else if (rng_() % 4 == 0) {
+        // A zero value, which is not encoded with implicit presence but is
+        // with a oneof.
+        switch (WireType(type)) {
+          case kUpb_WireType_64Bit:
+            out.append(8, '\0');
+            break;
+          case kUpb_WireType_32Bit:
+            out.append(4, '\0');
+            break;
+          default:
+            out.push_back('\0');
+            break;
+        }
+      } else {
+        PutValue(&out, type, number, depth);
+      }
+    }
+    return out;
+  };
+
+  for (int i = 0; i < 200; i++) {
+    std::string data = random_message(4);
+    upb_Message* msg = upb_Message_New(table, arena_.ptr());
+    ASSERT_EQ(kUpb_DecodeStatus_Ok,
+              upb_Decode(data.data(), data.size(), msg, table, nullptr, 0,
+                         arena_.ptr()));
+    char* buf;
+    size_t size;
+    ASSERT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, table, 0, arena_.ptr(), &buf, &size));
+    std::string fast(buf, size);
+    table->encode_table = nullptr;
+    ASSERT_EQ(kUpb_EncodeStatus_Ok,
+              upb_Encode(msg, table, 0, arena_.ptr(), &buf, &size));
+    table->encode_table = encode_table;
+    EXPECT_EQ(std::string(buf, size), fast);
+  }
+}
+
+}  // namespace
+
+#include "upb/port/undef.inc"
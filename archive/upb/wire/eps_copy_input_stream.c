@@ -30,8 +30,14 @@
 
 #include "upb/wire/eps_copy_input_stream.h"
 
-static const char* _upb_EpsCopyInputStream_NoOpCallback(
-    upb_EpsCopyInputStream* e, const char* old_end, const char* new_start) {
+#include <limits.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+const char* _upb_EpsCopyInputStream_NoOpCallback(upb_EpsCopyInputStream* e,
+                                                 const char* old_end,
+                                                 const char* new_start) {
   return new_start;
 }
 
@@ -40,3 +46,206 @@ const char* _upb_EpsCopyInputStream_IsDoneFallbackNoCallback(
   return _upb_EpsCopyInputStream_IsDoneFallbackInline(
       e, ptr, overrun, _upb_EpsCopyInputStream_NoOpCallback);
 }
+
+// Streaming input /////////////////////////////////////////////////////////////
+
+// While streaming, the kUpb_EpsCopyInputStream_SlopBytes past `end` always
+// hold real input data (or zeros once we have hit EOF).  Moving to the next
+// buffer copies those bytes to the front of the patch buffer, followed by the
+// start of the next chunk.  A small chunk is parsed out of the patch buffer,
+// while a large chunk is parsed in place once we are past the bytes that were
+// copied into the patch buffer.
+//
+// `ptr` is the current position and `overrun` is `ptr - e->end`, which must be
+// in the range [0, kUpb_EpsCopyInputStream_SlopBytes].  Returns the equivalent
+// position in the new buffer, or NULL if the stream reported an error.
+static const char* _upb_EpsCopyInputStream_NextBuffer(
+    upb_EpsCopyInputStream* e, const char* ptr, int overrun,
+    upb_EpsCopyInputStream_BufferFlipCallback* callback) {
+  UPB_ASSERT(overrun >= 0 && overrun <= kUpb_EpsCopyInputStream_SlopBytes);
+  UPB_ASSERT(!e->stream_eof);
+  const char* start;  // New location of the old `end`.
+  const char* new_end;
+
+  if (e->next_chunk) {
+    start = e->next_chunk;
+    new_end = start + e->next_chunk_size - kUpb_EpsCopyInputStream_SlopBytes;
+    e->next_chunk = NULL;
+    ptr = callback(e, ptr, start + overrun);
+  } else {
+    // The callback must run before we overwrite the patch buffer or call into
+    // the stream, since either one can invalidate the old buffer.
+    start = e->patch;
+    ptr = callback(e, ptr, start + overrun);
+    memmove(e->patch, e->end, kUpb_EpsCopyInputStream_SlopBytes);
+    char* tail = e->patch + kUpb_EpsCopyInputStream_SlopBytes;
+    size_t size;
+    const char* data =
+        upb_ZeroCopyInputStream_Next(e->stream, &size, e->status);
+    if (!data) {
+      if (!upb_Status_IsOk(e->status)) return NULL;
+      memset(tail, 0, kUpb_EpsCopyInputStream_SlopBytes);
+      new_end = tail;
+      e->stream_eof = true;
+    } else if (size > kUpb_EpsCopyInputStream_SlopBytes) {
+      memcpy(tail, data, kUpb_EpsCopyInputStream_SlopBytes);
+      e->next_chunk = data;
+      e->next_chunk_size = size;
+      new_end = tail;
+    } else {
+      memcpy(tail, data, size);
+      new_end = e->patch + size;
+    }
+  }
+
+  // All limits are relative to `end`, so they move with it.
+  size_t consumed = new_end - start;
+  if (consumed > (size_t)e->stream_limit - kUpb_EpsCopyInputStream_SlopBytes) {
+    upb_Status_SetErrorMessage(e->status, "Stream exceeds INT_MAX bytes");
+    return NULL;
+  }
+  e->limit -= (int)consumed;
+  e->stream_limit -= (int)consumed;
+  e->end = new_end;
+  e->limit_ptr = new_end + UPB_MIN(0, e->limit);
+  return ptr;
+}
+
+bool upb_EpsCopyInputStream_InitWithStream(upb_EpsCopyInputStream* e,
+                                           const char** ptr,
+                                           upb_ZeroCopyInputStream* stream,
+                                           upb_Status* status) {
+  // Start out as if we had just consumed an empty buffer, so that the regular
+  // buffer flip logic fills the patch buffer for us.
+  memset(e->patch, 0, sizeof(e->patch));
+  e->end = e->patch + kUpb_EpsCopyInputStream_SlopBytes;
+  e->limit_ptr = e->end;
+  e->aliasing = kUpb_EpsCopyInputStream_NoAliasing;
+  e->limit = INT_MAX;
+  e->error = false;
+  e->stream = stream;
+  e->status = status;
+  e->next_chunk = NULL;
+  e->next_chunk_size = 0;
+  e->stream_limit = INT_MAX;
+  e->stream_eof = false;
+
+  const char* p = e->patch + sizeof(e->patch);
+  do {
+    p = _upb_EpsCopyInputStream_NextBuffer(
+        e, p, p - e->end, _upb_EpsCopyInputStream_NoOpCallback);
+    if (!p) {
+      e->error = true;
+      return false;
+    }
+  } while (p >= e->end && !e->stream_eof);
+  *ptr = p;
+  return true;
+}
+
+const char* _upb_EpsCopyInputStream_IsDoneFallbackStream(
+    upb_EpsCopyInputStream* e, const char* ptr, int overrun,
+    upb_EpsCopyInputStream_BufferFlipCallback* callback) {
+  if (overrun < e->limit) {
+    do {
+      if (e->stream_eof) {
+        if (overrun == 0 && e->limit == e->stream_limit) {
+          // Clean EOF at the top level.  Turning the end of the stream into a
+          // limit lets IsDone() report it.
+          e->limit = 0;
+          e->stream_limit = 0;
+          e->limit_ptr = e->end;
+          return ptr;
+        }
+        // A value or a delimited field runs past the end of the stream.
+        break;
+      }
+      ptr = _upb_EpsCopyInputStream_NextBuffer(e, ptr, overrun, callback);
+      if (!ptr) break;
+      overrun = ptr - e->end;
+    } while (overrun >= 0);
+
+    if (ptr && overrun < 0) {
+      UPB_ASSERT(ptr < e->limit_ptr);
+      return ptr;
+    }
+  }
+  e->error = true;
+  return callback(e, NULL, NULL);
+}
+
+const char* _upb_EpsCopyInputStream_ReadFallback(
+    upb_EpsCopyInputStream* e, const char* ptr, char* to, int size,
+    upb_EpsCopyInputStream_BufferFlipCallback* callback) {
+  if (!e->stream || size < 0 ||
+      !upb_EpsCopyInputStream_CheckSize(e, ptr, size)) {
+    return NULL;
+  }
+  while (true) {
+    size_t avail = upb_EpsCopyInputStream_BytesAvailable(e, ptr);
+    if ((size_t)size <= avail) break;
+    if (e->stream_eof) {
+      e->error = true;
+      return NULL;
+    }
+    if (to) {
+      memcpy(to, ptr, avail);
+      to += avail;
+    }
+    size -= avail;
+    ptr = _upb_EpsCopyInputStream_NextBuffer(
+        e, ptr + avail, kUpb_EpsCopyInputStream_SlopBytes, callback);
+    if (!ptr) {
+      e->error = true;
+      return NULL;
+    }
+  }
+  if (to) memcpy(to, ptr, size);
+  return ptr + size;
+}
+
+const char* _upb_EpsCopyInputStream_ReadStringFallback(
+    upb_EpsCopyInputStream* e, const char** ptr, size_t size,
+    upb_Arena* arena) {
+  const char* p = *ptr;
+  if (!e->stream || size > INT_MAX ||
+      !upb_EpsCopyInputStream_CheckSize(e, p, size)) {
+    return NULL;
+  }
+  UPB_ASSERT(arena);
+  // Start with what the current buffer holds and double from there.
+  size_t capacity = upb_EpsCopyInputStream_BytesAvailable(e, p);
+  capacity = UPB_MIN(UPB_MAX(capacity, 128), size);
+  char* data = (char*)upb_Arena_Malloc(arena, capacity);
+  if (!data) return NULL;
+  size_t copied = 0;
+  while (true) {
+    size_t avail = upb_EpsCopyInputStream_BytesAvailable(e, p);
+    size_t n = UPB_MIN(avail, size - copied);
+    if (copied + n > capacity) {
+      size_t new_capacity = UPB_MIN(UPB_MAX(capacity * 2, copied + n), size);
+      data = (char*)upb_Arena_Realloc(arena, data, capacity, new_capacity);
+      if (!data) return NULL;
+      capacity = new_capacity;
+    }
+    memcpy(data + copied, p, n);
+    copied += n;
+    if (copied == size) {
+      *ptr = data;
+      return p + n;
+    }
+    if (e->stream_eof) {
+      e->error = true;
+      return NULL;
+    }
+    p = _upb_EpsCopyInputStream_NextBuffer(
+        e, p + avail, kUpb_EpsCopyInputStream_SlopBytes,
+        _upb_EpsCopyInputStream_NoOpCallback);
+    if (!p) {
+      e->error = true;
+      return NULL;
+    }
+  }
+}
+
+#include "upb/port/undef.inc"
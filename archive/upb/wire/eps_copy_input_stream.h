@@ -33,6 +33,8 @@
 
 #include <string.h>
 
+#include "upb/base/status.h"
+#include "upb/io/zero_copy_input_stream.h"
 #include "upb/mem/arena.h"
 
 // Must be last.
@@ -63,6 +65,15 @@ typedef struct {
   int limit;              // Submessage limit relative to end
   bool error;             // To distinguish between EOF and error.
   char patch[kUpb_EpsCopyInputStream_SlopBytes * 2];
+
+  // The remaining members are only used when reading from a
+  // upb_ZeroCopyInputStream (see upb_EpsCopyInputStream_InitWithStream()).
+  upb_ZeroCopyInputStream* stream;  // NULL for a flat input buffer.
+  upb_Status* status;               // Receives errors from `stream`.
+  const char* next_chunk;  // Large chunk whose first SlopBytes are in patch.
+  size_t next_chunk_size;
+  int stream_limit;  // Top-level limit relative to end, tracks `limit`.
+  bool stream_eof;   // `end` is the true end of the stream.
 } upb_EpsCopyInputStream;
 
 // Returns true if the stream is in the error state. A stream enters the error
@@ -100,8 +111,23 @@ UPB_INLINE void upb_EpsCopyInputStream_Init(upb_EpsCopyInputStream* e,
   }
   e->limit_ptr = e->end;
   e->error = false;
+  e->stream = NULL;
 }
 
+// Initializes a upb_EpsCopyInputStream that pulls its data from `stream`,
+// one chunk at a time, until the stream reports EOF.  On success, `*ptr` is
+// set to the start of the data and at least kUpb_EpsCopyInputStream_SlopBytes
+// are available to read.  Returns false if the stream reported an error, in
+// which case the error has been written to `status`.
+//
+// Aliasing is never available for streams, since a buffer returned from
+// upb_ZeroCopyInputStream_Next() only lives until the next call.  The total
+// size of the stream is limited to INT_MAX bytes.
+bool upb_EpsCopyInputStream_InitWithStream(upb_EpsCopyInputStream* e,
+                                           const char** ptr,
+                                           upb_ZeroCopyInputStream* stream,
+                                           upb_Status* status);
+
 typedef enum {
   // The current stream position is at a limit.
   kUpb_IsDoneStatus_Done,
@@ -146,7 +172,8 @@ UPB_INLINE bool upb_EpsCopyInputStream_IsDoneWithCallback(
       return false;
     case kUpb_IsDoneStatus_NeedFallback:
       *ptr = func(e, *ptr, overrun);
-      return *ptr == NULL;
+      // For streams, the fallback may discover that we are exactly at EOF.
+      return *ptr == NULL || *ptr - e->end == e->limit;
   }
   UPB_UNREACHABLE();
 }
@@ -179,6 +206,13 @@ UPB_INLINE size_t upb_EpsCopyInputStream_BytesAvailable(
   return (e->end - ptr) + kUpb_EpsCopyInputStream_SlopBytes;
 }
 
+// Returns the end of the data that can be read from the current buffer,
+// including the slop bytes, without passing the current limit.
+UPB_INLINE const char* upb_EpsCopyInputStream_AvailableEnd(
+    upb_EpsCopyInputStream* e) {
+  return e->end + UPB_MIN(e->limit, kUpb_EpsCopyInputStream_SlopBytes);
+}
+
 // Returns true if the given delimited field size is valid (it does not extend
 // beyond any previously-pushed limits).  `ptr` should point to the beginning
 // of the field data, after the delimited size.
@@ -248,8 +282,8 @@ UPB_INLINE bool upb_EpsCopyInputStream_AliasingEnabled(
 // alias into the region [ptr, size] in an input buffer.
 UPB_INLINE bool upb_EpsCopyInputStream_AliasingAvailable(
     upb_EpsCopyInputStream* e, const char* ptr, size_t size) {
-  // When EpsCopyInputStream supports streaming, this will need to become a
-  // runtime check.
+  // Streams always disable aliasing, so this does not need to check whether
+  // the data extends past the current buffer.
   return upb_EpsCopyInputStream_CheckDataSizeAvailable(e, ptr, size) &&
          e->aliasing >= kUpb_EpsCopyInputStream_NoDelta;
 }
@@ -284,11 +318,27 @@ UPB_INLINE const char* upb_EpsCopyInputStream_ReadStringAliased(
   return ret;
 }
 
+// Slow path for reading `size` bytes that extend past the current buffer of a
+// streaming input, flipping buffers as necessary.  The data is copied into `to`
+// unless it is NULL, in which case it is skipped.  `callback` is invoked at
+// every buffer flip.  Returns a pointer past the end of the data, or NULL on
+// end of stream, error, or if the input is not a stream.
+const char* _upb_EpsCopyInputStream_ReadFallback(
+    upb_EpsCopyInputStream* e, const char* ptr, char* to, int size,
+    upb_EpsCopyInputStream_BufferFlipCallback* callback);
+
+const char* _upb_EpsCopyInputStream_NoOpCallback(upb_EpsCopyInputStream* e,
+                                                 const char* old_end,
+                                                 const char* new_start);
+
 // Skips `size` bytes of data from the input and returns a pointer past the end.
 // Returns NULL on end of stream or error.
 UPB_INLINE const char* upb_EpsCopyInputStream_Skip(upb_EpsCopyInputStream* e,
                                                    const char* ptr, int size) {
-  if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(e, ptr, size)) return NULL;
+  if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(e, ptr, size)) {
+    return _upb_EpsCopyInputStream_ReadFallback(
+        e, ptr, NULL, size, _upb_EpsCopyInputStream_NoOpCallback);
+  }
   return ptr + size;
 }
 
@@ -297,11 +347,23 @@ UPB_INLINE const char* upb_EpsCopyInputStream_Skip(upb_EpsCopyInputStream* e,
 UPB_INLINE const char* upb_EpsCopyInputStream_Copy(upb_EpsCopyInputStream* e,
                                                    const char* ptr, void* to,
                                                    int size) {
-  if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(e, ptr, size)) return NULL;
+  if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(e, ptr, size)) {
+    return _upb_EpsCopyInputStream_ReadFallback(
+        e, ptr, (char*)to, size, _upb_EpsCopyInputStream_NoOpCallback);
+  }
   memcpy(to, ptr, size);
   return ptr + size;
 }
 
+// Reads string data that extends beyond the current buffer into memory from
+// `arena`.  The string grows as the data arrives, so a length that the stream
+// cannot back up does not allocate more than the data that was actually read.
+// Returns NULL on end of stream, error, out of memory, or if the input is not
+// a stream.
+const char* _upb_EpsCopyInputStream_ReadStringFallback(
+    upb_EpsCopyInputStream* e, const char** ptr, size_t size,
+    upb_Arena* arena);
+
 // Reads string data from the stream and advances the pointer accordingly.
 // If aliasing was enabled when the stream was initialized, then the returned
 // pointer will point into the input buffer if possible, otherwise new data
@@ -317,12 +379,13 @@ UPB_INLINE const char* upb_EpsCopyInputStream_ReadString(
   } else {
     // We need to allocate and copy.
     if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(e, *ptr, size)) {
-      return NULL;
+      return _upb_EpsCopyInputStream_ReadStringFallback(e, ptr, size, arena);
     }
     UPB_ASSERT(arena);
     char* data = (char*)upb_Arena_Malloc(arena, size);
     if (!data) return NULL;
-    const char* ret = upb_EpsCopyInputStream_Copy(e, *ptr, data, size);
+    memcpy(data, *ptr, size);
+    const char* ret = *ptr + size;
     *ptr = data;
     return ret;
   }
@@ -363,9 +426,17 @@ UPB_INLINE void upb_EpsCopyInputStream_PopLimit(upb_EpsCopyInputStream* e,
   _upb_EpsCopyInputStream_CheckLimit(e);
 }
 
+const char* _upb_EpsCopyInputStream_IsDoneFallbackStream(
+    upb_EpsCopyInputStream* e, const char* ptr, int overrun,
+    upb_EpsCopyInputStream_BufferFlipCallback* callback);
+
 UPB_INLINE const char* _upb_EpsCopyInputStream_IsDoneFallbackInline(
     upb_EpsCopyInputStream* e, const char* ptr, int overrun,
     upb_EpsCopyInputStream_BufferFlipCallback* callback) {
+  if (UPB_UNLIKELY(e->stream)) {
+    return _upb_EpsCopyInputStream_IsDoneFallbackStream(e, ptr, overrun,
+                                                        callback);
+  }
   if (overrun < e->limit) {
     // Need to copy remaining data into patch buffer.
     UPB_ASSERT(overrun < kUpb_EpsCopyInputStream_SlopBytes);
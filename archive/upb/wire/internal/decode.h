@@ -40,6 +40,7 @@
 #include "upb/message/internal/message.h"
 #include "upb/wire/decode.h"
 #include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/internal/decode_field_mask.h"
 #include "utf8_range.h"
 
 // Must be last.
@@ -56,6 +57,13 @@ typedef struct upb_Decoder {
   uint32_t end_group;  // field number of END_GROUP tag, else DECODE_NOGROUP.
   uint16_t options;
   bool missing_required;
+  // Message whose own required fields are not checked, used by the push
+  // decoder, which can only check them once all of the input has arrived.
+  const upb_Message* deferred_required;
+  // Field mask for the message being decoded, or NULL to decode every field.
+  const upb_DecodeFieldMask* mask;
+  // Field mask for the sub-message of the field being decoded.
+  const upb_DecodeFieldMask* submask;
   upb_Arena arena;
   upb_DecodeStatus status;
   jmp_buf err;
@@ -105,6 +113,12 @@ const char* _upb_Decoder_CheckRequired(upb_Decoder* d, const char* ptr,
                                        const upb_Message* msg,
                                        const upb_MiniTable* l);
 
+// Counts the fields with tag `tag` that immediately follow each other at
+// `ptr`, looking no further than the end of the current buffer.  Used to size
+// a repeated field's array before decoding the first of them.  Never fails:
+// it simply stops counting at anything unexpected.
+size_t _upb_Decoder_CountTagRun(upb_Decoder* d, const char* ptr, uint32_t tag);
+
 /* x86-64 pointers always have the high 16 bits matching. So we can shift
  * left 8 and right 8 without loss of information. */
 UPB_INLINE intptr_t decode_totable(const upb_MiniTable* tablep) {
@@ -153,6 +167,14 @@ const char* _upb_FastDecoder_TagDispatch(upb_Decoder* d, const char* ptr,
   UPB_MUSTTAIL return table_p->fasttable[idx].field_parser(d, ptr, msg, table,
                                                            hasbits, data);
 }
+
+#if UPB_FASTTABLE_TRAMPOLINE
+// Parses `msg` with the fast table until the end of the message.  Used instead
+// of _upb_FastDecoder_TagDispatch() when tail calls are not guaranteed: each
+// field parser returns here rather than tail calling the next one.
+const char* _upb_FastDecoder_Trampoline(upb_Decoder* d, const char* ptr,
+                                        upb_Message* msg, intptr_t table);
+#endif
 #endif
 
 UPB_INLINE uint32_t _upb_FastDecoder_LoadTag(const char* ptr) {
@@ -0,0 +1,74 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef UPB_WIRE_INTERNAL_DECODE_VARINT_H_
+#define UPB_WIRE_INTERNAL_DECODE_VARINT_H_
+
+#include <stddef.h>
+
+#include "upb/base/descriptor_constants.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decodes the body of a packed varint field into `out`, which has room for
+// `cap` elements of the in-memory representation of `type` (Bool, Enum, or
+// any of the int32/int64 variants).
+//
+// Every varint that starts before `end` is decoded, until `cap` elements have
+// been written; a varint may extend past `end`, exactly as if it had been
+// read one at a time.  The caller must guarantee that at least
+// kUpb_EpsCopyInputStream_SlopBytes past `end` are readable.
+//
+// Returns the position after the last decoded varint and stores the number
+// of elements written in `*count`, or returns NULL if a varint is longer than
+// ten bytes.
+//
+// On x86-64 this picks a SIMD implementation at runtime based on the CPU.
+const char* _upb_Decoder_DecodeVarintArray(const char* ptr, const char* end,
+                                           void* out, size_t cap,
+                                           upb_FieldType type, size_t* count);
+
+// Returns the number of varints that end in [ptr, end), which for a well-formed
+// packed field is the number of elements it holds.  Used to size arrays before
+// decoding into them.
+size_t _upb_Decoder_CountVarints(const char* ptr, const char* end);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_INTERNAL_DECODE_VARINT_H_ */
@@ -0,0 +1,495 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/validate.h"
+
+#include "upb/mini_table/enum.h"
+#include "upb/mini_table/extension.h"
+#include "upb/mini_table/field.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/sub.h"
+#include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/internal/common.h"
+#include "upb/wire/internal/decode.h"
+#include "upb/wire/reader.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// The validator follows the structure of _upb_Decoder_DecodeMessage(), but
+// since it never allocates it cannot run out of memory, so errors are returned
+// as a NULL pointer with the status saved in the validator rather than with
+// longjmp().
+
+typedef struct {
+  upb_EpsCopyInputStream input;
+  const upb_ExtensionRegistry* extreg;
+  int options;
+  int depth;           // Tracks recursion depth to bound stack usage.
+  uint32_t end_group;  // field number of END_GROUP tag, else DECODE_NOGROUP.
+  bool missing_required;
+  upb_DecodeStatus status;
+} upb_Validator;
+
+enum {
+  kStartItemTag = ((kUpb_MsgSet_Item << 3) | kUpb_WireType_StartGroup),
+  kEndItemTag = ((kUpb_MsgSet_Item << 3) | kUpb_WireType_EndGroup),
+  kTypeIdTag = ((kUpb_MsgSet_TypeId << 3) | kUpb_WireType_Varint),
+  kMessageTag = ((kUpb_MsgSet_Message << 3) | kUpb_WireType_Delimited),
+};
+
+static const char* _upb_Validator_ValidateMessage(upb_Validator* v,
+                                                  const char* ptr,
+                                                  const upb_MiniTable* t);
+
+static const char* _upb_Validator_Error(upb_Validator* v,
+                                        upb_DecodeStatus status) {
+  UPB_ASSERT(status != kUpb_DecodeStatus_Ok);
+  v->status = status;
+  return NULL;
+}
+
+UPB_FORCEINLINE
+static const char* _upb_Validator_ReadSize(upb_Validator* v, const char* ptr,
+                                           int* size) {
+  ptr = upb_WireReader_ReadSize(ptr, size);
+  if (!ptr || !upb_EpsCopyInputStream_CheckSize(&v->input, ptr, *size)) {
+    return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+  return ptr;
+}
+
+// Returns the delimited data at `ptr` as a contiguous range of the input
+// buffer, which may be different from `ptr` if we are in the patch buffer.
+UPB_FORCEINLINE
+static const char* _upb_Validator_GetData(upb_Validator* v, const char* ptr,
+                                          int size) {
+  if (!upb_EpsCopyInputStream_AliasingAvailable(&v->input, ptr, size)) {
+    return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+  return upb_EpsCopyInputStream_GetAliasedPtr(&v->input, ptr);
+}
+
+UPB_FORCEINLINE
+static bool _upb_Validator_CheckEnum(const upb_MiniTableSub* subs,
+                                     const upb_MiniTableField* f, uint32_t val) {
+  return upb_MiniTableEnum_CheckValue(
+      subs[f->UPB_PRIVATE(submsg_index)].subenum, val);
+}
+
+// Returns true if `f` is a sub-message field that upb_Decode() would treat as
+// unknown because it has not been linked.
+UPB_FORCEINLINE
+static bool _upb_Validator_IsUnlinked(upb_Validator* v, const upb_MiniTable* t,
+                                      const upb_MiniTableField* f) {
+  if (f->mode & kUpb_LabelFlags_IsExtension) return false;
+  if (v->options & kUpb_DecodeOption_ExperimentalAllowUnlinked) return false;
+  return t->subs[f->UPB_PRIVATE(submsg_index)].submsg ==
+         &_kUpb_MiniTable_Empty;
+}
+
+UPB_FORCEINLINE
+static const char* _upb_Validator_Recurse(upb_Validator* v, const char* ptr,
+                                          const upb_MiniTable* t,
+                                          uint32_t expected_end_group) {
+  if (--v->depth < 0) {
+    return _upb_Validator_Error(v, kUpb_DecodeStatus_MaxDepthExceeded);
+  }
+  ptr = _upb_Validator_ValidateMessage(v, ptr, t);
+  if (!ptr) return NULL;
+  v->depth++;
+  if (v->end_group != expected_end_group) {
+    return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+  return ptr;
+}
+
+static const char* _upb_Validator_ValidateGroup(upb_Validator* v,
+                                                const char* ptr,
+                                                const upb_MiniTable* t,
+                                                uint32_t number) {
+  if (upb_EpsCopyInputStream_IsDone(&v->input, &ptr)) {
+    return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+  ptr = _upb_Validator_Recurse(v, ptr, t, number);
+  v->end_group = DECODE_NOGROUP;
+  return ptr;
+}
+
+static const char* _upb_Validator_ValidateSubMessage(upb_Validator* v,
+                                                     const char* ptr,
+                                                     const upb_MiniTable* t,
+                                                     int size) {
+  int saved_delta = upb_EpsCopyInputStream_PushLimit(&v->input, ptr, size);
+  ptr = _upb_Validator_Recurse(v, ptr, t, DECODE_NOGROUP);
+  if (!ptr) return NULL;
+  upb_EpsCopyInputStream_PopLimit(&v->input, ptr, saved_delta);
+  return ptr;
+}
+
+// Skips a field that is not stored, which must still be well formed.
+static const char* _upb_Validator_SkipField(upb_Validator* v, const char* ptr,
+                                            uint32_t tag) {
+  switch (upb_WireReader_GetWireType(tag)) {
+    case kUpb_WireType_Varint:
+      ptr = upb_WireReader_SkipVarint(ptr);
+      if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+      return ptr;
+    case kUpb_WireType_64Bit:
+      return ptr + 8;
+    case kUpb_WireType_32Bit:
+      return ptr + 4;
+    case kUpb_WireType_Delimited: {
+      int size;
+      ptr = _upb_Validator_ReadSize(v, ptr, &size);
+      return ptr ? ptr + size : NULL;
+    }
+    case kUpb_WireType_StartGroup:
+      return _upb_Validator_ValidateGroup(
+          v, ptr, NULL, upb_WireReader_GetFieldNumber(tag));
+    default:
+      return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+}
+
+// Reads one element of a packed varint field, without reading past `end`.
+UPB_FORCEINLINE
+static const char* _upb_Validator_ReadPackedVarint(const char* ptr,
+                                                   const char* end,
+                                                   uint64_t* val) {
+  uint64_t ret = 0;
+  for (int i = 0; i < 10 && ptr < end; i++) {
+    uint64_t byte = (uint8_t)*ptr++;
+    ret |= (byte & 0x7f) << (i * 7);
+    if (!(byte & 0x80)) {
+      *val = ret;
+      return ptr;
+    }
+  }
+  return NULL;
+}
+
+static const char* _upb_Validator_ValidatePacked(upb_Validator* v,
+                                                 const char* ptr,
+                                                 const upb_MiniTableSub* subs,
+                                                 const upb_MiniTableField* f,
+                                                 int size) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      if (size & 3) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+      return ptr + size;
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      if (size & 7) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+      return ptr + size;
+    default:
+      break;
+  }
+
+  const char* data = _upb_Validator_GetData(v, ptr, size);
+  if (!data) return NULL;
+  const char* end = data + size;
+  bool check_enum = f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Enum &&
+                    (v->options & kUpb_ValidateOption_RejectUnknownEnum);
+  while (data < end) {
+    uint64_t val;
+    data = _upb_Validator_ReadPackedVarint(data, end, &val);
+    if (!data || (check_enum && !_upb_Validator_CheckEnum(subs, f, val))) {
+      return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+    }
+  }
+  return ptr + size;
+}
+
+// Validates the data of a delimited field.  Returns NULL on error, and sets
+// `*known` to false if upb_Decode() would store the field as unknown.
+static const char* _upb_Validator_ValidateDelimited(
+    upb_Validator* v, const char* ptr, const upb_MiniTable* t,
+    const upb_MiniTableSub* subs, const upb_MiniTableField* f, int size,
+    bool* known) {
+  const int type = f->UPB_PRIVATE(descriptortype);
+  const bool is_array = upb_FieldMode_Get(f) == kUpb_FieldMode_Array;
+  switch (type) {
+    case kUpb_FieldType_String: {
+      const char* data = _upb_Validator_GetData(v, ptr, size);
+      if (!data) return NULL;
+      if (!_upb_Decoder_VerifyUtf8Inline(data, size)) {
+        return _upb_Validator_Error(v, kUpb_DecodeStatus_BadUtf8);
+      }
+      return ptr + size;
+    }
+    case kUpb_FieldType_Bytes:
+      return ptr + size;
+    case kUpb_FieldType_Message:
+    case kUpb_FieldType_Group: {
+      if ((type == kUpb_FieldType_Group && !is_array) ||
+          _upb_Validator_IsUnlinked(v, t, f)) {
+        *known = false;
+        return ptr + size;
+      }
+      const upb_MiniTable* subl = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      UPB_ASSERT(subl);
+      if (type == kUpb_FieldType_Group) {
+        // Like upb_Decode(), parse a delimited repeated group as a group that
+        // starts after the length.
+        return _upb_Validator_ValidateGroup(v, ptr, subl, f->number);
+      }
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        // The decoder creates map values up front, so it fails on an
+        // unlinked value type even if the entry has no value.
+        const upb_MiniTableField* val = &subl->fields[1];
+        if (upb_MiniTableField_CType(val) == kUpb_CType_Message &&
+            subl->subs[val->UPB_PRIVATE(submsg_index)].submsg ==
+                &_kUpb_MiniTable_Empty &&
+            !(v->options & kUpb_DecodeOption_ExperimentalAllowUnlinked)) {
+          return _upb_Validator_Error(v, kUpb_DecodeStatus_UnlinkedSubMessage);
+        }
+      }
+      return _upb_Validator_ValidateSubMessage(v, ptr, subl, size);
+    }
+    default:
+      if (is_array) return _upb_Validator_ValidatePacked(v, ptr, subs, f, size);
+      *known = false;
+      return ptr + size;
+  }
+}
+
+static const char* _upb_Validator_ValidateField(upb_Validator* v,
+                                                const char* ptr,
+                                                const upb_MiniTable* t,
+                                                const upb_MiniTableSub* subs,
+                                                const upb_MiniTableField* f,
+                                                uint32_t tag, bool* known) {
+  static const unsigned kVarintOkMask =
+      (1 << kUpb_FieldType_Int64) | (1 << kUpb_FieldType_UInt64) |
+      (1 << kUpb_FieldType_Int32) | (1 << kUpb_FieldType_Bool) |
+      (1 << kUpb_FieldType_UInt32) | (1 << kUpb_FieldType_Enum) |
+      (1 << kUpb_FieldType_SInt32) | (1 << kUpb_FieldType_SInt64);
+
+  static const unsigned kFixed32OkMask = (1 << kUpb_FieldType_Float) |
+                                         (1 << kUpb_FieldType_Fixed32) |
+                                         (1 << kUpb_FieldType_SFixed32);
+
+  static const unsigned kFixed64OkMask = (1 << kUpb_FieldType_Double) |
+                                         (1 << kUpb_FieldType_Fixed64) |
+                                         (1 << kUpb_FieldType_SFixed64);
+
+  const unsigned type_bit = 1 << f->UPB_PRIVATE(descriptortype);
+  switch (upb_WireReader_GetWireType(tag)) {
+    case kUpb_WireType_Varint: {
+      uint64_t val;
+      ptr = upb_WireReader_ReadVarint(ptr, &val);
+      if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+      *known = type_bit & kVarintOkMask;
+      if (type_bit == (1 << kUpb_FieldType_Enum) &&
+          !_upb_Validator_CheckEnum(subs, f, val)) {
+        // upb_Decode() keeps unrecognized enum values as unknown fields.
+        if (v->options & kUpb_ValidateOption_RejectUnknownEnum) {
+          return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+        }
+        *known = false;
+      }
+      return ptr;
+    }
+    case kUpb_WireType_32Bit:
+      *known = type_bit & kFixed32OkMask;
+      return ptr + 4;
+    case kUpb_WireType_64Bit:
+      *known = type_bit & kFixed64OkMask;
+      return ptr + 8;
+    case kUpb_WireType_Delimited: {
+      int size;
+      ptr = _upb_Validator_ReadSize(v, ptr, &size);
+      if (!ptr) return NULL;
+      return _upb_Validator_ValidateDelimited(v, ptr, t, subs, f, size, known);
+    }
+    case kUpb_WireType_StartGroup:
+      if (type_bit != (1 << kUpb_FieldType_Group) ||
+          _upb_Validator_IsUnlinked(v, t, f)) {
+        *known = false;
+        return _upb_Validator_ValidateGroup(v, ptr, NULL, f->number);
+      }
+      return _upb_Validator_ValidateGroup(
+          v, ptr, subs[f->UPB_PRIVATE(submsg_index)].submsg, f->number);
+    default:
+      return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+  }
+}
+
+static const char* _upb_Validator_ValidateMessageSetItem(
+    upb_Validator* v, const char* ptr, const upb_MiniTable* t) {
+  uint32_t type_id = 0;
+  const char* data = NULL;
+  int size = 0;
+  bool have_id = false;
+  bool have_payload = false;
+  while (!upb_EpsCopyInputStream_IsDone(&v->input, &ptr)) {
+    uint32_t tag;
+    ptr = upb_WireReader_ReadTag(ptr, &tag);
+    if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+    switch (tag) {
+      case kEndItemTag:
+        return ptr;
+      case kTypeIdTag: {
+        uint64_t tmp;
+        ptr = upb_WireReader_ReadVarint(ptr, &tmp);
+        if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+        if (have_id) continue;  // Ignore dup.
+        have_id = true;
+        type_id = tmp;
+        break;
+      }
+      case kMessageTag: {
+        int this_size;
+        ptr = _upb_Validator_ReadSize(v, ptr, &this_size);
+        if (!ptr) return NULL;
+        const char* this_data = _upb_Validator_GetData(v, ptr, this_size);
+        if (!this_data) return NULL;
+        ptr += this_size;
+        if (have_payload) continue;  // Ignore dup.
+        have_payload = true;
+        data = this_data;
+        size = this_size;
+        break;
+      }
+      default:
+        ptr = _upb_Validator_SkipField(v, ptr, tag);
+        if (!ptr) return NULL;
+        continue;
+    }
+    if (have_id && have_payload) {
+      const upb_MiniTableExtension* item =
+          upb_ExtensionRegistry_Lookup(v->extreg, t, type_id);
+      if (item) {
+        // upb_Decode() parses items with a fresh decoder, so we do the same.
+        upb_DecodeStatus status =
+            upb_Validate(data, size, item->sub.submsg, v->extreg, v->options);
+        if (status != kUpb_DecodeStatus_Ok) {
+          return _upb_Validator_Error(v, status);
+        }
+      }
+    }
+  }
+  return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+}
+
+UPB_FORCEINLINE
+static const upb_MiniTableField* _upb_Validator_FindField(
+    upb_Validator* v, const upb_MiniTable* t, uint32_t number,
+    const upb_MiniTableSub** subs) {
+  if (!t) return NULL;
+  *subs = t->subs;
+  size_t idx = ((size_t)number) - 1;  // 0 wraps to SIZE_MAX
+  if (idx < t->dense_below) return &t->fields[idx];
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(t, number);
+  if (f) return f;
+  if (v->extreg && t->ext == kUpb_ExtMode_Extendable) {
+    const upb_MiniTableExtension* ext =
+        upb_ExtensionRegistry_Lookup(v->extreg, t, number);
+    if (ext) {
+      *subs = &ext->sub;
+      return &ext->field;
+    }
+  }
+  return NULL;
+}
+
+static const char* _upb_Validator_ValidateMessage(upb_Validator* v,
+                                                  const char* ptr,
+                                                  const upb_MiniTable* t) {
+  uint64_t required = 0;  // Hasbits of the required fields we have seen.
+
+  while (!upb_EpsCopyInputStream_IsDone(&v->input, &ptr)) {
+    uint32_t tag;
+    ptr = upb_WireReader_ReadTag(ptr, &tag);
+    if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+    const uint32_t number = upb_WireReader_GetFieldNumber(tag);
+
+    if (upb_WireReader_GetWireType(tag) == kUpb_WireType_EndGroup) {
+      v->end_group = number;
+      return ptr;
+    }
+
+    const upb_MiniTableSub* subs;
+    const upb_MiniTableField* f = _upb_Validator_FindField(v, t, number, &subs);
+    if (f) {
+      bool known = true;
+      ptr = _upb_Validator_ValidateField(v, ptr, t, subs, f, tag, &known);
+      if (known && f->presence > 0 && f->presence <= t->required_count) {
+        required |= 1ULL << f->presence;
+      }
+    } else if (tag == kStartItemTag && t && v->extreg &&
+               t->ext == kUpb_ExtMode_IsMessageSet) {
+      ptr = _upb_Validator_ValidateMessageSetItem(v, ptr, t);
+    } else {
+      if (number == 0) {
+        return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+      }
+      ptr = _upb_Validator_SkipField(v, ptr, tag);
+    }
+    if (!ptr) return NULL;
+  }
+
+  // IsDone() returns NULL if a field ran past the end of its message.
+  if (!ptr) return _upb_Validator_Error(v, kUpb_DecodeStatus_Malformed);
+
+  if (UPB_UNLIKELY(t && t->required_count) &&
+      (v->options & kUpb_DecodeOption_CheckRequired) &&
+      (upb_MiniTable_requiredmask(t) & ~required)) {
+    v->missing_required = true;
+  }
+  return ptr;
+}
+
+upb_DecodeStatus upb_Validate(const char* buf, size_t size,
+                              const upb_MiniTable* l,
+                              const upb_ExtensionRegistry* extreg,
+                              int options) {
+  upb_Validator v;
+  unsigned depth = (unsigned)options >> 16;
+
+  // Aliasing lets us see string data in the original buffer even when parsing
+  // from the patch buffer, so that it can be checked in one piece.
+  upb_EpsCopyInputStream_Init(&v.input, &buf, size, true);
+  v.extreg = extreg;
+  v.options = options;
+  v.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
+  v.end_group = DECODE_NOGROUP;
+  v.missing_required = false;
+  v.status = kUpb_DecodeStatus_Ok;
+
+  if (!_upb_Validator_ValidateMessage(&v, buf, l)) return v.status;
+  if (v.end_group != DECODE_NOGROUP) return kUpb_DecodeStatus_Malformed;
+  if (v.missing_required) return kUpb_DecodeStatus_MissingRequired;
+  return kUpb_DecodeStatus_Ok;
+}
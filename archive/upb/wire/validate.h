@@ -0,0 +1,81 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// upb_Validate: checking that a payload would parse, without parsing it.
+
+#ifndef UPB_WIRE_VALIDATE_H_
+#define UPB_WIRE_VALIDATE_H_
+
+#include <stddef.h>
+
+#include "upb/mini_table/extension_registry.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  /* If set, a value of a closed enum field that is not one of the enum's
+   * values fails validation with kUpb_DecodeStatus_Malformed.  By default such
+   * values are accepted, since upb_Decode() would keep them as unknown
+   * fields. */
+  kUpb_ValidateOption_RejectUnknownEnum = 1 << 15,
+};
+
+// Walks the wire data in `buf` against the MiniTable `l` without storing it
+// anywhere, and returns the status that upb_Decode() would return for the same
+// input.  No memory is allocated, so this is much cheaper than decoding into a
+// scratch arena when the message itself is not needed.
+//
+// `options` takes the same values as upb_Decode(), including the maximum depth
+// and kUpb_DecodeOption_CheckRequired, plus
+// kUpb_ValidateOption_RejectUnknownEnum.  Options that only affect how data is
+// stored, such as kUpb_DecodeOption_AliasString and kUpb_DecodeOption_Lazy,
+// are ignored: sub-messages are always validated in full.  Required fields
+// are checked in each occurrence of a sub-message on its own rather than after
+// merging, so the false positives described for
+// kUpb_DecodeOption_CheckRequired are a little more likely.
+UPB_API upb_DecodeStatus upb_Validate(const char* buf, size_t size,
+                                      const upb_MiniTable* l,
+                                      const upb_ExtensionRegistry* extreg,
+                                      int options);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_VALIDATE_H_ */
@@ -0,0 +1,224 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2023 Google LLC.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google LLC nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/validate.h"
+
+#include <string.h>
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "google/protobuf/descriptor.upb.h"
+#include "upb/base/status.hpp"
+#include "upb/mem/arena.hpp"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.hpp"
+#include "upb/mini_descriptor/internal/modifiers.h"
+#include "upb/mini_descriptor/link.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+namespace {
+
+std::string MakeTestPayload() {
+  upb::Arena arena;
+  google_protobuf_FileDescriptorProto* file =
+      google_protobuf_FileDescriptorProto_new(arena.ptr());
+  google_protobuf_FileDescriptorProto_set_name(
+      file, upb_StringView_FromString("some/path/to/a/file.proto"));
+  for (int i = 0; i < 10; i++) {
+    google_protobuf_DescriptorProto* msg =
+        google_protobuf_FileDescriptorProto_add_message_type(file,
+                                                              arena.ptr());
+    google_protobuf_DescriptorProto_set_name(
+        msg, upb_StringView_FromString("SomeMessage"));
+    for (int j = 0; j < i; j++) {
+      google_protobuf_FieldDescriptorProto* field =
+          google_protobuf_DescriptorProto_add_field(msg, arena.ptr());
+      google_protobuf_FieldDescriptorProto_set_name(
+          field, upb_StringView_FromString("some_field"));
+      google_protobuf_FieldDescriptorProto_set_number(field, j * 1000 + 1);
+      google_protobuf_FieldDescriptorProto_set_label(
+          field, google_protobuf_FieldDescriptorProto_LABEL_OPTIONAL);
+    }
+  }
+  google_protobuf_SourceCodeInfo* info =
+      google_protobuf_FileDescriptorProto_mutable_source_code_info(file,
+                                                                   arena.ptr());
+  google_protobuf_SourceCodeInfo_Location* loc =
+      google_protobuf_SourceCodeInfo_add_location(info, arena.ptr());
+  int32_t* path = google_protobuf_SourceCodeInfo_Location_resize_path(
+      loc, 50, arena.ptr());
+  for (int i = 0; i < 50; i++) path[i] = i * 12345;
+  size_t size;
+  char* buf = google_protobuf_FileDescriptorProto_serialize(file, arena.ptr(),
+                                                           &size);
+  EXPECT_NE(buf, nullptr);
+  // An unknown group.
+  return std::string(buf, size) + "\xc3\x3e\x08\x01\xc4\x3e";
+}
+
+upb_DecodeStatus Decode(const std::string& data, const upb_MiniTable* m,
+                        int options) {
+  upb::Arena arena;
+  upb_Message* msg = upb_Message_New(m, arena.ptr());
+  return upb_Decode(data.data(), data.size(), msg, m, nullptr, options,
+                    arena.ptr());
+}
+
+upb_DecodeStatus Validate(const std::string& data, const upb_MiniTable* m,
+                          int options) {
+  return upb_Validate(data.data(), data.size(), m, nullptr, options);
+}
+
+const upb_MiniTable* FileTable() {
+  return &google_protobuf_FileDescriptorProto_msg_init;
+}
+
+TEST(ValidateTest, Valid) {
+  std::string data = MakeTestPayload();
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate(data, FileTable(), 0));
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate("", FileTable(), 0));
+}
+
+TEST(ValidateTest, Truncated) {
+  std::string data = MakeTestPayload();
+  for (size_t len = 0; len < data.size(); len++) {
+    std::string prefix = data.substr(0, len);
+    EXPECT_EQ(Decode(prefix, FileTable(), 0), Validate(prefix, FileTable(), 0))
+        << len;
+  }
+}
+
+TEST(ValidateTest, MatchesDecodeOnCorruptInput) {
+  std::string data = MakeTestPayload();
+  std::mt19937 rng(12345);
+  for (int i = 0; i < 5000; i++) {
+    std::string corrupt = data;
+    int n = 1 + rng() % 3;
+    for (int j = 0; j < n; j++) {
+      corrupt[rng() % corrupt.size()] = static_cast<char>(rng());
+    }
+    upb_DecodeStatus decoded = Decode(corrupt, FileTable(), 0);
+#if UPB_FASTTABLE
+    // The generated fast table checks UTF-8 in descriptor.proto's strings,
+    // which the validator, like the mini table decoder, does not.
+    if (decoded == kUpb_DecodeStatus_BadUtf8) continue;
+#endif
+    ASSERT_EQ(decoded, Validate(corrupt, FileTable(), 0)) << i;
+  }
+}
+
+TEST(ValidateTest, ClosedEnum) {
+  // message_type { field { label: 99 } }
+  const std::string data("\x22\x04\x12\x02\x20\x63", 6);
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate(data, FileTable(), 0));
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            Validate(data, FileTable(), kUpb_ValidateOption_RejectUnknownEnum));
+  // label: LABEL_REPEATED
+  const std::string valid("\x22\x04\x12\x02\x20\x03", 6);
+  EXPECT_EQ(
+      kUpb_DecodeStatus_Ok,
+      Validate(valid, FileTable(), kUpb_ValidateOption_RejectUnknownEnum));
+}
+
+TEST(ValidateTest, Required) {
+  const upb_MiniTable* name_part =
+      &google_protobuf_UninterpretedOption_NamePart_msg_init;
+  const std::string name("\x0a\x03" "abc");
+  const std::string is_extension("\x10\x01");
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate(name, name_part, 0));
+  EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+            Validate(name, name_part, kUpb_DecodeOption_CheckRequired));
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate(name + is_extension, name_part,
+                                           kUpb_DecodeOption_CheckRequired));
+
+  // FileDescriptorProto.options.uninterpreted_option.name, where the
+  // NamePart is missing is_extension.
+  const std::string missing(
+      "\x42\x08"            // options
+      "\xba\x3e\x05"        // uninterpreted_option
+      "\x12\x03\x0a\x01x");  // name { name_part: "x" }
+  EXPECT_EQ(kUpb_DecodeStatus_MissingRequired,
+            Validate(missing, FileTable(), kUpb_DecodeOption_CheckRequired));
+}
+
+TEST(ValidateTest, MaxDepth) {
+  // Nested unknown groups.
+  std::string data;
+  for (int i = 0; i < 10; i++) data += "\xc3\x3e";
+  for (int i = 0; i < 10; i++) data += "\xc4\x3e";
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            Validate(data, FileTable(), upb_DecodeOptions_MaxDepth(10)));
+  EXPECT_EQ(kUpb_DecodeStatus_MaxDepthExceeded,
+            Validate(data, FileTable(), upb_DecodeOptions_MaxDepth(9)));
+  EXPECT_EQ(Decode(data, FileTable(), upb_DecodeOptions_MaxDepth(9)),
+            Validate(data, FileTable(), upb_DecodeOptions_MaxDepth(9)));
+}
+
+TEST(ValidateTest, Utf8AndPacked) {
+  upb::MtDataEncoder e;
+  e.StartMessage(kUpb_MessageModifier_ValidateUtf8);
+  e.PutField(kUpb_FieldType_String, 1, 0);
+  e.PutField(kUpb_FieldType_Fixed32, 2,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  e.PutField(kUpb_FieldType_Int64, 3,
+             kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  upb::Arena arena;
+  upb::Status status;
+  upb_MiniTable* table = upb_MiniTable_Build(e.data().data(), e.data().size(),
+                                             arena.ptr(), status.ptr());
+  ASSERT_NE(nullptr, table) << status.error_message();
+
+  // Long enough that the string does not fit in the patch buffer.
+  std::string str = "\x0a\x20" + std::string(30, 'x');
+  EXPECT_EQ(kUpb_DecodeStatus_Ok, Validate(str + "\xc3\xa9", table, 0));
+  str += 'x';
+  EXPECT_EQ(kUpb_DecodeStatus_BadUtf8, Validate(str + "\xff", table, 0));
+  EXPECT_EQ(kUpb_DecodeStatus_BadUtf8, Decode(str + "\xff", table, 0));
+
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            Validate(std::string("\x12\x08\1\2\3\4\5\6\7\x8", 10), table, 0));
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            Validate(std::string("\x12\x06\1\2\3\4\5\6", 8), table, 0));
+  EXPECT_EQ(kUpb_DecodeStatus_Ok,
+            Validate(std::string("\x1a\x03\x01\x80\x01", 5), table, 0));
+  // The last varint is cut off by the end of the field.
+  EXPECT_EQ(kUpb_DecodeStatus_Malformed,
+            Validate(std::string("\x1a\x02\x01\x80\x01", 5), table, 0));
+}
+
+}  // namespace
+
+#include "upb/port/undef.inc"
@@ -777,8 +777,9 @@ void GenerateNonRepeatedSetters(upb::FieldDefPtr field,
             struct $0* sub = (struct $0*)$1_$2(msg);
             if (sub == NULL) {
               sub = (struct $0*)_upb_Message_New($3, arena);
-              if (sub) $1_set_$2(msg, sub);
+              if (!sub) return NULL;
             }
+            $1_set_$2(msg, sub);
             return sub;
           }
         )cc",
@@ -1216,6 +1217,126 @@ std::vector<TableEntry> FastDecodeTable(upb::MessageDefPtr message,
   return table;
 }
 
+struct EncodeTableEntry {
+  std::string encoder;
+  uint64_t data32;
+  uint64_t data64;
+};
+
+uint64_t GetEncodeData(const upb_MiniTableField* field, uint64_t tag) {
+  uint64_t presence = 0;
+  if (field->presence > 0) {
+    presence = field->presence;
+  } else if (field->presence < 0) {
+    presence = ~field->presence;
+  }
+  uint64_t submsg_index = field->UPB_PRIVATE(submsg_index) == kUpb_NoSub
+                              ? 0
+                              : field->UPB_PRIVATE(submsg_index);
+  return tag | static_cast<uint64_t>(field->offset) << 16 | presence << 32 |
+         submsg_index << 48;
+}
+
+// Picks the encoder for `field` (see upb/wire/encode_fast.h), which is at
+// `index` in the MiniTable's fields.
+EncodeTableEntry FastEncodeEntry(const DefPoolPair& pools,
+                                 upb::FieldDefPtr field, int index) {
+  const upb_MiniTableField* field32 = pools.GetField32(field);
+  const upb_MiniTableField* field64 = pools.GetField64(field);
+  EncodeTableEntry generic = {"_upb_FastEncoder_EncodeGeneric",
+                              static_cast<uint64_t>(index),
+                              static_cast<uint64_t>(index)};
+
+  uint64_t tag = GetEncodedTag(field);
+  if (tag > 0x7fff) {
+    // Tag must fit within a two-byte varint.
+    return generic;
+  }
+
+  std::string card;
+  switch (upb_FieldMode_Get(field64)) {
+    case kUpb_FieldMode_Map:
+      return generic;
+    case kUpb_FieldMode_Array:
+      if (!(field64->mode & kUpb_LabelFlags_IsPacked)) return generic;
+      card = "p";
+      break;
+    case kUpb_FieldMode_Scalar:
+      if (field64->presence > 0) {
+        card = "h";
+      } else if (field64->presence < 0) {
+        card = "o";
+      } else {
+        card = "s";
+      }
+      break;
+  }
+
+  std::string type;
+  switch (field64->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+      type = "b1";
+      break;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      type = "v4";
+      break;
+    case kUpb_FieldType_UInt32:
+      type = "u4";
+      break;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      type = "v8";
+      break;
+    case kUpb_FieldType_SInt32:
+      type = "z4";
+      break;
+    case kUpb_FieldType_SInt64:
+      type = "z8";
+      break;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      type = "f4";
+      break;
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      type = "f8";
+      break;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      type = "s";
+      break;
+    case kUpb_FieldType_Message:
+      type = "m";
+      break;
+    default:
+      // Groups are rare enough to leave to the generic encoder.
+      return generic;
+  }
+
+  return {absl::Substitute("upb_e$0$1_$2bt", card, type, tag > 0xff ? 2 : 1),
+          GetEncodeData(field32, tag), GetEncodeData(field64, tag)};
+}
+
+// Returns an empty table if no field has a specialized encoder.
+std::vector<EncodeTableEntry> FastEncodeTable(upb::MessageDefPtr message,
+                                              const DefPoolPair& pools) {
+  const upb_MiniTable* mt_64 = pools.GetMiniTable64(message);
+  std::vector<EncodeTableEntry> table;
+  bool any_specialized = false;
+  for (int i = 0; i < mt_64->field_count; i++) {
+    upb::FieldDefPtr field = message.FindFieldByNumber(mt_64->fields[i].number);
+    table.push_back(FastEncodeEntry(pools, field, i));
+    if (table.back().encoder != "_upb_FastEncoder_EncodeGeneric") {
+      any_specialized = true;
+    }
+  }
+  if (!any_specialized) table.clear();
+  return table;
+}
+
 std::string ArchDependentSize(int64_t size32, int64_t size64) {
   if (size32 == size64) return absl::StrCat(size32);
   return absl::Substitute("UPB_SIZE($0, $1)", size32, size64);
@@ -1387,6 +1508,58 @@ void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
     output("};\n\n");
   }
 
+  std::string field_hash_ref = "NULL";
+
+  if (mt_64->field_hash) {
+    // Field indices are the same on every platform, so the 64-bit hash is
+    // valid for 32-bit too.
+    const struct upb_MiniTableFieldHash* hash = mt_64->field_hash;
+    const uint32_t slot_count = 1u << (32 - hash->shift);
+    std::string slots_array_name = msg_name + "__field_hash_slots";
+    std::string hash_name = msg_name + "__field_hash";
+    std::string slots;
+    for (uint32_t i = 0; i < slot_count; i++) {
+      absl::StrAppend(&slots, i % 16 == 0 ? "  " : " ", hash->slots[i], ",",
+                      i % 16 == 15 || i + 1 == slot_count ? "\n" : "");
+    }
+    output("static const uint16_t $0[$1] = {\n$2};\n\n", slots_array_name,
+           slot_count, slots);
+    output("static const struct upb_MiniTableFieldHash $0 = {\n", hash_name);
+    output("  &$0[0], 0x$1, $2,\n", slots_array_name,
+           absl::StrCat(absl::Hex(hash->mul, absl::kZeroPad8)),
+           static_cast<int>(hash->shift));
+    output("};\n\n");
+    field_hash_ref = "&" + hash_name;
+  }
+
+  std::string encode_table_ref = "NULL";
+
+  // Offsets are hard-coded into the encode table, so it can't be used with the
+  // bootstrap MiniTables, which are built at runtime.
+  if (!options.bootstrap) {
+    std::vector<EncodeTableEntry> encode_table =
+        FastEncodeTable(message, pools);
+    if (!encode_table.empty()) {
+      std::string encode_table_name = msg_name + "__encode_table";
+      output("static const _upb_FastEncoder_Entry $0[$1] = {\n",
+             encode_table_name, encode_table.size());
+      for (const auto& ent : encode_table) {
+        std::string data64 =
+            absl::StrCat("0x", absl::Hex(ent.data64, absl::kZeroPad16));
+        std::string data =
+            ent.data32 == ent.data64
+                ? data64
+                : absl::Substitute(
+                      "UPB_SIZE(0x$0, $1)",
+                      absl::StrCat(absl::Hex(ent.data32, absl::kZeroPad16)),
+                      data64);
+        output("  {$0, &$1},\n", data, ent.encoder);
+      }
+      output("};\n\n");
+      encode_table_ref = "&" + encode_table_name + "[0]";
+    }
+  }
+
   std::vector<TableEntry> table;
   uint8_t table_mask = -1;
 
@@ -1413,6 +1586,8 @@ void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
   output("  $0, $1, $2, $3, UPB_FASTTABLE_MASK($4), $5,\n",
          ArchDependentSize(mt_32->size, mt_64->size), mt_64->field_count,
          msgext, mt_64->dense_below, table_mask, mt_64->required_count);
+  output("  $0,\n", field_hash_ref);
+  output("  $0,\n", encode_table_ref);
   if (!table.empty()) {
     output("  UPB_FASTTABLE_INIT({\n");
     for (const auto& ent : table) {
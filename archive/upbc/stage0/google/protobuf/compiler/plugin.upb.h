@@ -294,8 +294,9 @@ UPB_INLINE struct google_protobuf_compiler_Version* google_protobuf_compiler_Cod
   struct google_protobuf_compiler_Version* sub = (struct google_protobuf_compiler_Version*)google_protobuf_compiler_CodeGeneratorRequest_compiler_version(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_compiler_Version*)_upb_Message_New(google_protobuf_compiler_Version_msg_init(), arena);
-    if (sub) google_protobuf_compiler_CodeGeneratorRequest_set_compiler_version(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_compiler_CodeGeneratorRequest_set_compiler_version(msg, sub);
   return sub;
 }
 UPB_INLINE struct google_protobuf_FileDescriptorProto** google_protobuf_compiler_CodeGeneratorRequest_mutable_proto_file(google_protobuf_compiler_CodeGeneratorRequest* msg, size_t* size) {
@@ -562,8 +563,9 @@ UPB_INLINE struct google_protobuf_GeneratedCodeInfo* google_protobuf_compiler_Co
   struct google_protobuf_GeneratedCodeInfo* sub = (struct google_protobuf_GeneratedCodeInfo*)google_protobuf_compiler_CodeGeneratorResponse_File_generated_code_info(msg);
   if (sub == NULL) {
     sub = (struct google_protobuf_GeneratedCodeInfo*)_upb_Message_New(google_protobuf_GeneratedCodeInfo_msg_init(), arena);
-    if (sub) google_protobuf_compiler_CodeGeneratorResponse_File_set_generated_code_info(msg, sub);
+    if (!sub) return NULL;
   }
+  google_protobuf_compiler_CodeGeneratorResponse_File_set_generated_code_info(msg, sub);
   return sub;
 }
 